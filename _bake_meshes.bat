@@ -0,0 +1,7 @@
+@echo off
+
+set mesh_baker=x64\Release\mesh_baker.exe
+
+for /r %%m in (data\*.gltf) do (
+	%mesh_baker% %%m %%~dpnm.mesh
+)
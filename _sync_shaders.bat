@@ -2,7 +2,12 @@
 
 del data\shaders\*.spv
 
+rem Bindless shaders need Vulkan 1.2; the rest target 1.0 so they also run where only the fallback path is available.
+setlocal enabledelayedexpansion
+
 for /r %%v in (data\shaders\*.vert,data\shaders\*.frag) do (
-	%VULKAN_SDK%\Bin32\glslc.exe %%v -o %%v.spv
+	set target_env=vulkan1.0
+	if /i "%%~nv"=="bindless" set target_env=vulkan1.2
+	%VULKAN_SDK%\Bin32\glslc.exe --target-env=!target_env! %%v -o %%v.spv
 	echo compiled %%~nxv to %%~nxv.spv
 )
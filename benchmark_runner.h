@@ -0,0 +1,323 @@
+#pragma once
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "renderer/json.h"
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+#include "ctk/containers.h"
+#include "ctk/file.h"
+#include "ctk/math.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+static constexpr u32 BENCHMARK_MAX_NAME_SIZE = 64;
+
+struct CameraKeyframe {
+    Vec3<f32> position;
+    Vec3<f32> rotation; // Euler angles in degrees.
+};
+
+// Keyframes are spread evenly over a benchmark's measured frames and interpolated with a Catmull-Rom spline, so the
+// camera's pose only depends on the frame index, never on frame time.
+struct CameraPath {
+    CameraKeyframe *keyframes;
+    u32 keyframe_count;
+};
+
+struct BenchmarkRunnerInfo {
+    cstr name;
+    u32 warmup_frame_count; // Frames rendered before measuring, so caches, LODs and texture streaming settle.
+    u32 frame_count;        // Measured frames.
+    u32 max_stages;
+};
+
+// A timed part of the frame; samples are milliseconds per measured frame, negative where none was recorded.
+struct BenchmarkStage {
+    char name[BENCHMARK_MAX_NAME_SIZE];
+    f64 *samples;
+};
+
+struct BenchmarkStats {
+    u32 sample_count;
+    f64 min;
+    f64 mean;
+    f64 p50;
+    f64 p95;
+    f64 p99;
+    f64 max;
+};
+
+struct BenchmarkRunner {
+    BenchmarkRunnerInfo info;
+    char name[BENCHMARK_MAX_NAME_SIZE];
+    BenchmarkStage *stages;
+    u32 stage_count;
+    u32 frame; // Includes warmup frames.
+    f64 *sorted_samples; // Scratch for percentiles.
+};
+
+////////////////////////////////////////////////////////////
+/// Internal
+////////////////////////////////////////////////////////////
+static s32 compare_benchmark_samples(const void *a, const void *b) {
+    f64 sample_a = *(f64 *)a;
+    f64 sample_b = *(f64 *)b;
+    return sample_a < sample_b ? -1 : sample_a > sample_b ? 1 : 0;
+}
+
+// Nearest-rank percentile of sorted samples.
+static f64 benchmark_percentile(f64 *sorted, u32 count, f64 percentile) {
+    u32 rank = (u32)ceil(percentile / 100.0 * count);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static f32 catmull_rom(f32 p0, f32 p1, f32 p2, f32 p3, f32 t) {
+    f32 t2 = t * t;
+    f32 t3 = t2 * t;
+    return 0.5f * (2 * p1 + (p2 - p0) * t + (2 * p0 - 5 * p1 + 4 * p2 - p3) * t2 + (3 * p1 - p0 - 3 * p2 + p3) * t3);
+}
+
+static Vec3<f32> catmull_rom(Vec3<f32> p0, Vec3<f32> p1, Vec3<f32> p2, Vec3<f32> p3, f32 t) {
+    return {
+        catmull_rom(p0.x, p1.x, p2.x, p3.x, t),
+        catmull_rom(p0.y, p1.y, p2.y, p3.y, t),
+        catmull_rom(p0.z, p1.z, p2.z, p3.z, t),
+    };
+}
+
+static Vec3<f32> load_camera_vec3(JSON *json, u32 array_idx) {
+    if (json_count(json, array_idx) != 3)
+        CTK_FATAL("camera path: expected array of 3 numbers");
+
+    return {
+        (f32)json_number(json, json_element(json, array_idx, 0)),
+        (f32)json_number(json, json_element(json, array_idx, 1)),
+        (f32)json_number(json, json_element(json, array_idx, 2)),
+    };
+}
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+// Loads a camera path from JSON: { "keyframes": [ { "position": [x, y, z], "rotation": [x, y, z] }, ... ] }.
+static CameraPath load_camera_path(Allocator *allocator, cstr path) {
+    Array<u8> *source = read_file<u8>(allocator, path);
+    if (source == NULL)
+        CTK_FATAL("failed to read camera path \"%s\"", path);
+
+    JSON *json = parse_json(allocator, (cstr)source->data, source->count);
+    u32 keyframes_idx = json_member(json, 0, "keyframes");
+    u32 keyframe_count = json_count(json, keyframes_idx);
+    if (keyframe_count < 2)
+        CTK_FATAL("camera path \"%s\" needs at least 2 keyframes", path);
+
+    CameraPath camera_path = {};
+    camera_path.keyframes = allocate<CameraKeyframe>(allocator, keyframe_count);
+    camera_path.keyframe_count = keyframe_count;
+    for (u32 i = 0; i < keyframe_count; ++i) {
+        u32 keyframe_idx = json_element(json, keyframes_idx, i);
+        camera_path.keyframes[i] = {
+            .position = load_camera_vec3(json, json_member(json, keyframe_idx, "position")),
+            .rotation = load_camera_vec3(json, json_member(json, keyframe_idx, "rotation")),
+        };
+    }
+
+    return camera_path;
+}
+
+// Samples path at t in [0, 1]; end keyframes are repeated as spline control points.
+static CameraKeyframe sample_camera_path(CameraPath *path, f32 t) {
+    CTK_ASSERT(path->keyframe_count >= 2);
+    t = t < 0 ? 0 : t > 1 ? 1 : t;
+
+    u32 segment_count = path->keyframe_count - 1;
+    f32 segment_t = t * segment_count;
+    u32 segment = (u32)segment_t;
+    if (segment >= segment_count)
+        segment = segment_count - 1;
+
+    f32 local_t = segment_t - segment;
+    CameraKeyframe *k0 = path->keyframes + (segment > 0 ? segment - 1 : 0);
+    CameraKeyframe *k1 = path->keyframes + segment;
+    CameraKeyframe *k2 = path->keyframes + segment + 1;
+    CameraKeyframe *k3 = path->keyframes + (segment + 2 < path->keyframe_count ? segment + 2 : segment + 1);
+
+    return {
+        .position = catmull_rom(k0->position, k1->position, k2->position, k3->position, local_t),
+        .rotation = catmull_rom(k0->rotation, k1->rotation, k2->rotation, k3->rotation, local_t),
+    };
+}
+
+static BenchmarkRunner *create_benchmark_runner(Allocator *allocator, BenchmarkRunnerInfo info) {
+    if (info.frame_count == 0)
+        CTK_FATAL("benchmark needs at least one measured frame");
+
+    auto runner = allocate<BenchmarkRunner>(allocator, 1);
+    *runner = {};
+    runner->info = info;
+    snprintf(runner->name, sizeof(runner->name), "%s", info.name);
+    runner->info.name = runner->name;
+    runner->stages = allocate<BenchmarkStage>(allocator, info.max_stages);
+    runner->sorted_samples = allocate<f64>(allocator, info.frame_count);
+
+    for (u32 i = 0; i < info.max_stages; ++i)
+        runner->stages[i].samples = allocate<f64>(allocator, info.frame_count);
+
+    return runner;
+}
+
+// Returns the stage's index for record_benchmark_sample().
+static u32 add_benchmark_stage(BenchmarkRunner *runner, cstr name) {
+    if (runner->stage_count == runner->info.max_stages)
+        CTK_FATAL("benchmark cannot have more than %u stages", runner->info.max_stages);
+
+    BenchmarkStage *stage = runner->stages + runner->stage_count;
+    snprintf(stage->name, sizeof(stage->name), "%s", name);
+    for (u32 i = 0; i < runner->info.frame_count; ++i)
+        stage->samples[i] = -1.0;
+
+    return runner->stage_count++;
+}
+
+static bool benchmark_running(BenchmarkRunner *runner) {
+    return runner->frame < runner->info.warmup_frame_count + runner->info.frame_count;
+}
+
+static bool benchmark_measuring(BenchmarkRunner *runner) {
+    return runner->frame >= runner->info.warmup_frame_count && benchmark_running(runner);
+}
+
+// Position along the camera path for the current frame; warmup frames hold the start of the path.
+static f32 get_benchmark_progress(BenchmarkRunner *runner) {
+    if (runner->frame < runner->info.warmup_frame_count || runner->info.frame_count == 1)
+        return 0;
+
+    return (f32)(runner->frame - runner->info.warmup_frame_count) / (runner->info.frame_count - 1);
+}
+
+// Records a sample for frame, which may be earlier than the current frame for results that arrive late (e.g. GPU
+// timestamps). Samples for warmup frames are ignored.
+static void record_benchmark_sample(BenchmarkRunner *runner, u32 stage, u32 frame, f64 ms) {
+    CTK_ASSERT(stage < runner->stage_count);
+    if (frame < runner->info.warmup_frame_count || frame >= runner->info.warmup_frame_count + runner->info.frame_count)
+        return;
+
+    runner->stages[stage].samples[frame - runner->info.warmup_frame_count] = ms;
+}
+
+static void next_benchmark_frame(BenchmarkRunner *runner) {
+    ++runner->frame;
+}
+
+static BenchmarkStats get_benchmark_stats(BenchmarkRunner *runner, u32 stage) {
+    BenchmarkStats stats = {};
+    f64 *samples = runner->stages[stage].samples;
+    f64 total = 0;
+
+    for (u32 i = 0; i < runner->info.frame_count; ++i) {
+        if (samples[i] < 0)
+            continue;
+
+        runner->sorted_samples[stats.sample_count++] = samples[i];
+        total += samples[i];
+    }
+
+    if (stats.sample_count == 0)
+        return stats;
+
+    f64 *sorted = runner->sorted_samples;
+    qsort(sorted, stats.sample_count, sizeof(f64), compare_benchmark_samples);
+    stats.min = sorted[0];
+    stats.mean = total / stats.sample_count;
+    stats.p50 = benchmark_percentile(sorted, stats.sample_count, 50);
+    stats.p95 = benchmark_percentile(sorted, stats.sample_count, 95);
+    stats.p99 = benchmark_percentile(sorted, stats.sample_count, 99);
+    stats.max = sorted[stats.sample_count - 1];
+
+    return stats;
+}
+
+static void print_benchmark_results(BenchmarkRunner *runner) {
+    print_line("benchmark \"%s\": %u frames (%u warmup)", runner->name, runner->info.frame_count,
+               runner->info.warmup_frame_count);
+
+    for (u32 stage = 0; stage < runner->stage_count; ++stage) {
+        BenchmarkStats stats = get_benchmark_stats(runner, stage);
+        print_line("    %-16s min %8.3fms  mean %8.3fms  p50 %8.3fms  p95 %8.3fms  p99 %8.3fms  (%u samples)",
+                   runner->stages[stage].name, stats.min, stats.mean, stats.p50, stats.p95, stats.p99,
+                   stats.sample_count);
+    }
+}
+
+// Writes summary stats and raw per-frame samples for every stage; missing samples are null.
+static bool write_benchmark_json(BenchmarkRunner *runner, cstr path) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        warning("failed to open benchmark results \"%s\"", path);
+        return false;
+    }
+
+    fprintf(file, "{\n    \"name\": \"%s\",\n    \"warmup_frame_count\": %u,\n    \"frame_count\": %u,\n",
+            runner->name, runner->info.warmup_frame_count, runner->info.frame_count);
+    fprintf(file, "    \"stages\": [\n");
+
+    for (u32 stage = 0; stage < runner->stage_count; ++stage) {
+        BenchmarkStats stats = get_benchmark_stats(runner, stage);
+        fprintf(file, "        {\n            \"name\": \"%s\",\n", runner->stages[stage].name);
+        fprintf(file, "            \"sample_count\": %u,\n", stats.sample_count);
+        fprintf(file, "            \"min\": %.6f,\n            \"mean\": %.6f,\n", stats.min, stats.mean);
+        fprintf(file, "            \"p50\": %.6f,\n            \"p95\": %.6f,\n", stats.p50, stats.p95);
+        fprintf(file, "            \"p99\": %.6f,\n            \"max\": %.6f,\n", stats.p99, stats.max);
+        fprintf(file, "            \"samples\": [");
+
+        f64 *samples = runner->stages[stage].samples;
+        for (u32 i = 0; i < runner->info.frame_count; ++i) {
+            cstr separator = i > 0 ? ", " : "";
+            if (samples[i] < 0)
+                fprintf(file, "%snull", separator);
+            else
+                fprintf(file, "%s%.6f", separator, samples[i]);
+        }
+
+        fprintf(file, "]\n        }%s\n", stage + 1 < runner->stage_count ? "," : "");
+    }
+
+    fprintf(file, "    ]\n}\n");
+    fclose(file);
+    return true;
+}
+
+// Writes one row per measured frame with a column per stage; missing samples are left empty.
+static bool write_benchmark_csv(BenchmarkRunner *runner, cstr path) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        warning("failed to open benchmark results \"%s\"", path);
+        return false;
+    }
+
+    fprintf(file, "frame");
+    for (u32 stage = 0; stage < runner->stage_count; ++stage)
+        fprintf(file, ",%s", runner->stages[stage].name);
+    fprintf(file, "\n");
+
+    for (u32 i = 0; i < runner->info.frame_count; ++i) {
+        fprintf(file, "%u", i);
+        for (u32 stage = 0; stage < runner->stage_count; ++stage) {
+            f64 sample = runner->stages[stage].samples[i];
+            if (sample < 0)
+                fprintf(file, ",");
+            else
+                fprintf(file, ",%.6f", sample);
+        }
+        fprintf(file, "\n");
+    }
+
+    fclose(file);
+    return true;
+}
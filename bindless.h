@@ -0,0 +1,171 @@
+#pragma once
+
+#include "renderer/vulkan.h"
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+struct BindlessInfo {
+    u32 max_textures;
+    u32 max_buffers;
+    VkShaderStageFlags stage;
+};
+
+// One descriptor set holding every texture and storage buffer, indexed from shaders. Binding 0 is a combined image
+// sampler array and binding 1 is a storage buffer array. Both are update-after-bind and partially bound, so slots can
+// be filled at any time and unused slots can stay empty.
+struct Bindless {
+    VkDescriptorPool pool;
+    VkDescriptorSetLayout layout;
+    VkDescriptorSet set;
+    BindlessInfo info;
+    u32 texture_count;
+    u32 buffer_count;
+};
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+static constexpr u32 BINDLESS_TEXTURE_BINDING = 0;
+static constexpr u32 BINDLESS_BUFFER_BINDING = 1;
+
+static Bindless *create_bindless(Allocator *allocator, Vulkan *vk, BindlessInfo info) {
+    if (!vk->descriptor_indexing_enabled)
+        CTK_FATAL("cannot create bindless descriptors: descriptor indexing is not enabled");
+
+    if (info.max_textures > vk->physical_device.max_update_after_bind_sampled_images ||
+        info.max_buffers > vk->physical_device.max_update_after_bind_storage_buffers)
+    {
+        CTK_FATAL("bindless descriptor counts (textures=%u buffers=%u) exceed device limits (textures=%u buffers=%u)",
+                  info.max_textures, info.max_buffers,
+                  vk->physical_device.max_update_after_bind_sampled_images,
+                  vk->physical_device.max_update_after_bind_storage_buffers);
+    }
+
+    auto bindless = allocate<Bindless>(allocator, 1);
+    bindless->info = info;
+
+    // Pool
+    VkDescriptorPoolSize pool_sizes[] = {
+        { .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = info.max_textures },
+        { .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = info.max_buffers },
+    };
+
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = CTK_ARRAY_SIZE(pool_sizes);
+    pool_info.pPoolSizes = pool_sizes;
+    validate_result(vkCreateDescriptorPool(vk->device, &pool_info, NULL, &bindless->pool),
+                    "failed to create bindless descriptor pool");
+
+    // Layout
+    VkDescriptorSetLayoutBinding bindings[] = {
+        {
+            .binding = BINDLESS_TEXTURE_BINDING,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = info.max_textures,
+            .stageFlags = info.stage,
+            .pImmutableSamplers = NULL,
+        },
+        {
+            .binding = BINDLESS_BUFFER_BINDING,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = info.max_buffers,
+            .stageFlags = info.stage,
+            .pImmutableSamplers = NULL,
+        },
+    };
+
+    VkDescriptorBindingFlags binding_flags[] = {
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
+    };
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info = {};
+    binding_flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    binding_flags_info.bindingCount = CTK_ARRAY_SIZE(binding_flags);
+    binding_flags_info.pBindingFlags = binding_flags;
+
+    VkDescriptorSetLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.pNext = &binding_flags_info;
+    layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layout_info.bindingCount = CTK_ARRAY_SIZE(bindings);
+    layout_info.pBindings = bindings;
+    validate_result(vkCreateDescriptorSetLayout(vk->device, &layout_info, NULL, &bindless->layout),
+                    "failed to create bindless descriptor set layout");
+
+    // Set
+    bindless->set = allocate_descriptor_set(vk, bindless->pool, bindless->layout);
+
+    return bindless;
+}
+
+static void update_bindless_texture(Vulkan *vk, Bindless *bindless, u32 index, ImageSampler *image_sampler) {
+    CTK_ASSERT(index < bindless->texture_count);
+
+    VkDescriptorImageInfo image_info = {};
+    image_info.sampler = image_sampler->sampler;
+    image_info.imageView = image_sampler->image->view;
+    image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = bindless->set;
+    write.dstBinding = BINDLESS_TEXTURE_BINDING;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &image_info;
+    vkUpdateDescriptorSets(vk->device, 1, &write, 0, NULL);
+}
+
+static void update_bindless_buffer(Vulkan *vk, Bindless *bindless, u32 index, Region *region) {
+    CTK_ASSERT(index < bindless->buffer_count);
+
+    VkDescriptorBufferInfo buffer_info = {};
+    buffer_info.buffer = region->buffer->handle;
+    buffer_info.offset = region->offset;
+    buffer_info.range = region->size;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = bindless->set;
+    write.dstBinding = BINDLESS_BUFFER_BINDING;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &buffer_info;
+    vkUpdateDescriptorSets(vk->device, 1, &write, 0, NULL);
+}
+
+// Returns index shaders use to access image_sampler through the bindless texture array.
+static u32 add_bindless_texture(Vulkan *vk, Bindless *bindless, ImageSampler *image_sampler) {
+    if (bindless->texture_count == bindless->info.max_textures)
+        CTK_FATAL("cannot add any more bindless textures (max=%u)", bindless->info.max_textures);
+
+    u32 index = bindless->texture_count++;
+    update_bindless_texture(vk, bindless, index, image_sampler);
+    return index;
+}
+
+// Returns index shaders use to access region through the bindless storage buffer array.
+static u32 add_bindless_buffer(Vulkan *vk, Bindless *bindless, Region *region) {
+    if (bindless->buffer_count == bindless->info.max_buffers)
+        CTK_FATAL("cannot add any more bindless buffers (max=%u)", bindless->info.max_buffers);
+
+    u32 index = bindless->buffer_count++;
+    update_bindless_buffer(vk, bindless, index, region);
+    return index;
+}
+
+static void bind_bindless(VkCommandBuffer cmd_buf, Bindless *bindless, VkPipelineLayout layout, u32 set_index) {
+    vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, set_index, 1, &bindless->set, 0, NULL);
+    count_render_stat(RenderCounter::DESCRIPTOR_SET_BINDS);
+}
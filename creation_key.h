@@ -0,0 +1,152 @@
+#pragma once
+
+#include <string.h>
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+#include "ctk/containers.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+// Canonical byte stream of everything that affects creating an object, for caches that deduplicate pipelines, layouts
+// and descriptor sets. The same walk hashes the stream, copies it out or compares it with a stored copy, so hash
+// collisions are caught without building the stream in temp memory first.
+struct CreationKey {
+    u64 hash;
+    u32 size;
+    u8 *copy;    // Stream is written here when not NULL.
+    u8 *compare; // Stream is compared with these bytes when not NULL; must be at least as long as the stream.
+    bool mismatch;
+};
+
+// A key kept with a cached object.
+struct StoredCreationKey {
+    u64 hash;
+    u8 *data;
+    u32 size;
+};
+
+// Open-addressed hash table of indexes into an array of entries that each have a StoredCreationKey named key; U32_MAX
+// marks empty slots.
+struct CreationKeyTable {
+    u32 *slots;
+    u32 size;
+};
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+static void write_creation_key_bytes(CreationKey *key, void *data, u64 size) {
+    if (size == 0)
+        return;
+
+    // FNV-1a
+    auto bytes = (u8 *)data;
+    for (u64 i = 0; i < size; ++i)
+        key->hash = (key->hash ^ bytes[i]) * 1099511628211ull;
+
+    if (key->copy != NULL)
+        memcpy(key->copy + key->size, data, size);
+
+    if (key->compare != NULL && !key->mismatch && memcmp(key->compare + key->size, data, size) != 0)
+        key->mismatch = true;
+
+    key->size += (u32)size;
+}
+
+// Only for padding-free types.
+template<typename Value>
+static void write_creation_key_value(CreationKey *key, Value value) {
+    write_creation_key_bytes(key, &value, sizeof(Value));
+}
+
+// Only for padding-free element types.
+template<typename Type>
+static void write_creation_key_array(CreationKey *key, Array<Type> *array) {
+    u32 count = array ? array->count : 0;
+    write_creation_key_value(key, count);
+    if (count > 0)
+        write_creation_key_bytes(key, array->data, count * sizeof(Type));
+}
+
+// write_key(CreationKey *) walks the stream; it runs once to hash and size the key, and again to compare or copy it.
+template<typename WriteKey>
+static CreationKey get_creation_key(WriteKey write_key) {
+    CreationKey key = { .hash = 14695981039346656037ull };
+    write_key(&key);
+    return key;
+}
+
+template<typename WriteKey>
+static bool creation_key_matches(WriteKey write_key, CreationKey *key, StoredCreationKey *stored) {
+    if (stored->hash != key->hash || stored->size != key->size)
+        return false;
+
+    CreationKey compare_key = { .compare = stored->data };
+    write_key(&compare_key);
+    return !compare_key.mismatch;
+}
+
+// data must have room for key->size bytes.
+template<typename WriteKey>
+static StoredCreationKey store_creation_key(WriteKey write_key, CreationKey *key, u8 *data) {
+    CreationKey copy_key = { .copy = data };
+    write_key(&copy_key);
+    return { .hash = key->hash, .data = data, .size = key->size };
+}
+
+template<typename WriteKey>
+static StoredCreationKey store_creation_key(Allocator *allocator, WriteKey write_key, CreationKey *key) {
+    return store_creation_key(write_key, key, allocate<u8>(allocator, key->size > 0 ? key->size : 1));
+}
+
+static void clear_creation_key_table(CreationKeyTable *table) {
+    for (u32 i = 0; i < table->size; ++i)
+        table->slots[i] = U32_MAX;
+}
+
+static CreationKeyTable create_creation_key_table(Allocator *allocator, u32 max_entries) {
+    // Keep load factor at or below 0.5.
+    CreationKeyTable table = {};
+    table.size = 1;
+    while (table.size < max_entries * 2)
+        table.size *= 2;
+
+    table.slots = allocate<u32>(allocator, table.size);
+    clear_creation_key_table(&table);
+    return table;
+}
+
+// Returns the index of the entry whose key matches, or U32_MAX with *insert_slot set to the slot a new entry for key
+// goes in.
+template<typename Entry, typename WriteKey>
+static u32 find_creation_key_entry(CreationKeyTable *table, Entry *entries, WriteKey write_key, CreationKey *key,
+                                   u32 *insert_slot)
+{
+    u32 table_mask = table->size - 1;
+    u32 slot = (u32)key->hash & table_mask;
+    for (; table->slots[slot] != U32_MAX; slot = (slot + 1) & table_mask) {
+        u32 entry_idx = table->slots[slot];
+        if (creation_key_matches(write_key, key, &entries[entry_idx].key))
+            return entry_idx;
+    }
+
+    *insert_slot = slot;
+    return U32_MAX;
+}
+
+// Reinserts every entry, for when entries' keys changed in place.
+template<typename Entry>
+static void rebuild_creation_key_table(CreationKeyTable *table, Entry *entries, u32 entry_count) {
+    clear_creation_key_table(table);
+    u32 table_mask = table->size - 1;
+    for (u32 entry_idx = 0; entry_idx < entry_count; ++entry_idx) {
+        u32 slot = (u32)entries[entry_idx].key.hash & table_mask;
+        while (table->slots[slot] != U32_MAX)
+            slot = (slot + 1) & table_mask;
+
+        table->slots[slot] = entry_idx;
+    }
+}
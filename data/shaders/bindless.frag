@@ -0,0 +1,19 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout (location = 0) in vec2 in_uv;
+layout (location = 1) flat in uint in_texture_index;
+layout (location = 0) out vec4 out_color;
+
+layout (set = 0, binding = 0) uniform sampler2D textures[];
+
+// Set when every invocation in a draw uses the same texture index, so indexing doesn't need to be non-uniform.
+layout (constant_id = 0) const bool UNIFORM_TEXTURE_INDEX = false;
+
+void main() {
+    if (UNIFORM_TEXTURE_INDEX)
+        out_color = texture(textures[in_texture_index], in_uv);
+    else
+        out_color = texture(textures[nonuniformEXT(in_texture_index)], in_uv);
+}
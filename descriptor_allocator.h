@@ -0,0 +1,334 @@
+#pragma once
+
+#include "renderer/vulkan.h"
+#include "renderer/creation_key.h"
+#include "renderer/pipeline_registry.h"
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+#include "ctk/containers.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+struct DescriptorAllocatorInfo {
+    DescriptorPoolInfo pool;     // Size of each pool; chains grow by one pool of this size at a time.
+    u32 max_pools_per_chain;
+    u32 frame_count;             // Frames that can be in flight; each gets its own transient pool chain.
+    u32 max_transient_sets;      // Per frame.
+    u32 max_transient_key_bytes; // Per frame; each set's key is ~16 bytes plus 20-28 per bound resource.
+};
+
+// Pools allocated from in order; when one runs out, the next is created (or reused after a reset) and allocation
+// retried.
+struct DescriptorPoolChain {
+    Array<VkDescriptorPool> *pools;
+    u32 current;
+};
+
+struct TransientDescriptorSet {
+    StoredCreationKey key; // In the frame's key_data.
+    VkDescriptorSet handle;
+};
+
+struct TransientDescriptorFrame {
+    DescriptorPoolChain chain;
+
+    // Sets allocated this frame, keyed by layout and bound resources.
+    TransientDescriptorSet *sets;
+    CreationKeyTable set_table;
+    u32 set_count;
+
+    u8 *key_data;
+    u32 key_data_size;
+};
+
+struct DescriptorAllocatorStats {
+    u32 persistent_pool_count;
+    u32 transient_pool_count;   // Across all frames.
+    u32 transient_set_count;    // Allocated for the current frame.
+    u32 reused_transient_count; // Requests for the current frame served by an existing set.
+};
+
+// Descriptor sets that outlive a frame come from a persistent pool chain; per-frame sets come from transient chains
+// that are reset wholesale when their frame comes around again. Not thread-safe; sets are allocated and written from
+// the thread preparing each frame. Set layouts come from the pipeline registry, so layouts reflected from shaders and
+// layouts requested here are the same handles.
+struct DescriptorAllocator {
+    Vulkan *vk;
+    PipelineRegistry *registry;
+    DescriptorAllocatorInfo info;
+
+    DescriptorPoolChain persistent;
+    TransientDescriptorFrame *frames;
+    TransientDescriptorFrame *frame;
+    u32 reused_transient_count;
+};
+
+////////////////////////////////////////////////////////////
+/// Internal
+////////////////////////////////////////////////////////////
+// Writes the resources each binding refers to rather than the binding structs, so identical tuples match even when
+// their Region or ImageSampler structs are different copies.
+static void write_descriptor_bindings_key(CreationKey *key, VkDescriptorSetLayout layout,
+                                          DescriptorBinding *bindings, u32 binding_count)
+{
+    write_creation_key_value(key, layout);
+    write_creation_key_value(key, binding_count);
+    for (u32 i = 0; i < binding_count; ++i) {
+        DescriptorBinding *binding = bindings + i;
+        write_creation_key_value(key, binding->type);
+        if (binding->type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER) {
+            write_creation_key_value(key, binding->image_sampler->image->view);
+            write_creation_key_value(key, binding->image_sampler->sampler);
+        }
+        else {
+            write_creation_key_value(key, binding->uniform_buffer->buffer->handle);
+            write_creation_key_value(key, binding->uniform_buffer->offset);
+            write_creation_key_value(key, binding->uniform_buffer->size);
+        }
+    }
+}
+
+static void write_descriptor_template_key(CreationKey *key, VkDescriptorSetLayout layout,
+                                          DescriptorUpdateTemplate *update_template, DescriptorTemplateData *data)
+{
+    write_creation_key_value(key, layout);
+    write_creation_key_value(key, update_template->handle);
+    write_creation_key_bytes(key, data, update_template->descriptor_count * sizeof(DescriptorTemplateData));
+}
+
+static VkResult try_allocate_descriptor_sets(Vulkan *vk, VkDescriptorPool pool, VkDescriptorSetLayout layout,
+                                             u32 count, VkDescriptorSet *descriptor_sets)
+{
+    push_frame(vk->mem.temp);
+
+    auto layouts = create_array<VkDescriptorSetLayout>(vk->mem.temp, count);
+    CTK_REPEAT(count)
+        push(layouts, layout);
+
+    VkDescriptorSetAllocateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    info.descriptorPool = pool;
+    info.descriptorSetCount = count;
+    info.pSetLayouts = layouts->data;
+    VkResult result = vkAllocateDescriptorSets(vk->device, &info, descriptor_sets);
+
+    pop_frame(vk->mem.temp);
+
+    return result;
+}
+
+static void allocate_from_chain(DescriptorAllocator *allocator, DescriptorPoolChain *chain,
+                                VkDescriptorSetLayout layout, u32 count, VkDescriptorSet *descriptor_sets)
+{
+    for (u32 first_pool = chain->current;; ++chain->current) {
+        // Pools past current are either not created yet, or were reset and are empty.
+        bool pool_empty = chain->current != first_pool;
+        if (chain->current == chain->pools->count) {
+            if (chain->pools->count == chain->pools->size) {
+                CTK_FATAL("descriptor pool chain exceeds max_pools_per_chain (%u)",
+                          allocator->info.max_pools_per_chain);
+            }
+
+            push(chain->pools, create_descriptor_pool(allocator->vk, allocator->info.pool));
+            pool_empty = true;
+        }
+
+        VkResult result = try_allocate_descriptor_sets(allocator->vk, chain->pools->data[chain->current], layout,
+                                                       count, descriptor_sets);
+        if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) {
+            validate_result(result, "failed to allocate descriptor sets");
+            return;
+        }
+
+        // A request that doesn't fit an empty pool never will.
+        if (pool_empty) {
+            CTK_FATAL("%u descriptor sets don't fit in an empty pool; DescriptorAllocatorInfo::pool is too small",
+                      count);
+        }
+    }
+}
+
+static void reset_chain(Vulkan *vk, DescriptorPoolChain *chain) {
+    for (u32 i = 0; i < chain->pools->count && i <= chain->current; ++i) {
+        validate_result(vkResetDescriptorPool(vk->device, chain->pools->data[i], 0),
+                        "failed to reset descriptor pool");
+    }
+
+    chain->current = 0;
+}
+
+static void destroy_chain(Vulkan *vk, DescriptorPoolChain *chain) {
+    for (u32 i = 0; i < chain->pools->count; ++i)
+        vkDestroyDescriptorPool(vk->device, chain->pools->data[i], NULL);
+
+    chain->pools->count = 0;
+    chain->current = 0;
+}
+
+// Returns the current frame's set for the key write_key walks, allocating one with layout if there isn't one yet;
+// allocated is set when the caller needs to write the new set.
+template<typename WriteKey>
+static VkDescriptorSet find_or_allocate_transient_set(DescriptorAllocator *allocator, VkDescriptorSetLayout layout,
+                                                      WriteKey write_key, bool *allocated)
+{
+    TransientDescriptorFrame *frame = allocator->frame;
+    CreationKey key = get_creation_key(write_key);
+    u32 slot = 0;
+    u32 set_idx = find_creation_key_entry(&frame->set_table, frame->sets, write_key, &key, &slot);
+    if (set_idx != U32_MAX) {
+        ++allocator->reused_transient_count;
+        *allocated = false;
+        return frame->sets[set_idx].handle;
+    }
+
+    if (frame->set_count == allocator->info.max_transient_sets) {
+        CTK_FATAL("descriptor allocator transient set count exceeds max_transient_sets (%u)",
+                  allocator->info.max_transient_sets);
+    }
+
+    if (key.size > allocator->info.max_transient_key_bytes - frame->key_data_size) {
+        CTK_FATAL("descriptor allocator transient keys exceed max_transient_key_bytes (%u)",
+                  allocator->info.max_transient_key_bytes);
+    }
+
+    frame->set_table.slots[slot] = frame->set_count;
+    TransientDescriptorSet *set = frame->sets + frame->set_count++;
+    set->key = store_creation_key(write_key, &key, frame->key_data + frame->key_data_size);
+    frame->key_data_size += key.size;
+    allocate_from_chain(allocator, &frame->chain, layout, 1, &set->handle);
+    *allocated = true;
+    return set->handle;
+}
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+static DescriptorAllocator *create_descriptor_allocator(Allocator *allocator, Vulkan *vk, PipelineRegistry *registry,
+                                                        DescriptorAllocatorInfo info)
+{
+    if (info.frame_count == 0)
+        CTK_FATAL("descriptor allocator frame_count must be at least 1");
+
+    auto descriptor_allocator = allocate<DescriptorAllocator>(allocator, 1);
+    *descriptor_allocator = {};
+    descriptor_allocator->vk = vk;
+    descriptor_allocator->registry = registry;
+    descriptor_allocator->info = info;
+    descriptor_allocator->persistent.pools = create_array<VkDescriptorPool>(allocator, info.max_pools_per_chain);
+
+    descriptor_allocator->frames = allocate<TransientDescriptorFrame>(allocator, info.frame_count);
+    for (u32 i = 0; i < info.frame_count; ++i) {
+        TransientDescriptorFrame *frame = descriptor_allocator->frames + i;
+        *frame = {};
+        frame->chain.pools = create_array<VkDescriptorPool>(allocator, info.max_pools_per_chain);
+        frame->sets = allocate<TransientDescriptorSet>(allocator, info.max_transient_sets);
+        frame->set_table = create_creation_key_table(allocator, info.max_transient_sets);
+        frame->key_data = allocate<u8>(allocator, info.max_transient_key_bytes > 0 ? info.max_transient_key_bytes : 1);
+    }
+    descriptor_allocator->frame = descriptor_allocator->frames;
+
+    return descriptor_allocator;
+}
+
+// Returns the registry's shared layout with one binding per descriptor info, numbered from 0, creating it on first
+// request.
+static VkDescriptorSetLayout get_descriptor_set_layout(DescriptorAllocator *allocator, DescriptorInfo *infos,
+                                                       u32 count)
+{
+    Vulkan *vk = allocator->vk;
+    push_frame(vk->mem.temp);
+
+    auto bindings = create_array<VkDescriptorSetLayoutBinding>(vk->mem.temp, count > 0 ? count : 1);
+    for (u32 i = 0; i < count; ++i) {
+        push(bindings, {
+            .binding = i,
+            .descriptorType = infos[i].type,
+            .descriptorCount = infos[i].count,
+            .stageFlags = infos[i].stage,
+            .pImmutableSamplers = NULL,
+        });
+    }
+
+    VkDescriptorSetLayout layout = get_descriptor_set_layout(allocator->registry, bindings->data, bindings->count);
+
+    pop_frame(vk->mem.temp);
+    return layout;
+}
+
+// Allocates sets that live until the allocator is destroyed.
+static void allocate_descriptor_sets(DescriptorAllocator *allocator, VkDescriptorSetLayout layout, u32 count,
+                                     VkDescriptorSet *descriptor_sets)
+{
+    allocate_from_chain(allocator, &allocator->persistent, layout, count, descriptor_sets);
+}
+
+// Starts frame_idx's frame: its transient pools are reset and its cached sets forgotten. The frame's previous
+// submission must have finished executing.
+static void begin_descriptor_frame(DescriptorAllocator *allocator, u32 frame_idx) {
+    if (frame_idx >= allocator->info.frame_count)
+        CTK_FATAL("descriptor frame index %u exceeds frame_count (%u)", frame_idx, allocator->info.frame_count);
+
+    TransientDescriptorFrame *frame = allocator->frames + frame_idx;
+    reset_chain(allocator->vk, &frame->chain);
+    clear_creation_key_table(&frame->set_table);
+
+    frame->set_count = 0;
+    frame->key_data_size = 0;
+    allocator->frame = frame;
+    allocator->reused_transient_count = 0;
+}
+
+// Returns a set for the current frame with bindings written from 0; requests with the same layout and bound resources
+// within a frame share one set. The set is only valid until the frame comes around again.
+static VkDescriptorSet get_transient_descriptor_set(DescriptorAllocator *allocator, VkDescriptorSetLayout layout,
+                                                    DescriptorBinding *bindings, u32 binding_count)
+{
+    auto write_key = [layout, bindings, binding_count](CreationKey *key) {
+        write_descriptor_bindings_key(key, layout, bindings, binding_count);
+    };
+    bool allocated = false;
+    VkDescriptorSet set = find_or_allocate_transient_set(allocator, layout, write_key, &allocated);
+    if (allocated)
+        update_descriptor_set(allocator->vk, set, binding_count, bindings);
+
+    return set;
+}
+
+// Template version of the above; data is update_template->descriptor_count elements packed with
+// pack_descriptor_template_data() (or otherwise zero-padded, since it's compared as bytes).
+static VkDescriptorSet get_transient_descriptor_set(DescriptorAllocator *allocator, VkDescriptorSetLayout layout,
+                                                    DescriptorUpdateTemplate *update_template,
+                                                    DescriptorTemplateData *data)
+{
+    auto write_key = [layout, update_template, data](CreationKey *key) {
+        write_descriptor_template_key(key, layout, update_template, data);
+    };
+    bool allocated = false;
+    VkDescriptorSet set = find_or_allocate_transient_set(allocator, layout, write_key, &allocated);
+    if (allocated)
+        update_descriptor_set(allocator->vk, set, update_template, data);
+
+    return set;
+}
+
+static DescriptorAllocatorStats get_descriptor_allocator_stats(DescriptorAllocator *allocator) {
+    DescriptorAllocatorStats stats = {};
+    stats.persistent_pool_count = allocator->persistent.pools->count;
+    for (u32 i = 0; i < allocator->info.frame_count; ++i)
+        stats.transient_pool_count += allocator->frames[i].chain.pools->count;
+
+    stats.transient_set_count = allocator->frame->set_count;
+    stats.reused_transient_count = allocator->reused_transient_count;
+    return stats;
+}
+
+// Destroys every pool; sets allocated from the allocator are freed with their pools. Layouts belong to the registry.
+static void destroy_descriptor_allocator(DescriptorAllocator *allocator) {
+    Vulkan *vk = allocator->vk;
+    destroy_chain(vk, &allocator->persistent);
+    for (u32 i = 0; i < allocator->info.frame_count; ++i)
+        destroy_chain(vk, &allocator->frames[i].chain);
+}
@@ -0,0 +1,595 @@
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "renderer/vulkan.h"
+#include "renderer/timer.h"
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+#include "ctk/containers.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+static constexpr u32 FRAME_READBACK_MAX_PATH_SIZE = 256;
+
+enum struct ReadbackOutput {
+    NONE, // Frames are read back but not written anywhere; measures readback alone.
+    RAW,  // Tightly packed pixels in the target's format, one file per frame.
+    PPM,  // Binary RGB PPM, one file per frame.
+    PNG,  // Uncompressed RGBA PNG, one file per frame.
+    PIPE, // Raw frames written back to back to a command's stdin, e.g. a video encoder.
+};
+
+struct FrameReadbackInfo {
+    // Number of frames readback can trail rendering by; each slot holds one frame in host-visible memory.
+    u32 slot_count;
+    ReadbackOutput output;
+
+    // File outputs: printf format given the frame index, e.g. "out/frame_%05u.png". PIPE: command to write frames to.
+    cstr path;
+};
+
+enum struct ReadbackSlotState : u32 {
+    FREE,
+    COPYING, // Copy submitted; waiting on fence.
+    WRITING, // Copy finished; owned by the writer thread.
+};
+
+struct ReadbackSlot {
+    Region *region;
+    u8 *mapped;
+    VkCommandBuffer cmd_buf;
+    VkFence fence;
+    u32 frame_idx;
+    std::atomic<ReadbackSlotState> state;
+};
+
+struct FrameReadbackStats {
+    u32 frames_queued;
+    u32 frames_written;
+    u32 stall_count; // Times queue_frame_readback() had to wait for a slot.
+    f64 stall_ms;
+    f64 frames_per_second; // Sustained rate frames were written at since the first frame was queued.
+    f64 megabytes_per_second;
+};
+
+// Copies rendered frames into a ring of host-visible slots and hands finished copies to a writer thread, so neither
+// the GPU nor the render thread waits on readback unless every slot is still busy.
+struct FrameReadback {
+    Vulkan *vk;
+    FrameReadbackInfo info;
+    char path[FRAME_READBACK_MAX_PATH_SIZE];
+    VkExtent2D extent;
+    VkFormat format;
+    u32 frame_size;
+    bool bgra; // Source channels are stored BGRA and are swizzled for PPM and PNG.
+
+    Buffer *buffer;
+    VkCommandPool cmd_pool;
+    ReadbackSlot *slots;
+    u32 next_slot; // Also the oldest slot, since slots are used in ring order.
+
+    // Slots whose copies have finished, in frame order, waiting on the writer thread. Ring buffer sized to slot_count.
+    u32 *write_queue;
+    u32 write_queue_head;
+    u32 write_queue_count;
+
+    // Guards the write queue and slot hand-back; cond wakes the writer for queued slots and the render thread for freed
+    // ones.
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::thread thread;
+    bool running;
+
+    FILE *pipe;
+    u8 *encode_buffer; // Writer thread only; holds PPM/PNG encoded frames.
+    u32 encode_buffer_size;
+
+    u64 start_ns;
+    u32 frames_queued;
+    std::atomic<u32> frames_written;
+    u32 stall_count;
+    u64 stall_ns;
+};
+
+////////////////////////////////////////////////////////////
+/// Internal
+////////////////////////////////////////////////////////////
+#ifdef _WIN32
+static FILE *open_readback_pipe(cstr command) { return _popen(command, "wb"); }
+static void close_readback_pipe(FILE *pipe) { _pclose(pipe); }
+#else
+static FILE *open_readback_pipe(cstr command) { return popen(command, "w"); }
+static void close_readback_pipe(FILE *pipe) { pclose(pipe); }
+#endif
+
+static bool readback_format_is_bgra(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB: return true;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB: return false;
+        default: CTK_FATAL("frame readback only supports 8-bit RGBA and BGRA formats");
+    }
+}
+
+// Cached memory makes CPU reads of copied frames much faster; fall back to uncached memory if there is none.
+static VkMemoryPropertyFlags select_readback_memory_flags(Vulkan *vk) {
+    VkMemoryPropertyFlags cached_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                                         VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+    VkPhysicalDeviceMemoryProperties *mem_props = &vk->physical_device.mem_properties;
+    for (u32 i = 0; i < mem_props->memoryTypeCount; ++i)
+        if ((mem_props->memoryTypes[i].propertyFlags & cached_flags) == cached_flags)
+            return cached_flags;
+
+    return VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+static u32 png_crc(u32 crc, u8 *data, u32 size) {
+    static u32 table[256] = {};
+    static bool table_init = false;
+
+    if (!table_init) {
+        for (u32 n = 0; n < 256; ++n) {
+            u32 c = n;
+            for (u32 k = 0; k < 8; ++k)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        table_init = true;
+    }
+
+    crc = ~crc;
+    for (u32 i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static u8 *write_png_u32(u8 *out, u32 value) {
+    out[0] = (u8)(value >> 24);
+    out[1] = (u8)(value >> 16);
+    out[2] = (u8)(value >> 8);
+    out[3] = (u8)value;
+    return out + 4;
+}
+
+// Writes chunk type and data (already at out + 8) framed by length and CRC; returns end of chunk.
+static u8 *finish_png_chunk(u8 *out, cstr type, u32 data_size) {
+    write_png_u32(out, data_size);
+    memcpy(out + 4, type, 4);
+    return write_png_u32(out + 8 + data_size, png_crc(0, out + 4, data_size + 4));
+}
+
+static u32 png_deflate_block_count(u32 raw_size) {
+    return (raw_size + 0xFFFE) / 0xFFFF;
+}
+
+// Upper bound for encode_png(); stored (uncompressed) deflate blocks add 5 bytes per 64KB.
+static u32 png_encoded_size(VkExtent2D extent) {
+    u32 raw_size = extent.height * (1 + extent.width * 4);
+    return 8 + (12 + 13) + (12 + 2 + raw_size + png_deflate_block_count(raw_size) * 5 + 4) + 12;
+}
+
+// Encodes pixels as an uncompressed RGBA PNG. Deflate is skipped; readback favors throughput over file size.
+static u32 encode_png(u8 *out, u8 *pixels, VkExtent2D extent, bool bgra) {
+    static constexpr u8 SIGNATURE[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    u8 *start = out;
+    memcpy(out, SIGNATURE, sizeof(SIGNATURE));
+    out += sizeof(SIGNATURE);
+
+    // IHDR: 8-bit RGBA, no interlacing.
+    u8 *data = write_png_u32(write_png_u32(out + 8, extent.width), extent.height);
+    data[0] = 8;
+    data[1] = 6;
+    data[2] = 0;
+    data[3] = 0;
+    data[4] = 0;
+    out = finish_png_chunk(out, "IHDR", 13);
+
+    // IDAT: zlib stream of stored deflate blocks over rows prefixed with filter type 0.
+    u32 row_size = extent.width * 4;
+    u32 raw_size = extent.height * (1 + row_size);
+    u32 block_count = png_deflate_block_count(raw_size);
+    u32 idat_size = 2 + raw_size + block_count * 5 + 4;
+    u8 *idat = out;
+    data = out + 8;
+    *data++ = 0x78;
+    *data++ = 0x01;
+
+    u32 adler_a = 1;
+    u32 adler_b = 0;
+    u32 block_remaining = 0;
+    u32 raw_remaining = raw_size;
+    for (u32 y = 0; y < extent.height; ++y) {
+        u8 *row = pixels + y * row_size;
+        for (u32 i = 0; i < 1 + row_size; ++i) {
+            if (block_remaining == 0) {
+                block_remaining = raw_remaining < 0xFFFF ? raw_remaining : 0xFFFF;
+                raw_remaining -= block_remaining;
+                *data++ = raw_remaining == 0 ? 1 : 0; // BFINAL on last block, BTYPE 00 (stored).
+                *data++ = (u8)block_remaining;
+                *data++ = (u8)(block_remaining >> 8);
+                *data++ = (u8)~block_remaining;
+                *data++ = (u8)(~block_remaining >> 8);
+            }
+
+            u8 byte = 0;
+            if (i > 0) {
+                u8 *pixel = row + ((i - 1) & ~3u);
+                u32 channel = (i - 1) & 3;
+                byte = bgra && channel != 3 ? pixel[2 - channel] : pixel[channel];
+            }
+
+            *data++ = byte;
+            adler_a = (adler_a + byte) % 65521;
+            adler_b = (adler_b + adler_a) % 65521;
+            --block_remaining;
+        }
+    }
+
+    write_png_u32(data, (adler_b << 16) | adler_a);
+    out = finish_png_chunk(idat, "IDAT", idat_size);
+    out = finish_png_chunk(out, "IEND", 0);
+
+    return (u32)(out - start);
+}
+
+static u32 encode_ppm(u8 *out, u8 *pixels, VkExtent2D extent, bool bgra) {
+    u32 header_size = (u32)sprintf((char *)out, "P6\n%u %u\n255\n", extent.width, extent.height);
+    u8 *rgb = out + header_size;
+    u32 pixel_count = extent.width * extent.height;
+
+    for (u32 i = 0; i < pixel_count; ++i) {
+        u8 *pixel = pixels + i * 4;
+        rgb[i * 3 + 0] = bgra ? pixel[2] : pixel[0];
+        rgb[i * 3 + 1] = pixel[1];
+        rgb[i * 3 + 2] = bgra ? pixel[0] : pixel[2];
+    }
+
+    return header_size + pixel_count * 3;
+}
+
+static void write_readback_file(FrameReadback *readback, u32 frame_idx, u8 *data, u32 size) {
+    char path[FRAME_READBACK_MAX_PATH_SIZE] = {};
+    snprintf(path, sizeof(path), readback->path, frame_idx);
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL || fwrite(data, 1, size, file) != size)
+        warning("failed to write frame readback \"%s\"", path);
+
+    if (file != NULL)
+        fclose(file);
+}
+
+static void write_readback_frame(FrameReadback *readback, ReadbackSlot *slot) {
+    PROFILE_FUNCTION();
+    switch (readback->info.output) {
+        case ReadbackOutput::NONE: {
+            break;
+        }
+        case ReadbackOutput::RAW: {
+            write_readback_file(readback, slot->frame_idx, slot->mapped, readback->frame_size);
+            break;
+        }
+        case ReadbackOutput::PPM: {
+            u32 size = encode_ppm(readback->encode_buffer, slot->mapped, readback->extent, readback->bgra);
+            write_readback_file(readback, slot->frame_idx, readback->encode_buffer, size);
+            break;
+        }
+        case ReadbackOutput::PNG: {
+            u32 size = encode_png(readback->encode_buffer, slot->mapped, readback->extent, readback->bgra);
+            write_readback_file(readback, slot->frame_idx, readback->encode_buffer, size);
+            break;
+        }
+        case ReadbackOutput::PIPE: {
+            if (readback->pipe == NULL)
+                break;
+
+            if (fwrite(slot->mapped, 1, readback->frame_size, readback->pipe) != readback->frame_size) {
+                warning("failed to write frame %u to readback pipe; closing it", slot->frame_idx);
+                close_readback_pipe(readback->pipe);
+                readback->pipe = NULL;
+            }
+            break;
+        }
+    }
+}
+
+static void run_frame_readback_thread(FrameReadback *readback) {
+    set_profiler_thread_name("frame readback");
+    while (1) {
+        u32 slot_idx = U32_MAX;
+        {
+            std::unique_lock<std::mutex> lock(readback->mutex);
+            readback->cond.wait(lock, [readback] { return readback->write_queue_count > 0 || !readback->running; });
+
+            // Stopping still drains queued frames.
+            if (readback->write_queue_count == 0)
+                return;
+
+            slot_idx = readback->write_queue[readback->write_queue_head];
+            readback->write_queue_head = (readback->write_queue_head + 1) % readback->info.slot_count;
+            --readback->write_queue_count;
+        }
+
+        ReadbackSlot *slot = readback->slots + slot_idx;
+        write_readback_frame(readback, slot);
+
+        {
+            std::lock_guard<std::mutex> lock(readback->mutex);
+            slot->state = ReadbackSlotState::FREE;
+            ++readback->frames_written;
+        }
+        readback->cond.notify_all();
+    }
+}
+
+static void hand_off_readback_slot(FrameReadback *readback, u32 slot_idx) {
+    {
+        std::lock_guard<std::mutex> lock(readback->mutex);
+        u32 tail = (readback->write_queue_head + readback->write_queue_count) % readback->info.slot_count;
+        readback->write_queue[tail] = slot_idx;
+        ++readback->write_queue_count;
+        readback->slots[slot_idx].state = ReadbackSlotState::WRITING;
+    }
+    readback->cond.notify_all();
+}
+
+// Hands finished copies to the writer thread in frame order, stopping at the first copy still in flight.
+static void collect_finished_readbacks(FrameReadback *readback) {
+    for (u32 i = 0; i < readback->info.slot_count; ++i) {
+        u32 slot_idx = (readback->next_slot + i) % readback->info.slot_count;
+        ReadbackSlot *slot = readback->slots + slot_idx;
+
+        if (slot->state != ReadbackSlotState::COPYING)
+            continue;
+
+        if (vkGetFenceStatus(readback->vk->device, slot->fence) != VK_SUCCESS)
+            break;
+
+        hand_off_readback_slot(readback, slot_idx);
+    }
+}
+
+// Waits until the slot is free; only stalls when readback has fallen slot_count frames behind.
+static void wait_for_readback_slot(FrameReadback *readback, u32 slot_idx) {
+    ReadbackSlot *slot = readback->slots + slot_idx;
+    if (slot->state == ReadbackSlotState::FREE)
+        return;
+
+    u64 stall_start = get_time_ns();
+
+    // Oldest slot, so handing it off here keeps frames in order.
+    if (slot->state == ReadbackSlotState::COPYING) {
+        validate_result(vkWaitForFences(readback->vk->device, 1, &slot->fence, VK_TRUE, U64_MAX),
+                        "vkWaitForFences failed");
+        hand_off_readback_slot(readback, slot_idx);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(readback->mutex);
+        readback->cond.wait(lock, [slot] { return slot->state == ReadbackSlotState::FREE; });
+    }
+
+    ++readback->stall_count;
+    readback->stall_ns += get_time_ns() - stall_start;
+}
+
+static void record_readback_copy(FrameReadback *readback, ReadbackSlot *slot, Image *image) {
+    VkCommandBuffer cmd_buf = slot->cmd_buf;
+    begin_temp_cmd_buf(cmd_buf);
+
+    // Render pass leaves image in TRANSFER_SRC_OPTIMAL; wait for its color writes.
+    VkImageMemoryBarrier image_barrier = {};
+    image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    image_barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    image_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    image_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    image_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    image_barrier.image = image->handle;
+    image_barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, NULL, 0, NULL, 1, &image_barrier);
+
+    VkBufferImageCopy copy = {};
+    copy.bufferOffset = slot->region->offset;
+    copy.bufferRowLength = 0; // Tightly packed.
+    copy.bufferImageHeight = 0;
+    copy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    copy.imageOffset = { 0, 0, 0 };
+    copy.imageExtent = { readback->extent.width, readback->extent.height, 1 };
+    vkCmdCopyImageToBuffer(cmd_buf, image->handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback->buffer->handle,
+                           1, &copy);
+
+    // Make copied data visible to host reads once the slot's fence signals.
+    VkBufferMemoryBarrier buffer_barrier = {};
+    buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    buffer_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    buffer_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buffer_barrier.buffer = readback->buffer->handle;
+    buffer_barrier.offset = slot->region->offset;
+    buffer_barrier.size = slot->region->size;
+    vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         0, NULL, 1, &buffer_barrier, 0, NULL);
+
+    vkEndCommandBuffer(cmd_buf);
+}
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+// Reads back images of the given extent and format. Images read back must be left in TRANSFER_SRC_OPTIMAL by rendering
+// and have been created with VK_IMAGE_USAGE_TRANSFER_SRC_BIT.
+static FrameReadback *create_frame_readback(Allocator *allocator, Vulkan *vk, VkExtent2D extent, VkFormat format,
+                                            FrameReadbackInfo info)
+{
+    if (info.slot_count == 0)
+        CTK_FATAL("frame readback needs at least one slot");
+
+    bool file_output = info.output == ReadbackOutput::RAW || info.output == ReadbackOutput::PPM ||
+                       info.output == ReadbackOutput::PNG;
+    if ((file_output || info.output == ReadbackOutput::PIPE) &&
+        (info.path == NULL || strlen(info.path) >= FRAME_READBACK_MAX_PATH_SIZE))
+    {
+        CTK_FATAL("frame readback output needs a path under %u characters", FRAME_READBACK_MAX_PATH_SIZE);
+    }
+
+    auto readback = allocate<FrameReadback>(allocator, 1);
+    new (readback) FrameReadback {};
+    readback->vk = vk;
+    readback->info = info;
+    readback->extent = extent;
+    readback->format = format;
+    readback->frame_size = extent.width * extent.height * 4;
+    readback->bgra = readback_format_is_bgra(format);
+    if (info.path != NULL)
+        snprintf(readback->path, sizeof(readback->path), "%s", info.path);
+
+    // Slots share one buffer, each with its own region.
+    BufferInfo buffer_info = {};
+    buffer_info.size = (VkDeviceSize)readback->frame_size * info.slot_count;
+    buffer_info.sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
+    buffer_info.usage_flags = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buffer_info.mem_property_flags = select_readback_memory_flags(vk);
+    readback->buffer = create_buffer(vk, &buffer_info);
+
+    // Memory can only be mapped once, so the whole buffer stays mapped and slots point into it.
+    u8 *mapped = NULL;
+    validate_result(vkMapMemory(vk->device, readback->buffer->mem, 0, VK_WHOLE_SIZE, 0, (void **)&mapped),
+                    "failed to map frame readback buffer");
+
+    readback->cmd_pool = create_cmd_pool(vk);
+    readback->slots = allocate<ReadbackSlot>(allocator, info.slot_count);
+    readback->write_queue = allocate<u32>(allocator, info.slot_count);
+
+    for (u32 i = 0; i < info.slot_count; ++i) {
+        ReadbackSlot *slot = new (readback->slots + i) ReadbackSlot {};
+        slot->region = allocate_region(vk, readback->buffer, readback->frame_size, 4);
+        slot->mapped = mapped + slot->region->offset;
+        slot->fence = create_fence(vk);
+        slot->state = ReadbackSlotState::FREE;
+        allocate_cmd_bufs(vk, &slot->cmd_buf, {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = readback->cmd_pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        });
+    }
+
+    if (info.output == ReadbackOutput::PPM || info.output == ReadbackOutput::PNG) {
+        readback->encode_buffer_size = png_encoded_size(extent); // Larger than PPM encoding.
+        readback->encode_buffer = allocate<u8>(allocator, readback->encode_buffer_size);
+    }
+
+    if (info.output == ReadbackOutput::PIPE) {
+        readback->pipe = open_readback_pipe(readback->path);
+        if (readback->pipe == NULL)
+            CTK_FATAL("failed to open frame readback pipe \"%s\"", readback->path);
+    }
+
+    readback->running = true;
+    readback->thread = std::thread(run_frame_readback_thread, readback);
+
+    return readback;
+}
+
+// Copies image into the next slot and submits the copy to the graphics queue; call right after submitting the commands
+// rendering image. The frame is written out by the writer thread once the copy finishes, slot_count frames later at
+// most.
+static void queue_frame_readback(FrameReadback *readback, Image *image, u32 frame_idx) {
+    Vulkan *vk = readback->vk;
+    if (readback->frames_queued == 0)
+        readback->start_ns = get_time_ns();
+
+    collect_finished_readbacks(readback);
+
+    u32 slot_idx = readback->next_slot;
+    wait_for_readback_slot(readback, slot_idx);
+    readback->next_slot = (slot_idx + 1) % readback->info.slot_count;
+
+    ReadbackSlot *slot = readback->slots + slot_idx;
+    slot->frame_idx = frame_idx;
+    record_readback_copy(readback, slot, image);
+
+    validate_result(vkResetFences(vk->device, 1, &slot->fence), "vkResetFences failed");
+    slot->state = ReadbackSlotState::COPYING;
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &slot->cmd_buf;
+    validate_result(vkQueueSubmit(vk->queue.graphics, 1, &submit_info, slot->fence), "vkQueueSubmit failed");
+
+    ++readback->frames_queued;
+}
+
+static FrameReadbackStats get_frame_readback_stats(FrameReadback *readback) {
+    u32 frames_written = readback->frames_written;
+    f64 seconds = readback->frames_queued > 0 ? elapsed_ms(readback->start_ns) / 1000.0 : 0.0;
+    f64 frames_per_second = seconds > 0.0 ? frames_written / seconds : 0.0;
+
+    return {
+        .frames_queued = readback->frames_queued,
+        .frames_written = frames_written,
+        .stall_count = readback->stall_count,
+        .stall_ms = ns_to_ms(readback->stall_ns),
+        .frames_per_second = frames_per_second,
+        .megabytes_per_second = frames_per_second * readback->frame_size / (1024.0 * 1024.0),
+    };
+}
+
+static void print_frame_readback_stats(FrameReadback *readback) {
+    FrameReadbackStats stats = get_frame_readback_stats(readback);
+    print_line("frame readback: %u/%u frames written, %.2f frames/s (%.2f MB/s), %u stalls (%.2fms)",
+               stats.frames_written, stats.frames_queued, stats.frames_per_second, stats.megabytes_per_second,
+               stats.stall_count, stats.stall_ms);
+}
+
+// Waits for every queued frame to be written, then stops the writer thread and destroys readback objects.
+static void destroy_frame_readback(FrameReadback *readback) {
+    Vulkan *vk = readback->vk;
+
+    // Hand off remaining copies oldest first.
+    for (u32 i = 0; i < readback->info.slot_count; ++i) {
+        u32 slot_idx = (readback->next_slot + i) % readback->info.slot_count;
+        ReadbackSlot *slot = readback->slots + slot_idx;
+        if (slot->state != ReadbackSlotState::COPYING)
+            continue;
+
+        validate_result(vkWaitForFences(vk->device, 1, &slot->fence, VK_TRUE, U64_MAX), "vkWaitForFences failed");
+        hand_off_readback_slot(readback, slot_idx);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(readback->mutex);
+        readback->running = false;
+    }
+    readback->cond.notify_all();
+
+    if (readback->thread.joinable())
+        readback->thread.join();
+
+    if (readback->pipe != NULL)
+        close_readback_pipe(readback->pipe);
+
+    for (u32 i = 0; i < readback->info.slot_count; ++i)
+        vkDestroyFence(vk->device, readback->slots[i].fence, NULL);
+
+    vkDestroyCommandPool(vk->device, readback->cmd_pool, NULL);
+    vkUnmapMemory(vk->device, readback->buffer->mem);
+    vkDestroyBuffer(vk->device, readback->buffer->handle, NULL);
+    vkFreeMemory(vk->device, readback->buffer->mem, NULL);
+}
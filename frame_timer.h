@@ -0,0 +1,191 @@
+#pragma once
+
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <thread>
+#include "renderer/timer.h"
+#include "renderer/profiler.h"
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+struct FrameTimerInfo {
+    u32 history_size;  // Frame times kept for percentiles.
+    f64 smoothing;     // Weight of the newest frame time in the smoothed average, in (0, 1].
+    f64 max_fps;       // 0 disables the frame limiter.
+};
+
+struct FrameTimeStats {
+    u32 sample_count;
+    f64 smoothed_ms;
+    f64 min;
+    f64 mean;
+    f64 p50;
+    f64 p95;
+    f64 p99;
+    f64 max;
+};
+
+struct FrameTimer {
+    FrameTimerInfo info;
+    u64 frame_count;
+    u64 last_tick_ns;  // 0 until the first tick.
+    f64 frame_ms;      // Wall time between the last two ticks, including any limiter wait.
+    f64 smoothed_ms;
+
+    // Ring of the last history_size frame times.
+    f64 *history;
+    f64 *sorted_history; // Scratch for percentiles.
+    u32 history_count;
+    u32 history_next;
+
+    // Limiter
+    u64 target_frame_ns;
+    u64 next_frame_ns;
+
+    // Running mean and variance of how long a 1 ms sleep actually takes, so the limiter knows when the remaining time
+    // is too short to trust the scheduler and switches to spinning.
+    f64 sleep_mean_ms;
+    f64 sleep_m2;
+    u64 sleep_count;
+    f64 sleep_estimate_ms;
+};
+
+////////////////////////////////////////////////////////////
+/// Internal
+////////////////////////////////////////////////////////////
+static s32 compare_frame_times(const void *a, const void *b) {
+    f64 lhs = *(f64 *)a;
+    f64 rhs = *(f64 *)b;
+    return lhs < rhs ? -1 : lhs > rhs ? 1 : 0;
+}
+
+// Nearest-rank percentile of sorted frame times.
+static f64 frame_time_percentile(f64 *sorted, u32 count, f64 percentile) {
+    u32 rank = (u32)ceil(percentile / 100.0 * count);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static void update_sleep_estimate(FrameTimer *timer, f64 observed_ms) {
+    // Welford's online mean/variance; the estimate is one standard deviation above the mean.
+    ++timer->sleep_count;
+    f64 delta = observed_ms - timer->sleep_mean_ms;
+    timer->sleep_mean_ms += delta / timer->sleep_count;
+    timer->sleep_m2 += delta * (observed_ms - timer->sleep_mean_ms);
+    f64 stddev = timer->sleep_count > 1 ? sqrt(timer->sleep_m2 / (timer->sleep_count - 1)) : 0.0;
+    timer->sleep_estimate_ms = timer->sleep_mean_ms + stddev;
+}
+
+// Sleeps in 1 ms steps while the remaining time comfortably exceeds what a sleep has been observed to cost, then spins
+// the rest. Sleep granularity varies by OS and timer resolution (up to ~15.6 ms on Windows by default); the estimate
+// adapts to it, trading CPU time for precision only in the final stretch.
+static void wait_until(FrameTimer *timer, u64 deadline_ns) {
+    PROFILE_FUNCTION();
+
+    for (;;) {
+        u64 now_ns = get_time_ns();
+        if (now_ns >= deadline_ns || ns_to_ms(deadline_ns - now_ns) <= timer->sleep_estimate_ms)
+            break;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        update_sleep_estimate(timer, elapsed_ms(now_ns));
+    }
+
+    while (get_time_ns() < deadline_ns)
+        std::this_thread::yield();
+}
+
+static void push_frame_time(FrameTimer *timer, f64 frame_ms) {
+    timer->frame_ms = frame_ms;
+    timer->smoothed_ms = timer->history_count == 0
+                         ? frame_ms
+                         : timer->smoothed_ms + timer->info.smoothing * (frame_ms - timer->smoothed_ms);
+
+    timer->history[timer->history_next] = frame_ms;
+    timer->history_next = (timer->history_next + 1) % timer->info.history_size;
+    if (timer->history_count < timer->info.history_size)
+        ++timer->history_count;
+}
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+static FrameTimer *create_frame_timer(Allocator *allocator, FrameTimerInfo info) {
+    CTK_ASSERT(info.history_size > 0);
+    CTK_ASSERT(info.smoothing > 0.0 && info.smoothing <= 1.0);
+    CTK_ASSERT(info.max_fps >= 0.0);
+
+    auto timer = allocate<FrameTimer>(allocator, 1);
+    *timer = {};
+    timer->info = info;
+    timer->history = allocate<f64>(allocator, info.history_size);
+    timer->sorted_history = allocate<f64>(allocator, info.history_size);
+    timer->target_frame_ns = info.max_fps > 0.0 ? (u64)(1000000000.0 / info.max_fps) : 0;
+    timer->sleep_estimate_ms = 1.0;
+
+    return timer;
+}
+
+// Marks a frame boundary; call once per frame at the same point in the loop. With a limiter, first waits until the
+// frame's deadline. Deadlines advance by the target frame time rather than from when the wait ended so pacing doesn't
+// drift, and restart from now after a frame that overran by more than a whole frame. Returns the last frame's time in
+// milliseconds (0 on the first tick).
+static f64 tick_frame_timer(FrameTimer *timer) {
+    if (timer->target_frame_ns > 0 && timer->last_tick_ns != 0)
+        wait_until(timer, timer->next_frame_ns);
+
+    u64 now_ns = get_time_ns();
+    if (timer->target_frame_ns > 0) {
+        timer->next_frame_ns += timer->target_frame_ns;
+        if (timer->last_tick_ns == 0 || now_ns >= timer->next_frame_ns)
+            timer->next_frame_ns = now_ns + timer->target_frame_ns;
+    }
+
+    if (timer->last_tick_ns != 0)
+        push_frame_time(timer, ns_to_ms(now_ns - timer->last_tick_ns));
+
+    timer->last_tick_ns = now_ns;
+    ++timer->frame_count;
+
+    return timer->frame_ms;
+}
+
+static FrameTimeStats get_frame_time_stats(FrameTimer *timer) {
+    FrameTimeStats stats = {};
+    stats.sample_count = timer->history_count;
+    stats.smoothed_ms = timer->smoothed_ms;
+    if (stats.sample_count == 0)
+        return stats;
+
+    f64 *sorted = timer->sorted_history;
+    f64 total = 0.0;
+    for (u32 i = 0; i < stats.sample_count; ++i) {
+        sorted[i] = timer->history[i];
+        total += sorted[i];
+    }
+
+    qsort(sorted, stats.sample_count, sizeof(f64), compare_frame_times);
+    stats.min = sorted[0];
+    stats.mean = total / stats.sample_count;
+    stats.p50 = frame_time_percentile(sorted, stats.sample_count, 50);
+    stats.p95 = frame_time_percentile(sorted, stats.sample_count, 95);
+    stats.p99 = frame_time_percentile(sorted, stats.sample_count, 99);
+    stats.max = sorted[stats.sample_count - 1];
+
+    return stats;
+}
+
+static void print_frame_time_stats(FrameTimer *timer) {
+    FrameTimeStats stats = get_frame_time_stats(timer);
+    if (stats.sample_count == 0)
+        return;
+
+    print_line("%.1f fps, %.2f ms (smoothed %.2f ms) | last %u frames: min %.2f, p50 %.2f, p95 %.2f, p99 %.2f, "
+               "max %.2f ms", 1000.0 / stats.mean, stats.mean, stats.smoothed_ms, stats.sample_count, stats.min,
+               stats.p50, stats.p95, stats.p99, stats.max);
+}
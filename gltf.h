@@ -0,0 +1,465 @@
+#pragma once
+
+#include <new>
+#include <math.h>
+#include <atomic>
+#include <thread>
+#include <string.h>
+#include "renderer/mesh.h"
+#include "renderer/json.h"
+#include "renderer/mapped_file.h"
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+#include "ctk/containers.h"
+#include "ctk/file.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+static constexpr u32 GLTF_MAX_BUFFERS = 16;
+static constexpr u32 GLTF_MAX_NAME_SIZE = 64;
+
+enum struct GLTFComponentType : u32 {
+    S8  = 5120,
+    U8  = 5121,
+    S16 = 5122,
+    U16 = 5123,
+    U32 = 5125,
+    F32 = 5126,
+};
+
+static constexpr u32 GLTF_MODE_TRIANGLES = 4;
+
+// Strided view into a mapped buffer; no data is copied.
+struct GLTFAccessor {
+    u8 *data;
+    u32 count;
+    u32 stride;
+    GLTFComponentType component_type;
+    u32 component_count;
+};
+
+struct GLTFPrimitive {
+    GLTFAccessor position;
+    GLTFAccessor uv; // data is NULL if primitive has no TEXCOORD_0.
+    GLTFAccessor normal; // data is NULL if primitive has no NORMAL; normals are generated from triangles instead.
+    GLTFAccessor index; // data is NULL if primitive is not indexed.
+    u32 vertex_count;
+    u32 index_count;
+    u32 vertex_data_offset; // Offsets into memory passed to write_gltf_primitives().
+    u32 index_data_offset;
+};
+
+struct GLTFMesh {
+    char name[GLTF_MAX_NAME_SIZE];
+    u32 first_primitive;
+    u32 primitive_count;
+};
+
+// Parsed .gltf file with its buffer files mapped. Primitives reference mapped buffer data until close_gltf().
+struct GLTFScene {
+    JSON *json;
+    MappedFile buffers[GLTF_MAX_BUFFERS];
+    u32 buffer_count;
+    u64 mapped_bytes;
+
+    Array<GLTFMesh> *meshes;
+    Array<GLTFPrimitive> *primitives;
+    u32 vertex_count;
+    u32 index_count;
+    u32 data_size; // Bytes of Vertex and u32 index data written by write_gltf_primitives().
+};
+
+struct GLTFWriteState {
+    GLTFScene *scene;
+    u8 *dst;
+    std::atomic<u32> next_primitive_idx;
+};
+
+////////////////////////////////////////////////////////////
+/// Internal
+////////////////////////////////////////////////////////////
+static u32 gltf_component_size(GLTFComponentType component_type) {
+    switch (component_type) {
+        case GLTFComponentType::S8:
+        case GLTFComponentType::U8:  return 1;
+        case GLTFComponentType::S16:
+        case GLTFComponentType::U16: return 2;
+        case GLTFComponentType::U32:
+        case GLTFComponentType::F32: return 4;
+    }
+
+    CTK_FATAL("unknown glTF component type %u", (u32)component_type);
+}
+
+static u32 gltf_component_count(JSON *json, u32 type_idx) {
+    static constexpr struct { cstr type; u32 count; } TYPES[] = {
+        { "SCALAR", 1 },
+        { "VEC2",   2 },
+        { "VEC3",   3 },
+        { "VEC4",   4 },
+        { "MAT2",   4 },
+        { "MAT3",   9 },
+        { "MAT4",  16 },
+    };
+
+    for (u32 i = 0; i < CTK_ARRAY_SIZE(TYPES); ++i)
+        if (json_string_equals(json, type_idx, TYPES[i].type))
+            return TYPES[i].count;
+
+    CTK_FATAL("unknown glTF accessor type");
+}
+
+static void map_gltf_buffers(GLTFScene *scene, cstr gltf_path) {
+    JSON *json = scene->json;
+    u32 buffers_idx = json_member(json, 0, "buffers");
+    scene->buffer_count = json_count(json, buffers_idx);
+
+    if (scene->buffer_count > GLTF_MAX_BUFFERS)
+        CTK_FATAL("glTF file \"%s\" has %u buffers (max=%u)", gltf_path, scene->buffer_count, GLTF_MAX_BUFFERS);
+
+    // Buffer URIs are relative to the directory containing the .gltf file.
+    u32 dir_size = 0;
+    for (u32 i = 0; gltf_path[i] != '\0'; ++i)
+        if (gltf_path[i] == '/' || gltf_path[i] == '\\')
+            dir_size = i + 1;
+
+    for (u32 i = 0; i < scene->buffer_count; ++i) {
+        char uri[256] = {};
+        json_string(json, json_member(json, json_element(json, buffers_idx, i), "uri"), uri, sizeof(uri));
+
+        if (uri[0] == '\0' || strncmp(uri, "data:", 5) == 0)
+            CTK_FATAL("glTF file \"%s\" buffer %u: only external buffer files are supported", gltf_path, i);
+
+        char path[512] = {};
+        if (dir_size + strlen(uri) >= sizeof(path))
+            CTK_FATAL("glTF file \"%s\" buffer %u: path is too long", gltf_path, i);
+
+        memcpy(path, gltf_path, dir_size);
+        strcpy(path + dir_size, uri);
+
+        if (!map_file(scene->buffers + i, path))
+            CTK_FATAL("failed to map glTF buffer file \"%s\"", path);
+    }
+}
+
+static GLTFAccessor get_gltf_accessor(GLTFScene *scene, u32 accessor) {
+    JSON *json = scene->json;
+    u32 accessor_idx = json_element(json, json_member(json, 0, "accessors"), accessor);
+    if (accessor_idx == U32_MAX)
+        CTK_FATAL("glTF accessor %u does not exist", accessor);
+
+    if (json_member(json, accessor_idx, "sparse") != U32_MAX)
+        CTK_FATAL("glTF accessor %u: sparse accessors are not supported", accessor);
+
+    u32 view = json_u32(json, json_member(json, accessor_idx, "bufferView"));
+    u32 view_idx = json_element(json, json_member(json, 0, "bufferViews"), view);
+    if (view_idx == U32_MAX)
+        CTK_FATAL("glTF accessor %u: buffer view %u does not exist", accessor, view);
+
+    u32 buffer = json_u32(json, json_member(json, view_idx, "buffer"));
+    if (buffer >= scene->buffer_count)
+        CTK_FATAL("glTF buffer view %u: buffer %u does not exist", view, buffer);
+
+    GLTFAccessor result = {};
+    result.count = json_u32(json, json_member(json, accessor_idx, "count"));
+    result.component_type = (GLTFComponentType)json_u32(json, json_member(json, accessor_idx, "componentType"));
+    result.component_count = gltf_component_count(json, json_member(json, accessor_idx, "type"));
+
+    u32 element_size = gltf_component_size(result.component_type) * result.component_count;
+    result.stride = json_u32(json, json_member(json, view_idx, "byteStride"), element_size);
+
+    u64 offset = (u64)json_u32(json, json_member(json, view_idx, "byteOffset"), 0) +
+                 (u64)json_u32(json, json_member(json, accessor_idx, "byteOffset"), 0);
+    u64 end = result.count > 0 ? offset + (u64)(result.count - 1) * result.stride + element_size : offset;
+
+    MappedFile *mapped_file = scene->buffers + buffer;
+    if (end > mapped_file->size) {
+        CTK_FATAL("glTF accessor %u reads past end of buffer %u (%llu > %llu)", accessor, buffer, end,
+                  mapped_file->size);
+    }
+
+    result.data = mapped_file->data + offset;
+    return result;
+}
+
+// Integer components are treated as normalized, which is the only integer form glTF allows for TEXCOORD_0.
+static f32 read_gltf_component(GLTFAccessor *accessor, u32 element, u32 component) {
+    u32 component_size = gltf_component_size(accessor->component_type);
+    u8 *src = accessor->data + (u64)element * accessor->stride + component * component_size;
+
+    switch (accessor->component_type) {
+        case GLTFComponentType::F32: { f32 value; memcpy(&value, src, sizeof(value)); return value; }
+        case GLTFComponentType::U8:  return *src / 255.0f;
+        case GLTFComponentType::U16: { u16 value; memcpy(&value, src, sizeof(value)); return value / 65535.0f; }
+        default: CTK_FATAL("unsupported glTF vertex attribute component type %u", (u32)accessor->component_type);
+    }
+}
+
+static u32 read_gltf_index(GLTFAccessor *accessor, u32 element) {
+    u8 *src = accessor->data + (u64)element * accessor->stride;
+
+    switch (accessor->component_type) {
+        case GLTFComponentType::U8:  return *src;
+        case GLTFComponentType::U16: { u16 value; memcpy(&value, src, sizeof(value)); return value; }
+        case GLTFComponentType::U32: { u32 value; memcpy(&value, src, sizeof(value)); return value; }
+        default: CTK_FATAL("unsupported glTF index component type %u", (u32)accessor->component_type);
+    }
+}
+
+// Area-weighted average of adjacent triangle normals.
+static void generate_gltf_normals(Vertex *vertexes, u32 vertex_count, u32 *indexes, u32 index_count) {
+    for (u32 i = 0; i < vertex_count; ++i)
+        vertexes[i].normal = {};
+
+    for (u32 i = 0; i + 2 < index_count; i += 3) {
+        u32 a = indexes[i + 0];
+        u32 b = indexes[i + 1];
+        u32 c = indexes[i + 2];
+        if (a >= vertex_count || b >= vertex_count || c >= vertex_count)
+            continue;
+
+        // Front faces are clockwise in renderer space.
+        Vec3<f32> edge_0 = vertexes[c].position - vertexes[a].position;
+        Vec3<f32> edge_1 = vertexes[b].position - vertexes[a].position;
+        Vec3<f32> normal = {
+            edge_0.y * edge_1.z - edge_0.z * edge_1.y,
+            edge_0.z * edge_1.x - edge_0.x * edge_1.z,
+            edge_0.x * edge_1.y - edge_0.y * edge_1.x,
+        };
+        vertexes[a].normal += normal;
+        vertexes[b].normal += normal;
+        vertexes[c].normal += normal;
+    }
+
+    for (u32 i = 0; i < vertex_count; ++i) {
+        Vec3<f32> normal = vertexes[i].normal;
+        f32 length = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+        if (length > 0.0f)
+            vertexes[i].normal = { normal.x / length, normal.y / length, normal.z / length };
+    }
+}
+
+static void write_gltf_primitive(GLTFPrimitive *primitive, u8 *dst) {
+    auto vertexes = (Vertex *)(dst + primitive->vertex_data_offset);
+    auto indexes = (u32 *)(dst + primitive->index_data_offset);
+
+    // glTF is +Y up with counter-clockwise front faces; renderer world space is -Y up with clockwise front faces.
+    // Negating Y converts both.
+    if (primitive->position.component_type == GLTFComponentType::F32 &&
+        primitive->position.stride == sizeof(Vec3<f32>))
+    {
+        auto positions = (Vec3<f32> *)primitive->position.data;
+        for (u32 i = 0; i < primitive->vertex_count; ++i)
+            vertexes[i].position = { positions[i].x, -positions[i].y, positions[i].z };
+    }
+    else {
+        for (u32 i = 0; i < primitive->vertex_count; ++i) {
+            vertexes[i].position = {
+                 read_gltf_component(&primitive->position, i, 0),
+                -read_gltf_component(&primitive->position, i, 1),
+                 read_gltf_component(&primitive->position, i, 2),
+            };
+        }
+    }
+
+    if (primitive->uv.data != NULL) {
+        for (u32 i = 0; i < primitive->vertex_count; ++i)
+            vertexes[i].uv = { read_gltf_component(&primitive->uv, i, 0), read_gltf_component(&primitive->uv, i, 1) };
+    }
+    else {
+        for (u32 i = 0; i < primitive->vertex_count; ++i)
+            vertexes[i].uv = {};
+    }
+
+    if (primitive->index.data != NULL) {
+        // Out of range indexes would have the optimizer, simplifier and meshlet builder index past their vertex data.
+        for (u32 i = 0; i < primitive->index_count; ++i) {
+            indexes[i] = read_gltf_index(&primitive->index, i);
+            if (indexes[i] >= primitive->vertex_count) {
+                CTK_FATAL("glTF index accessor element %u is %u, out of range for a primitive with %u vertexes", i,
+                          indexes[i], primitive->vertex_count);
+            }
+        }
+    }
+    else {
+        for (u32 i = 0; i < primitive->index_count; ++i)
+            indexes[i] = i;
+    }
+
+    if (primitive->normal.data != NULL) {
+        for (u32 i = 0; i < primitive->vertex_count; ++i) {
+            vertexes[i].normal = {
+                 read_gltf_component(&primitive->normal, i, 0),
+                -read_gltf_component(&primitive->normal, i, 1),
+                 read_gltf_component(&primitive->normal, i, 2),
+            };
+        }
+    }
+    else {
+        generate_gltf_normals(vertexes, primitive->vertex_count, indexes, primitive->index_count);
+    }
+}
+
+static void run_gltf_write_thread(GLTFWriteState *state, u32 thread_idx) {
+    while (true) {
+        u32 idx = state->next_primitive_idx.fetch_add(1);
+        if (idx >= state->scene->primitives->count)
+            return;
+
+        write_gltf_primitive(state->scene->primitives->data + idx, state->dst);
+    }
+}
+
+static u32 align_gltf_data_offset(u32 offset) {
+    return (offset + 15) & ~15u;
+}
+
+static u32 count_gltf_primitives(JSON *json) {
+    u32 meshes_idx = json_member(json, 0, "meshes");
+    u32 count = 0;
+
+    for (u32 i = 0; i < json_count(json, meshes_idx); ++i)
+        count += json_count(json, json_member(json, json_element(json, meshes_idx, i), "primitives"));
+
+    return count;
+}
+
+static void load_gltf_primitive(GLTFScene *scene, u32 primitive_idx, GLTFPrimitive *primitive) {
+    JSON *json = scene->json;
+
+    u32 mode = json_u32(json, json_member(json, primitive_idx, "mode"), GLTF_MODE_TRIANGLES);
+    if (mode != GLTF_MODE_TRIANGLES)
+        CTK_FATAL("glTF primitive mode %u is not supported; only triangle lists are", mode);
+
+    u32 attributes_idx = json_member(json, primitive_idx, "attributes");
+    u32 position = json_u32(json, json_member(json, attributes_idx, "POSITION"));
+    if (position == U32_MAX)
+        CTK_FATAL("glTF primitive has no POSITION attribute");
+
+    *primitive = {};
+    primitive->position = get_gltf_accessor(scene, position);
+    primitive->vertex_count = primitive->position.count;
+
+    u32 uv = json_u32(json, json_member(json, attributes_idx, "TEXCOORD_0"));
+    if (uv != U32_MAX) {
+        primitive->uv = get_gltf_accessor(scene, uv);
+        if (primitive->uv.count < primitive->vertex_count)
+            CTK_FATAL("glTF TEXCOORD_0 accessor %u has fewer elements than POSITION", uv);
+    }
+
+    u32 normal = json_u32(json, json_member(json, attributes_idx, "NORMAL"));
+    if (normal != U32_MAX) {
+        primitive->normal = get_gltf_accessor(scene, normal);
+        if (primitive->normal.count < primitive->vertex_count || primitive->normal.component_count != 3)
+            CTK_FATAL("glTF NORMAL accessor %u must be a VEC3 with as many elements as POSITION", normal);
+    }
+
+    u32 index = json_u32(json, json_member(json, primitive_idx, "indices"));
+    if (index != U32_MAX) {
+        primitive->index = get_gltf_accessor(scene, index);
+        primitive->index_count = primitive->index.count;
+    }
+    else {
+        primitive->index_count = primitive->vertex_count;
+    }
+
+    primitive->vertex_data_offset = align_gltf_data_offset(scene->data_size);
+    primitive->index_data_offset =
+        align_gltf_data_offset(primitive->vertex_data_offset + primitive->vertex_count * (u32)sizeof(Vertex));
+    scene->data_size = primitive->index_data_offset + primitive->index_count * (u32)sizeof(u32);
+    scene->vertex_count += primitive->vertex_count;
+    scene->index_count += primitive->index_count;
+}
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+static GLTFScene *open_gltf(Allocator *allocator, cstr path) {
+    Array<u8> *source = read_file<u8>(allocator, path);
+    if (source == NULL)
+        CTK_FATAL("failed to read glTF file \"%s\"", path);
+
+    auto scene = allocate<GLTFScene>(allocator, 1);
+    *scene = {};
+    scene->json = parse_json(allocator, (cstr)source->data, source->count);
+    JSON *json = scene->json;
+
+    map_gltf_buffers(scene, path);
+    for (u32 i = 0; i < scene->buffer_count; ++i)
+        scene->mapped_bytes += scene->buffers[i].size;
+
+    u32 meshes_idx = json_member(json, 0, "meshes");
+    scene->meshes = create_array<GLTFMesh>(allocator, json_count(json, meshes_idx));
+    scene->primitives = create_array<GLTFPrimitive>(allocator, count_gltf_primitives(json));
+
+    for (u32 mesh = 0; mesh < scene->meshes->size; ++mesh) {
+        u32 mesh_idx = json_element(json, meshes_idx, mesh);
+        u32 mesh_primitives_idx = json_member(json, mesh_idx, "primitives");
+
+        GLTFMesh *gltf_mesh = push(scene->meshes);
+        json_string(json, json_member(json, mesh_idx, "name"), gltf_mesh->name, GLTF_MAX_NAME_SIZE);
+        gltf_mesh->first_primitive = scene->primitives->count;
+        gltf_mesh->primitive_count = json_count(json, mesh_primitives_idx);
+
+        for (u32 i = 0; i < gltf_mesh->primitive_count; ++i)
+            load_gltf_primitive(scene, json_element(json, mesh_primitives_idx, i), push(scene->primitives));
+    }
+
+    return scene;
+}
+
+// Upper bound on temp memory open_gltf() took to open scene.
+static u64 get_gltf_open_scratch_size(GLTFScene *scene) {
+    JSON *json = scene->json;
+    return mesh_scratch_array_size<Array<u8>>(1) + mesh_scratch_array_size<u8>(json->length + 1ull) + // Source
+           mesh_scratch_array_size<GLTFScene>(1) +
+           mesh_scratch_array_size<JSON>(1) +
+           mesh_scratch_array_size<Array<JSONNode>>(1) + mesh_scratch_array_size<JSONNode>(json->nodes->size) +
+           mesh_scratch_array_size<Array<GLTFMesh>>(1) + mesh_scratch_array_size<GLTFMesh>(scene->meshes->size) +
+           mesh_scratch_array_size<Array<GLTFPrimitive>>(1) +
+           mesh_scratch_array_size<GLTFPrimitive>(scene->primitives->size);
+}
+
+// Upper bound on temp memory write_gltf_primitives() uses.
+static u64 get_gltf_write_scratch_size(u32 thread_count) {
+    return mesh_scratch_array_size<GLTFWriteState>(1) +
+           mesh_scratch_array_size<std::thread>(thread_count > 1 ? thread_count - 1 : 1);
+}
+
+// Converts every primitive's positions, UVs, normals and indexes into dst (scene->data_size bytes) on the calling
+// thread and thread_count - 1 workers, reading accessor data directly from mapped buffers. Workers are started here
+// rather than by run_parallel() so their temp memory is exactly what get_gltf_write_scratch_size() counts.
+static void write_gltf_primitives(GLTFScene *scene, u8 *dst, u32 thread_count, Allocator *temp) {
+    push_frame(temp);
+
+    auto state = allocate<GLTFWriteState>(temp, 1);
+    new (state) GLTFWriteState {};
+    state->scene = scene;
+    state->dst = dst;
+
+    u32 worker_count = thread_count > 1 ? thread_count - 1 : 0;
+    auto workers = allocate<std::thread>(temp, worker_count > 0 ? worker_count : 1);
+    for (u32 i = 0; i < worker_count; ++i)
+        new (workers + i) std::thread(run_gltf_write_thread, state, i + 1);
+
+    run_gltf_write_thread(state, 0);
+
+    for (u32 i = 0; i < worker_count; ++i) {
+        workers[i].join();
+        workers[i].~thread();
+    }
+
+    state->~GLTFWriteState();
+
+    pop_frame(temp);
+}
+
+static void close_gltf(GLTFScene *scene) {
+    for (u32 i = 0; i < scene->buffer_count; ++i)
+        unmap_file(scene->buffers + i);
+
+    scene->buffer_count = 0;
+}
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <stdlib.h>
+#include <string.h>
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+#include "ctk/containers.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+enum struct JSONType {
+    OBJECT,
+    ARRAY,
+    STRING,
+    NUMBER,
+    BOOLEAN,
+    NULL_VALUE,
+};
+
+// Nodes are stored in pre-order. Object children alternate key (STRING) and value nodes. String nodes reference the
+// characters between the quotes in the source, so source must outlive the JSON.
+struct JSONNode {
+    JSONType type;
+    u32 start;
+    u32 end;
+    u32 child_count;
+    u32 subtree_size; // Node count of this node and all descendants.
+};
+
+struct JSON {
+    cstr source;
+    u32 length;
+    Array<JSONNode> *nodes;
+};
+
+struct JSONParser {
+    JSON *json;
+    u32 pos;
+};
+
+////////////////////////////////////////////////////////////
+/// Internal
+////////////////////////////////////////////////////////////
+static void skip_whitespace(JSONParser *parser) {
+    cstr source = parser->json->source;
+
+    while (parser->pos < parser->json->length &&
+           (source[parser->pos] == ' '  || source[parser->pos] == '\t' ||
+            source[parser->pos] == '\n' || source[parser->pos] == '\r'))
+    {
+        ++parser->pos;
+    }
+}
+
+static char peek(JSONParser *parser) {
+    return parser->pos < parser->json->length ? parser->json->source[parser->pos] : '\0';
+}
+
+static void expect(JSONParser *parser, char c) {
+    if (peek(parser) != c)
+        CTK_FATAL("json: expected '%c' at offset %u but found '%c'", c, parser->pos, peek(parser));
+
+    ++parser->pos;
+}
+
+static u32 push_node(JSONParser *parser, JSONType type) {
+    Array<JSONNode> *nodes = parser->json->nodes;
+    if (nodes->count == nodes->size)
+        CTK_FATAL("json: node capacity (%u) exceeded", nodes->size);
+
+    u32 idx = nodes->count;
+    push(nodes, { .type = type, .start = parser->pos, .end = parser->pos, .child_count = 0, .subtree_size = 1 });
+    return idx;
+}
+
+static void parse_value(JSONParser *parser);
+
+static void parse_string(JSONParser *parser) {
+    expect(parser, '"');
+    u32 idx = push_node(parser, JSONType::STRING);
+    cstr source = parser->json->source;
+
+    while (parser->pos < parser->json->length && source[parser->pos] != '"') {
+        if (source[parser->pos] == '\\') {
+            if (parser->pos + 1 >= parser->json->length)
+                CTK_FATAL("json: unterminated escape sequence at offset %u", parser->pos);
+
+            ++parser->pos;
+        }
+
+        ++parser->pos;
+    }
+
+    parser->json->nodes->data[idx].end = parser->pos;
+    expect(parser, '"');
+}
+
+static void parse_literal(JSONParser *parser, cstr literal, JSONType type) {
+    u32 length = (u32)strlen(literal);
+    if (parser->pos + length > parser->json->length ||
+        strncmp(parser->json->source + parser->pos, literal, length) != 0)
+    {
+        CTK_FATAL("json: invalid literal at offset %u", parser->pos);
+    }
+
+    u32 idx = push_node(parser, type);
+    parser->pos += length;
+    parser->json->nodes->data[idx].end = parser->pos;
+}
+
+static void parse_number(JSONParser *parser) {
+    u32 idx = push_node(parser, JSONType::NUMBER);
+    cstr source = parser->json->source;
+
+    while (parser->pos < parser->json->length &&
+           (strchr("+-.eE", source[parser->pos]) || (source[parser->pos] >= '0' && source[parser->pos] <= '9')))
+    {
+        ++parser->pos;
+    }
+
+    if (parser->pos == parser->json->nodes->data[idx].start)
+        CTK_FATAL("json: unexpected character '%c' at offset %u", peek(parser), parser->pos);
+
+    parser->json->nodes->data[idx].end = parser->pos;
+}
+
+static void parse_container(JSONParser *parser, JSONType type) {
+    bool is_object = type == JSONType::OBJECT;
+    char close = is_object ? '}' : ']';
+
+    ++parser->pos;
+    u32 idx = push_node(parser, type);
+
+    skip_whitespace(parser);
+    if (peek(parser) != close) {
+        while (true) {
+            skip_whitespace(parser);
+
+            if (is_object) {
+                parse_string(parser);
+                skip_whitespace(parser);
+                expect(parser, ':');
+                skip_whitespace(parser);
+            }
+
+            parse_value(parser);
+            ++parser->json->nodes->data[idx].child_count;
+
+            skip_whitespace(parser);
+            if (peek(parser) != ',')
+                break;
+
+            ++parser->pos;
+        }
+    }
+
+    expect(parser, close);
+
+    JSONNode *node = parser->json->nodes->data + idx;
+    node->end = parser->pos;
+    node->subtree_size = parser->json->nodes->count - idx;
+}
+
+static void parse_value(JSONParser *parser) {
+    skip_whitespace(parser);
+    char c = peek(parser);
+
+    if (c == '{')
+        parse_container(parser, JSONType::OBJECT);
+    else if (c == '[')
+        parse_container(parser, JSONType::ARRAY);
+    else if (c == '"')
+        parse_string(parser);
+    else if (c == 't')
+        parse_literal(parser, "true", JSONType::BOOLEAN);
+    else if (c == 'f')
+        parse_literal(parser, "false", JSONType::BOOLEAN);
+    else if (c == 'n')
+        parse_literal(parser, "null", JSONType::NULL_VALUE);
+    else
+        parse_number(parser);
+}
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+static JSON *parse_json(Allocator *allocator, cstr source, u32 length) {
+    auto json = allocate<JSON>(allocator, 1);
+    json->source = source;
+    json->length = length;
+
+    // Every node is at least one character followed by a separator or closing bracket, so length / 2 (plus the root
+    // and a trailing value with no separator) bounds the node count.
+    json->nodes = create_array<JSONNode>(allocator, length / 2 + 2);
+
+    JSONParser parser = { json, 0 };
+    parse_value(&parser);
+
+    return json;
+}
+
+static JSONNode *json_node(JSON *json, u32 idx) {
+    return json->nodes->data + idx;
+}
+
+static bool json_string_equals(JSON *json, u32 idx, cstr string) {
+    JSONNode *node = json_node(json, idx);
+    u32 length = node->end - node->start;
+    return node->type == JSONType::STRING && strlen(string) == length &&
+           strncmp(json->source + node->start, string, length) == 0;
+}
+
+// Returns index of value for key in object node, or U32_MAX if object has no such member.
+static u32 json_member(JSON *json, u32 object_idx, cstr key) {
+    if (object_idx == U32_MAX || json_node(json, object_idx)->type != JSONType::OBJECT)
+        return U32_MAX;
+
+    u32 child_idx = object_idx + 1;
+    for (u32 i = 0; i < json_node(json, object_idx)->child_count; ++i) {
+        u32 value_idx = child_idx + 1;
+
+        if (json_string_equals(json, child_idx, key))
+            return value_idx;
+
+        child_idx = value_idx + json_node(json, value_idx)->subtree_size;
+    }
+
+    return U32_MAX;
+}
+
+// Returns index of element in array node, or U32_MAX if out of range.
+static u32 json_element(JSON *json, u32 array_idx, u32 element) {
+    if (array_idx == U32_MAX || json_node(json, array_idx)->type != JSONType::ARRAY ||
+        element >= json_node(json, array_idx)->child_count)
+    {
+        return U32_MAX;
+    }
+
+    u32 child_idx = array_idx + 1;
+    for (u32 i = 0; i < element; ++i)
+        child_idx += json_node(json, child_idx)->subtree_size;
+
+    return child_idx;
+}
+
+static u32 json_count(JSON *json, u32 idx) {
+    return idx == U32_MAX ? 0 : json_node(json, idx)->child_count;
+}
+
+static f64 json_number(JSON *json, u32 idx, f64 default_value = 0.0) {
+    if (idx == U32_MAX || json_node(json, idx)->type != JSONType::NUMBER)
+        return default_value;
+
+    JSONNode *node = json_node(json, idx);
+    char buf[64] = {};
+    u32 length = node->end - node->start;
+    if (length >= sizeof(buf))
+        CTK_FATAL("json: number at offset %u is too long", node->start);
+
+    memcpy(buf, json->source + node->start, length);
+    return strtod(buf, NULL);
+}
+
+static u32 json_u32(JSON *json, u32 idx, u32 default_value = U32_MAX) {
+    return idx == U32_MAX ? default_value : (u32)json_number(json, idx, default_value);
+}
+
+// Copies string value into buf (null-terminated, truncated to buf_size). Escape sequences are not decoded.
+static void json_string(JSON *json, u32 idx, char *buf, u32 buf_size) {
+    buf[0] = '\0';
+    if (idx == U32_MAX || json_node(json, idx)->type != JSONType::STRING)
+        return;
+
+    JSONNode *node = json_node(json, idx);
+    u32 length = node->end - node->start;
+    if (length >= buf_size)
+        length = buf_size - 1;
+
+    memcpy(buf, json->source + node->start, length);
+    buf[length] = '\0';
+}
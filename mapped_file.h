@@ -0,0 +1,93 @@
+#pragma once
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+struct MappedFile {
+    u8 *data;
+    u64 size;
+
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    s32 fd;
+#endif
+};
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+// Maps file read-only into memory; returns false if the file could not be opened or mapped.
+static bool map_file(MappedFile *mapped_file, cstr path) {
+    *mapped_file = {};
+
+#ifdef _WIN32
+    mapped_file->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (mapped_file->file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size = {};
+    GetFileSizeEx(mapped_file->file, &size);
+    mapped_file->size = (u64)size.QuadPart;
+
+    mapped_file->mapping = CreateFileMappingA(mapped_file->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapped_file->mapping == NULL) {
+        CloseHandle(mapped_file->file);
+        return false;
+    }
+
+    mapped_file->data = (u8 *)MapViewOfFile(mapped_file->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (mapped_file->data == NULL) {
+        CloseHandle(mapped_file->mapping);
+        CloseHandle(mapped_file->file);
+        return false;
+    }
+#else
+    mapped_file->fd = open(path, O_RDONLY);
+    if (mapped_file->fd < 0)
+        return false;
+
+    struct stat file_stat = {};
+    fstat(mapped_file->fd, &file_stat);
+    mapped_file->size = (u64)file_stat.st_size;
+
+    void *data = mmap(NULL, mapped_file->size, PROT_READ, MAP_PRIVATE, mapped_file->fd, 0);
+    if (data == MAP_FAILED) {
+        close(mapped_file->fd);
+        return false;
+    }
+
+    mapped_file->data = (u8 *)data;
+#endif
+
+    return true;
+}
+
+static void unmap_file(MappedFile *mapped_file) {
+#ifdef _WIN32
+    UnmapViewOfFile(mapped_file->data);
+    CloseHandle(mapped_file->mapping);
+    CloseHandle(mapped_file->file);
+#else
+    munmap(mapped_file->data, mapped_file->size);
+    close(mapped_file->fd);
+#endif
+
+    *mapped_file = {};
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <math.h>
+#include "ctk/ctk.h"
+#include "ctk/math.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+struct Region;
+struct MeshletCullData;
+
+static constexpr u32 MESH_MAX_LODS = 8;
+
+// Padding added to every temp allocation when bounding mesh processing scratch memory, covering allocator alignment.
+static constexpr u64 MESH_SCRATCH_ALLOCATION_PADDING = 64;
+
+// Full-precision vertex; used for loading and processing, and uploaded as-is for VertexFormat::F32 meshes.
+struct Vertex {
+    Vec3<f32> position;
+    Vec2<f32> uv;
+    Vec3<f32> normal;
+};
+
+// Layout of vertex data in a mesh's vertex region. Quantized formats are generated by vertex_quantization.h.
+enum struct VertexFormat : u32 {
+    F32,                // Vertex
+    QUANTIZED_UNORM_UV, // QuantizedVertex with unorm16 UVs; UVs must be in [0, 1].
+    QUANTIZED_HALF_UV,  // QuantizedVertex with half-float UVs.
+    COUNT,
+};
+
+// Positions are unorm16 relative to the mesh's bounds (see Mesh::position_offset/position_scale), normals are
+// octahedral-encoded snorm16 and UVs are unorm16 or half-float depending on the vertex format. position[3] is padding
+// so position can be fetched as a single R16G16B16A16_UNORM attribute.
+struct QuantizedVertex {
+    u16 position[4];
+    s16 normal[2];
+    u16 uv[2];
+};
+
+static_assert(sizeof(Vertex) == 32, "Vertex layout changed; update vertex layouts and bump MESH_FILE_VERSION");
+static_assert(sizeof(QuantizedVertex) == 16, "QuantizedVertex layout changed; update vertex layouts");
+
+// Index range drawn for one level of detail; all of a mesh's LODs share its vertexes. error is how far the LOD's
+// surface deviates from full detail, in model-space units (see mesh_simplifier.h).
+struct MeshLOD {
+    u32 first_index; // Relative to the mesh's first index.
+    u32 index_count;
+    f32 error;
+};
+
+static_assert(sizeof(MeshLOD) == 12, "MeshLOD layout changed; bump MESH_FILE_VERSION");
+
+struct Mesh {
+    u32 vertex_count;
+    u32 index_count; // All LODs' indexes.
+    Region *vertex_region;
+    Region *index_region;
+    VertexFormat vertex_format;
+
+    // Dequantized position = position_offset + position * position_scale; identity for VertexFormat::F32.
+    Vec3<f32> position_offset;
+    Vec3<f32> position_scale;
+
+    // Ordered from full detail (error 0) to coarsest; meshes without simplified LODs have only lods[0].
+    MeshLOD lods[MESH_MAX_LODS];
+    u32 lod_count;
+
+    // Meshlets cover lods[0]. NULL if mesh has no meshlets, in which case LOD 0 is drawn as a whole.
+    MeshletCullData *meshlet_cull_data;
+    u32 meshlet_count;
+};
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+// Temp memory taken by allocating count elements of Type. Mesh processing functions have matching *_scratch_size()
+// functions built from this, so callers can size temp memory for an asset before processing it.
+template<typename Type>
+static u64 mesh_scratch_array_size(u64 count) {
+    return count * sizeof(Type) + MESH_SCRATCH_ALLOCATION_PADDING;
+}
+
+static u32 vertex_format_size(VertexFormat format) {
+    return format == VertexFormat::F32 ? sizeof(Vertex) : sizeof(QuantizedVertex);
+}
+
+// Model-space transform for a mesh's stored positions; pre-multiply into the mesh's model matrix so shaders can use
+// quantized positions without knowing the mesh's vertex format.
+static Matrix get_position_dequantization_matrix(Mesh *mesh) {
+    Matrix scale_matrix = MATRIX_ID;
+    scale_matrix[0][0] = mesh->position_scale.x;
+    scale_matrix[1][1] = mesh->position_scale.y;
+    scale_matrix[2][2] = mesh->position_scale.z;
+    return translate(MATRIX_ID, mesh->position_offset) * scale_matrix;
+}
+
+// Pixels covered by one model-space unit at distance 1 from the camera; divide by distance for the projected size.
+static f32 calculate_lod_screen_scale(f32 vertical_fov, u32 viewport_height) {
+    f32 half_fov = vertical_fov * 0.5f * (3.14159265f / 180.0f);
+    return viewport_height / (2.0f * tanf(half_fov));
+}
+
+// Selects the coarsest LOD whose error projects to at most max_error_pixels at distance. To avoid popping when error
+// sits near the threshold, moving to a coarser LOD than current_lod requires its error to be within (1 - hysteresis) of
+// the threshold, while current_lod and finer LODs are kept until their error exceeds (1 + hysteresis) of it.
+static u32 select_mesh_lod(Mesh *mesh, u32 current_lod, f32 distance, f32 screen_scale, f32 max_error_pixels,
+                           f32 hysteresis)
+{
+    f32 pixels_per_unit = screen_scale / (distance > 0.001f ? distance : 0.001f);
+
+    for (u32 lod = mesh->lod_count - 1; lod > 0; --lod) {
+        f32 threshold = max_error_pixels * (lod > current_lod ? 1 - hysteresis : 1 + hysteresis);
+        if (mesh->lods[lod].error * pixels_per_unit <= threshold)
+            return lod;
+    }
+
+    return 0;
+}
@@ -0,0 +1,322 @@
+#pragma once
+
+#include <stdio.h>
+#include <cfloat>
+#include "renderer/mesh.h"
+#include "renderer/meshlet.h"
+#include "renderer/mapped_file.h"
+#include "ctk/ctk.h"
+#include "ctk/math.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+// Baked mesh container. Layout:
+//   MeshFileHeader
+//   MeshFileSection[header.section_count]
+//   section data, each section starting on a MESH_FILE_ALIGNMENT boundary
+// Vertex and index sections hold data in the exact layout uploaded to the GPU, so they can be copied straight from the
+// mapped file into staging memory. The vertex section is raw bytes, as each mesh's vertexes are stored in that mesh's
+// vertex format. Unknown section types are skipped, so sections can be added without a version bump;
+// changing the layout of an existing section requires bumping MESH_FILE_VERSION.
+static constexpr u32 MESH_FILE_MAGIC = 0x48534D52; // "RMSH"
+static constexpr u32 MESH_FILE_VERSION = 2;
+static constexpr u32 MESH_FILE_ALIGNMENT = 16;
+static constexpr u32 MESH_FILE_MAX_NAME_SIZE = 64;
+
+enum struct MeshFileSectionType : u32 {
+    MESHES,
+    VERTEXES,
+    INDEXES,
+    MESHLETS, // Optional; Meshlet elements, referenced by MeshFileMesh::first_meshlet/meshlet_count.
+    LODS,     // Optional; MeshLOD elements, referenced by MeshFileMesh::first_lod/lod_count.
+    COUNT,
+};
+
+struct MeshFileHeader {
+    u32 magic;
+    u32 version;
+    u32 vertex_size; // sizeof(Vertex); guards against Vertex layout changes without a version bump.
+    u32 index_size;
+    u32 mesh_count;
+    u32 section_count;
+    u64 file_size;
+};
+
+struct MeshFileSection {
+    MeshFileSectionType type;
+    u32 element_size;
+    u64 offset;
+    u64 size;
+};
+
+// vertex_offset is a MESH_FILE_ALIGNMENT-aligned byte offset into the vertex section, and the index range indexes into
+// the index section; index values are relative to the mesh's first vertex. The index range holds every LOD's indexes;
+// meshes with lod_count 0 have a single LOD covering the whole range. For quantized vertex formats, bounds_min and
+// bounds_max - bounds_min are the position dequantization offset and scale.
+struct MeshFileMesh {
+    char name[MESH_FILE_MAX_NAME_SIZE];
+    u32 vertex_offset;
+    u32 vertex_count;
+    u32 first_index;
+    u32 index_count;
+    Vec3<f32> bounds_min;
+    Vec3<f32> bounds_max;
+    u32 first_meshlet;
+    u32 meshlet_count;
+    u32 first_lod;
+    u32 lod_count;
+    VertexFormat vertex_format;
+    u32 reserved;
+};
+
+static_assert(sizeof(MeshFileHeader) == 32, "MeshFileHeader layout changed; bump MESH_FILE_VERSION");
+static_assert(sizeof(MeshFileSection) == 24, "MeshFileSection layout changed; bump MESH_FILE_VERSION");
+static_assert(sizeof(MeshFileMesh) == 128, "MeshFileMesh layout changed; bump MESH_FILE_VERSION");
+
+struct MeshFileSectionData {
+    MeshFileSectionType type;
+    u32 element_size;
+    void *data;
+    u64 size;
+};
+
+// Validated view into a mapped mesh file; all pointers reference mapped memory and are valid until close_mesh_file().
+struct MeshFile {
+    MappedFile mapped_file;
+    MeshFileHeader *header;
+    MeshFileMesh *meshes;
+    u8 *vertex_data;
+    u32 *indexes;
+    u64 vertex_data_size;
+    u32 vertex_count; // Sum of all meshes' vertex counts.
+    u32 index_count;
+    Meshlet *meshlets;
+    u32 meshlet_count;
+    MeshLOD *lods;
+    u32 lod_count;
+    u8 *sections[(u32)MeshFileSectionType::COUNT];
+    u64 section_sizes[(u32)MeshFileSectionType::COUNT];
+};
+
+////////////////////////////////////////////////////////////
+/// Internal
+////////////////////////////////////////////////////////////
+static u64 align_mesh_file_offset(u64 offset) {
+    return (offset + MESH_FILE_ALIGNMENT - 1) & ~(u64)(MESH_FILE_ALIGNMENT - 1);
+}
+
+static bool invalid_mesh_file(MeshFile *mesh_file, cstr path, cstr reason) {
+    warning("invalid mesh file \"%s\": %s", path, reason);
+    unmap_file(&mesh_file->mapped_file);
+    return false;
+}
+
+static bool validate_mesh_ranges(MeshFile *mesh_file) {
+    for (u32 i = 0; i < mesh_file->header->mesh_count; ++i) {
+        MeshFileMesh *mesh = mesh_file->meshes + i;
+
+        if ((u32)mesh->vertex_format >= (u32)VertexFormat::COUNT || mesh->vertex_offset % MESH_FILE_ALIGNMENT != 0 ||
+            mesh->vertex_offset + (u64)mesh->vertex_count * vertex_format_size(mesh->vertex_format) >
+            mesh_file->vertex_data_size ||
+            (u64)mesh->first_index + mesh->index_count > mesh_file->index_count ||
+            (u64)mesh->first_meshlet + mesh->meshlet_count > mesh_file->meshlet_count ||
+            (u64)mesh->first_lod + mesh->lod_count > mesh_file->lod_count || mesh->lod_count > MESH_MAX_LODS)
+        {
+            return false;
+        }
+
+        for (u32 j = 0; j < mesh->lod_count; ++j) {
+            MeshLOD *lod = mesh_file->lods + mesh->first_lod + j;
+            if ((u64)lod->first_index + lod->index_count > mesh->index_count || lod->index_count % 3 != 0)
+                return false;
+        }
+
+        for (u32 j = 0; j < mesh->meshlet_count; ++j) {
+            Meshlet *meshlet = mesh_file->meshlets + mesh->first_meshlet + j;
+            if ((u64)meshlet->first_index + meshlet->index_count > mesh->index_count)
+                return false;
+        }
+
+        // Index values are relative to the mesh's first vertex and must stay within its vertexes.
+        u32 *indexes = mesh_file->indexes + mesh->first_index;
+        for (u32 j = 0; j < mesh->index_count; ++j) {
+            if (indexes[j] >= mesh->vertex_count)
+                return false;
+        }
+
+        mesh_file->vertex_count += mesh->vertex_count;
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+// vertexes points to the mesh's first vertex.
+static void calculate_mesh_bounds(MeshFileMesh *mesh, Vertex *vertexes) {
+    mesh->bounds_min = { FLT_MAX, FLT_MAX, FLT_MAX };
+    mesh->bounds_max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+    for (u32 i = 0; i < mesh->vertex_count; ++i) {
+        Vec3<f32> position = vertexes[i].position;
+        if (position.x < mesh->bounds_min.x) mesh->bounds_min.x = position.x;
+        if (position.y < mesh->bounds_min.y) mesh->bounds_min.y = position.y;
+        if (position.z < mesh->bounds_min.z) mesh->bounds_min.z = position.z;
+        if (position.x > mesh->bounds_max.x) mesh->bounds_max.x = position.x;
+        if (position.y > mesh->bounds_max.y) mesh->bounds_max.y = position.y;
+        if (position.z > mesh->bounds_max.z) mesh->bounds_max.z = position.z;
+    }
+}
+
+// Sections must include MESHES, VERTEXES and INDEXES.
+static bool write_mesh_file(cstr path, MeshFileSectionData *sections, u32 section_count) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return false;
+
+    MeshFileHeader header = {};
+    header.magic = MESH_FILE_MAGIC;
+    header.version = MESH_FILE_VERSION;
+    header.vertex_size = sizeof(Vertex);
+    header.index_size = sizeof(u32);
+    header.section_count = section_count;
+
+    // Lay out section data after header and section table.
+    MeshFileSection section_table[(u32)MeshFileSectionType::COUNT] = {};
+    CTK_ASSERT(section_count <= CTK_ARRAY_SIZE(section_table));
+
+    u64 offset = sizeof(MeshFileHeader) + section_count * sizeof(MeshFileSection);
+    for (u32 i = 0; i < section_count; ++i) {
+        offset = align_mesh_file_offset(offset);
+        section_table[i] = {
+            .type = sections[i].type,
+            .element_size = sections[i].element_size,
+            .offset = offset,
+            .size = sections[i].size,
+        };
+        offset += sections[i].size;
+
+        if (sections[i].type == MeshFileSectionType::MESHES)
+            header.mesh_count = (u32)(sections[i].size / sizeof(MeshFileMesh));
+    }
+
+    header.file_size = offset;
+
+    // Write
+    static constexpr u8 PADDING[MESH_FILE_ALIGNMENT] = {};
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(section_table, sizeof(MeshFileSection), section_count, file) == section_count;
+
+    u64 written = sizeof(MeshFileHeader) + section_count * sizeof(MeshFileSection);
+    for (u32 i = 0; success && i < section_count; ++i) {
+        u64 padding = section_table[i].offset - written;
+        success = fwrite(PADDING, 1, padding, file) == padding &&
+                  fwrite(sections[i].data, 1, sections[i].size, file) == sections[i].size;
+        written = section_table[i].offset + section_table[i].size;
+    }
+
+    fclose(file);
+    return success;
+}
+
+// Maps and validates mesh file; returns false with a warning if the file is missing, stale or malformed.
+static bool open_mesh_file(MeshFile *mesh_file, cstr path) {
+    *mesh_file = {};
+
+    if (!map_file(&mesh_file->mapped_file, path))
+        return false;
+
+    u8 *data = mesh_file->mapped_file.data;
+    u64 size = mesh_file->mapped_file.size;
+
+    // Header
+    if (size < sizeof(MeshFileHeader))
+        return invalid_mesh_file(mesh_file, path, "file is smaller than header");
+
+    auto header = (MeshFileHeader *)data;
+    if (header->magic != MESH_FILE_MAGIC)
+        return invalid_mesh_file(mesh_file, path, "bad magic");
+
+    if (header->version != MESH_FILE_VERSION)
+        return invalid_mesh_file(mesh_file, path, "unsupported version");
+
+    if (header->file_size != size)
+        return invalid_mesh_file(mesh_file, path, "file size does not match header (truncated?)");
+
+    if (header->vertex_size != sizeof(Vertex) || header->index_size != sizeof(u32))
+        return invalid_mesh_file(mesh_file, path, "vertex or index format does not match renderer");
+
+    if (sizeof(MeshFileHeader) + (u64)header->section_count * sizeof(MeshFileSection) > size)
+        return invalid_mesh_file(mesh_file, path, "section table extends past end of file");
+
+    // Sections; the first REQUIRED_SECTION_COUNT are required.
+    static constexpr u32 REQUIRED_SECTION_COUNT = 3;
+    static constexpr u32 ELEMENT_SIZES[] = {
+        sizeof(MeshFileMesh), // MESHES
+        1,                    // VERTEXES
+        sizeof(u32),          // INDEXES
+        sizeof(Meshlet),      // MESHLETS
+        sizeof(MeshLOD),      // LODS
+    };
+
+    auto section_table = (MeshFileSection *)(header + 1);
+    for (u32 i = 0; i < header->section_count; ++i) {
+        MeshFileSection *section = section_table + i;
+
+        if (section->offset % MESH_FILE_ALIGNMENT != 0 || section->offset > size ||
+            section->size > size - section->offset)
+        {
+            return invalid_mesh_file(mesh_file, path, "section is misaligned or out of bounds");
+        }
+
+        if ((u32)section->type >= (u32)MeshFileSectionType::COUNT)
+            continue;
+
+        if (section->element_size == 0 || section->size % section->element_size != 0)
+            return invalid_mesh_file(mesh_file, path, "section size is not a multiple of its element size");
+
+        if ((u32)section->type < CTK_ARRAY_SIZE(ELEMENT_SIZES) &&
+            section->element_size != ELEMENT_SIZES[(u32)section->type])
+        {
+            return invalid_mesh_file(mesh_file, path, "section element size does not match renderer");
+        }
+
+        if (mesh_file->sections[(u32)section->type] != NULL)
+            return invalid_mesh_file(mesh_file, path, "duplicate section");
+
+        mesh_file->sections[(u32)section->type] = data + section->offset;
+        mesh_file->section_sizes[(u32)section->type] = section->size;
+    }
+
+    for (u32 i = 0; i < REQUIRED_SECTION_COUNT; ++i)
+        if (mesh_file->sections[i] == NULL)
+            return invalid_mesh_file(mesh_file, path, "missing required section");
+
+    mesh_file->header = header;
+    mesh_file->meshes = (MeshFileMesh *)mesh_file->sections[(u32)MeshFileSectionType::MESHES];
+    mesh_file->vertex_data = mesh_file->sections[(u32)MeshFileSectionType::VERTEXES];
+    mesh_file->indexes = (u32 *)mesh_file->sections[(u32)MeshFileSectionType::INDEXES];
+    mesh_file->vertex_data_size = mesh_file->section_sizes[(u32)MeshFileSectionType::VERTEXES];
+    mesh_file->meshlets = (Meshlet *)mesh_file->sections[(u32)MeshFileSectionType::MESHLETS];
+    mesh_file->meshlet_count = (u32)(mesh_file->section_sizes[(u32)MeshFileSectionType::MESHLETS] / sizeof(Meshlet));
+    mesh_file->lods = (MeshLOD *)mesh_file->sections[(u32)MeshFileSectionType::LODS];
+    mesh_file->lod_count = (u32)(mesh_file->section_sizes[(u32)MeshFileSectionType::LODS] / sizeof(MeshLOD));
+    mesh_file->index_count = (u32)(mesh_file->section_sizes[(u32)MeshFileSectionType::INDEXES] / sizeof(u32));
+
+    if (header->mesh_count != mesh_file->section_sizes[(u32)MeshFileSectionType::MESHES] / sizeof(MeshFileMesh))
+        return invalid_mesh_file(mesh_file, path, "mesh count does not match mesh section");
+
+    if (!validate_mesh_ranges(mesh_file))
+        return invalid_mesh_file(mesh_file, path, "mesh format, range or index value is invalid");
+
+    return true;
+}
+
+static void close_mesh_file(MeshFile *mesh_file) {
+    unmap_file(&mesh_file->mapped_file);
+    *mesh_file = {};
+}
@@ -0,0 +1,437 @@
+#pragma once
+
+#include <stddef.h>
+#include "renderer/vulkan.h"
+#include "renderer/mesh.h"
+#include "renderer/gltf.h"
+#include "renderer/mesh_file.h"
+#include "renderer/mesh_optimizer.h"
+#include "renderer/meshlet.h"
+#include "renderer/mesh_simplifier.h"
+#include "renderer/timer.h"
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+#include "ctk/containers.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+struct MeshLoadStats {
+    u32 mesh_count;
+    u32 vertex_count;
+    u32 index_count;
+    u32 meshlet_count;
+    u32 lod_count;     // Simplified LODs, excluding full detail.
+    u32 upload_count;  // Number of staging region flushes.
+    u64 source_bytes;  // Bytes of mapped source files.
+    u64 copied_bytes;  // Bytes written into staging memory (the only CPU-side copy).
+    f64 open_ms;       // Parsing (glTF) or mapping and validating (baked) source files.
+    f64 write_ms;      // Writing vertex and index data into staging memory.
+    f64 optimize_ms;   // Load-time mesh optimization and LOD generation (glTF only, when requested).
+    f64 total_ms;
+};
+
+// Vertex shader inputs; shaders use location 0 for position, 1 for UV and 2 for normal.
+enum VertexAttributeBits : u32 {
+    VERTEX_ATTRIBUTE_POSITION_BIT = 0x1,
+    VERTEX_ATTRIBUTE_UV_BIT       = 0x2,
+    VERTEX_ATTRIBUTE_NORMAL_BIT   = 0x4,
+};
+
+////////////////////////////////////////////////////////////
+/// Internal
+////////////////////////////////////////////////////////////
+static u32 align_staging_offset(u32 offset) {
+    return (offset + 15) & ~15u;
+}
+
+// Copies vertexes and the first index_count indexes; the rest of the mesh's index region is left for LOD indexes.
+static void copy_staging_to_mesh(VkCommandBuffer cmd_buf, Region *staging_region, Mesh *mesh,
+                                 u32 vertex_staging_offset, u32 index_staging_offset, u32 index_count)
+{
+    VkBufferCopy vertex_copy = {
+        .srcOffset = staging_region->offset + vertex_staging_offset,
+        .dstOffset = mesh->vertex_region->offset,
+        .size = mesh->vertex_region->size,
+    };
+    VkBufferCopy index_copy = {
+        .srcOffset = staging_region->offset + index_staging_offset,
+        .dstOffset = mesh->index_region->offset,
+        .size = index_count * sizeof(u32),
+    };
+
+    vkCmdCopyBuffer(cmd_buf, staging_region->buffer->handle, mesh->vertex_region->buffer->handle, 1, &vertex_copy);
+    vkCmdCopyBuffer(cmd_buf, staging_region->buffer->handle, mesh->index_region->buffer->handle, 1, &index_copy);
+}
+
+static Mesh *push_mesh(Vulkan *vk, Array<Mesh> *meshes, Buffer *device_buffer, VertexFormat vertex_format,
+                       u32 vertex_count, u32 index_count)
+{
+    Mesh *mesh = push(meshes);
+    mesh->vertex_count = vertex_count;
+    mesh->index_count = index_count;
+    mesh->vertex_region = allocate_region(vk, device_buffer, vertex_count * vertex_format_size(vertex_format), 16);
+    mesh->index_region = allocate_region(vk, device_buffer, index_count * sizeof(u32), 16);
+    mesh->vertex_format = vertex_format;
+    mesh->position_offset = { 0, 0, 0 };
+    mesh->position_scale = { 1, 1, 1 };
+    mesh->lods[0] = { 0, index_count, 0 };
+    mesh->lod_count = 1;
+    mesh->meshlet_cull_data = NULL;
+    mesh->meshlet_count = 0;
+    return mesh;
+}
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+// Upper bound on temp memory load_gltf_meshes() uses for the .gltf file at path, including opening it, so callers can
+// give it a scratch allocator sized for the asset. Opens the file in a frame pushed on allocator to read its counts.
+static u64 get_gltf_mesh_scratch_size(cstr path, u32 thread_count, Allocator *allocator, bool optimize = false) {
+    push_frame(allocator);
+
+    GLTFScene *scene = open_gltf(allocator, path);
+    u64 size = get_gltf_open_scratch_size(scene) + get_gltf_write_scratch_size(thread_count);
+
+    if (optimize) {
+        u32 primitive_count = scene->primitives->count;
+        size += mesh_scratch_array_size<u8>(scene->data_size) +
+                mesh_scratch_array_size<MeshletCullData *>(primitive_count) +
+                mesh_scratch_array_size<u32>(primitive_count) * 4 + // Meshlet and LOD counts, LOD index ranges
+                mesh_scratch_array_size<MeshLOD>(primitive_count * MESH_MAX_LODS) +
+                mesh_scratch_array_size<u32>(scene->index_count); // LOD indexes
+
+        // Primitives are processed one at a time, and each step frees its scratch before the next.
+        u64 primitive_size = 0;
+        for (u32 i = 0; i < primitive_count; ++i) {
+            u32 vertex_count = scene->primitives->data[i].vertex_count;
+            u32 index_count = scene->primitives->data[i].index_count;
+            u64 optimize_size = optimize_mesh_scratch_size(vertex_count, index_count);
+            u64 lod_size = generate_mesh_lods_scratch_size(vertex_count, index_count);
+            u64 meshlet_size = mesh_scratch_array_size<Meshlet>(max_meshlet_count(index_count)) +
+                               build_meshlets_scratch_size(vertex_count, index_count);
+
+            primitive_size = optimize_size > primitive_size ? optimize_size : primitive_size;
+            primitive_size = lod_size > primitive_size ? lod_size : primitive_size;
+            primitive_size = meshlet_size > primitive_size ? meshlet_size : primitive_size;
+        }
+
+        size += primitive_size;
+    }
+
+    close_gltf(scene);
+    pop_frame(allocator);
+
+    return size;
+}
+
+// Loads every primitive of every mesh in a .gltf file as its own Mesh in device_buffer. Buffer files are memory-mapped
+// and accessor data is converted on worker threads straight into staging_region, which must be large enough to hold
+// all converted data. If optimize is set, data is converted into temp memory instead and run through optimize_mesh(),
+// generate_mesh_lods() and build_meshlets() before being copied to staging, with LOD indexes following all converted
+// data; assets baked with tools/mesh_baker are already optimized. temp must have get_gltf_mesh_scratch_size() bytes
+// free.
+static MeshLoadStats load_gltf_meshes(Vulkan *vk, VkCommandBuffer cmd_buf, Region *staging_region,
+                                      Buffer *device_buffer, cstr path, Array<Mesh> **meshes, u32 thread_count,
+                                      Allocator *allocator, Allocator *temp, bool optimize = false)
+{
+    MeshLoadStats stats = {};
+    u64 start = get_time_ns();
+
+    push_frame(temp);
+
+    GLTFScene *scene = open_gltf(temp, path);
+    stats.mesh_count = scene->primitives->count;
+    stats.vertex_count = scene->vertex_count;
+    stats.index_count = scene->index_count;
+    stats.source_bytes = scene->mapped_bytes;
+    stats.copied_bytes = scene->data_size;
+    stats.open_ms = elapsed_ms(start);
+
+    if (scene->data_size > staging_region->size) {
+        CTK_FATAL("glTF file \"%s\" needs %u bytes of staging memory but staging region is only %u bytes", path,
+                  scene->data_size, staging_region->size);
+    }
+
+    MeshletCullData **meshlet_cull_data = NULL;
+    u32 *meshlet_counts = NULL;
+    MeshLOD *lods = NULL; // MESH_MAX_LODS per primitive.
+    u32 *lod_counts = NULL;
+    u32 *lod_index_offsets = NULL;
+    u32 *lod_index_counts = NULL;
+    u32 lod_staging_offset = align_staging_offset(scene->data_size);
+
+    if (optimize) {
+        // Optimization reads converted data back, so convert into cached temp memory rather than staging memory.
+        u64 write_start = get_time_ns();
+        auto data = allocate<u8>(temp, scene->data_size);
+        write_gltf_primitives(scene, data, thread_count, temp);
+        stats.write_ms = elapsed_ms(write_start);
+
+        u64 optimize_start = get_time_ns();
+        stats.vertex_count = 0;
+        meshlet_cull_data = allocate<MeshletCullData *>(temp, scene->primitives->count);
+        meshlet_counts = allocate<u32>(temp, scene->primitives->count);
+        lods = allocate<MeshLOD>(temp, scene->primitives->count * MESH_MAX_LODS);
+        lod_counts = allocate<u32>(temp, scene->primitives->count);
+        lod_index_offsets = allocate<u32>(temp, scene->primitives->count);
+        lod_index_counts = allocate<u32>(temp, scene->primitives->count);
+
+        // Each primitive's simplified LODs take at most as many indexes as its full detail LOD.
+        auto lod_indexes = allocate<u32>(temp, scene->index_count);
+        u32 lod_index_count = 0;
+
+        for (u32 i = 0; i < scene->primitives->count; ++i) {
+            GLTFPrimitive *primitive = scene->primitives->data + i;
+            auto vertexes = (Vertex *)(data + primitive->vertex_data_offset);
+            auto indexes = (u32 *)(data + primitive->index_data_offset);
+
+            MeshOptimizationStats optimization_stats =
+                optimize_mesh(vertexes, &primitive->vertex_count, indexes, primitive->index_count, temp);
+            print_mesh_optimization_stats(path, &optimization_stats);
+            stats.vertex_count += primitive->vertex_count;
+
+            MeshLOD *primitive_lods = lods + i * MESH_MAX_LODS;
+            lod_counts[i] = generate_mesh_lods(vertexes, primitive->vertex_count, indexes, primitive->index_count,
+                                               primitive_lods, lod_indexes + lod_index_count, temp);
+            lod_index_offsets[i] = lod_index_count;
+            lod_index_counts[i] = 0;
+            for (u32 lod = 1; lod < lod_counts[i]; ++lod)
+                lod_index_counts[i] += primitive_lods[lod].index_count;
+
+            lod_index_count += lod_index_counts[i];
+            stats.lod_count += lod_counts[i] - 1;
+
+            push_frame(temp);
+            auto meshlets = allocate<Meshlet>(temp, max_meshlet_count(primitive->index_count));
+            meshlet_counts[i] =
+                build_meshlets(vertexes, primitive->vertex_count, indexes, primitive->index_count, meshlets, temp);
+            meshlet_cull_data[i] = create_meshlet_cull_data(allocator, meshlets, meshlet_counts[i]);
+            pop_frame(temp);
+
+            stats.meshlet_count += meshlet_counts[i];
+        }
+        stats.optimize_ms = elapsed_ms(optimize_start);
+
+        u64 staging_size = lod_staging_offset + (u64)lod_index_count * sizeof(u32);
+        if (staging_size > staging_region->size) {
+            CTK_FATAL("glTF file \"%s\" needs %llu bytes of staging memory including LODs but staging region is only "
+                      "%u bytes", path, staging_size, staging_region->size);
+        }
+
+        write_start = get_time_ns();
+        u8 *staging = map_host_region(vk->device, staging_region);
+        memcpy(staging, data, scene->data_size);
+        memcpy(staging + lod_staging_offset, lod_indexes, lod_index_count * sizeof(u32));
+        unmap_host_region(vk->device, staging_region);
+        stats.copied_bytes += lod_index_count * sizeof(u32);
+        stats.write_ms += elapsed_ms(write_start);
+    }
+    else {
+        // Convert accessor data directly into mapped staging memory.
+        u64 write_start = get_time_ns();
+        write_gltf_primitives(scene, map_host_region(vk->device, staging_region), thread_count, temp);
+        unmap_host_region(vk->device, staging_region);
+        stats.write_ms = elapsed_ms(write_start);
+    }
+
+    // Copy staging memory to device regions.
+    *meshes = create_array<Mesh>(allocator, scene->primitives->count);
+
+    begin_temp_cmd_buf(cmd_buf);
+    for (u32 i = 0; i < scene->primitives->count; ++i) {
+        GLTFPrimitive *primitive = scene->primitives->data + i;
+        u32 lod_index_count = optimize ? lod_index_counts[i] : 0;
+        Mesh *mesh = push_mesh(vk, *meshes, device_buffer, VertexFormat::F32, primitive->vertex_count,
+                               primitive->index_count + lod_index_count);
+        copy_staging_to_mesh(cmd_buf, staging_region, mesh, primitive->vertex_data_offset,
+                             primitive->index_data_offset, primitive->index_count);
+
+        if (optimize) {
+            memcpy(mesh->lods, lods + i * MESH_MAX_LODS, lod_counts[i] * sizeof(MeshLOD));
+            mesh->lod_count = lod_counts[i];
+            mesh->meshlet_cull_data = meshlet_cull_data[i];
+            mesh->meshlet_count = meshlet_counts[i];
+        }
+
+        if (lod_index_count > 0) {
+            VkBufferCopy lod_copy = {
+                .srcOffset = staging_region->offset + lod_staging_offset + lod_index_offsets[i] * sizeof(u32),
+                .dstOffset = mesh->index_region->offset + primitive->index_count * sizeof(u32),
+                .size = lod_index_count * sizeof(u32),
+            };
+            vkCmdCopyBuffer(cmd_buf, staging_region->buffer->handle, mesh->index_region->buffer->handle, 1, &lod_copy);
+        }
+    }
+    submit_temp_cmd_buf(cmd_buf, vk->queue.graphics);
+    stats.upload_count = 1;
+
+    close_gltf(scene);
+    pop_frame(temp);
+
+    stats.total_ms = elapsed_ms(start);
+    return stats;
+}
+
+// Loads meshes from a baked mesh file (see mesh_file.h). Vertex and index data is written to staging memory directly
+// from the mapped file with no intermediate allocation, flushing whenever the staging region fills. Meshes keep the
+// vertex format they were baked with. Returns false if the file is missing or invalid, so callers can fall back to the
+// source asset.
+static bool load_baked_meshes(Vulkan *vk, VkCommandBuffer cmd_buf, Region *staging_region, Buffer *device_buffer,
+                              cstr path, Array<Mesh> **meshes, Allocator *allocator, MeshLoadStats *stats)
+{
+    *stats = {};
+    u64 start = get_time_ns();
+
+    MeshFile mesh_file = {};
+    if (!open_mesh_file(&mesh_file, path))
+        return false;
+
+    stats->mesh_count = mesh_file.header->mesh_count;
+    stats->vertex_count = mesh_file.vertex_count;
+    stats->index_count = mesh_file.index_count;
+    stats->source_bytes = mesh_file.mapped_file.size;
+    stats->open_ms = elapsed_ms(start);
+
+    u64 write_start = get_time_ns();
+    *meshes = create_array<Mesh>(allocator, mesh_file.header->mesh_count);
+    u32 staging_offset = 0;
+
+    for (u32 i = 0; i < mesh_file.header->mesh_count; ++i) {
+        MeshFileMesh *mesh_info = mesh_file.meshes + i;
+        u32 vertex_size = mesh_info->vertex_count * vertex_format_size(mesh_info->vertex_format);
+        u32 index_size = mesh_info->index_count * sizeof(u32);
+        u32 mesh_size = align_staging_offset(vertex_size) + align_staging_offset(index_size);
+
+        if (mesh_size > staging_region->size)
+            CTK_FATAL("mesh \"%s\" (%u bytes) does not fit in staging region", mesh_info->name, mesh_size);
+
+        // Staging region is full; wait for pending copies to complete before reusing it.
+        if (staging_offset + mesh_size > staging_region->size) {
+            submit_temp_cmd_buf(cmd_buf, vk->queue.graphics);
+            staging_offset = 0;
+            ++stats->upload_count;
+        }
+
+        if (staging_offset == 0)
+            begin_temp_cmd_buf(cmd_buf);
+
+        Mesh *mesh = push_mesh(vk, *meshes, device_buffer, mesh_info->vertex_format, mesh_info->vertex_count,
+                               mesh_info->index_count);
+        if (mesh_info->vertex_format != VertexFormat::F32) {
+            mesh->position_offset = mesh_info->bounds_min;
+            mesh->position_scale = mesh_info->bounds_max - mesh_info->bounds_min;
+        }
+
+        if (mesh_info->meshlet_count > 0) {
+            mesh->meshlet_cull_data = create_meshlet_cull_data(allocator, mesh_file.meshlets + mesh_info->first_meshlet,
+                                                               mesh_info->meshlet_count);
+            mesh->meshlet_count = mesh_info->meshlet_count;
+            stats->meshlet_count += mesh->meshlet_count;
+        }
+
+        if (mesh_info->lod_count > 0) {
+            memcpy(mesh->lods, mesh_file.lods + mesh_info->first_lod, mesh_info->lod_count * sizeof(MeshLOD));
+            mesh->lod_count = mesh_info->lod_count;
+            stats->lod_count += mesh->lod_count - 1;
+        }
+
+        u32 index_staging_offset = align_staging_offset(staging_offset + vertex_size);
+
+        write_to_device_region(vk, cmd_buf, staging_region, staging_offset, mesh->vertex_region, 0,
+                               mesh_file.vertex_data + mesh_info->vertex_offset, vertex_size);
+        write_to_device_region(vk, cmd_buf, staging_region, index_staging_offset, mesh->index_region, 0,
+                               mesh_file.indexes + mesh_info->first_index, index_size);
+
+        staging_offset = align_staging_offset(index_staging_offset + index_size);
+        stats->copied_bytes += vertex_size + index_size;
+    }
+
+    if (staging_offset > 0) {
+        submit_temp_cmd_buf(cmd_buf, vk->queue.graphics);
+        ++stats->upload_count;
+    }
+
+    stats->write_ms = elapsed_ms(write_start);
+    close_mesh_file(&mesh_file);
+
+    stats->total_ms = elapsed_ms(start);
+    return true;
+}
+
+static void print_mesh_load_stats(cstr path, MeshLoadStats *stats) {
+    print_line("loaded \"%s\" in %.2fms (open %.2fms, write %.2fms, optimize %.2fms, %u uploads): %u meshes, "
+               "%u vertexes, %u indexes, %u meshlets, %u LODs; %llu source bytes mapped, %llu bytes copied to staging",
+               path, stats->total_ms, stats->open_ms, stats->write_ms, stats->optimize_ms, stats->upload_count,
+               stats->mesh_count, stats->vertex_count, stats->index_count, stats->meshlet_count, stats->lod_count,
+               stats->source_bytes, stats->copied_bytes);
+}
+
+// Pushes the vertex binding and the requested attributes (VertexAttributeBits) for meshes stored in vertex_format.
+// Quantized positions and UVs are converted to floats by vertex fetch, so shaders reading only those attributes work
+// with every format. Quantized normals are octahedral-encoded and must be decoded by the shader (see
+// decode_octahedral_normal() in vertex_quantization.h), so shaders reading normals need a variant per encoding.
+// info->vertex_bindings and info->vertex_attributes must have room for 1 and 3 elements respectively.
+static void push_vertex_layout(PipelineInfo *info, VertexFormat vertex_format, u32 attributes) {
+    struct {
+        VkFormat position;
+        VkFormat uv;
+        VkFormat normal;
+        u32 uv_offset;
+        u32 normal_offset;
+    } layout = {};
+
+    if (vertex_format == VertexFormat::F32) {
+        layout = {
+            .position = VK_FORMAT_R32G32B32_SFLOAT,
+            .uv = VK_FORMAT_R32G32_SFLOAT,
+            .normal = VK_FORMAT_R32G32B32_SFLOAT,
+            .uv_offset = offsetof(Vertex, uv),
+            .normal_offset = offsetof(Vertex, normal),
+        };
+    }
+    else {
+        layout = {
+            .position = VK_FORMAT_R16G16B16A16_UNORM,
+            .uv = vertex_format == VertexFormat::QUANTIZED_UNORM_UV ? VK_FORMAT_R16G16_UNORM : VK_FORMAT_R16G16_SFLOAT,
+            .normal = VK_FORMAT_R16G16_SNORM,
+            .uv_offset = offsetof(QuantizedVertex, uv),
+            .normal_offset = offsetof(QuantizedVertex, normal),
+        };
+    }
+
+    push(info->vertex_bindings, {
+        .binding = 0,
+        .stride = vertex_format_size(vertex_format),
+        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+    });
+
+    if (attributes & VERTEX_ATTRIBUTE_POSITION_BIT) {
+        push(info->vertex_attributes, {
+            .location = 0,
+            .binding = 0,
+            .format = layout.position,
+            .offset = 0,
+        });
+    }
+
+    if (attributes & VERTEX_ATTRIBUTE_UV_BIT) {
+        push(info->vertex_attributes, {
+            .location = 1,
+            .binding = 0,
+            .format = layout.uv,
+            .offset = layout.uv_offset,
+        });
+    }
+
+    if (attributes & VERTEX_ATTRIBUTE_NORMAL_BIT) {
+        push(info->vertex_attributes, {
+            .location = 2,
+            .binding = 0,
+            .format = layout.normal,
+            .offset = layout.normal_offset,
+        });
+    }
+}
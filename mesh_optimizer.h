@@ -0,0 +1,514 @@
+#pragma once
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include "renderer/mesh.h"
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+#include "ctk/math.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+static constexpr u32 DEFAULT_VERTEX_CACHE_SIZE = 16;
+static constexpr f32 DEFAULT_OVERDRAW_THRESHOLD = 1.05f;
+
+struct VertexCacheStats {
+    f32 acmr; // Average cache miss ratio: vertex shader invocations per triangle (~0.5 best for large grids, 3 worst).
+    f32 atvr; // Average transform to vertex ratio: vertex shader invocations per unique vertex (1 is ideal).
+};
+
+struct MeshOptimizationStats {
+    u32 vertex_count_before;
+    u32 vertex_count_after;
+    u32 index_count;
+    VertexCacheStats before;
+    VertexCacheStats after;
+};
+
+struct TipsifyState {
+    u32 *indexes;
+    u32 vertex_count;
+    u32 cache_size;
+
+    // Vertex -> triangle adjacency.
+    u32 *adjacency_offsets;
+    u32 *adjacency;
+
+    u32 *live_triangle_counts;
+    u32 *cache_timestamps;
+    u32 timestamp;
+
+    u32 *dead_end_stack;
+    u32 dead_end_count;
+    u32 scan_cursor;
+};
+
+struct MeshCluster {
+    u32 first_index;
+    u32 index_count;
+    f32 sort_key;
+};
+
+////////////////////////////////////////////////////////////
+/// Internal
+////////////////////////////////////////////////////////////
+static u32 hash_vertex(Vertex *vertex) {
+    // FNV-1a over vertex bytes; Vertex has no padding, so bytewise equality is value equality (except -0/+0 and NaN,
+    // which are left unwelded).
+    auto bytes = (u8 *)vertex;
+    u32 hash = 2166136261u;
+    for (u32 i = 0; i < sizeof(Vertex); ++i)
+        hash = (hash ^ bytes[i]) * 16777619u;
+
+    return hash;
+}
+
+// Simulates FIFO post-transform cache; returns number of misses for triangle and updates cache.
+static u32 update_vertex_cache(u32 *cache_timestamps, u32 *timestamp, u32 cache_size, u32 *triangle) {
+    u32 misses = 0;
+
+    for (u32 i = 0; i < 3; ++i) {
+        u32 vertex = triangle[i];
+        if (*timestamp - cache_timestamps[vertex] > cache_size) {
+            cache_timestamps[vertex] = (*timestamp)++;
+            ++misses;
+        }
+    }
+
+    return misses;
+}
+
+static void reset_vertex_cache(u32 *timestamp, u32 cache_size) {
+    // Advancing timestamp past cache size evicts every vertex without clearing the timestamp array.
+    *timestamp += cache_size + 1;
+}
+
+static s32 skip_tipsify_dead_end(TipsifyState *state) {
+    while (state->dead_end_count > 0) {
+        u32 vertex = state->dead_end_stack[--state->dead_end_count];
+        if (state->live_triangle_counts[vertex] > 0)
+            return (s32)vertex;
+    }
+
+    while (state->scan_cursor < state->vertex_count) {
+        u32 vertex = state->scan_cursor++;
+        if (state->live_triangle_counts[vertex] > 0)
+            return (s32)vertex;
+    }
+
+    return -1;
+}
+
+static s32 next_tipsify_vertex(TipsifyState *state, u32 *candidates, u32 candidate_count) {
+    // Prefer candidate that will still be in cache after its remaining triangles are emitted and has been in cache the
+    // longest.
+    s32 best_vertex = -1;
+    s32 best_priority = -1;
+
+    for (u32 i = 0; i < candidate_count; ++i) {
+        u32 vertex = candidates[i];
+        if (state->live_triangle_counts[vertex] == 0)
+            continue;
+
+        s32 priority = 0;
+        u32 age = state->timestamp - state->cache_timestamps[vertex];
+        if (age + 2 * state->live_triangle_counts[vertex] <= state->cache_size)
+            priority = (s32)age;
+
+        if (priority > best_priority) {
+            best_priority = priority;
+            best_vertex = (s32)vertex;
+        }
+    }
+
+    return best_vertex != -1 ? best_vertex : skip_tipsify_dead_end(state);
+}
+
+static void build_vertex_adjacency(u32 *indexes, u32 index_count, u32 vertex_count, u32 *offsets, u32 *adjacency,
+                                   u32 *counts)
+{
+    memset(counts, 0, vertex_count * sizeof(u32));
+    for (u32 i = 0; i < index_count; ++i)
+        ++counts[indexes[i]];
+
+    u32 offset = 0;
+    for (u32 vertex = 0; vertex < vertex_count; ++vertex) {
+        offsets[vertex] = offset;
+        offset += counts[vertex];
+    }
+    offsets[vertex_count] = offset;
+
+    memset(counts, 0, vertex_count * sizeof(u32));
+    for (u32 i = 0; i < index_count; ++i) {
+        u32 vertex = indexes[i];
+        adjacency[offsets[vertex] + counts[vertex]++] = i / 3;
+    }
+}
+
+static Vec3<f32> cross3(Vec3<f32> a, Vec3<f32> b) {
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+static f32 dot3(Vec3<f32> a, Vec3<f32> b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+// Sort key is how much cluster faces away from mesh center; drawing outward-facing clusters first lets them occlude
+// the rest of the mesh from most view directions.
+static f32 calculate_cluster_sort_key(u32 *indexes, MeshCluster *cluster, Vertex *vertexes, Vec3<f32> mesh_centroid) {
+    Vec3<f32> centroid = {};
+    Vec3<f32> normal = {};
+    f32 total_area = 0;
+
+    for (u32 i = cluster->first_index; i < cluster->first_index + cluster->index_count; i += 3) {
+        Vec3<f32> p0 = vertexes[indexes[i + 0]].position;
+        Vec3<f32> p1 = vertexes[indexes[i + 1]].position;
+        Vec3<f32> p2 = vertexes[indexes[i + 2]].position;
+
+        // Front faces are clockwise in renderer world space, so cross(p2 - p0, p1 - p0) points out of the surface.
+        Vec3<f32> triangle_normal = cross3(p2 - p0, p1 - p0);
+        f32 area = sqrtf(dot3(triangle_normal, triangle_normal));
+
+        centroid.x += (p0.x + p1.x + p2.x) * (area / 3);
+        centroid.y += (p0.y + p1.y + p2.y) * (area / 3);
+        centroid.z += (p0.z + p1.z + p2.z) * (area / 3);
+        normal.x += triangle_normal.x;
+        normal.y += triangle_normal.y;
+        normal.z += triangle_normal.z;
+        total_area += area;
+    }
+
+    if (total_area == 0)
+        return 0;
+
+    centroid = { centroid.x / total_area, centroid.y / total_area, centroid.z / total_area };
+
+    f32 normal_length = sqrtf(dot3(normal, normal));
+    if (normal_length == 0)
+        return 0;
+
+    normal = { normal.x / normal_length, normal.y / normal_length, normal.z / normal_length };
+    return dot3(centroid - mesh_centroid, normal);
+}
+
+// Size of an open-addressing vertex hash table: the next power of two at least twice vertex_count.
+static u64 hash_table_size(u32 vertex_count) {
+    u64 table_size = 1;
+    while (table_size < vertex_count * 2ull)
+        table_size *= 2;
+
+    return table_size;
+}
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+static VertexCacheStats analyze_vertex_cache(u32 *indexes, u32 index_count, u32 vertex_count, Allocator *temp,
+                                             u32 cache_size = DEFAULT_VERTEX_CACHE_SIZE)
+{
+    VertexCacheStats stats = {};
+    if (index_count == 0 || vertex_count == 0)
+        return stats;
+
+    push_frame(temp);
+
+    auto cache_timestamps = allocate<u32>(temp, vertex_count);
+    memset(cache_timestamps, 0, vertex_count * sizeof(u32));
+    u32 timestamp = cache_size + 1;
+    u32 misses = 0;
+
+    auto used = allocate<bool>(temp, vertex_count);
+    memset(used, 0, vertex_count * sizeof(bool));
+    u32 used_count = 0;
+
+    for (u32 i = 0; i < index_count; i += 3) {
+        misses += update_vertex_cache(cache_timestamps, &timestamp, cache_size, indexes + i);
+
+        for (u32 j = 0; j < 3; ++j) {
+            if (!used[indexes[i + j]]) {
+                used[indexes[i + j]] = true;
+                ++used_count;
+            }
+        }
+    }
+
+    stats.acmr = (f32)misses / (index_count / 3);
+    stats.atvr = (f32)misses / used_count;
+
+    pop_frame(temp);
+    return stats;
+}
+
+// Merges bitwise-identical vertexes, compacting vertexes in place and remapping indexes; returns new vertex count.
+static u32 weld_vertexes(Vertex *vertexes, u32 vertex_count, u32 *indexes, u32 index_count, Allocator *temp) {
+    push_frame(temp);
+
+    u32 table_size = (u32)hash_table_size(vertex_count);
+    auto table = allocate<u32>(temp, table_size);
+    memset(table, 0xFF, table_size * sizeof(u32));
+
+    auto remap = allocate<u32>(temp, vertex_count);
+    u32 unique_count = 0;
+
+    for (u32 vertex = 0; vertex < vertex_count; ++vertex) {
+        u32 slot = hash_vertex(vertexes + vertex) & (table_size - 1);
+
+        while (table[slot] != U32_MAX && memcmp(vertexes + table[slot], vertexes + vertex, sizeof(Vertex)) != 0)
+            slot = (slot + 1) & (table_size - 1);
+
+        if (table[slot] == U32_MAX) {
+            // Unique vertexes are compacted in place; slot stores compacted index, which is <= vertex and so already
+            // holds its final value when compared against later vertexes.
+            vertexes[unique_count] = vertexes[vertex];
+            table[slot] = unique_count++;
+        }
+
+        remap[vertex] = table[slot];
+    }
+
+    for (u32 i = 0; i < index_count; ++i)
+        indexes[i] = remap[indexes[i]];
+
+    pop_frame(temp);
+    return unique_count;
+}
+
+// Upper bound on temp memory optimize_vertex_cache() uses.
+static u64 optimize_vertex_cache_scratch_size(u32 vertex_count, u32 index_count) {
+    return mesh_scratch_array_size<u32>(vertex_count + 1ull) +     // Adjacency offsets
+           mesh_scratch_array_size<u32>(index_count) * 4 +         // Adjacency, dead-end stack, output, candidates
+           mesh_scratch_array_size<u32>(vertex_count) * 2 +        // Live triangle counts, cache timestamps
+           mesh_scratch_array_size<bool>(index_count / 3);         // Emitted triangles
+}
+
+// Reorders triangles for post-transform vertex cache locality using Tipsify (Sander, Nehab and Barczak, "Fast
+// Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007).
+static void optimize_vertex_cache(u32 *indexes, u32 index_count, u32 vertex_count, Allocator *temp,
+                                  u32 cache_size = DEFAULT_VERTEX_CACHE_SIZE)
+{
+    if (index_count == 0)
+        return;
+
+    push_frame(temp);
+
+    TipsifyState state = {};
+    state.indexes = indexes;
+    state.vertex_count = vertex_count;
+    state.cache_size = cache_size;
+    state.adjacency_offsets = allocate<u32>(temp, vertex_count + 1);
+    state.adjacency = allocate<u32>(temp, index_count);
+    state.live_triangle_counts = allocate<u32>(temp, vertex_count);
+    state.cache_timestamps = allocate<u32>(temp, vertex_count);
+    state.timestamp = cache_size + 1;
+    state.dead_end_stack = allocate<u32>(temp, index_count);
+
+    build_vertex_adjacency(indexes, index_count, vertex_count, state.adjacency_offsets, state.adjacency,
+                           state.live_triangle_counts);
+    memset(state.cache_timestamps, 0, vertex_count * sizeof(u32));
+
+    u32 triangle_count = index_count / 3;
+    auto emitted = allocate<bool>(temp, triangle_count);
+    memset(emitted, 0, triangle_count * sizeof(bool));
+
+    auto output = allocate<u32>(temp, index_count);
+    u32 output_count = 0;
+
+    auto candidates = allocate<u32>(temp, index_count);
+
+    s32 fanning_vertex = skip_tipsify_dead_end(&state);
+    while (fanning_vertex >= 0) {
+        u32 candidate_count = 0;
+
+        for (u32 i = state.adjacency_offsets[fanning_vertex]; i < state.adjacency_offsets[fanning_vertex + 1]; ++i) {
+            u32 triangle = state.adjacency[i];
+            if (emitted[triangle])
+                continue;
+
+            for (u32 j = 0; j < 3; ++j) {
+                u32 vertex = indexes[triangle * 3 + j];
+                output[output_count++] = vertex;
+                state.dead_end_stack[state.dead_end_count++] = vertex;
+                candidates[candidate_count++] = vertex;
+                --state.live_triangle_counts[vertex];
+
+                if (state.timestamp - state.cache_timestamps[vertex] > cache_size)
+                    state.cache_timestamps[vertex] = state.timestamp++;
+            }
+
+            emitted[triangle] = true;
+        }
+
+        fanning_vertex = next_tipsify_vertex(&state, candidates, candidate_count);
+    }
+
+    memcpy(indexes, output, index_count * sizeof(u32));
+    pop_frame(temp);
+}
+
+// Reorders clusters of a cache-optimized index buffer to reduce overdraw, keeping vertex cache efficiency within
+// threshold (e.g. 1.05 allows 5% worse ACMR). Clusters are cut where the cache was flushed (hard boundaries) and
+// further where local ACMR is already within threshold of the cluster's ACMR (soft boundaries), then drawn
+// outward-facing first.
+static void optimize_overdraw(u32 *indexes, u32 index_count, Vertex *vertexes, u32 vertex_count, Allocator *temp,
+                              f32 threshold = DEFAULT_OVERDRAW_THRESHOLD, u32 cache_size = DEFAULT_VERTEX_CACHE_SIZE)
+{
+    if (index_count == 0)
+        return;
+
+    push_frame(temp);
+
+    u32 triangle_count = index_count / 3;
+    auto cache_timestamps = allocate<u32>(temp, vertex_count);
+    memset(cache_timestamps, 0, vertex_count * sizeof(u32));
+    u32 timestamp = cache_size + 1;
+
+    // Hard boundaries: first triangle, and triangles where every vertex missed, meaning the ordering restarted
+    // somewhere new.
+    auto hard_boundaries = allocate<u32>(temp, triangle_count + 1);
+    u32 hard_boundary_count = 0;
+    for (u32 triangle = 0; triangle < triangle_count; ++triangle) {
+        u32 misses = update_vertex_cache(cache_timestamps, &timestamp, cache_size, indexes + triangle * 3);
+        if (triangle == 0 || misses == 3)
+            hard_boundaries[hard_boundary_count++] = triangle;
+    }
+
+    hard_boundaries[hard_boundary_count] = triangle_count;
+
+    // Soft boundaries
+    auto clusters = allocate<MeshCluster>(temp, triangle_count);
+    u32 cluster_count = 0;
+
+    for (u32 hard = 0; hard < hard_boundary_count; ++hard) {
+        u32 start = hard_boundaries[hard];
+        u32 end = hard_boundaries[hard + 1];
+
+        reset_vertex_cache(&timestamp, cache_size);
+        u32 cluster_misses = 0;
+        for (u32 triangle = start; triangle < end; ++triangle)
+            cluster_misses += update_vertex_cache(cache_timestamps, &timestamp, cache_size, indexes + triangle * 3);
+
+        f32 cluster_threshold = threshold * ((f32)cluster_misses / (end - start));
+
+        reset_vertex_cache(&timestamp, cache_size);
+        u32 cluster_start = start;
+        u32 misses = 0;
+
+        for (u32 triangle = start; triangle < end; ++triangle) {
+            misses += update_vertex_cache(cache_timestamps, &timestamp, cache_size, indexes + triangle * 3);
+
+            if (triangle + 1 == end || (f32)misses / (triangle - cluster_start + 1) <= cluster_threshold) {
+                clusters[cluster_count++] = {
+                    .first_index = cluster_start * 3,
+                    .index_count = (triangle + 1 - cluster_start) * 3,
+                    .sort_key = 0,
+                };
+
+                cluster_start = triangle + 1;
+                misses = 0;
+                reset_vertex_cache(&timestamp, cache_size);
+            }
+        }
+    }
+
+    // Sort clusters outward-facing first.
+    Vec3<f32> mesh_centroid = {};
+    for (u32 i = 0; i < index_count; ++i) {
+        mesh_centroid.x += vertexes[indexes[i]].position.x;
+        mesh_centroid.y += vertexes[indexes[i]].position.y;
+        mesh_centroid.z += vertexes[indexes[i]].position.z;
+    }
+    mesh_centroid = { mesh_centroid.x / index_count, mesh_centroid.y / index_count, mesh_centroid.z / index_count };
+
+    for (u32 i = 0; i < cluster_count; ++i)
+        clusters[i].sort_key = calculate_cluster_sort_key(indexes, clusters + i, vertexes, mesh_centroid);
+
+    std::stable_sort(clusters, clusters + cluster_count,
+                     [](const MeshCluster &a, const MeshCluster &b) { return a.sort_key > b.sort_key; });
+
+    auto output = allocate<u32>(temp, index_count);
+    u32 output_count = 0;
+    for (u32 i = 0; i < cluster_count; ++i) {
+        memcpy(output + output_count, indexes + clusters[i].first_index, clusters[i].index_count * sizeof(u32));
+        output_count += clusters[i].index_count;
+    }
+
+    memcpy(indexes, output, index_count * sizeof(u32));
+    pop_frame(temp);
+}
+
+// Reorders vertexes in order of first use by index buffer so vertex fetches stream through memory, dropping unused
+// vertexes; returns new vertex count.
+static u32 optimize_vertex_fetch(Vertex *vertexes, u32 vertex_count, u32 *indexes, u32 index_count, Allocator *temp) {
+    push_frame(temp);
+
+    auto remap = allocate<u32>(temp, vertex_count);
+    memset(remap, 0xFF, vertex_count * sizeof(u32));
+
+    auto reordered = allocate<Vertex>(temp, vertex_count);
+    u32 reordered_count = 0;
+
+    for (u32 i = 0; i < index_count; ++i) {
+        u32 vertex = indexes[i];
+        if (remap[vertex] == U32_MAX) {
+            remap[vertex] = reordered_count;
+            reordered[reordered_count++] = vertexes[vertex];
+        }
+
+        indexes[i] = remap[vertex];
+    }
+
+    memcpy(vertexes, reordered, reordered_count * sizeof(Vertex));
+
+    pop_frame(temp);
+    return reordered_count;
+}
+
+// Upper bound on temp memory optimize_mesh() uses; each step frees its scratch before the next runs.
+static u64 optimize_mesh_scratch_size(u32 vertex_count, u32 index_count) {
+    u64 triangle_count = index_count / 3;
+    u64 analyze_size = mesh_scratch_array_size<u32>(vertex_count) + mesh_scratch_array_size<bool>(vertex_count);
+    u64 weld_size = mesh_scratch_array_size<u32>(hash_table_size(vertex_count)) +
+                    mesh_scratch_array_size<u32>(vertex_count);
+    u64 vertex_cache_size = optimize_vertex_cache_scratch_size(vertex_count, index_count);
+    u64 overdraw_size = mesh_scratch_array_size<u32>(vertex_count) +
+                        mesh_scratch_array_size<u32>(triangle_count + 1) +
+                        mesh_scratch_array_size<MeshCluster>(triangle_count) +
+                        mesh_scratch_array_size<u32>(index_count);
+    u64 fetch_size = mesh_scratch_array_size<u32>(vertex_count) + mesh_scratch_array_size<Vertex>(vertex_count);
+
+    u64 size = analyze_size;
+    size = weld_size > size ? weld_size : size;
+    size = vertex_cache_size > size ? vertex_cache_size : size;
+    size = overdraw_size > size ? overdraw_size : size;
+    size = fetch_size > size ? fetch_size : size;
+    return size;
+}
+
+// Runs full optimization pipeline in place: weld, vertex cache, overdraw, vertex fetch. Updates *vertex_count.
+static MeshOptimizationStats optimize_mesh(Vertex *vertexes, u32 *vertex_count, u32 *indexes, u32 index_count,
+                                           Allocator *temp)
+{
+    MeshOptimizationStats stats = {};
+    stats.vertex_count_before = *vertex_count;
+    stats.index_count = index_count;
+    stats.before = analyze_vertex_cache(indexes, index_count, *vertex_count, temp);
+
+    *vertex_count = weld_vertexes(vertexes, *vertex_count, indexes, index_count, temp);
+    optimize_vertex_cache(indexes, index_count, *vertex_count, temp);
+    optimize_overdraw(indexes, index_count, vertexes, *vertex_count, temp);
+    *vertex_count = optimize_vertex_fetch(vertexes, *vertex_count, indexes, index_count, temp);
+
+    stats.vertex_count_after = *vertex_count;
+    stats.after = analyze_vertex_cache(indexes, index_count, *vertex_count, temp);
+    return stats;
+}
+
+static void print_mesh_optimization_stats(cstr name, MeshOptimizationStats *stats) {
+    print_line("    %s: %u -> %u vertexes, %u triangles; ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", name,
+               stats->vertex_count_before, stats->vertex_count_after, stats->index_count / 3, stats->before.acmr,
+               stats->after.acmr, stats->before.atvr, stats->after.atvr);
+}
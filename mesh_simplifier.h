@@ -0,0 +1,431 @@
+#pragma once
+
+#include <math.h>
+#include <string.h>
+#include <cfloat>
+#include <algorithm>
+#include "renderer/mesh.h"
+#include "renderer/mesh_optimizer.h"
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+#include "ctk/math.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+// Each LOD targets this fraction of the previous LOD's triangles.
+static constexpr f32 MESH_LOD_TRIANGLE_RATIO = 0.5f;
+
+// A LOD that simplification couldn't bring below this fraction of the previous LOD's triangles isn't worth drawing.
+static constexpr f32 MESH_LOD_MIN_REDUCTION = 0.85f;
+
+// No LODs are generated below this many triangles.
+static constexpr u32 MESH_LOD_MIN_TRIANGLES = 32;
+
+// Collapses with error above this fraction of the mesh's bounding box diagonal are rejected, ending the LOD chain.
+static constexpr f32 MESH_LOD_MAX_RELATIVE_ERROR = 0.05f;
+
+// Symmetric 4x4 error quadric (Garland and Heckbert, "Surface Simplification Using Quadric Error Metrics", 1997) as its
+// upper triangle. Plane quadrics are weighted by triangle area, so evaluate_quadric() / weight is the area-weighted
+// mean squared distance to the accumulated planes.
+struct Quadric {
+    f64 a00, a01, a02, a03;
+    f64 a11, a12, a13;
+    f64 a22, a23;
+    f64 a33;
+    f64 weight;
+};
+
+struct EdgeCollapse {
+    u32 from;
+    u32 to;
+    f32 cost; // Squared error.
+};
+
+struct SimplifyState {
+    Vertex *vertexes;
+    u32 vertex_count;
+    u32 *indexes; // Working index buffer; shrinks as triangles collapse.
+    u32 index_count;
+    Quadric *quadrics; // Indexed by position representative (see position_remap).
+    u32 *position_remap; // First vertex with each vertex's position.
+    bool *locked;
+    bool *touched;
+    u32 *collapse_remap;
+    u32 *adjacency_offsets;
+    u32 *adjacency;
+    u32 *adjacency_counts;
+    EdgeCollapse *collapses;
+    f32 error; // Largest error of any collapse applied so far.
+};
+
+////////////////////////////////////////////////////////////
+/// Internal
+////////////////////////////////////////////////////////////
+static Quadric plane_quadric(Vec3<f32> normal, f32 distance, f64 weight) {
+    f64 a = normal.x;
+    f64 b = normal.y;
+    f64 c = normal.z;
+    f64 d = distance;
+
+    return {
+        a * a * weight, a * b * weight, a * c * weight, a * d * weight,
+        b * b * weight, b * c * weight, b * d * weight,
+        c * c * weight, c * d * weight,
+        d * d * weight,
+        weight,
+    };
+}
+
+static void add_quadric(Quadric *dst, Quadric *src) {
+    dst->a00 += src->a00; dst->a01 += src->a01; dst->a02 += src->a02; dst->a03 += src->a03;
+    dst->a11 += src->a11; dst->a12 += src->a12; dst->a13 += src->a13;
+    dst->a22 += src->a22; dst->a23 += src->a23;
+    dst->a33 += src->a33;
+    dst->weight += src->weight;
+}
+
+static f64 evaluate_quadric(Quadric *q, Vec3<f32> p) {
+    f64 x = p.x;
+    f64 y = p.y;
+    f64 z = p.z;
+
+    return q->a00 * x * x + 2 * q->a01 * x * y + 2 * q->a02 * x * z + 2 * q->a03 * x +
+           q->a11 * y * y + 2 * q->a12 * y * z + 2 * q->a13 * y +
+           q->a22 * z * z + 2 * q->a23 * z +
+           q->a33;
+}
+
+static u32 hash_position(Vec3<f32> *position) {
+    auto bytes = (u8 *)position;
+    u32 hash = 2166136261u;
+    for (u32 i = 0; i < sizeof(Vec3<f32>); ++i)
+        hash = (hash ^ bytes[i]) * 16777619u;
+
+    return hash;
+}
+
+// Maps each vertex to the first vertex sharing its position, so attribute seams (vertexes split by UV or normal) share
+// one quadric and are recognized as one point of the surface.
+static void build_position_remap(Vertex *vertexes, u32 vertex_count, u32 *remap, Allocator *temp) {
+    push_frame(temp);
+
+    u32 table_size = (u32)hash_table_size(vertex_count);
+    auto table = allocate<u32>(temp, table_size);
+    memset(table, 0xFF, table_size * sizeof(u32));
+
+    for (u32 vertex = 0; vertex < vertex_count; ++vertex) {
+        Vec3<f32> *position = &vertexes[vertex].position;
+        u32 slot = hash_position(position) & (table_size - 1);
+
+        while (table[slot] != U32_MAX && memcmp(&vertexes[table[slot]].position, position, sizeof(Vec3<f32>)) != 0)
+            slot = (slot + 1) & (table_size - 1);
+
+        if (table[slot] == U32_MAX)
+            table[slot] = vertex;
+
+        remap[vertex] = table[slot];
+    }
+
+    pop_frame(temp);
+}
+
+// Locks vertexes that can't move without visibly changing the mesh's outline or attributes: attribute seams and
+// vertexes on open or non-manifold edges.
+static void lock_simplify_vertexes(SimplifyState *state, Allocator *temp) {
+    push_frame(temp);
+
+    u32 *remap = state->position_remap;
+    auto group_sizes = allocate<u32>(temp, state->vertex_count);
+    auto locked_positions = allocate<bool>(temp, state->vertex_count);
+    memset(group_sizes, 0, state->vertex_count * sizeof(u32));
+    memset(locked_positions, 0, state->vertex_count * sizeof(bool));
+
+    for (u32 vertex = 0; vertex < state->vertex_count; ++vertex)
+        ++group_sizes[remap[vertex]];
+
+    // Directed edges between positions; an edge is interior and manifold only if it appears exactly once in each
+    // direction.
+    auto edges = allocate<u64>(temp, state->index_count);
+    for (u32 i = 0; i < state->index_count; ++i) {
+        u32 a = remap[state->indexes[i]];
+        u32 b = remap[state->indexes[i - i % 3 + (i + 1) % 3]];
+        edges[i] = (u64)a << 32 | b;
+    }
+
+    std::sort(edges, edges + state->index_count);
+
+    for (u32 i = 0; i < state->index_count; ++i) {
+        u32 a = (u32)(edges[i] >> 32);
+        u32 b = (u32)edges[i];
+        u64 opposite = (u64)b << 32 | a;
+        u64 *first = std::lower_bound(edges, edges + state->index_count, opposite);
+        u64 *last = std::upper_bound(edges, edges + state->index_count, opposite);
+        bool duplicate = (i > 0 && edges[i - 1] == edges[i]) ||
+                         (i + 1 < state->index_count && edges[i + 1] == edges[i]);
+
+        if (last - first != 1 || duplicate) {
+            locked_positions[a] = true;
+            locked_positions[b] = true;
+        }
+    }
+
+    for (u32 vertex = 0; vertex < state->vertex_count; ++vertex)
+        state->locked[vertex] = group_sizes[remap[vertex]] > 1 || locked_positions[remap[vertex]];
+
+    pop_frame(temp);
+}
+
+static void init_simplify_quadrics(SimplifyState *state) {
+    memset(state->quadrics, 0, state->vertex_count * sizeof(Quadric));
+
+    for (u32 i = 0; i < state->index_count; i += 3) {
+        Vec3<f32> p0 = state->vertexes[state->indexes[i + 0]].position;
+        Vec3<f32> p1 = state->vertexes[state->indexes[i + 1]].position;
+        Vec3<f32> p2 = state->vertexes[state->indexes[i + 2]].position;
+        Vec3<f32> normal = cross3(p1 - p0, p2 - p0);
+        f32 length = sqrtf(dot3(normal, normal));
+        if (length == 0)
+            continue;
+
+        normal = (1 / length) * normal;
+        Quadric quadric = plane_quadric(normal, -dot3(normal, p0), length * 0.5f);
+        for (u32 j = 0; j < 3; ++j)
+            add_quadric(state->quadrics + state->position_remap[state->indexes[i + j]], &quadric);
+    }
+}
+
+static f32 calculate_collapse_cost(SimplifyState *state, u32 from, u32 to) {
+    Quadric *from_quadric = state->quadrics + state->position_remap[from];
+    Quadric *to_quadric = state->quadrics + state->position_remap[to];
+    f64 weight = from_quadric->weight + to_quadric->weight;
+    if (weight == 0)
+        return 0;
+
+    Vec3<f32> position = state->vertexes[to].position;
+    f64 error = (evaluate_quadric(from_quadric, position) + evaluate_quadric(to_quadric, position)) / weight;
+    return error > 0 ? (f32)error : 0;
+}
+
+// Rejects collapses that flip or fold any triangle around from that survives the collapse.
+static bool collapse_keeps_orientation(SimplifyState *state, u32 from, u32 to) {
+    Vec3<f32> to_position = state->vertexes[to].position;
+
+    for (u32 i = state->adjacency_offsets[from]; i < state->adjacency_offsets[from + 1]; ++i) {
+        u32 *triangle = state->indexes + state->adjacency[i] * 3;
+        if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+            continue;
+
+        Vec3<f32> positions[3] = {};
+        for (u32 j = 0; j < 3; ++j)
+            positions[j] = state->vertexes[triangle[j]].position;
+
+        Vec3<f32> normal = cross3(positions[1] - positions[0], positions[2] - positions[0]);
+        for (u32 j = 0; j < 3; ++j)
+            if (triangle[j] == from)
+                positions[j] = to_position;
+
+        Vec3<f32> new_normal = cross3(positions[1] - positions[0], positions[2] - positions[0]);
+        if (dot3(normal, new_normal) <= 0.25f * sqrtf(dot3(normal, normal) * dot3(new_normal, new_normal)))
+            return false;
+    }
+
+    return true;
+}
+
+// One round of collapses in order of increasing cost; each vertex takes part in at most one collapse per pass so
+// adjacency stays valid. Stops once triangle_target is reached or costs exceed max_cost. Returns collapse count.
+static u32 run_simplify_pass(SimplifyState *state, u32 triangle_target, f32 max_cost) {
+    build_vertex_adjacency(state->indexes, state->index_count, state->vertex_count, state->adjacency_offsets,
+                           state->adjacency, state->adjacency_counts);
+
+    u32 collapse_count = 0;
+    for (u32 i = 0; i < state->index_count; ++i) {
+        u32 a = state->indexes[i];
+        u32 b = state->indexes[i - i % 3 + (i + 1) % 3];
+
+        if (!state->locked[a])
+            state->collapses[collapse_count++] = { a, b, calculate_collapse_cost(state, a, b) };
+        if (!state->locked[b])
+            state->collapses[collapse_count++] = { b, a, calculate_collapse_cost(state, b, a) };
+    }
+
+    // Ties broken by vertex order keep output deterministic across standard library implementations.
+    std::sort(state->collapses, state->collapses + collapse_count, [](const EdgeCollapse &a, const EdgeCollapse &b) {
+        if (a.cost != b.cost) return a.cost < b.cost;
+        if (a.from != b.from) return a.from < b.from;
+        return a.to < b.to;
+    });
+
+    memset(state->touched, 0, state->vertex_count * sizeof(bool));
+    for (u32 vertex = 0; vertex < state->vertex_count; ++vertex)
+        state->collapse_remap[vertex] = vertex;
+
+    u32 triangle_count = state->index_count / 3;
+    u32 applied_count = 0;
+
+    for (u32 i = 0; i < collapse_count && triangle_count > triangle_target; ++i) {
+        EdgeCollapse *collapse = state->collapses + i;
+        if (collapse->cost > max_cost)
+            break;
+
+        if (state->touched[collapse->from] || state->touched[collapse->to] ||
+            !collapse_keeps_orientation(state, collapse->from, collapse->to))
+        {
+            continue;
+        }
+
+        // Lock from's one-ring for the rest of the pass, as its triangles change shape.
+        for (u32 j = state->adjacency_offsets[collapse->from]; j < state->adjacency_offsets[collapse->from + 1]; ++j) {
+            u32 *triangle = state->indexes + state->adjacency[j] * 3;
+            if (triangle[0] == collapse->to || triangle[1] == collapse->to || triangle[2] == collapse->to)
+                --triangle_count;
+
+            for (u32 k = 0; k < 3; ++k)
+                state->touched[triangle[k]] = true;
+        }
+
+        state->collapse_remap[collapse->from] = collapse->to;
+        add_quadric(state->quadrics + state->position_remap[collapse->to],
+                    state->quadrics + state->position_remap[collapse->from]);
+
+        if (collapse->cost > state->error)
+            state->error = collapse->cost;
+
+        ++applied_count;
+    }
+
+    // Remap collapsed vertexes and drop degenerate triangles.
+    u32 index_count = 0;
+    for (u32 i = 0; i < state->index_count; i += 3) {
+        u32 a = state->collapse_remap[state->indexes[i + 0]];
+        u32 b = state->collapse_remap[state->indexes[i + 1]];
+        u32 c = state->collapse_remap[state->indexes[i + 2]];
+
+        if (a != b && b != c && c != a) {
+            state->indexes[index_count++] = a;
+            state->indexes[index_count++] = b;
+            state->indexes[index_count++] = c;
+        }
+    }
+
+    state->index_count = index_count;
+    return applied_count;
+}
+
+static f32 calculate_mesh_diagonal(Vertex *vertexes, u32 *indexes, u32 index_count) {
+    Vec3<f32> bounds_min = { FLT_MAX, FLT_MAX, FLT_MAX };
+    Vec3<f32> bounds_max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+    for (u32 i = 0; i < index_count; ++i) {
+        Vec3<f32> position = vertexes[indexes[i]].position;
+        bounds_min = { fminf(bounds_min.x, position.x), fminf(bounds_min.y, position.y),
+                       fminf(bounds_min.z, position.z) };
+        bounds_max = { fmaxf(bounds_max.x, position.x), fmaxf(bounds_max.y, position.y),
+                       fmaxf(bounds_max.z, position.z) };
+    }
+
+    Vec3<f32> extent = bounds_max - bounds_min;
+    return sqrtf(dot3(extent, extent));
+}
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+// Upper bound on temp memory generate_mesh_lods() uses.
+static u64 generate_mesh_lods_scratch_size(u32 vertex_count, u32 index_count) {
+    u64 state_size = mesh_scratch_array_size<u32>(index_count) * 2 +      // Indexes, adjacency
+                     mesh_scratch_array_size<Quadric>(vertex_count) +
+                     mesh_scratch_array_size<u32>(vertex_count) * 3 +     // Remaps, adjacency counts
+                     mesh_scratch_array_size<bool>(vertex_count) * 2 +    // Locked, touched
+                     mesh_scratch_array_size<u32>(vertex_count + 1ull) +  // Adjacency offsets
+                     mesh_scratch_array_size<EdgeCollapse>(index_count * 2ull);
+
+    // Steps that run with the state allocated, each freeing its scratch before the next.
+    u64 remap_size = mesh_scratch_array_size<u32>(hash_table_size(vertex_count));
+    u64 lock_size = mesh_scratch_array_size<u32>(vertex_count) + mesh_scratch_array_size<bool>(vertex_count) +
+                    mesh_scratch_array_size<u64>(index_count);
+    u64 vertex_cache_size = optimize_vertex_cache_scratch_size(vertex_count, index_count);
+
+    u64 step_size = remap_size;
+    step_size = lock_size > step_size ? lock_size : step_size;
+    step_size = vertex_cache_size > step_size ? vertex_cache_size : step_size;
+    return state_size + step_size;
+}
+
+// Generates a LOD chain by quadric error metric edge collapse, each LOD targeting MESH_LOD_TRIANGLE_RATIO of the
+// previous one's triangles. Vertexes only collapse onto existing neighbours, so all LODs index the original vertexes;
+// attribute seams and open borders are kept intact. lods[0] is set to the full detail index range and simplified LODs
+// follow it in the mesh's index buffer: their indexes are written to lod_indexes, which must have room for index_count
+// indexes (each LOD is at most half its predecessor, except possibly the last). Each LOD's index order is optimized
+// for the vertex cache. lods must have room for MESH_MAX_LODS elements; returns the LOD count (at least 1).
+static u32 generate_mesh_lods(Vertex *vertexes, u32 vertex_count, u32 *indexes, u32 index_count, MeshLOD *lods,
+                              u32 *lod_indexes, Allocator *temp)
+{
+    lods[0] = { 0, index_count, 0 };
+    u32 lod_count = 1;
+    u32 triangle_count = index_count / 3;
+    if (triangle_count * MESH_LOD_TRIANGLE_RATIO < MESH_LOD_MIN_TRIANGLES)
+        return lod_count;
+
+    push_frame(temp);
+
+    SimplifyState state = {};
+    state.vertexes = vertexes;
+    state.vertex_count = vertex_count;
+    state.indexes = allocate<u32>(temp, index_count);
+    state.index_count = index_count;
+    state.quadrics = allocate<Quadric>(temp, vertex_count);
+    state.position_remap = allocate<u32>(temp, vertex_count);
+    state.locked = allocate<bool>(temp, vertex_count);
+    state.touched = allocate<bool>(temp, vertex_count);
+    state.collapse_remap = allocate<u32>(temp, vertex_count);
+    state.adjacency_offsets = allocate<u32>(temp, vertex_count + 1);
+    state.adjacency = allocate<u32>(temp, index_count);
+    state.adjacency_counts = allocate<u32>(temp, vertex_count);
+    state.collapses = allocate<EdgeCollapse>(temp, index_count * 2);
+    memcpy(state.indexes, indexes, index_count * sizeof(u32));
+
+    build_position_remap(vertexes, vertex_count, state.position_remap, temp);
+    lock_simplify_vertexes(&state, temp);
+    init_simplify_quadrics(&state);
+
+    f32 max_error = MESH_LOD_MAX_RELATIVE_ERROR * calculate_mesh_diagonal(vertexes, indexes, index_count);
+    f32 max_cost = max_error * max_error;
+    u32 lod_index_count = 0;
+
+    while (lod_count < MESH_MAX_LODS) {
+        u32 previous_triangle_count = lods[lod_count - 1].index_count / 3;
+        u32 triangle_target = (u32)(previous_triangle_count * MESH_LOD_TRIANGLE_RATIO);
+        if (triangle_target < MESH_LOD_MIN_TRIANGLES)
+            break;
+
+        bool stalled = false;
+        while (state.index_count / 3 > triangle_target && !stalled)
+            stalled = run_simplify_pass(&state, triangle_target, max_cost) == 0;
+
+        if (state.index_count / 3 > previous_triangle_count * MESH_LOD_MIN_REDUCTION)
+            break;
+
+        u32 *dst = lod_indexes + lod_index_count;
+        memcpy(dst, state.indexes, state.index_count * sizeof(u32));
+        optimize_vertex_cache(dst, state.index_count, vertex_count, temp);
+
+        lods[lod_count++] = { index_count + lod_index_count, state.index_count, sqrtf(state.error) };
+        lod_index_count += state.index_count;
+
+        if (stalled)
+            break;
+    }
+
+    pop_frame(temp);
+    return lod_count;
+}
+
+static void print_mesh_lods(cstr name, MeshLOD *lods, u32 lod_count) {
+    print_line("    %s: %u LODs", name, lod_count);
+    for (u32 i = 0; i < lod_count; ++i)
+        print_line("        LOD %u: %u triangles, error %g", i, lods[i].index_count / 3, lods[i].error);
+}
@@ -0,0 +1,486 @@
+#pragma once
+
+#include <math.h>
+#include <string.h>
+#include <cfloat>
+#include <emmintrin.h>
+#include "renderer/mesh.h"
+#include "renderer/mesh_optimizer.h"
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+#include "ctk/math.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+static constexpr u32 MESHLET_MAX_VERTEXES = 64;
+static constexpr u32 MESHLET_MAX_TRIANGLES = 124;
+
+// Triangles whose normals spread further than this from the cone axis (dot product) make the cone useless, so such
+// meshlets are never backface culled.
+static constexpr f32 MESHLET_MIN_CONE_SPREAD = 0.1f;
+
+// Cluster of a mesh's triangles stored contiguously in the mesh's index buffer, with bounds in model space. The cluster
+// is entirely back-facing from any camera position where dot(normalize(cone_apex - camera), cone_axis) > cone_cutoff;
+// cone_cutoff is above 1 when the cluster's normals spread too much to ever cull it.
+struct Meshlet {
+    Vec3<f32> center;
+    f32 radius;
+    Vec3<f32> cone_apex;
+    f32 cone_cutoff;
+    Vec3<f32> cone_axis;
+    u32 first_index; // Relative to the mesh's first index.
+    u32 index_count;
+    u32 vertex_count; // Unique vertexes referenced.
+};
+
+static_assert(sizeof(Meshlet) == 56, "Meshlet layout changed; bump MESH_FILE_VERSION");
+
+// Layout-compatible with VkDrawIndexedIndirectCommand, so culling output can be written straight to an indirect buffer.
+struct MeshletDrawCommand {
+    u32 index_count;
+    u32 instance_count;
+    u32 first_index;
+    s32 vertex_offset;
+    u32 first_instance;
+};
+
+// Meshlet bounds in structure-of-arrays layout for SIMD culling; arrays are zero-padded to a multiple of 4 elements.
+struct MeshletCullData {
+    u32 count;
+    f32 *center_x;
+    f32 *center_y;
+    f32 *center_z;
+    f32 *radius;
+    f32 *cone_apex_x;
+    f32 *cone_apex_y;
+    f32 *cone_apex_z;
+    f32 *cone_axis_x;
+    f32 *cone_axis_y;
+    f32 *cone_axis_z;
+    f32 *cone_cutoff;
+    u32 *first_index;
+    u32 *index_count;
+};
+
+// Frustum planes (xyz = inward normal, w = distance) and camera position in a mesh's model space.
+struct MeshletCullView {
+    f32 planes[6][4];
+    Vec3<f32> camera_position;
+};
+
+struct MeshletBuildState {
+    u32 *indexes;
+    u32 vertex_count;
+
+    // Vertex -> live (not yet emitted) triangle adjacency; emitted triangles are swapped out of each vertex's range.
+    u32 *adjacency_offsets;
+    u32 *adjacency;
+    u32 *live_triangle_counts;
+
+    // Vertexes of the meshlet being built are stamped with its meshlet index + 1.
+    u32 *vertex_stamps;
+    u32 meshlet_vertexes[MESHLET_MAX_VERTEXES];
+    u32 meshlet_vertex_count;
+    u32 meshlet_triangle_count;
+    u32 meshlet_stamp;
+
+    bool *emitted;
+    u32 seed_cursor;
+};
+
+////////////////////////////////////////////////////////////
+/// Internal
+////////////////////////////////////////////////////////////
+static u32 count_new_meshlet_vertexes(MeshletBuildState *state, u32 triangle) {
+    u32 *triangle_indexes = state->indexes + triangle * 3;
+    return (state->vertex_stamps[triangle_indexes[0]] != state->meshlet_stamp) +
+           (state->vertex_stamps[triangle_indexes[1]] != state->meshlet_stamp) +
+           (state->vertex_stamps[triangle_indexes[2]] != state->meshlet_stamp);
+}
+
+// Picks the live triangle adjacent to the current meshlet that adds the fewest vertexes to it, taking the first found
+// on ties so output only depends on input. Falls back to the next live triangle in index order if the meshlet has no
+// live neighbors, which keeps locality for meshes that were already optimized for the vertex cache.
+static u32 next_meshlet_triangle(MeshletBuildState *state, u32 triangle_count) {
+    u32 best_triangle = U32_MAX;
+    u32 best_new_vertex_count = 4;
+
+    for (u32 i = 0; i < state->meshlet_vertex_count && best_new_vertex_count > 0; ++i) {
+        u32 vertex = state->meshlet_vertexes[i];
+        u32 *triangles = state->adjacency + state->adjacency_offsets[vertex];
+
+        for (u32 j = 0; j < state->live_triangle_counts[vertex]; ++j) {
+            u32 new_vertex_count = count_new_meshlet_vertexes(state, triangles[j]);
+            if (new_vertex_count < best_new_vertex_count) {
+                best_triangle = triangles[j];
+                best_new_vertex_count = new_vertex_count;
+                if (new_vertex_count == 0)
+                    break;
+            }
+        }
+    }
+
+    if (best_triangle != U32_MAX)
+        return best_triangle;
+
+    while (state->seed_cursor < triangle_count && state->emitted[state->seed_cursor])
+        ++state->seed_cursor;
+
+    return state->seed_cursor;
+}
+
+static void remove_live_triangle(MeshletBuildState *state, u32 vertex, u32 triangle) {
+    u32 *triangles = state->adjacency + state->adjacency_offsets[vertex];
+    u32 count = state->live_triangle_counts[vertex];
+
+    for (u32 i = 0; i < count; ++i) {
+        if (triangles[i] == triangle) {
+            triangles[i] = triangles[count - 1];
+            triangles[count - 1] = triangle;
+            --state->live_triangle_counts[vertex];
+            return;
+        }
+    }
+}
+
+static void calculate_meshlet_bounds(Meshlet *meshlet, u32 *indexes, Vertex *vertexes) {
+    u32 *meshlet_indexes = indexes + meshlet->first_index;
+
+    // Bounding sphere: centered on the AABB, radius reaching the farthest vertex.
+    Vec3<f32> bounds_min = { FLT_MAX, FLT_MAX, FLT_MAX };
+    Vec3<f32> bounds_max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (u32 i = 0; i < meshlet->index_count; ++i) {
+        Vec3<f32> position = vertexes[meshlet_indexes[i]].position;
+        if (position.x < bounds_min.x) bounds_min.x = position.x;
+        if (position.y < bounds_min.y) bounds_min.y = position.y;
+        if (position.z < bounds_min.z) bounds_min.z = position.z;
+        if (position.x > bounds_max.x) bounds_max.x = position.x;
+        if (position.y > bounds_max.y) bounds_max.y = position.y;
+        if (position.z > bounds_max.z) bounds_max.z = position.z;
+    }
+
+    meshlet->center = 0.5f * (bounds_min + bounds_max);
+    f32 radius_sq = 0;
+    for (u32 i = 0; i < meshlet->index_count; ++i) {
+        Vec3<f32> offset = vertexes[meshlet_indexes[i]].position - meshlet->center;
+        f32 distance_sq = dot3(offset, offset);
+        if (distance_sq > radius_sq)
+            radius_sq = distance_sq;
+    }
+    meshlet->radius = sqrtf(radius_sq);
+
+    // Normal cone: axis is the average triangle normal and the cutoff covers the normal farthest from it. Normals are
+    // outward for clockwise front faces.
+    Vec3<f32> normal_sum = {};
+    for (u32 i = 0; i < meshlet->index_count; i += 3) {
+        Vec3<f32> p0 = vertexes[meshlet_indexes[i + 0]].position;
+        Vec3<f32> p1 = vertexes[meshlet_indexes[i + 1]].position;
+        Vec3<f32> p2 = vertexes[meshlet_indexes[i + 2]].position;
+        Vec3<f32> normal = cross3(p2 - p0, p1 - p0);
+        f32 length = sqrtf(dot3(normal, normal));
+        if (length > 0)
+            normal_sum += (1.0f / length) * normal;
+    }
+
+    meshlet->cone_apex = meshlet->center;
+    meshlet->cone_axis = {};
+    meshlet->cone_cutoff = 2.0f;
+
+    f32 normal_sum_length = sqrtf(dot3(normal_sum, normal_sum));
+    if (normal_sum_length == 0)
+        return;
+
+    Vec3<f32> axis = (1.0f / normal_sum_length) * normal_sum;
+    f32 min_dot = 1.0f;
+    for (u32 i = 0; i < meshlet->index_count; i += 3) {
+        Vec3<f32> p0 = vertexes[meshlet_indexes[i + 0]].position;
+        Vec3<f32> p1 = vertexes[meshlet_indexes[i + 1]].position;
+        Vec3<f32> p2 = vertexes[meshlet_indexes[i + 2]].position;
+        Vec3<f32> normal = cross3(p2 - p0, p1 - p0);
+        f32 length = sqrtf(dot3(normal, normal));
+        if (length > 0 && dot3(axis, normal) / length < min_dot)
+            min_dot = dot3(axis, normal) / length;
+    }
+
+    if (min_dot <= MESHLET_MIN_CONE_SPREAD)
+        return;
+
+    // Move apex back along the axis until every triangle's plane faces away from it.
+    f32 max_t = 0;
+    for (u32 i = 0; i < meshlet->index_count; i += 3) {
+        Vec3<f32> p0 = vertexes[meshlet_indexes[i + 0]].position;
+        Vec3<f32> p1 = vertexes[meshlet_indexes[i + 1]].position;
+        Vec3<f32> p2 = vertexes[meshlet_indexes[i + 2]].position;
+        Vec3<f32> normal = cross3(p2 - p0, p1 - p0);
+        f32 axis_dot = dot3(axis, normal);
+        if (axis_dot <= 0)
+            continue;
+
+        f32 t = dot3(meshlet->center - p0, normal) / axis_dot;
+        if (t > max_t)
+            max_t = t;
+    }
+
+    meshlet->cone_apex = meshlet->center - max_t * axis;
+    meshlet->cone_axis = axis;
+    meshlet->cone_cutoff = sqrtf(1.0f - min_dot * min_dot);
+}
+
+static void normalize_cull_plane(f32 *plane) {
+    f32 length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+    for (u32 i = 0; i < 4; ++i)
+        plane[i] /= length;
+}
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+// Upper bound on the number of meshlets build_meshlets() produces: meshlets only close when the next triangle doesn't
+// fit, so each holds at least MESHLET_MAX_VERTEXES / 3 triangles.
+static u32 max_meshlet_count(u32 index_count) {
+    static constexpr u32 MIN_TRIANGLES = MESHLET_MAX_VERTEXES / 3;
+    return (index_count / 3 + MIN_TRIANGLES - 1) / MIN_TRIANGLES + 1;
+}
+
+// Upper bound on temp memory build_meshlets() uses.
+static u64 build_meshlets_scratch_size(u32 vertex_count, u32 index_count) {
+    u64 triangle_count = index_count / 3;
+    return mesh_scratch_array_size<u32>(vertex_count + 1ull) +   // Adjacency offsets
+           mesh_scratch_array_size<u32>(index_count) +           // Adjacency
+           mesh_scratch_array_size<u32>(vertex_count) * 2 +      // Live triangle counts, vertex stamps
+           mesh_scratch_array_size<bool>(triangle_count) +       // Emitted
+           mesh_scratch_array_size<u32>(triangle_count * 3);     // Output
+}
+
+// Splits a triangle list into meshlets of at most MESHLET_MAX_VERTEXES vertexes and MESHLET_MAX_TRIANGLES triangles,
+// greedily growing each meshlet with whichever adjacent triangle adds the fewest vertexes. Indexes are reordered in
+// place so each meshlet's triangles are contiguous. meshlets must have room for max_meshlet_count(index_count)
+// elements. Output is deterministic; returns the meshlet count.
+static u32 build_meshlets(Vertex *vertexes, u32 vertex_count, u32 *indexes, u32 index_count, Meshlet *meshlets,
+                          Allocator *temp)
+{
+    u32 triangle_count = index_count / 3;
+    if (triangle_count == 0)
+        return 0;
+
+    push_frame(temp);
+
+    MeshletBuildState state = {};
+    state.indexes = indexes;
+    state.vertex_count = vertex_count;
+    state.adjacency_offsets = allocate<u32>(temp, vertex_count + 1);
+    state.adjacency = allocate<u32>(temp, index_count);
+    state.live_triangle_counts = allocate<u32>(temp, vertex_count);
+    state.vertex_stamps = allocate<u32>(temp, vertex_count);
+    state.emitted = allocate<bool>(temp, triangle_count);
+    memset(state.vertex_stamps, 0, vertex_count * sizeof(u32));
+    memset(state.emitted, 0, triangle_count * sizeof(bool));
+    build_vertex_adjacency(indexes, triangle_count * 3, vertex_count, state.adjacency_offsets, state.adjacency,
+                           state.live_triangle_counts);
+
+    auto output = allocate<u32>(temp, triangle_count * 3);
+    u32 meshlet_count = 0;
+    Meshlet *meshlet = meshlets;
+    *meshlet = {};
+    state.meshlet_stamp = 1;
+
+    for (u32 emitted_count = 0; emitted_count < triangle_count; ++emitted_count) {
+        u32 triangle = next_meshlet_triangle(&state, triangle_count);
+
+        // Close current meshlet if triangle doesn't fit.
+        if (state.meshlet_vertex_count + count_new_meshlet_vertexes(&state, triangle) > MESHLET_MAX_VERTEXES ||
+            state.meshlet_triangle_count == MESHLET_MAX_TRIANGLES)
+        {
+            meshlet->vertex_count = state.meshlet_vertex_count;
+            ++meshlet_count;
+            meshlet = meshlets + meshlet_count;
+            *meshlet = {};
+            meshlet->first_index = emitted_count * 3;
+
+            state.meshlet_vertex_count = 0;
+            state.meshlet_triangle_count = 0;
+            ++state.meshlet_stamp;
+        }
+
+        // Add triangle.
+        u32 *triangle_indexes = indexes + triangle * 3;
+        for (u32 i = 0; i < 3; ++i) {
+            u32 vertex = triangle_indexes[i];
+            output[emitted_count * 3 + i] = vertex;
+            remove_live_triangle(&state, vertex, triangle);
+
+            if (state.vertex_stamps[vertex] != state.meshlet_stamp) {
+                state.vertex_stamps[vertex] = state.meshlet_stamp;
+                state.meshlet_vertexes[state.meshlet_vertex_count++] = vertex;
+            }
+        }
+
+        state.emitted[triangle] = true;
+        ++state.meshlet_triangle_count;
+        meshlet->index_count += 3;
+    }
+
+    meshlet->vertex_count = state.meshlet_vertex_count;
+    ++meshlet_count;
+
+    memcpy(indexes, output, triangle_count * 3 * sizeof(u32));
+    for (u32 i = 0; i < meshlet_count; ++i)
+        calculate_meshlet_bounds(meshlets + i, indexes, vertexes);
+
+    pop_frame(temp);
+    return meshlet_count;
+}
+
+static MeshletCullData *create_meshlet_cull_data(Allocator *allocator, Meshlet *meshlets, u32 meshlet_count) {
+    u32 padded_count = (meshlet_count + 3) & ~3u;
+
+    auto cull_data = allocate<MeshletCullData>(allocator, 1);
+    cull_data->count = meshlet_count;
+
+    f32 **f32_arrays[] = {
+        &cull_data->center_x, &cull_data->center_y, &cull_data->center_z, &cull_data->radius,
+        &cull_data->cone_apex_x, &cull_data->cone_apex_y, &cull_data->cone_apex_z,
+        &cull_data->cone_axis_x, &cull_data->cone_axis_y, &cull_data->cone_axis_z, &cull_data->cone_cutoff,
+    };
+    for (u32 i = 0; i < CTK_ARRAY_SIZE(f32_arrays); ++i) {
+        *f32_arrays[i] = allocate<f32>(allocator, padded_count);
+        memset(*f32_arrays[i], 0, padded_count * sizeof(f32));
+    }
+
+    cull_data->first_index = allocate<u32>(allocator, padded_count);
+    cull_data->index_count = allocate<u32>(allocator, padded_count);
+
+    for (u32 i = 0; i < meshlet_count; ++i) {
+        Meshlet *meshlet = meshlets + i;
+        cull_data->center_x[i] = meshlet->center.x;
+        cull_data->center_y[i] = meshlet->center.y;
+        cull_data->center_z[i] = meshlet->center.z;
+        cull_data->radius[i] = meshlet->radius;
+        cull_data->cone_apex_x[i] = meshlet->cone_apex.x;
+        cull_data->cone_apex_y[i] = meshlet->cone_apex.y;
+        cull_data->cone_apex_z[i] = meshlet->cone_apex.z;
+        cull_data->cone_axis_x[i] = meshlet->cone_axis.x;
+        cull_data->cone_axis_y[i] = meshlet->cone_axis.y;
+        cull_data->cone_axis_z[i] = meshlet->cone_axis.z;
+        cull_data->cone_cutoff[i] = meshlet->cone_cutoff;
+        cull_data->first_index[i] = meshlet->first_index;
+        cull_data->index_count[i] = meshlet->index_count;
+    }
+
+    return cull_data;
+}
+
+// Extracts frustum planes and camera position in model space from a model-view-projection matrix (without any
+// position dequantization), assuming Vulkan's [0, 1] clip-space depth range.
+static MeshletCullView create_meshlet_cull_view(Matrix model_view_projection) {
+    // Rows of the matrix, which is column-major.
+    f32 rows[4][4] = {};
+    for (u32 row = 0; row < 4; ++row)
+        for (u32 column = 0; column < 4; ++column)
+            rows[row][column] = model_view_projection[column][row];
+
+    MeshletCullView view = {};
+    for (u32 i = 0; i < 4; ++i) {
+        view.planes[0][i] = rows[3][i] + rows[0][i]; // Left
+        view.planes[1][i] = rows[3][i] - rows[0][i]; // Right
+        view.planes[2][i] = rows[3][i] + rows[1][i]; // Bottom
+        view.planes[3][i] = rows[3][i] - rows[1][i]; // Top
+        view.planes[4][i] = rows[2][i];              // Near
+        view.planes[5][i] = rows[3][i] - rows[2][i]; // Far
+    }
+    for (u32 i = 0; i < 6; ++i)
+        normalize_cull_plane(view.planes[i]);
+
+    // The camera is the point where clip-space x, y and w are all 0; solve with Cramer's rule.
+    f64 a[3][3] = {
+        { rows[0][0], rows[0][1], rows[0][2] },
+        { rows[1][0], rows[1][1], rows[1][2] },
+        { rows[3][0], rows[3][1], rows[3][2] },
+    };
+    f64 b[3] = { -rows[0][3], -rows[1][3], -rows[3][3] };
+    f64 determinant = a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1]) -
+                      a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0]) +
+                      a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+    if (determinant == 0)
+        return view;
+
+    f64 solution[3] = {};
+    for (u32 column = 0; column < 3; ++column) {
+        f64 m[3][3] = {};
+        for (u32 row = 0; row < 3; ++row)
+            for (u32 i = 0; i < 3; ++i)
+                m[row][i] = i == column ? b[row] : a[row][i];
+
+        solution[column] = (m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+                            m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+                            m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0])) / determinant;
+    }
+
+    view.camera_position = { (f32)solution[0], (f32)solution[1], (f32)solution[2] };
+    return view;
+}
+
+// Culls meshlets outside the frustum or entirely back-facing, 4 at a time, and writes a draw command for each visible
+// meshlet to draws (which must have room for cull_data->count commands). Returns the number of draws written.
+static u32 cull_meshlets(MeshletCullData *cull_data, MeshletCullView *view, MeshletDrawCommand *draws) {
+    __m128 planes[6][4];
+    for (u32 i = 0; i < 6; ++i)
+        for (u32 j = 0; j < 4; ++j)
+            planes[i][j] = _mm_set1_ps(view->planes[i][j]);
+
+    __m128 camera_x = _mm_set1_ps(view->camera_position.x);
+    __m128 camera_y = _mm_set1_ps(view->camera_position.y);
+    __m128 camera_z = _mm_set1_ps(view->camera_position.z);
+    u32 draw_count = 0;
+
+    for (u32 base = 0; base < cull_data->count; base += 4) {
+        __m128 center_x = _mm_loadu_ps(cull_data->center_x + base);
+        __m128 center_y = _mm_loadu_ps(cull_data->center_y + base);
+        __m128 center_z = _mm_loadu_ps(cull_data->center_z + base);
+        __m128 negative_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(cull_data->radius + base));
+
+        // Frustum: sphere must not be entirely behind any plane.
+        __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (u32 i = 0; i < 6; ++i) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[i][0], center_x),
+                                                    _mm_mul_ps(planes[i][1], center_y)),
+                                         _mm_add_ps(_mm_mul_ps(planes[i][2], center_z), planes[i][3]));
+            visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, negative_radius));
+        }
+
+        // Backface cone: cull if dot(apex - camera, axis) > cutoff * length(apex - camera).
+        __m128 to_apex_x = _mm_sub_ps(_mm_loadu_ps(cull_data->cone_apex_x + base), camera_x);
+        __m128 to_apex_y = _mm_sub_ps(_mm_loadu_ps(cull_data->cone_apex_y + base), camera_y);
+        __m128 to_apex_z = _mm_sub_ps(_mm_loadu_ps(cull_data->cone_apex_z + base), camera_z);
+        __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(to_apex_x, to_apex_x),
+                                                            _mm_mul_ps(to_apex_y, to_apex_y)),
+                                                 _mm_mul_ps(to_apex_z, to_apex_z)));
+        __m128 axis_dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(to_apex_x, _mm_loadu_ps(cull_data->cone_axis_x + base)),
+                                                _mm_mul_ps(to_apex_y, _mm_loadu_ps(cull_data->cone_axis_y + base))),
+                                     _mm_mul_ps(to_apex_z, _mm_loadu_ps(cull_data->cone_axis_z + base)));
+        __m128 back_facing = _mm_cmpgt_ps(axis_dot, _mm_mul_ps(_mm_loadu_ps(cull_data->cone_cutoff + base), distance));
+        visible = _mm_andnot_ps(back_facing, visible);
+
+        u32 mask = (u32)_mm_movemask_ps(visible);
+        u32 remaining = cull_data->count - base;
+        if (remaining < 4)
+            mask &= (1u << remaining) - 1;
+
+        for (u32 i = 0; i < 4; ++i) {
+            if (mask & (1u << i)) {
+                draws[draw_count++] = {
+                    .index_count = cull_data->index_count[base + i],
+                    .instance_count = 1,
+                    .first_index = cull_data->first_index[base + i],
+                    .vertex_offset = 0,
+                    .first_instance = 0,
+                };
+            }
+        }
+    }
+
+    return draw_count;
+}
@@ -0,0 +1,598 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "renderer/vulkan.h"
+#include "renderer/timer.h"
+#include "renderer/creation_key.h"
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+#include "ctk/containers.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+struct PipelineRegistryInfo {
+    u32 max_variants;
+    u32 max_layouts;
+    u32 max_descriptor_set_layouts;
+    u32 max_precompile_threads;
+};
+
+enum class PipelineVariantState : u32 {
+    PENDING,
+    BUILDING,
+    BUILT,
+};
+
+// A registered pipeline. Its layout is created at registration, but its VkPipeline is only built on first use or by
+// precompilation, from the registry's own copy of the PipelineInfo.
+struct PipelineVariant {
+    StoredCreationKey key;
+    RenderPass *render_pass;
+    u32 subpass;
+    PipelineInfo info;
+    Pipeline *pipeline;
+    std::atomic<PipelineVariantState> state;
+    f64 build_ms;
+};
+
+struct PipelineLayoutEntry {
+    StoredCreationKey key;
+    VkPipelineLayout handle;
+};
+
+struct DescriptorSetLayoutEntry {
+    StoredCreationKey key;
+    VkDescriptorSetLayout handle;
+};
+
+struct PipelineRegistryStats {
+    u32 variant_count;
+    u32 layout_count;
+    u32 descriptor_set_layout_count;
+    u32 deduplicated_variant_count; // Registrations that returned an existing variant.
+    u32 deduplicated_layout_count;  // Registrations that reused an existing layout.
+    u32 precompiled_count;
+    u32 lazy_build_count;           // Variants built on first use rather than by precompilation.
+    f64 precompile_ms;
+};
+
+// Pipelines and layouts keyed by their full creation state. Variants must be registered from the thread that
+// owns vk (registration allocates from vk->pool); get_pipeline() can be called from any thread.
+struct PipelineRegistry {
+    Vulkan *vk;
+    Allocator *mem;
+
+    PipelineVariant *variants;
+    CreationKeyTable variant_table;
+    u32 variant_count;
+
+    PipelineLayoutEntry *layouts;
+    CreationKeyTable layout_table;
+    u32 layout_count;
+
+    // Descriptor set layouts from shader reflection by apply_reflected_layout() and from get_descriptor_set_layout(),
+    // shared with descriptor allocators.
+    DescriptorSetLayoutEntry *descriptor_set_layouts;
+    CreationKeyTable descriptor_set_layout_table;
+    u32 descriptor_set_layout_count;
+
+    PipelineRegistryInfo info;
+
+    // Signaled whenever a variant finishes building, for threads waiting on a variant another thread is building.
+    std::mutex build_mutex;
+    std::condition_variable build_cond;
+
+    std::thread *precompile_threads;
+    u32 precompile_thread_count;
+    u32 precompile_variant_count;
+    std::atomic<u32> next_precompile_idx;
+    std::atomic<u32> running_precompile_threads;
+    u64 precompile_start_ns;
+    std::atomic<u64> precompile_end_ns; // Latest thread finish; published by the running_precompile_threads decrement.
+
+    std::atomic<u32> precompiled_count;
+    std::atomic<u32> lazy_build_count;
+    u32 deduplicated_variant_count;
+    u32 deduplicated_layout_count;
+};
+
+////////////////////////////////////////////////////////////
+/// Internal
+////////////////////////////////////////////////////////////
+static void write_pipeline_layout_key(CreationKey *key, PipelineInfo *info) {
+    write_creation_key_array(key, info->descriptor_set_layouts);
+    write_creation_key_array(key, info->push_constant_ranges);
+}
+
+// Writes every field that affects pipeline creation; pNext chains on the fixed-function state structs are ignored.
+static void write_pipeline_variant_key(CreationKey *key, RenderPass *render_pass, u32 subpass, PipelineInfo *info) {
+    write_pipeline_layout_key(key, info);
+    write_creation_key_value(key, render_pass->handle);
+    write_creation_key_value(key, subpass);
+
+    // Shaders
+    write_creation_key_value(key, info->shaders.count);
+    for (u32 i = 0; i < info->shaders.count; ++i) {
+        write_creation_key_value(key, info->shaders.data[i]->handle);
+        write_creation_key_value(key, info->shaders.data[i]->stage);
+    }
+
+    // Specialization Constants
+    write_creation_key_value(key, info->specialization_constants.count);
+    for (u32 i = 0; i < info->specialization_constants.count; ++i) {
+        SpecializationConstants *constants = info->specialization_constants.data + i;
+        write_creation_key_value(key, constants->stage);
+        write_creation_key_value(key, constants->entries.count);
+        for (u32 entry_idx = 0; entry_idx < constants->entries.count; ++entry_idx) {
+            write_creation_key_value(key, constants->entries.data[entry_idx].constantID);
+            write_creation_key_value(key, constants->entries.data[entry_idx].offset);
+        }
+
+        write_creation_key_bytes(key, constants->data.data, constants->data.count * sizeof(u32));
+    }
+
+    // Vertex Input/Viewport
+    write_creation_key_array(key, info->vertex_bindings);
+    write_creation_key_array(key, info->vertex_attributes);
+    write_creation_key_array(key, info->viewports);
+    write_creation_key_array(key, info->scissors);
+
+    // Input Assembly
+    VkPipelineInputAssemblyStateCreateInfo *input_assembly = &info->input_assembly;
+    write_creation_key_value(key, input_assembly->flags);
+    write_creation_key_value(key, input_assembly->topology);
+    write_creation_key_value(key, input_assembly->primitiveRestartEnable);
+
+    // Rasterization
+    VkPipelineRasterizationStateCreateInfo *rasterization = &info->rasterization;
+    write_creation_key_value(key, rasterization->flags);
+    write_creation_key_value(key, rasterization->depthClampEnable);
+    write_creation_key_value(key, rasterization->rasterizerDiscardEnable);
+    write_creation_key_value(key, rasterization->polygonMode);
+    write_creation_key_value(key, rasterization->cullMode);
+    write_creation_key_value(key, rasterization->frontFace);
+    write_creation_key_value(key, rasterization->depthBiasEnable);
+    write_creation_key_value(key, rasterization->depthBiasConstantFactor);
+    write_creation_key_value(key, rasterization->depthBiasClamp);
+    write_creation_key_value(key, rasterization->depthBiasSlopeFactor);
+    write_creation_key_value(key, rasterization->lineWidth);
+
+    // Multisample
+    VkPipelineMultisampleStateCreateInfo *multisample = &info->multisample;
+    write_creation_key_value(key, multisample->flags);
+    write_creation_key_value(key, multisample->rasterizationSamples);
+    write_creation_key_value(key, multisample->sampleShadingEnable);
+    write_creation_key_value(key, multisample->minSampleShading);
+    write_creation_key_value(key, multisample->alphaToCoverageEnable);
+    write_creation_key_value(key, multisample->alphaToOneEnable);
+    if (multisample->pSampleMask != NULL) {
+        u32 mask_count = ((u32)multisample->rasterizationSamples + 31) / 32;
+        write_creation_key_bytes(key, (void *)multisample->pSampleMask, mask_count * sizeof(VkSampleMask));
+    }
+
+    // Depth/Stencil
+    VkPipelineDepthStencilStateCreateInfo *depth_stencil = &info->depth_stencil;
+    write_creation_key_value(key, depth_stencil->flags);
+    write_creation_key_value(key, depth_stencil->depthTestEnable);
+    write_creation_key_value(key, depth_stencil->depthWriteEnable);
+    write_creation_key_value(key, depth_stencil->depthCompareOp);
+    write_creation_key_value(key, depth_stencil->depthBoundsTestEnable);
+    write_creation_key_value(key, depth_stencil->stencilTestEnable);
+    write_creation_key_value(key, depth_stencil->front);
+    write_creation_key_value(key, depth_stencil->back);
+    write_creation_key_value(key, depth_stencil->minDepthBounds);
+    write_creation_key_value(key, depth_stencil->maxDepthBounds);
+
+    // Color Blend
+    VkPipelineColorBlendStateCreateInfo *color_blend = &info->color_blend;
+    write_creation_key_value(key, color_blend->flags);
+    write_creation_key_value(key, color_blend->logicOpEnable);
+    write_creation_key_value(key, color_blend->logicOp);
+    write_creation_key_bytes(key, color_blend->blendConstants, sizeof(color_blend->blendConstants));
+    write_creation_key_value(key, info->color_blend_attachments.count);
+    write_creation_key_bytes(key, info->color_blend_attachments.data,
+                             info->color_blend_attachments.count * sizeof(VkPipelineColorBlendAttachmentState));
+}
+
+template<typename Type>
+static Array<Type> *copy_pipeline_array(Allocator *allocator, Array<Type> *array) {
+    if (array == NULL)
+        return NULL;
+
+    auto copy = create_array<Type>(allocator, array->count > 0 ? array->count : 1);
+    memcpy(copy->data, array->data, array->count * sizeof(Type));
+    copy->count = array->count;
+    return copy;
+}
+
+// Registered infos must outlive the caller's temp memory, so arrays are copied into registry memory.
+static void copy_pipeline_info(Allocator *allocator, PipelineInfo *dst, PipelineInfo *src) {
+    *dst = *src;
+    dst->descriptor_set_layouts = copy_pipeline_array(allocator, src->descriptor_set_layouts);
+    dst->push_constant_ranges = copy_pipeline_array(allocator, src->push_constant_ranges);
+    dst->vertex_bindings = copy_pipeline_array(allocator, src->vertex_bindings);
+    dst->vertex_attributes = copy_pipeline_array(allocator, src->vertex_attributes);
+    dst->viewports = copy_pipeline_array(allocator, src->viewports);
+    dst->scissors = copy_pipeline_array(allocator, src->scissors);
+
+    if (src->multisample.pSampleMask != NULL) {
+        u32 mask_count = ((u32)src->multisample.rasterizationSamples + 31) / 32;
+        auto sample_mask = allocate<VkSampleMask>(allocator, mask_count);
+        memcpy(sample_mask, src->multisample.pSampleMask, mask_count * sizeof(VkSampleMask));
+        dst->multisample.pSampleMask = sample_mask;
+    }
+}
+
+static VkPipelineLayout find_or_create_pipeline_layout(PipelineRegistry *registry, PipelineInfo *info) {
+    auto write_key = [info](CreationKey *key) { write_pipeline_layout_key(key, info); };
+    CreationKey key = get_creation_key(write_key);
+    u32 slot = 0;
+    u32 layout_idx = find_creation_key_entry(&registry->layout_table, registry->layouts, write_key, &key, &slot);
+    if (layout_idx != U32_MAX) {
+        ++registry->deduplicated_layout_count;
+        return registry->layouts[layout_idx].handle;
+    }
+
+    if (registry->layout_count == registry->info.max_layouts)
+        CTK_FATAL("pipeline registry layout count exceeds max_layouts (%u)", registry->info.max_layouts);
+
+    registry->layout_table.slots[slot] = registry->layout_count;
+    PipelineLayoutEntry *layout = registry->layouts + registry->layout_count++;
+    layout->key = store_creation_key(registry->mem, write_key, &key);
+    layout->handle = create_pipeline_layout(registry->vk, info);
+    return layout->handle;
+}
+
+static void write_descriptor_set_layout_key(CreationKey *key, VkDescriptorSetLayoutBinding *bindings, u32 count) {
+    write_creation_key_value(key, count);
+    for (u32 i = 0; i < count; ++i) {
+        write_creation_key_value(key, bindings[i].binding);
+        write_creation_key_value(key, bindings[i].descriptorType);
+        write_creation_key_value(key, bindings[i].descriptorCount);
+        write_creation_key_value(key, bindings[i].stageFlags);
+    }
+}
+
+// Builds variant unless it is already built; if another thread is building it, waits for that build to finish.
+static void build_pipeline_variant(PipelineRegistry *registry, PipelineVariant *variant, bool lazy) {
+    auto expected = PipelineVariantState::PENDING;
+    if (!variant->state.compare_exchange_strong(expected, PipelineVariantState::BUILDING)) {
+        if (expected == PipelineVariantState::BUILT)
+            return;
+
+        PROFILE_ZONE("wait_pipeline_variant");
+        std::unique_lock<std::mutex> lock(registry->build_mutex);
+        registry->build_cond.wait(lock, [variant] { return variant->state == PipelineVariantState::BUILT; });
+        return;
+    }
+
+    PROFILE_ZONE("build_pipeline_variant");
+    u64 build_start = get_time_ns();
+    init_pipeline_handle(registry->vk, variant->pipeline, variant->render_pass, variant->subpass, &variant->info);
+    variant->build_ms = elapsed_ms(build_start);
+
+    if (lazy)
+        ++registry->lazy_build_count;
+    else
+        ++registry->precompiled_count;
+
+    // Publish under lock so waiters can't miss the notification between checking state and waiting.
+    {
+        std::lock_guard<std::mutex> lock(registry->build_mutex);
+        variant->state = PipelineVariantState::BUILT;
+    }
+    registry->build_cond.notify_all();
+}
+
+static void run_pipeline_precompile_thread(PipelineRegistry *registry) {
+    set_profiler_thread_name("pipeline precompile");
+    for (u32 idx = registry->next_precompile_idx.fetch_add(1);
+         idx < registry->precompile_variant_count;
+         idx = registry->next_precompile_idx.fetch_add(1))
+    {
+        build_pipeline_variant(registry, registry->variants + idx, false);
+    }
+
+    // Record this thread's finish time before the decrement releases it, so a reader that sees no running threads
+    // also sees the latest finish time.
+    u64 end_ns = get_time_ns();
+    u64 latest_end_ns = registry->precompile_end_ns.load(std::memory_order_relaxed);
+    while (latest_end_ns < end_ns &&
+           !registry->precompile_end_ns.compare_exchange_weak(latest_end_ns, end_ns, std::memory_order_relaxed))
+    {
+        // The failed exchange reloaded latest_end_ns.
+    }
+
+    registry->running_precompile_threads.fetch_sub(1, std::memory_order_release);
+}
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+static PipelineRegistry *create_pipeline_registry(Allocator *allocator, Vulkan *vk, PipelineRegistryInfo info) {
+    auto registry = allocate<PipelineRegistry>(allocator, 1);
+    new (registry) PipelineRegistry {};
+    registry->vk = vk;
+    registry->mem = allocator;
+    registry->info = info;
+
+    registry->variants = allocate<PipelineVariant>(allocator, info.max_variants);
+    for (u32 i = 0; i < info.max_variants; ++i)
+        new (registry->variants + i) PipelineVariant {};
+
+    registry->variant_table = create_creation_key_table(allocator, info.max_variants);
+    registry->layouts = allocate<PipelineLayoutEntry>(allocator, info.max_layouts);
+    registry->layout_table = create_creation_key_table(allocator, info.max_layouts);
+    registry->descriptor_set_layouts = allocate<DescriptorSetLayoutEntry>(allocator, info.max_descriptor_set_layouts);
+    registry->descriptor_set_layout_table = create_creation_key_table(allocator, info.max_descriptor_set_layouts);
+
+    registry->precompile_threads = allocate<std::thread>(allocator, info.max_precompile_threads);
+    for (u32 i = 0; i < info.max_precompile_threads; ++i)
+        new (registry->precompile_threads + i) std::thread();
+
+    return registry;
+}
+
+// Returns the shared layout for bindings, creating it on first request. Bindings with immutable samplers aren't
+// supported. Call from the thread that registers variants.
+static VkDescriptorSetLayout get_descriptor_set_layout(PipelineRegistry *registry,
+                                                       VkDescriptorSetLayoutBinding *bindings, u32 count)
+{
+    auto write_key = [bindings, count](CreationKey *key) { write_descriptor_set_layout_key(key, bindings, count); };
+    CreationKey key = get_creation_key(write_key);
+    u32 slot = 0;
+    u32 entry_idx = find_creation_key_entry(&registry->descriptor_set_layout_table, registry->descriptor_set_layouts,
+                                            write_key, &key, &slot);
+    if (entry_idx != U32_MAX)
+        return registry->descriptor_set_layouts[entry_idx].handle;
+
+    if (registry->descriptor_set_layout_count == registry->info.max_descriptor_set_layouts) {
+        CTK_FATAL("pipeline registry descriptor set layout count exceeds max_descriptor_set_layouts (%u)",
+                  registry->info.max_descriptor_set_layouts);
+    }
+
+    registry->descriptor_set_layout_table.slots[slot] = registry->descriptor_set_layout_count;
+    DescriptorSetLayoutEntry *entry = registry->descriptor_set_layouts + registry->descriptor_set_layout_count++;
+    entry->key = store_creation_key(registry->mem, write_key, &key);
+    entry->handle = create_descriptor_set_layout(registry->vk->device, bindings, count);
+    return entry->handle;
+}
+
+// Fills in whichever of info's descriptor set layouts and push constant ranges are NULL from its shaders' reflection.
+// Bindings used by several stages are merged; identical reflected set layouts are shared across pipelines.
+// Runtime-sized arrays and dynamic or update-after-bind descriptors can't be inferred from SPIR-V and need an explicit
+// layout.
+static void apply_reflected_layout(PipelineRegistry *registry, PipelineInfo *info, Allocator *allocator) {
+    if (info->push_constant_ranges == NULL) {
+        info->push_constant_ranges = create_array<VkPushConstantRange>(allocator, info->shaders.count);
+        for (u32 i = 0; i < info->shaders.count; ++i) {
+            Shader *shader = info->shaders.data[i];
+            if (shader->reflection.push_constant_size == 0)
+                continue;
+
+            VkPushConstantRange *range = push(info->push_constant_ranges);
+            range->stageFlags = shader->stage;
+            range->offset = shader->reflection.push_constant_offset;
+            range->size = shader->reflection.push_constant_size;
+        }
+    }
+
+    if (info->descriptor_set_layouts != NULL)
+        return;
+
+    // Merge bindings across stages.
+    FixedArray<ReflectedBinding, SPIRV_MAX_BINDINGS * 8> bindings = {};
+    FixedArray<VkShaderStageFlags, SPIRV_MAX_BINDINGS * 8> binding_stages = {};
+    u32 set_count = 0;
+    for (u32 shader_idx = 0; shader_idx < info->shaders.count; ++shader_idx) {
+        Shader *shader = info->shaders.data[shader_idx];
+        for (u32 i = 0; i < shader->reflection.bindings.count; ++i) {
+            ReflectedBinding *reflected = shader->reflection.bindings.data + i;
+            if (reflected->count == 0) {
+                CTK_FATAL("set %u binding %u is a runtime-sized array; pipeline needs explicit descriptor set layouts",
+                          reflected->set, reflected->binding);
+            }
+
+            u32 merged_idx = 0;
+            while (merged_idx < bindings.count &&
+                   (bindings.data[merged_idx].set != reflected->set ||
+                    bindings.data[merged_idx].binding != reflected->binding))
+            {
+                ++merged_idx;
+            }
+
+            if (merged_idx == bindings.count) {
+                push(&bindings, *reflected);
+                push(&binding_stages, (VkShaderStageFlags)shader->stage);
+            }
+            else {
+                ReflectedBinding *merged = bindings.data + merged_idx;
+                if (merged->type != reflected->type) {
+                    CTK_FATAL("set %u binding %u is declared with different descriptor types across stages",
+                              reflected->set, reflected->binding);
+                }
+
+                if (reflected->count > merged->count)
+                    merged->count = reflected->count;
+
+                binding_stages.data[merged_idx] |= shader->stage;
+            }
+
+            if (reflected->set + 1 > set_count)
+                set_count = reflected->set + 1;
+        }
+    }
+
+    // Sets without bindings below the highest used set still need (empty) layouts.
+    info->descriptor_set_layouts = create_array<VkDescriptorSetLayout>(allocator, set_count > 0 ? set_count : 1);
+    for (u32 set = 0; set < set_count; ++set) {
+        FixedArray<VkDescriptorSetLayoutBinding, SPIRV_MAX_BINDINGS * 8> set_bindings = {};
+        for (u32 i = 0; i < bindings.count; ++i) {
+            if (bindings.data[i].set != set)
+                continue;
+
+            VkDescriptorSetLayoutBinding *binding = push(&set_bindings);
+            binding->binding = bindings.data[i].binding;
+            binding->descriptorType = bindings.data[i].type;
+            binding->descriptorCount = bindings.data[i].count;
+            binding->stageFlags = binding_stages.data[i];
+            binding->pImmutableSamplers = NULL;
+        }
+
+        push(info->descriptor_set_layouts,
+             get_descriptor_set_layout(registry, set_bindings.data, set_bindings.count));
+    }
+}
+
+// Returns the variant matching info's full creation state, registering a new one if none matches. Nothing is built
+// until get_pipeline() or precompilation; the variant's pipeline layout is usable immediately.
+static PipelineVariant *register_pipeline_variant(PipelineRegistry *registry, RenderPass *render_pass, u32 subpass,
+                                                  PipelineInfo *info)
+{
+    auto write_key = [render_pass, subpass, info](CreationKey *key) {
+        write_pipeline_variant_key(key, render_pass, subpass, info);
+    };
+    CreationKey key = get_creation_key(write_key);
+    u32 slot = 0;
+    u32 variant_idx = find_creation_key_entry(&registry->variant_table, registry->variants, write_key, &key, &slot);
+    if (variant_idx != U32_MAX) {
+        ++registry->deduplicated_variant_count;
+        return registry->variants + variant_idx;
+    }
+
+    if (registry->variant_count == registry->info.max_variants)
+        CTK_FATAL("pipeline registry variant count exceeds max_variants (%u)", registry->info.max_variants);
+
+    registry->variant_table.slots[slot] = registry->variant_count;
+    PipelineVariant *variant = registry->variants + registry->variant_count++;
+    variant->key = store_creation_key(registry->mem, write_key, &key);
+    variant->render_pass = render_pass;
+    variant->subpass = subpass;
+    copy_pipeline_info(registry->mem, &variant->info, info);
+    validate_pipeline_shaders(&variant->info);
+    variant->pipeline = allocate(registry->vk->pool.pipeline);
+    variant->pipeline->handle = VK_NULL_HANDLE;
+    variant->pipeline->layout = find_or_create_pipeline_layout(registry, &variant->info);
+
+    return variant;
+}
+
+static bool pipeline_variant_uses_shader(PipelineVariant *variant, Shader *shader) {
+    for (u32 i = 0; i < variant->info.shaders.count; ++i)
+        if (variant->info.shaders.data[i] == shader)
+            return true;
+
+    return false;
+}
+
+// Returns a built variant to pending so its next get_pipeline() rebuilds it from its current shaders, handing the old
+// pipeline back to the caller to destroy once it's no longer in use. Must not be called while the variant is building.
+static VkPipeline invalidate_pipeline_variant(PipelineVariant *variant) {
+    if (variant->state == PipelineVariantState::BUILDING)
+        CTK_FATAL("can't invalidate a pipeline variant while it's building");
+
+    VkPipeline old_handle = variant->pipeline->handle;
+    variant->pipeline->handle = VK_NULL_HANDLE;
+    variant->state = PipelineVariantState::PENDING;
+    return old_handle;
+}
+
+// Refreshes the keys of every variant using shader after its module handle changed (e.g. by shader reloading), so
+// registering the same info again finds the existing variant instead of adding a duplicate. Call from the thread that
+// registers variants.
+static void rekey_pipeline_variants(PipelineRegistry *registry, Shader *shader) {
+    bool rekeyed = false;
+    for (u32 variant_idx = 0; variant_idx < registry->variant_count; ++variant_idx) {
+        PipelineVariant *variant = registry->variants + variant_idx;
+        if (!pipeline_variant_uses_shader(variant, shader))
+            continue;
+
+        auto write_key = [variant](CreationKey *key) {
+            write_pipeline_variant_key(key, variant->render_pass, variant->subpass, &variant->info);
+        };
+        CreationKey key = get_creation_key(write_key);
+
+        // Only handles changed, so the key is rewritten in place.
+        if (key.size != variant->key.size)
+            CTK_FATAL("pipeline variant key size changed from %u to %u bytes", variant->key.size, key.size);
+
+        variant->key = store_creation_key(write_key, &key, variant->key.data);
+        rekeyed = true;
+    }
+
+    // Probe sequences follow the old hashes, so the table is rebuilt rather than patched.
+    if (rekeyed)
+        rebuild_creation_key_table(&registry->variant_table, registry->variants, registry->variant_count);
+}
+
+// Builds variant on first use. Safe to call from any thread; blocks while another thread is building the variant.
+static Pipeline *get_pipeline(PipelineRegistry *registry, PipelineVariant *variant) {
+    if (variant->state != PipelineVariantState::BUILT)
+        build_pipeline_variant(registry, variant, true);
+
+    return variant->pipeline;
+}
+
+// Builds every variant registered so far on thread_count background threads. Variants registered afterwards are only
+// built on first use.
+static void start_pipeline_precompile(PipelineRegistry *registry, u32 thread_count) {
+    if (registry->precompile_thread_count > 0)
+        CTK_FATAL("pipeline precompile already started");
+
+    if (thread_count == 0)
+        thread_count = 1;
+    else if (thread_count > registry->info.max_precompile_threads)
+        thread_count = registry->info.max_precompile_threads;
+
+    registry->precompile_variant_count = registry->variant_count;
+    registry->next_precompile_idx = 0;
+    registry->running_precompile_threads = thread_count;
+    registry->precompile_start_ns = get_time_ns();
+    registry->precompile_thread_count = thread_count;
+
+    for (u32 i = 0; i < thread_count; ++i)
+        registry->precompile_threads[i] = std::thread(run_pipeline_precompile_thread, registry);
+}
+
+// Waits for background precompilation to finish; must be called before shutdown.
+static void finish_pipeline_precompile(PipelineRegistry *registry) {
+    for (u32 i = 0; i < registry->precompile_thread_count; ++i)
+        if (registry->precompile_threads[i].joinable())
+            registry->precompile_threads[i].join();
+}
+
+static PipelineRegistryStats get_pipeline_registry_stats(PipelineRegistry *registry) {
+    PipelineRegistryStats stats = {};
+    stats.variant_count = registry->variant_count;
+    stats.layout_count = registry->layout_count;
+    stats.descriptor_set_layout_count = registry->descriptor_set_layout_count;
+    stats.deduplicated_variant_count = registry->deduplicated_variant_count;
+    stats.deduplicated_layout_count = registry->deduplicated_layout_count;
+    stats.precompiled_count = registry->precompiled_count;
+    stats.lazy_build_count = registry->lazy_build_count;
+
+    if (registry->precompile_thread_count > 0 &&
+        registry->running_precompile_threads.load(std::memory_order_acquire) == 0)
+    {
+        u64 end_ns = registry->precompile_end_ns.load(std::memory_order_acquire);
+        stats.precompile_ms = ns_to_ms(end_ns - registry->precompile_start_ns);
+    }
+
+    return stats;
+}
+
+static void print_pipeline_registry_stats(PipelineRegistry *registry) {
+    PipelineRegistryStats stats = get_pipeline_registry_stats(registry);
+    print_line("pipeline registry: %u variants (%u deduplicated), %u layouts (%u deduplicated), "
+               "%u descriptor set layouts",
+               stats.variant_count, stats.deduplicated_variant_count,
+               stats.layout_count, stats.deduplicated_layout_count, stats.descriptor_set_layout_count);
+    print_line("    %u precompiled in %.2fms, %u built on first use",
+               stats.precompiled_count, stats.precompile_ms, stats.lazy_build_count);
+}
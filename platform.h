@@ -1,7 +1,10 @@
 #pragma once
 
+#ifdef _WIN32
 #include <windows.h>
 #include <winuser.h>
+#endif
+#include <thread>
 #include "ctk/ctk.h"
 #include "ctk/memory.h"
 #include "ctk/containers.h"
@@ -25,7 +28,9 @@ struct WindowInfo {
 };
 
 struct Window {
+#ifdef _WIN32
     HWND handle;
+#endif
     bool open;
     bool key_down[(s32)Key::COUNT];
     bool mouse_button_down[5];
@@ -33,8 +38,10 @@ struct Window {
 
 struct Platform {
     Allocator *module_mem;
+#ifdef _WIN32
     HINSTANCE instance;
-    Window *window;
+#endif
+    Window *window; // NULL for headless platforms.
     s32 key_map[(s32)Key::COUNT];
     u32 thread_count;
 };
@@ -44,11 +51,14 @@ static Platform *instance;
 ////////////////////////////////////////////////////////////
 /// Key Mapping
 ////////////////////////////////////////////////////////////
+#ifdef _WIN32
 #include "renderer/win32_keymap.h"
+#endif
 
 ////////////////////////////////////////////////////////////
 /// Interface
 ////////////////////////////////////////////////////////////
+#ifdef _WIN32
 #define mouse_button_handlers(name, num) \
     case WM_ ## name ## DOWN: { \
         instance->window->mouse_button_down[num] = true; \
@@ -235,3 +245,33 @@ static bool window_is_active(Window *window) {
 static void set_window_title(Window *window, cstr title) {
     SetWindowTextA(window->handle, title);
 }
+#else
+// Only headless platforms exist off Win32; they have no window or input.
+static void process_events(Window *window) {}
+static bool key_down(Platform *platform, Key key) { return false; }
+static bool mouse_button_down(Platform *platform, u32 button) { return false; }
+static Vec2<s32> get_mouse_position(Platform *platform) { return { 0, 0 }; }
+static void set_mouse_position(Platform *platform, Vec2<s32> position) {}
+static void set_mouse_visible(bool visible) {}
+static bool window_is_active(Window *window) { return false; }
+static void set_window_title(Window *window, cstr title) {}
+#endif
+
+// Platform without a window for offscreen rendering (CI, render farms); available on every OS.
+static Platform *create_headless_platform(Allocator *module_mem) {
+    if (instance)
+        CTK_FATAL("a Platform instance has already been created");
+
+    auto platform = allocate<Platform>(module_mem, 1);
+    platform->module_mem = module_mem;
+    platform->window = NULL;
+    platform->thread_count = std::thread::hardware_concurrency();
+
+    // hardware_concurrency() may report 0 when unknown; callers reserve threads from this count.
+    if (platform->thread_count < 3)
+        platform->thread_count = 3;
+
+    instance = platform;
+
+    return platform;
+}
@@ -0,0 +1,274 @@
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include "renderer/timer.h"
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+
+using namespace ctk;
+
+// Scoped-zone CPU profiler. Only compiled in when RENDERER_PROFILER is defined; otherwise the PROFILE_* macros expand
+// to nothing and the interface functions are empty, so call sites need no #ifdefs.
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+struct ProfilerInfo {
+    u32 max_threads;
+    u32 events_per_thread; // Ring capacity; once full, each thread keeps its most recent events.
+};
+
+#ifdef RENDERER_PROFILER
+
+struct ProfileEvent {
+    cstr name; // Must outlive the profiler; zones are named with string literals or __func__.
+    u64 start_ns;
+    u64 end_ns;
+};
+
+// Single-producer ring: only the owning thread writes events and publishes them by bumping write_count. Task threads
+// are short-lived, so a slot is released when its thread exits and the next new thread continues its ring.
+struct ProfilerThread {
+    ProfileEvent *events;
+    std::atomic<u64> write_count;
+    std::atomic<bool> in_use;
+    char name[32];
+};
+
+struct Profiler {
+    ProfilerInfo info;
+    u64 start_ns;
+    ProfilerThread *threads;
+    std::atomic<u32> slot_count;
+};
+
+struct ProfilerThreadHandle {
+    ProfilerThread *thread;
+
+    ~ProfilerThreadHandle() {
+        if (thread != NULL)
+            thread->in_use.store(false, std::memory_order_release);
+    }
+};
+
+static Profiler *profiler_instance;
+static thread_local ProfilerThreadHandle profiler_thread;
+
+////////////////////////////////////////////////////////////
+/// Internal
+////////////////////////////////////////////////////////////
+// Tracks only take slots that have never recorded anything so their events don't mix with an exited thread's.
+static ProfilerThread *register_profiler_thread(bool unused_slot) {
+    Profiler *profiler = profiler_instance;
+    for (u32 thread_idx = 0; thread_idx < profiler->info.max_threads; ++thread_idx) {
+        ProfilerThread *thread = profiler->threads + thread_idx;
+        if (unused_slot && thread->write_count.load(std::memory_order_relaxed) > 0)
+            continue;
+
+        bool in_use = false;
+        if (!thread->in_use.compare_exchange_strong(in_use, true, std::memory_order_acquire))
+            continue;
+
+        snprintf(thread->name, sizeof(thread->name), "thread %u", thread_idx);
+
+        // Track how many slots have ever been used so trace writes skip the rest.
+        u32 slot_count = profiler->slot_count.load(std::memory_order_relaxed);
+        while (slot_count <= thread_idx) {
+            if (profiler->slot_count.compare_exchange_weak(slot_count, thread_idx + 1, std::memory_order_release))
+                break;
+        }
+
+        return thread;
+    }
+
+    // More threads are alive than max_threads; this one goes unrecorded.
+    return NULL;
+}
+
+static ProfilerThread *get_profiler_thread() {
+    if (profiler_thread.thread == NULL)
+        profiler_thread.thread = register_profiler_thread(false);
+
+    return profiler_thread.thread;
+}
+
+static void write_profile_event(ProfilerThread *thread, cstr name, u64 start_ns, u64 end_ns) {
+    u64 write_count = thread->write_count.load(std::memory_order_relaxed);
+    thread->events[write_count % profiler_instance->info.events_per_thread] = { name, start_ns, end_ns };
+    thread->write_count.store(write_count + 1, std::memory_order_release);
+}
+
+static void record_profile_event(cstr name, u64 start_ns, u64 end_ns) {
+    ProfilerThread *thread = get_profiler_thread();
+    if (thread != NULL)
+        write_profile_event(thread, name, start_ns, end_ns);
+}
+
+struct ProfileZone {
+    cstr name;
+    u64 start_ns;
+
+    ProfileZone(cstr zone_name) {
+        name = zone_name;
+        start_ns = profiler_instance ? get_time_ns() : 0;
+    }
+
+    ~ProfileZone() {
+        if (profiler_instance)
+            record_profile_event(name, start_ns, get_time_ns());
+    }
+};
+
+static void write_trace_string(FILE *file, cstr string) {
+    fputc('"', file);
+    for (cstr c = string; *c != '\0'; ++c) {
+        if (*c == '"' || *c == '\\')
+            fputc('\\', file);
+
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+#define PROFILE_CONCAT_INNER(A, B) A##B
+#define PROFILE_CONCAT(A, B) PROFILE_CONCAT_INNER(A, B)
+#define PROFILE_ZONE(NAME) ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)(NAME)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+static void init_profiler(Allocator *allocator, ProfilerInfo info) {
+    CTK_ASSERT(profiler_instance == NULL);
+    CTK_ASSERT(info.max_threads > 0 && info.events_per_thread > 0);
+
+    auto profiler = allocate<Profiler>(allocator, 1);
+    new (profiler) Profiler {};
+    profiler->info = info;
+    profiler->start_ns = get_time_ns();
+    profiler->threads = allocate<ProfilerThread>(allocator, info.max_threads);
+    for (u32 i = 0; i < info.max_threads; ++i) {
+        new (profiler->threads + i) ProfilerThread {};
+        profiler->threads[i].events = allocate<ProfileEvent>(allocator, info.events_per_thread);
+    }
+
+    profiler_instance = profiler;
+}
+
+static bool profiler_enabled() {
+    return true;
+}
+
+// Names the calling thread's track in the trace; registers the thread if it hasn't recorded a zone yet.
+static void set_profiler_thread_name(cstr name) {
+    if (profiler_instance == NULL)
+        return;
+
+    ProfilerThread *thread = get_profiler_thread();
+    if (thread != NULL)
+        snprintf(thread->name, sizeof(thread->name), "%s", name);
+}
+
+// Claims a ring for events that don't come from a CPU thread, such as GPU timestamps converted to CPU time; the track
+// shows up as its own named thread in the trace. Only one thread at a time may record to a track. Returns U32_MAX if
+// the profiler isn't initialized or every slot is taken.
+static u32 add_profiler_track(cstr name) {
+    if (profiler_instance == NULL)
+        return U32_MAX;
+
+    // Tracks are claimed the same way as threads but never released.
+    ProfilerThread *track = register_profiler_thread(true);
+    if (track == NULL)
+        return U32_MAX;
+
+    snprintf(track->name, sizeof(track->name), "%s", name);
+    return (u32)(track - profiler_instance->threads);
+}
+
+static void record_profiler_track_event(u32 track, cstr name, u64 start_ns, u64 end_ns) {
+    if (profiler_instance == NULL || track == U32_MAX)
+        return;
+
+    write_profile_event(profiler_instance->threads + track, name, start_ns, end_ns);
+}
+
+// Writes every thread's buffered zones as Chrome trace event JSON (chrome://tracing, ui.perfetto.dev). Safe to call
+// while other threads keep recording; events overwritten during the write are skipped.
+static bool write_profiler_trace(cstr path) {
+    if (profiler_instance == NULL)
+        return false;
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        warning("failed to open profiler trace \"%s\" for writing", path);
+        return false;
+    }
+
+    Profiler *profiler = profiler_instance;
+    u32 events_per_thread = profiler->info.events_per_thread;
+    u32 slot_count = profiler->slot_count.load(std::memory_order_acquire);
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+    bool first_event = true;
+    u32 event_count = 0;
+    for (u32 thread_idx = 0; thread_idx < slot_count; ++thread_idx) {
+        ProfilerThread *thread = profiler->threads + thread_idx;
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                first_event ? "" : ",\n", thread_idx);
+        write_trace_string(file, thread->name);
+        fputs("}}", file);
+        first_event = false;
+
+        u64 write_count = thread->write_count.load(std::memory_order_acquire);
+        u64 first = write_count > events_per_thread ? write_count - events_per_thread : 0;
+        for (u64 i = first; i < write_count; ++i) {
+            ProfileEvent event = thread->events[i % events_per_thread];
+
+            // Skip the event if the owning thread has since lapped the ring onto its slot or may be writing it now.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (i + events_per_thread <= thread->write_count.load(std::memory_order_relaxed))
+                continue;
+
+            fputs(",\n{\"name\":", file);
+            write_trace_string(file, event.name);
+            fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", thread_idx,
+                    (event.start_ns - profiler->start_ns) / 1000.0, (event.end_ns - event.start_ns) / 1000.0);
+            ++event_count;
+        }
+    }
+
+    fputs("\n]}\n", file);
+    fclose(file);
+    print_line("wrote %u profiler zones from %u threads to %s", event_count, slot_count, path);
+    return true;
+}
+
+#else
+
+#define PROFILE_ZONE(NAME)
+#define PROFILE_FUNCTION()
+
+static void init_profiler(Allocator *, ProfilerInfo) {
+}
+
+static bool profiler_enabled() {
+    return false;
+}
+
+static void set_profiler_thread_name(cstr) {
+}
+
+static u32 add_profiler_track(cstr) {
+    return U32_MAX;
+}
+
+static void record_profiler_track_event(u32, cstr, u64, u64) {
+}
+
+static bool write_profiler_trace(cstr) {
+    return false;
+}
+
+#endif
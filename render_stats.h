@@ -0,0 +1,210 @@
+#pragma once
+
+#include <atomic>
+#include "renderer/timer.h"
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+enum struct RenderCounter {
+    DRAW_CALLS,
+    INSTANCES,
+    TRIANGLES,
+    PIPELINE_BINDS,
+    DESCRIPTOR_SET_BINDS,
+    VERTEX_BUFFER_BINDS,
+    INDEX_BUFFER_BINDS,
+    PUSH_CONSTANT_BYTES,
+    UPLOADED_BYTES,
+    SECONDARY_CMD_BUFS,
+    FENCE_WAIT_NS,
+    ACQUIRE_WAIT_NS,
+    COUNT,
+};
+
+static constexpr cstr RENDER_COUNTER_NAMES[] = {
+    "draw calls",
+    "instances",
+    "triangles",
+    "pipeline binds",
+    "descriptor set binds",
+    "vertex buffer binds",
+    "index buffer binds",
+    "push constant bytes",
+    "uploaded bytes",
+    "secondary cmd bufs",
+    "fence wait ns",
+    "acquire wait ns",
+};
+
+static_assert(CTK_ARRAY_SIZE(RENDER_COUNTER_NAMES) == (u32)RenderCounter::COUNT);
+
+struct RenderStatsInfo {
+    u32 max_threads;
+    u32 log_interval_ms; // 0 disables the periodic log line.
+};
+
+struct RenderFrameStats {
+    u64 counters[(u32)RenderCounter::COUNT];
+};
+
+// Threads count into their own block with plain adds. A block is claimed on a thread's first count and released when
+// the thread exits, keeping its counts for the next collection, so short-lived task threads don't lose or leak them.
+struct RenderCounterBlock {
+    u64 counters[(u32)RenderCounter::COUNT];
+    std::atomic<bool> in_use;
+};
+
+struct RenderCounterBlockHandle {
+    RenderCounterBlock *block;
+
+    ~RenderCounterBlockHandle() {
+        if (block != NULL)
+            block->in_use.store(false, std::memory_order_release);
+    }
+};
+
+struct RenderStats {
+    RenderStatsInfo info;
+    RenderCounterBlock *blocks;
+    RenderFrameStats frame; // Totals for the last completed frame.
+
+    // Periodic log
+    RenderFrameStats interval;
+    u32 interval_frame_count;
+    u64 interval_start_ns;
+    bool overflow_warned;
+};
+
+static RenderStats *render_stats_instance;
+static thread_local RenderCounterBlockHandle render_counter_block;
+
+////////////////////////////////////////////////////////////
+/// Internal
+////////////////////////////////////////////////////////////
+static RenderCounterBlock *claim_render_counter_block() {
+    RenderStats *stats = render_stats_instance;
+    for (u32 i = 0; i < stats->info.max_threads; ++i) {
+        bool in_use = false;
+        if (stats->blocks[i].in_use.compare_exchange_strong(in_use, true, std::memory_order_acquire))
+            return stats->blocks + i;
+    }
+
+    return NULL;
+}
+
+static f64 per_frame(RenderFrameStats *stats, RenderCounter counter, u32 frame_count) {
+    return (f64)stats->counters[(u32)counter] / frame_count;
+}
+
+static void log_render_stats(RenderStats *stats) {
+    RenderFrameStats *interval = &stats->interval;
+    u32 frame_count = stats->interval_frame_count;
+    print_line("draws %.0f, instances %.0f, triangles %.0f | binds: pipeline %.1f, descriptor set %.1f, vertex buffer "
+               "%.1f, index buffer %.1f | push %.0f B, upload %.0f B, secondary cmd bufs %.1f | wait: fence %.3f ms, "
+               "acquire %.3f ms",
+               per_frame(interval, RenderCounter::DRAW_CALLS, frame_count),
+               per_frame(interval, RenderCounter::INSTANCES, frame_count),
+               per_frame(interval, RenderCounter::TRIANGLES, frame_count),
+               per_frame(interval, RenderCounter::PIPELINE_BINDS, frame_count),
+               per_frame(interval, RenderCounter::DESCRIPTOR_SET_BINDS, frame_count),
+               per_frame(interval, RenderCounter::VERTEX_BUFFER_BINDS, frame_count),
+               per_frame(interval, RenderCounter::INDEX_BUFFER_BINDS, frame_count),
+               per_frame(interval, RenderCounter::PUSH_CONSTANT_BYTES, frame_count),
+               per_frame(interval, RenderCounter::UPLOADED_BYTES, frame_count),
+               per_frame(interval, RenderCounter::SECONDARY_CMD_BUFS, frame_count),
+               per_frame(interval, RenderCounter::FENCE_WAIT_NS, frame_count) / 1000000.0,
+               per_frame(interval, RenderCounter::ACQUIRE_WAIT_NS, frame_count) / 1000000.0);
+}
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+static void init_render_stats(Allocator *allocator, RenderStatsInfo info) {
+    CTK_ASSERT(render_stats_instance == NULL);
+    CTK_ASSERT(info.max_threads > 0);
+
+    auto stats = allocate<RenderStats>(allocator, 1);
+    new (stats) RenderStats {};
+    stats->info = info;
+    stats->blocks = allocate<RenderCounterBlock>(allocator, info.max_threads);
+    for (u32 i = 0; i < info.max_threads; ++i)
+        new (stats->blocks + i) RenderCounterBlock {};
+
+    stats->interval_start_ns = get_time_ns();
+    render_stats_instance = stats;
+}
+
+// Hot path: no atomics or locks once the calling thread has a block. Counts made before init_render_stats() or from
+// more than max_threads live threads are dropped.
+static void count_render_stat(RenderCounter counter, u64 amount = 1) {
+    RenderCounterBlock *block = render_counter_block.block;
+    if (block == NULL) {
+        if (render_stats_instance == NULL)
+            return;
+
+        block = claim_render_counter_block();
+        if (block == NULL) {
+            if (!render_stats_instance->overflow_warned) {
+                render_stats_instance->overflow_warned = true;
+                warning("more than %u threads counting render stats; extra threads' counts are dropped",
+                        render_stats_instance->info.max_threads);
+            }
+
+            return;
+        }
+
+        render_counter_block.block = block;
+    }
+
+    block->counters[(u32)counter] += amount;
+}
+
+// Sums and clears every thread's counts into the frame totals. Call once per frame on the main thread at a point
+// where no other thread is counting for this frame (i.e. after render tasks have been joined). Returns true when the
+// periodic log line was printed.
+static bool end_render_stats_frame() {
+    RenderStats *stats = render_stats_instance;
+    if (stats == NULL)
+        return false;
+
+    stats->frame = {};
+    for (u32 i = 0; i < stats->info.max_threads; ++i) {
+        RenderCounterBlock *block = stats->blocks + i;
+        for (u32 counter = 0; counter < (u32)RenderCounter::COUNT; ++counter) {
+            stats->frame.counters[counter] += block->counters[counter];
+            block->counters[counter] = 0;
+        }
+    }
+
+    for (u32 counter = 0; counter < (u32)RenderCounter::COUNT; ++counter)
+        stats->interval.counters[counter] += stats->frame.counters[counter];
+
+    ++stats->interval_frame_count;
+
+    if (stats->info.log_interval_ms == 0)
+        return false;
+
+    u64 now_ns = get_time_ns();
+    if (now_ns - stats->interval_start_ns < stats->info.log_interval_ms * 1000000ull)
+        return false;
+
+    log_render_stats(stats);
+    stats->interval = {};
+    stats->interval_frame_count = 0;
+    stats->interval_start_ns = now_ns;
+    return true;
+}
+
+// Totals for the last frame passed to end_render_stats_frame(), or NULL if render stats aren't initialized.
+static RenderFrameStats *get_render_frame_stats() {
+    return render_stats_instance ? &render_stats_instance->frame : NULL;
+}
+
+static u64 get_render_stat(RenderFrameStats *stats, RenderCounter counter) {
+    return stats->counters[(u32)counter];
+}
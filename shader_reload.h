@@ -0,0 +1,448 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include "renderer/vulkan.h"
+#include "renderer/pipeline_registry.h"
+#include "renderer/timer.h"
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+#include "ctk/containers.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+static constexpr u32 SHADER_RELOAD_MAX_PATH_SIZE = 256;
+
+// Default compiler path relative to %VULKAN_SDK%, matching _sync_shaders.bat.
+#ifdef _WIN32
+static constexpr cstr SHADER_RELOAD_SDK_COMPILER_FORMAT = "%s\\Bin32\\glslc.exe";
+#else
+static constexpr cstr SHADER_RELOAD_SDK_COMPILER_FORMAT = "%s/bin/glslc";
+#endif
+
+struct ShaderReloadInfo {
+    cstr compiler_path; // glslc executable; NULL uses the Vulkan SDK's glslc.
+    u32 max_shaders;
+    u32 poll_interval_ms;
+
+    // Number of frames a replaced pipeline or shader module must wait before being destroyed, so in-flight frames can
+    // finish with it.
+    u32 retire_frame_count;
+};
+
+struct ReloadedPipeline {
+    PipelineVariant *variant;
+    VkPipeline handle;
+};
+
+// A shader whose GLSL source is watched. Source path is the SPIR-V path without its ".spv" extension, matching
+// _sync_shaders.bat.
+struct WatchedShader {
+    Shader *shader;
+    char spirv_path[SHADER_RELOAD_MAX_PATH_SIZE];
+    char source_path[SHADER_RELOAD_MAX_PATH_SIZE];
+    cstr target_env; // glslc --target-env the SPIR-V was built for, e.g. "vulkan1.0".
+
+    // Source write time the current module was compiled from, and the write time seen on the last poll; a change is
+    // only compiled once the write time has been stable for a poll, so editors writing in several steps compile once.
+    std::filesystem::file_time_type compiled_time;
+    std::filesystem::file_time_type seen_time;
+
+    // Replacement module and pipelines waiting to be swapped in by update_shader_reload(). Only written by the reload
+    // thread while pending is false, and only read by the render thread while pending is true.
+    bool pending;
+    VkShaderModule new_handle;
+    ShaderReflection new_reflection;
+    ReloadedPipeline *new_pipelines; // Sized to the registry's max_variants.
+    u32 new_pipeline_count;
+    f64 compile_ms;
+    f64 build_ms;
+};
+
+struct RetiredShaderObject {
+    VkPipeline pipeline;
+    VkShaderModule module;
+    u64 frame;
+};
+
+struct ShaderReloadStats {
+    u32 reload_count;
+    u32 failed_count;
+    u32 rebuilt_pipeline_count;
+};
+
+// Recompiles watched shaders on a background thread when their source changes and rebuilds every registered pipeline
+// variant using them. The render thread swaps the new handles in at a frame boundary, so rendering never waits on
+// compilation.
+struct ShaderReloader {
+    Vulkan *vk;
+    PipelineRegistry *registry;
+    ShaderReloadInfo info;
+    char compiler_path[SHADER_RELOAD_MAX_PATH_SIZE];
+
+    WatchedShader *shaders;
+    u32 shader_count;
+
+    // Held by the reload thread while it reads shader handles to build pipelines and publishes reloads; the render
+    // thread only try-locks it, skipping the swap for a frame rather than waiting on a build.
+    std::mutex mutex;
+
+    std::thread thread;
+    std::atomic<bool> running;
+    std::mutex wake_mutex;
+    std::condition_variable wake_cond;
+
+    Array<RetiredShaderObject> *retired;
+    u64 frame;
+
+    std::atomic<u32> failed_count;
+    u32 reload_count;
+    u32 rebuilt_pipeline_count;
+};
+
+////////////////////////////////////////////////////////////
+/// Internal
+////////////////////////////////////////////////////////////
+static bool get_shader_source_time(cstr path, std::filesystem::file_time_type *time) {
+    std::error_code error;
+    *time = std::filesystem::last_write_time(path, error);
+    return !error;
+}
+
+static bool compile_shader_source(ShaderReloader *reloader, WatchedShader *watched) {
+    char command[SHADER_RELOAD_MAX_PATH_SIZE * 4] = {};
+
+    // cmd.exe strips the outermost quotes from commands that start with one, so the whole command is quoted again.
+#ifdef _WIN32
+    cstr format = "\"\"%s\" --target-env=%s \"%s\" -o \"%s\"\"";
+#else
+    cstr format = "\"%s\" --target-env=%s \"%s\" -o \"%s\"";
+#endif
+    snprintf(command, sizeof(command), format, reloader->compiler_path, watched->target_env, watched->source_path,
+             watched->spirv_path);
+
+    // glslc leaves the existing SPIR-V untouched on errors, which it prints itself.
+    return system(command) == 0;
+}
+
+// Builds the pipelines of every built variant using watched->shader, with the shader's module replaced by new_handle.
+// Must be called with reloader->mutex held so other stages' shader handles can't be swapped mid-build.
+static bool build_reloaded_pipelines(ShaderReloader *reloader, WatchedShader *watched) {
+    PipelineRegistry *registry = reloader->registry;
+    Shader new_shader = {
+        .handle = watched->new_handle,
+        .stage = watched->shader->stage,
+        .reflection = watched->new_reflection,
+    };
+
+    watched->new_pipeline_count = 0;
+    for (u32 variant_idx = 0; variant_idx < registry->variant_count; ++variant_idx) {
+        PipelineVariant *variant = registry->variants + variant_idx;
+
+        // Unbuilt variants pick up the new module when they're first built.
+        if (variant->state != PipelineVariantState::BUILT)
+            continue;
+
+        // Copies reference the variant's arrays, which are never modified after registration.
+        PipelineInfo info = variant->info;
+        bool uses_shader = false;
+        for (u32 i = 0; i < info.shaders.count; ++i) {
+            if (info.shaders.data[i] == watched->shader) {
+                info.shaders.data[i] = &new_shader;
+                uses_shader = true;
+            }
+        }
+
+        if (!uses_shader)
+            continue;
+
+        // Layouts aren't rebuilt, so the new interface must still match the variant's.
+        if (!check_pipeline_shaders(&info)) {
+            warning("\"%s\" no longer matches the layout of a pipeline using it", watched->source_path);
+            return false;
+        }
+
+        Pipeline pipeline = { .handle = VK_NULL_HANDLE, .layout = variant->pipeline->layout };
+        init_pipeline_handle(reloader->vk, &pipeline, variant->render_pass, variant->subpass, &info);
+        watched->new_pipelines[watched->new_pipeline_count++] = { variant, pipeline.handle };
+    }
+
+    return true;
+}
+
+static bool has_reloaded_pipeline(WatchedShader *watched, PipelineVariant *variant) {
+    for (u32 i = 0; i < watched->new_pipeline_count; ++i)
+        if (watched->new_pipelines[i].variant == variant)
+            return true;
+
+    return false;
+}
+
+static void destroy_reloaded_objects(ShaderReloader *reloader, WatchedShader *watched) {
+    for (u32 i = 0; i < watched->new_pipeline_count; ++i)
+        vkDestroyPipeline(reloader->vk->device, watched->new_pipelines[i].handle, NULL);
+
+    vkDestroyShaderModule(reloader->vk->device, watched->new_handle, NULL);
+    watched->new_pipeline_count = 0;
+    watched->new_handle = VK_NULL_HANDLE;
+}
+
+static void reload_shader(ShaderReloader *reloader, WatchedShader *watched) {
+    PROFILE_FUNCTION();
+    u64 compile_start = get_time_ns();
+    if (!compile_shader_source(reloader, watched)) {
+        warning("failed to compile \"%s\"; keeping current shader", watched->source_path);
+        ++reloader->failed_count;
+        return;
+    }
+
+    if (!load_shader_module(reloader->vk, watched->spirv_path, &watched->new_handle, &watched->new_reflection)) {
+        ++reloader->failed_count;
+        return;
+    }
+
+    watched->compile_ms = elapsed_ms(compile_start);
+
+    std::lock_guard<std::mutex> lock(reloader->mutex);
+    u64 build_start = get_time_ns();
+    if (!build_reloaded_pipelines(reloader, watched)) {
+        destroy_reloaded_objects(reloader, watched);
+        ++reloader->failed_count;
+        return;
+    }
+
+    watched->build_ms = elapsed_ms(build_start);
+    watched->pending = true;
+}
+
+static void run_shader_reload_thread(ShaderReloader *reloader) {
+    set_profiler_thread_name("shader reload");
+    while (reloader->running) {
+        for (u32 i = 0; i < reloader->shader_count; ++i) {
+            WatchedShader *watched = reloader->shaders + i;
+
+            // Wait for the render thread to swap in the last reload first.
+            {
+                std::lock_guard<std::mutex> lock(reloader->mutex);
+                if (watched->pending)
+                    continue;
+            }
+
+            std::filesystem::file_time_type source_time = {};
+            if (!get_shader_source_time(watched->source_path, &source_time))
+                continue;
+
+            bool stable = source_time == watched->seen_time;
+            watched->seen_time = source_time;
+            if (stable && source_time != watched->compiled_time) {
+                watched->compiled_time = source_time;
+                reload_shader(reloader, watched);
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(reloader->wake_mutex);
+        reloader->wake_cond.wait_for(lock, std::chrono::milliseconds(reloader->info.poll_interval_ms),
+                                     [reloader] { return !reloader->running; });
+    }
+}
+
+static void retire_shader_object(ShaderReloader *reloader, VkPipeline pipeline, VkShaderModule module) {
+    push(reloader->retired, { pipeline, module, reloader->frame });
+}
+
+static void destroy_retired_shader_objects(ShaderReloader *reloader, bool all) {
+    for (u32 i = 0; i < reloader->retired->count;) {
+        RetiredShaderObject *retired = reloader->retired->data + i;
+
+        if (!all && reloader->frame - retired->frame < reloader->info.retire_frame_count) {
+            ++i;
+            continue;
+        }
+
+        if (retired->pipeline != VK_NULL_HANDLE)
+            vkDestroyPipeline(reloader->vk->device, retired->pipeline, NULL);
+
+        if (retired->module != VK_NULL_HANDLE)
+            vkDestroyShaderModule(reloader->vk->device, retired->module, NULL);
+
+        *retired = reloader->retired->data[--reloader->retired->count];
+    }
+}
+
+// Swaps in watched's new module and pipelines, retiring the old ones. Returns false if there isn't room to retire them
+// yet, leaving the reload pending.
+static bool swap_reloaded_shader(ShaderReloader *reloader, WatchedShader *watched) {
+    PipelineRegistry *registry = reloader->registry;
+
+    // Variants built on first use after build_reloaded_pipelines() ran were built with the old module, so they're
+    // invalidated to be rebuilt with the new one. One still building can't be, so the swap waits for it to finish.
+    u32 stale_count = 0;
+    for (u32 variant_idx = 0; variant_idx < registry->variant_count; ++variant_idx) {
+        PipelineVariant *variant = registry->variants + variant_idx;
+        if (!pipeline_variant_uses_shader(variant, watched->shader) || has_reloaded_pipeline(watched, variant))
+            continue;
+
+        if (variant->state == PipelineVariantState::BUILDING)
+            return false;
+
+        if (variant->state == PipelineVariantState::BUILT)
+            ++stale_count;
+    }
+
+    if (reloader->retired->size - reloader->retired->count < watched->new_pipeline_count + stale_count + 1)
+        return false;
+
+    retire_shader_object(reloader, VK_NULL_HANDLE, watched->shader->handle);
+    watched->shader->handle = watched->new_handle;
+    watched->shader->reflection = watched->new_reflection;
+
+    for (u32 i = 0; i < watched->new_pipeline_count; ++i) {
+        Pipeline *pipeline = watched->new_pipelines[i].variant->pipeline;
+        retire_shader_object(reloader, pipeline->handle, VK_NULL_HANDLE);
+        pipeline->handle = watched->new_pipelines[i].handle;
+    }
+
+    if (stale_count > 0) {
+        for (u32 variant_idx = 0; variant_idx < registry->variant_count; ++variant_idx) {
+            PipelineVariant *variant = registry->variants + variant_idx;
+            if (variant->state == PipelineVariantState::BUILT &&
+                pipeline_variant_uses_shader(variant, watched->shader) && !has_reloaded_pipeline(watched, variant))
+            {
+                retire_shader_object(reloader, invalidate_pipeline_variant(variant), VK_NULL_HANDLE);
+            }
+        }
+    }
+
+    // Variant keys include module handles.
+    rekey_pipeline_variants(registry, watched->shader);
+
+    print_line("reloaded \"%s\": compiled in %.2fms, %u pipelines rebuilt in %.2fms", watched->source_path,
+               watched->compile_ms, watched->new_pipeline_count, watched->build_ms);
+
+    ++reloader->reload_count;
+    reloader->rebuilt_pipeline_count += watched->new_pipeline_count;
+    watched->new_handle = VK_NULL_HANDLE;
+    watched->new_pipeline_count = 0;
+    watched->pending = false;
+    return true;
+}
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+static ShaderReloader *create_shader_reloader(Allocator *allocator, Vulkan *vk, PipelineRegistry *registry,
+                                              ShaderReloadInfo info)
+{
+    auto reloader = allocate<ShaderReloader>(allocator, 1);
+    new (reloader) ShaderReloader {};
+    reloader->vk = vk;
+    reloader->registry = registry;
+    reloader->info = info;
+
+    cstr vulkan_sdk = getenv("VULKAN_SDK");
+    u32 compiler_path_size = sizeof(reloader->compiler_path);
+    if (info.compiler_path != NULL)
+        snprintf(reloader->compiler_path, compiler_path_size, "%s", info.compiler_path);
+    else if (vulkan_sdk != NULL)
+        snprintf(reloader->compiler_path, compiler_path_size, SHADER_RELOAD_SDK_COMPILER_FORMAT, vulkan_sdk);
+    else
+        snprintf(reloader->compiler_path, compiler_path_size, "glslc");
+
+    reloader->shaders = allocate<WatchedShader>(allocator, info.max_shaders);
+    for (u32 i = 0; i < info.max_shaders; ++i) {
+        new (reloader->shaders + i) WatchedShader {};
+        reloader->shaders[i].new_pipelines = allocate<ReloadedPipeline>(allocator, registry->info.max_variants);
+    }
+
+    // Room for every watched shader's module and pipelines to be replaced on each frame a retired object waits out.
+    u32 max_retired = info.max_shaders * (registry->info.max_variants + 1) * (info.retire_frame_count + 1);
+    reloader->retired = create_array<RetiredShaderObject>(allocator, max_retired);
+
+    return reloader;
+}
+
+// Watches the GLSL source of shader, which was loaded from spirv_path and is recompiled for target_env (a glslc
+// --target-env such as "vulkan1.0", matching _sync_shaders.bat; must outlive the reloader). Shaders must be watched
+// before start_shader_reload().
+static void watch_shader(ShaderReloader *reloader, Shader *shader, cstr spirv_path, cstr target_env) {
+    if (reloader->shader_count == reloader->info.max_shaders)
+        CTK_FATAL("shader reloader cannot watch more than %u shaders", reloader->info.max_shaders);
+
+    u32 path_size = (u32)strlen(spirv_path);
+    if (path_size < 4 || strcmp(spirv_path + path_size - 4, ".spv") != 0 || path_size >= SHADER_RELOAD_MAX_PATH_SIZE) {
+        CTK_FATAL("can't watch \"%s\": path must end in \".spv\" and be under %u characters", spirv_path,
+                  SHADER_RELOAD_MAX_PATH_SIZE);
+    }
+
+    WatchedShader *watched = reloader->shaders + reloader->shader_count++;
+    watched->shader = shader;
+    watched->target_env = target_env;
+    memcpy(watched->spirv_path, spirv_path, path_size);
+    memcpy(watched->source_path, spirv_path, path_size - 4);
+
+    // The loaded SPIR-V is assumed to be up to date with the source as of now.
+    get_shader_source_time(watched->source_path, &watched->compiled_time);
+    watched->seen_time = watched->compiled_time;
+}
+
+// Starts watching for changes. Every pipeline variant must be registered, and precompilation finished, beforehand.
+static void start_shader_reload(ShaderReloader *reloader) {
+    reloader->running = true;
+    reloader->thread = std::thread(run_shader_reload_thread, reloader);
+}
+
+// Swaps in any reloaded shaders and destroys objects retired long enough ago. Call once per frame from the thread
+// recording commands, before recording; pipelines only change inside this call. Swaps rekey the registry's variants, so
+// that thread must also be the one registering them.
+static void update_shader_reload(ShaderReloader *reloader) {
+    ++reloader->frame;
+    destroy_retired_shader_objects(reloader, false);
+
+    std::unique_lock<std::mutex> lock(reloader->mutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return;
+
+    for (u32 i = 0; i < reloader->shader_count; ++i)
+        if (reloader->shaders[i].pending)
+            swap_reloaded_shader(reloader, reloader->shaders + i);
+}
+
+// Stops the reload thread and destroys pending and retired objects; waits for the device to be idle.
+static void stop_shader_reload(ShaderReloader *reloader) {
+    {
+        std::lock_guard<std::mutex> lock(reloader->wake_mutex);
+        reloader->running = false;
+    }
+    reloader->wake_cond.notify_all();
+
+    if (reloader->thread.joinable())
+        reloader->thread.join();
+
+    for (u32 i = 0; i < reloader->shader_count; ++i) {
+        WatchedShader *watched = reloader->shaders + i;
+        if (watched->pending) {
+            destroy_reloaded_objects(reloader, watched);
+            watched->pending = false;
+        }
+    }
+
+    vkDeviceWaitIdle(reloader->vk->device);
+    destroy_retired_shader_objects(reloader, true);
+}
+
+static ShaderReloadStats get_shader_reload_stats(ShaderReloader *reloader) {
+    return {
+        .reload_count = reloader->reload_count,
+        .failed_count = reloader->failed_count,
+        .rebuilt_pipeline_count = reloader->rebuilt_pipeline_count,
+    };
+}
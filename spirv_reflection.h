@@ -0,0 +1,429 @@
+#pragma once
+
+#include <stdlib.h>
+#include <vulkan/vulkan.h>
+#include "ctk/ctk.h"
+#include "ctk/containers.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+static constexpr u32 SPIRV_MAGIC = 0x07230203;
+static constexpr u32 SPIRV_HEADER_WORD_COUNT = 5;
+static constexpr u32 SPIRV_MAX_INPUTS = 16;
+static constexpr u32 SPIRV_MAX_BINDINGS = 16;
+
+// Opcodes
+static constexpr u32 SPIRV_OP_DECORATE           = 71;
+static constexpr u32 SPIRV_OP_MEMBER_DECORATE    = 72;
+static constexpr u32 SPIRV_OP_TYPE_INT           = 21;
+static constexpr u32 SPIRV_OP_TYPE_FLOAT         = 22;
+static constexpr u32 SPIRV_OP_TYPE_VECTOR        = 23;
+static constexpr u32 SPIRV_OP_TYPE_MATRIX        = 24;
+static constexpr u32 SPIRV_OP_TYPE_IMAGE         = 25;
+static constexpr u32 SPIRV_OP_TYPE_SAMPLER       = 26;
+static constexpr u32 SPIRV_OP_TYPE_SAMPLED_IMAGE = 27;
+static constexpr u32 SPIRV_OP_TYPE_ARRAY         = 28;
+static constexpr u32 SPIRV_OP_TYPE_RUNTIME_ARRAY = 29;
+static constexpr u32 SPIRV_OP_TYPE_STRUCT        = 30;
+static constexpr u32 SPIRV_OP_TYPE_POINTER       = 32;
+static constexpr u32 SPIRV_OP_CONSTANT           = 43;
+static constexpr u32 SPIRV_OP_VARIABLE           = 59;
+
+// Decorations
+static constexpr u32 SPIRV_DECORATION_BLOCK          = 2;
+static constexpr u32 SPIRV_DECORATION_BUFFER_BLOCK   = 3;
+static constexpr u32 SPIRV_DECORATION_ARRAY_STRIDE   = 6;
+static constexpr u32 SPIRV_DECORATION_MATRIX_STRIDE  = 7;
+static constexpr u32 SPIRV_DECORATION_BUILT_IN       = 11;
+static constexpr u32 SPIRV_DECORATION_LOCATION       = 30;
+static constexpr u32 SPIRV_DECORATION_BINDING        = 33;
+static constexpr u32 SPIRV_DECORATION_DESCRIPTOR_SET = 34;
+static constexpr u32 SPIRV_DECORATION_OFFSET         = 35;
+
+// Storage Classes
+static constexpr u32 SPIRV_STORAGE_CLASS_UNIFORM_CONSTANT = 0;
+static constexpr u32 SPIRV_STORAGE_CLASS_INPUT            = 1;
+static constexpr u32 SPIRV_STORAGE_CLASS_UNIFORM          = 2;
+static constexpr u32 SPIRV_STORAGE_CLASS_PUSH_CONSTANT    = 9;
+static constexpr u32 SPIRV_STORAGE_CLASS_STORAGE_BUFFER   = 12;
+
+// Image Dimensions
+static constexpr u32 SPIRV_DIM_BUFFER       = 5;
+static constexpr u32 SPIRV_DIM_SUBPASS_DATA = 6;
+
+enum struct SPIRVNumericType : u32 {
+    UNKNOWN,
+    FLOAT,
+    SINT,
+    UINT,
+};
+
+struct ReflectedInput {
+    u32 location;
+    SPIRVNumericType numeric_type;
+    u32 component_count;
+};
+
+struct ReflectedBinding {
+    u32 set;
+    u32 binding;
+    VkDescriptorType type;
+    u32 count; // 0 for runtime-sized arrays.
+};
+
+// Interface of one shader stage. Uniform buffers are always reflected as VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; whether a
+// binding is dynamic isn't encoded in SPIR-V.
+struct ShaderReflection {
+    FixedArray<ReflectedInput, SPIRV_MAX_INPUTS> inputs; // User-defined scalar/vector inputs; built-ins are skipped.
+    FixedArray<ReflectedBinding, SPIRV_MAX_BINDINGS> bindings;
+    u32 push_constant_offset;
+    u32 push_constant_size; // 0 if the stage declares no push constant block.
+};
+
+// Defining instruction and decorations of a result id.
+struct SPIRVId {
+    u32 opcode;
+    u32 word_offset;
+    u32 location;
+    u32 binding;
+    u32 set;
+    u32 array_stride;
+    bool block;
+    bool buffer_block;
+    bool built_in;
+};
+
+struct SPIRVModule {
+    u32 *code;
+    u32 word_count;
+    SPIRVId *ids;
+    u32 id_bound;
+};
+
+////////////////////////////////////////////////////////////
+/// Internal
+////////////////////////////////////////////////////////////
+static u32 *spirv_instruction(SPIRVModule *module, u32 id) {
+    return module->code + module->ids[id].word_offset;
+}
+
+static bool valid_spirv_id(SPIRVModule *module, u32 id) {
+    return id < module->id_bound && module->ids[id].opcode != 0;
+}
+
+static u32 spirv_member_decoration(SPIRVModule *module, u32 struct_id, u32 member, u32 decoration) {
+    for (u32 offset = SPIRV_HEADER_WORD_COUNT; offset < module->word_count; offset += module->code[offset] >> 16) {
+        u32 *instruction = module->code + offset;
+        if ((instruction[0] & 0xFFFF) == SPIRV_OP_MEMBER_DECORATE && (instruction[0] >> 16) >= 4 &&
+            instruction[1] == struct_id && instruction[2] == member && instruction[3] == decoration)
+        {
+            return (instruction[0] >> 16) >= 5 ? instruction[4] : 0;
+        }
+    }
+
+    return U32_MAX;
+}
+
+static u32 spirv_constant_value(SPIRVModule *module, u32 id) {
+    if (!valid_spirv_id(module, id) || module->ids[id].opcode != SPIRV_OP_CONSTANT)
+        return 0;
+
+    return spirv_instruction(module, id)[3];
+}
+
+// Size in bytes of type as laid out in a block; matrix_stride only applies when type is a matrix.
+static u32 spirv_type_size(SPIRVModule *module, u32 type_id, u32 matrix_stride) {
+    if (!valid_spirv_id(module, type_id))
+        return 0;
+
+    u32 *instruction = spirv_instruction(module, type_id);
+    switch (module->ids[type_id].opcode) {
+        case SPIRV_OP_TYPE_INT:
+        case SPIRV_OP_TYPE_FLOAT:
+            return instruction[2] / 8;
+        case SPIRV_OP_TYPE_VECTOR:
+            return instruction[3] * spirv_type_size(module, instruction[2], 0);
+        case SPIRV_OP_TYPE_MATRIX:
+            return instruction[3] * (matrix_stride != U32_MAX && matrix_stride > 0
+                                     ? matrix_stride
+                                     : spirv_type_size(module, instruction[2], 0));
+        case SPIRV_OP_TYPE_ARRAY: {
+            u32 length = spirv_constant_value(module, instruction[3]);
+            u32 stride = module->ids[type_id].array_stride;
+            return length * (stride > 0 ? stride : spirv_type_size(module, instruction[2], matrix_stride));
+        }
+        case SPIRV_OP_TYPE_STRUCT: {
+            u32 size = 0;
+            u32 member_count = (instruction[0] >> 16) - 2;
+            for (u32 member = 0; member < member_count; ++member) {
+                u32 offset = spirv_member_decoration(module, type_id, member, SPIRV_DECORATION_OFFSET);
+                u32 member_matrix_stride =
+                    spirv_member_decoration(module, type_id, member, SPIRV_DECORATION_MATRIX_STRIDE);
+                u32 end = (offset != U32_MAX ? offset : 0) +
+                          spirv_type_size(module, instruction[2 + member], member_matrix_stride);
+                if (end > size)
+                    size = end;
+            }
+
+            return size;
+        }
+    }
+
+    return 0;
+}
+
+static u32 spirv_struct_min_offset(SPIRVModule *module, u32 struct_id) {
+    u32 member_count = (spirv_instruction(module, struct_id)[0] >> 16) - 2;
+    u32 min_offset = U32_MAX;
+    for (u32 member = 0; member < member_count; ++member) {
+        u32 offset = spirv_member_decoration(module, struct_id, member, SPIRV_DECORATION_OFFSET);
+        if (offset < min_offset)
+            min_offset = offset;
+    }
+
+    return min_offset != U32_MAX ? min_offset : 0;
+}
+
+// Strips array types, multiplying their lengths into count; runtime arrays set count to 0.
+static u32 spirv_strip_arrays(SPIRVModule *module, u32 type_id, u32 *count) {
+    *count = 1;
+    while (valid_spirv_id(module, type_id)) {
+        u32 *instruction = spirv_instruction(module, type_id);
+        if (module->ids[type_id].opcode == SPIRV_OP_TYPE_ARRAY)
+            *count *= spirv_constant_value(module, instruction[3]);
+        else if (module->ids[type_id].opcode == SPIRV_OP_TYPE_RUNTIME_ARRAY)
+            *count = 0;
+        else
+            break;
+
+        type_id = instruction[2];
+    }
+
+    return type_id;
+}
+
+static SPIRVNumericType spirv_numeric_type(SPIRVModule *module, u32 type_id, u32 *component_count) {
+    *component_count = 1;
+    if (valid_spirv_id(module, type_id) && module->ids[type_id].opcode == SPIRV_OP_TYPE_VECTOR) {
+        *component_count = spirv_instruction(module, type_id)[3];
+        type_id = spirv_instruction(module, type_id)[2];
+    }
+
+    if (!valid_spirv_id(module, type_id))
+        return SPIRVNumericType::UNKNOWN;
+
+    if (module->ids[type_id].opcode == SPIRV_OP_TYPE_FLOAT)
+        return SPIRVNumericType::FLOAT;
+
+    if (module->ids[type_id].opcode == SPIRV_OP_TYPE_INT)
+        return spirv_instruction(module, type_id)[3] ? SPIRVNumericType::SINT : SPIRVNumericType::UINT;
+
+    return SPIRVNumericType::UNKNOWN;
+}
+
+static bool spirv_descriptor_type(SPIRVModule *module, u32 storage_class, u32 type_id, VkDescriptorType *type) {
+    if (!valid_spirv_id(module, type_id))
+        return false;
+
+    SPIRVId *id = module->ids + type_id;
+    u32 *instruction = spirv_instruction(module, type_id);
+
+    if (storage_class == SPIRV_STORAGE_CLASS_STORAGE_BUFFER) {
+        *type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        return true;
+    }
+
+    if (storage_class == SPIRV_STORAGE_CLASS_UNIFORM) {
+        if (id->opcode != SPIRV_OP_TYPE_STRUCT)
+            return false;
+
+        *type = id->buffer_block ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        return id->block || id->buffer_block;
+    }
+
+    switch (id->opcode) {
+        case SPIRV_OP_TYPE_SAMPLED_IMAGE: *type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER; return true;
+        case SPIRV_OP_TYPE_SAMPLER:       *type = VK_DESCRIPTOR_TYPE_SAMPLER;                return true;
+        case SPIRV_OP_TYPE_IMAGE: {
+            u32 dim = instruction[3];
+            bool storage = instruction[7] == 2; // Sampled operand: 1 = sampled, 2 = storage.
+            if (dim == SPIRV_DIM_SUBPASS_DATA)
+                *type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+            else if (dim == SPIRV_DIM_BUFFER)
+                *type = storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+            else
+                *type = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool load_spirv_ids(SPIRVModule *module, cstr *error) {
+    for (u32 offset = SPIRV_HEADER_WORD_COUNT; offset < module->word_count;) {
+        u32 *instruction = module->code + offset;
+        u32 opcode = instruction[0] & 0xFFFF;
+        u32 instruction_word_count = instruction[0] >> 16;
+
+        if (instruction_word_count == 0 || offset + instruction_word_count > module->word_count) {
+            *error = "instruction overruns module";
+            return false;
+        }
+
+        // Result id is the first operand of type declarations and the second of constants and variables.
+        u32 result_id = U32_MAX;
+        if (opcode >= SPIRV_OP_TYPE_INT && opcode <= SPIRV_OP_TYPE_POINTER && instruction_word_count >= 2)
+            result_id = instruction[1];
+        else if ((opcode == SPIRV_OP_CONSTANT || opcode == SPIRV_OP_VARIABLE) && instruction_word_count >= 3)
+            result_id = instruction[2];
+
+        if (result_id != U32_MAX) {
+            if (result_id >= module->id_bound) {
+                *error = "result id exceeds id bound";
+                return false;
+            }
+
+            module->ids[result_id].opcode = opcode;
+            module->ids[result_id].word_offset = offset;
+        }
+
+        if (opcode == SPIRV_OP_DECORATE && instruction_word_count >= 3) {
+            if (instruction[1] >= module->id_bound) {
+                *error = "decoration target exceeds id bound";
+                return false;
+            }
+
+            SPIRVId *target = module->ids + instruction[1];
+            u32 literal = instruction_word_count >= 4 ? instruction[3] : 0;
+            switch (instruction[2]) {
+                case SPIRV_DECORATION_BLOCK:          target->block = true;         break;
+                case SPIRV_DECORATION_BUFFER_BLOCK:   target->buffer_block = true;  break;
+                case SPIRV_DECORATION_ARRAY_STRIDE:   target->array_stride = literal; break;
+                case SPIRV_DECORATION_BUILT_IN:       target->built_in = true;      break;
+                case SPIRV_DECORATION_LOCATION:       target->location = literal;   break;
+                case SPIRV_DECORATION_BINDING:        target->binding = literal;    break;
+                case SPIRV_DECORATION_DESCRIPTOR_SET: target->set = literal;        break;
+            }
+        }
+
+        offset += instruction_word_count;
+    }
+
+    return true;
+}
+
+static bool reflect_spirv_variable(SPIRVModule *module, ShaderReflection *reflection, u32 variable_id, cstr *error) {
+    u32 *instruction = spirv_instruction(module, variable_id);
+    SPIRVId *variable = module->ids + variable_id;
+    u32 storage_class = instruction[3];
+
+    // Variables are always pointers; reflect pointee type.
+    u32 pointer_type_id = instruction[1];
+    if (!valid_spirv_id(module, pointer_type_id) || module->ids[pointer_type_id].opcode != SPIRV_OP_TYPE_POINTER) {
+        *error = "variable type is not a pointer";
+        return false;
+    }
+
+    u32 type_id = spirv_instruction(module, pointer_type_id)[3];
+
+    if (storage_class == SPIRV_STORAGE_CLASS_INPUT) {
+        if (variable->built_in || variable->location == U32_MAX)
+            return true;
+
+        ReflectedInput input = { .location = variable->location };
+        input.numeric_type = spirv_numeric_type(module, type_id, &input.component_count);
+        if (input.numeric_type == SPIRVNumericType::UNKNOWN)
+            return true;
+
+        if (reflection->inputs.count == SPIRV_MAX_INPUTS) {
+            *error = "too many inputs";
+            return false;
+        }
+
+        push(&reflection->inputs, input);
+    }
+    else if (storage_class == SPIRV_STORAGE_CLASS_PUSH_CONSTANT) {
+        if (!valid_spirv_id(module, type_id) || module->ids[type_id].opcode != SPIRV_OP_TYPE_STRUCT) {
+            *error = "push constant block is not a struct";
+            return false;
+        }
+
+        reflection->push_constant_offset = spirv_struct_min_offset(module, type_id);
+        reflection->push_constant_size = spirv_type_size(module, type_id, 0) - reflection->push_constant_offset;
+    }
+    else if (storage_class == SPIRV_STORAGE_CLASS_UNIFORM_CONSTANT ||
+             storage_class == SPIRV_STORAGE_CLASS_UNIFORM ||
+             storage_class == SPIRV_STORAGE_CLASS_STORAGE_BUFFER)
+    {
+        ReflectedBinding binding = {
+            .set = variable->set != U32_MAX ? variable->set : 0,
+            .binding = variable->binding != U32_MAX ? variable->binding : 0,
+        };
+
+        u32 element_type_id = spirv_strip_arrays(module, type_id, &binding.count);
+        if (!spirv_descriptor_type(module, storage_class, element_type_id, &binding.type)) {
+            *error = "unsupported descriptor type";
+            return false;
+        }
+
+        if (reflection->bindings.count == SPIRV_MAX_BINDINGS) {
+            *error = "too many descriptor bindings";
+            return false;
+        }
+
+        push(&reflection->bindings, binding);
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+// Reflects inputs, descriptor bindings and push constant block of a SPIR-V module. Returns false with a description
+// in error if the module is malformed or uses an unsupported descriptor type.
+static bool reflect_spirv(ShaderReflection *reflection, u32 *code, u32 word_count, cstr *error) {
+    *reflection = {};
+
+    if (word_count < SPIRV_HEADER_WORD_COUNT || code[0] != SPIRV_MAGIC) {
+        *error = "not a SPIR-V module";
+        return false;
+    }
+
+    SPIRVModule module = {
+        .code = code,
+        .word_count = word_count,
+        .ids = NULL,
+        .id_bound = code[3],
+    };
+
+    // Allocated rather than taken from a stack allocator so shaders can be reflected from multiple threads.
+    module.ids = (SPIRVId *)calloc(module.id_bound, sizeof(SPIRVId));
+    for (u32 i = 0; i < module.id_bound; ++i) {
+        module.ids[i].location = U32_MAX;
+        module.ids[i].binding = U32_MAX;
+        module.ids[i].set = U32_MAX;
+    }
+
+    bool success = load_spirv_ids(&module, error);
+    for (u32 id = 0; success && id < module.id_bound; ++id)
+        if (module.ids[id].opcode == SPIRV_OP_VARIABLE)
+            success = reflect_spirv_variable(&module, reflection, id, error);
+
+    free(module.ids);
+    return success;
+}
+
+static cstr spirv_numeric_type_name(SPIRVNumericType numeric_type) {
+    switch (numeric_type) {
+        case SPIRVNumericType::FLOAT: return "float";
+        case SPIRVNumericType::SINT:  return "int";
+        case SPIRVNumericType::UINT:  return "uint";
+        default:                      return "unknown";
+    }
+}
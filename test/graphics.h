@@ -1,6 +1,12 @@
 #pragma once
 
 #include "renderer/vulkan.h"
+#include "renderer/bindless.h"
+#include "renderer/descriptor_allocator.h"
+#include "renderer/mesh.h"
+#include "renderer/mesh_loader.h"
+#include "renderer/pipeline_registry.h"
+#include "renderer/shader_reload.h"
 #include "ctk/memory.h"
 #include "ctk/containers.h"
 
@@ -32,6 +38,7 @@ struct Graphics {
     struct {
         Buffer *host;
         Buffer *device;
+        Buffer *indirect; // Host-visible indirect draw commands written by CPU culling; created by the test app.
     } buffer;
 
     Region *staging_region;
@@ -40,32 +47,46 @@ struct Graphics {
         VkSampler test;
     } sampler;
 
-    VkDescriptorPool descriptor_pool;
+    DescriptorAllocator *descriptor_allocator;
+
+    // Only created when descriptor indexing is enabled.
+    Bindless *bindless;
 
     struct {
         // VkDescriptorSetLayout mvp_matrix;
         VkDescriptorSetLayout image_sampler;
     } descriptor_set_layout;
 
+    struct {
+        DescriptorUpdateTemplate image_sampler;
+    } descriptor_update_template;
+
     struct {
         // Array<VkDescriptorSet> *mvp_matrix;
-        Array<VkDescriptorSet> *image_sampler;
+        VkDescriptorSet image_sampler; // Transient; written for each frame before recording.
     } descriptor_set;
 
     struct {
         ShaderGroup test;
+        ShaderGroup bindless;
     } shader;
 
     RenderPass *main_render_pass;
 
     struct {
         Image *depth;
+        Array<Image *> *color; // Headless only; stand in for swapchain images.
     } framebuffer_image;
 
+    // Indexed by VertexFormat; pipelines only differ in vertex input layout. Built on first use unless precompiled.
+    PipelineRegistry *pipeline_registry;
     struct {
-        Pipeline *test;
+        PipelineVariant *test[(u32)VertexFormat::COUNT];
+        PipelineVariant *bindless[(u32)VertexFormat::COUNT];
     } pipeline;
 
+    ShaderReloader *shader_reloader;
+
     Array<VkFramebuffer> *framebuffers;
 
     Array<VkCommandBuffer> *render_pass_cmd_bufs;
@@ -78,8 +99,27 @@ struct Graphics {
         u32 swap_img_idx;
         u32 curr_frame_idx;
     } sync;
+
+    GPUQueries *gpu_queries;
+};
+
+static constexpr u32 FRAMES_IN_FLIGHT = 1;
+
+// Bindless shaders are only loaded when descriptor indexing is enabled.
+static ShaderInfo SHADER_INFOS[] = {
+    { "data/shaders/test.vert.spv",     VK_SHADER_STAGE_VERTEX_BIT   },
+    { "data/shaders/test.frag.spv",     VK_SHADER_STAGE_FRAGMENT_BIT },
+    { "data/shaders/bindless.vert.spv", VK_SHADER_STAGE_VERTEX_BIT   },
+    { "data/shaders/bindless.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT },
 };
 
+// glslc target environments, matching _sync_shaders.bat: bindless shaders need Vulkan 1.2, the rest run on 1.0.
+static cstr SHADER_TARGET_ENVS[] = { "vulkan1.0", "vulkan1.0", "vulkan1.2", "vulkan1.2" };
+static_assert(CTK_ARRAY_SIZE(SHADER_TARGET_ENVS) == CTK_ARRAY_SIZE(SHADER_INFOS), "one target env per shader");
+
+// Specialization constant IDs.
+static constexpr u32 BINDLESS_UNIFORM_TEXTURE_INDEX_CONSTANT = 0; // bindless.frag UNIFORM_TEXTURE_INDEX
+
 ////////////////////////////////////////////////////////////
 /// Internal
 ////////////////////////////////////////////////////////////
@@ -135,22 +175,28 @@ static void create_samplers(Graphics *gfx, Vulkan *vk) {
         .compareEnable = VK_FALSE,
         .compareOp = VK_COMPARE_OP_NEVER,
         .minLod = 0.0f,
-        .maxLod = 0.0f,
+        .maxLod = VK_LOD_CLAMP_NONE,
         .borderColor = VK_BORDER_COLOR_INT_OPAQUE_WHITE,
         .unnormalizedCoordinates = VK_FALSE,
     });
 }
 
 static void create_descriptor_sets(Graphics *gfx, Vulkan *vk) {
-    // Pool
-    gfx->descriptor_pool = create_descriptor_pool(vk, {
-        .descriptor_count = {
-            .uniform_buffer = 8,
-            .uniform_buffer_dynamic = 4,
-            .combined_image_sampler = 8,
-            // .input_attachment = 4,
+    // Allocator
+    gfx->descriptor_allocator = create_descriptor_allocator(gfx->mem.module, vk, gfx->pipeline_registry, {
+        .pool = {
+            .descriptor_count = {
+                .uniform_buffer = 8,
+                .uniform_buffer_dynamic = 4,
+                .combined_image_sampler = 8,
+                // .input_attachment = 4,
+            },
+            .max_descriptor_sets = 64,
         },
-        .max_descriptor_sets = 64,
+        .max_pools_per_chain = 16,
+        .frame_count = FRAMES_IN_FLIGHT,
+        .max_transient_sets = 256,
+        .max_transient_key_bytes = (u32)kilobyte(16),
     });
 
     // // MVP Matrix
@@ -161,34 +207,34 @@ static void create_descriptor_sets(Graphics *gfx, Vulkan *vk) {
     //         .stage = VK_SHADER_STAGE_VERTEX_BIT,
     //     };
 
-    //     gfx->descriptor_set_layout.mvp_matrix = create_descriptor_set_layout(vk, &descriptor_info, 1);
+    //     gfx->descriptor_set_layout.mvp_matrix =
+    //         get_descriptor_set_layout(gfx->descriptor_allocator, &descriptor_info, 1);
     //     gfx->descriptor_set.mvp_matrix = create_array<VkDescriptorSet>(gfx->mem.module, vk->swapchain.image_count);
-    //     allocate_descriptor_sets(vk, gfx->descriptor_pool, gfx->descriptor_set_layout.mvp_matrix,
+    //     allocate_descriptor_sets(gfx->descriptor_allocator, gfx->descriptor_set_layout.mvp_matrix,
     //                              vk->swapchain.image_count, gfx->descriptor_set.mvp_matrix->data);
     // }
 
-    // Image Sampler
-    {
-        DescriptorInfo descriptor_info = {
-            .count = 1,
-            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+    // Bindless
+    if (vk->descriptor_indexing_enabled) {
+        gfx->bindless = create_bindless(gfx->mem.module, vk, {
+            .max_textures = 1024,
+            .max_buffers = 64,
             .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-        };
-
-        gfx->descriptor_set_layout.image_sampler = create_descriptor_set_layout(vk, &descriptor_info, 1);
-        gfx->descriptor_set.image_sampler = create_array<VkDescriptorSet>(gfx->mem.module, vk->swapchain.image_count);
-        allocate_descriptor_sets(vk, gfx->descriptor_pool, gfx->descriptor_set_layout.image_sampler,
-                                 vk->swapchain.image_count, gfx->descriptor_set.image_sampler->data);
+        });
     }
 }
 
-static void create_shaders(Graphics *gfx, Vulkan *vk) {
+static void create_shaders(Graphics *gfx, Vulkan *vk, u32 thread_count) {
+    Shader *shaders[CTK_ARRAY_SIZE(SHADER_INFOS)] = {};
+    u32 shader_count = gfx->bindless ? 4 : 2;
+    create_shader_batch(vk, SHADER_INFOS, shader_count, shaders, thread_count, gfx->mem.temp);
+
     gfx->shader = {
-        .test = {
-            .vert = create_shader(vk, "data/shaders/test.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
-            .frag = create_shader(vk, "data/shaders/test.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
-        },
+        .test = { .vert = shaders[0], .frag = shaders[1] },
     };
+
+    if (gfx->bindless)
+        gfx->shader.bindless = { .vert = shaders[2], .frag = shaders[3] };
 }
 
 static u32 push_attachment(RenderPassInfo *info, AttachmentInfo attachment_info) {
@@ -218,6 +264,10 @@ static void create_render_passes(Graphics *gfx, Vulkan *vk) {
             },
         };
 
+        // Headless color images are left ready to be copied out instead of presented.
+        VkImageLayout color_final_layout =
+            vk->headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
         // Swapchain Image Attachment
         u32 depth_attachment_index = push_attachment(&info, {
             .description = {
@@ -247,7 +297,7 @@ static void create_render_passes(Graphics *gfx, Vulkan *vk) {
                 .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
 
                 .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-                .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                .finalLayout = color_final_layout,
             },
             .clear_value = { 0, 0, 0, 1 },
         });
@@ -275,6 +325,19 @@ static void create_render_passes(Graphics *gfx, Vulkan *vk) {
         //     .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT,
         // });
 
+        // Headless color images may still be read by an earlier frame's readback copy when rendering starts.
+        if (vk->headless) {
+            push(info.subpass.dependencies, {
+                .srcSubpass = VK_SUBPASS_EXTERNAL,
+                .dstSubpass = 0,
+                .srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+                .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                .srcAccessMask = 0,
+                .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                .dependencyFlags = 0,
+            });
+        }
+
         gfx->main_render_pass = create_render_pass(vk, &info);
 
         pop_frame(gfx->mem.temp);
@@ -326,14 +389,60 @@ static void create_framebuffer_images(Graphics *gfx, Vulkan *vk) {
         },
         .mem_property_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
     });
+
+    if (!vk->headless)
+        return;
+
+    // Headless color targets replace swapchain images, one per swapchain image index.
+    gfx->framebuffer_image.color = create_array<Image *>(gfx->mem.module, vk->swapchain.image_count);
+    for (u32 i = 0; i < vk->swapchain.image_count; ++i) {
+        push(gfx->framebuffer_image.color, create_image(vk, {
+            .image = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                .flags = 0,
+                .imageType = VK_IMAGE_TYPE_2D,
+                .format = vk->swapchain.image_format,
+                .extent = {
+                    .width = vk->swapchain.extent.width,
+                    .height = vk->swapchain.extent.height,
+                    .depth = 1
+                },
+                .mipLevels = 1,
+                .arrayLayers = 1,
+                .samples = VK_SAMPLE_COUNT_1_BIT,
+                .tiling = VK_IMAGE_TILING_OPTIMAL,
+                .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                .queueFamilyIndexCount = 0,
+                .pQueueFamilyIndices = NULL,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            },
+            .view = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                .flags = 0,
+                .viewType = VK_IMAGE_VIEW_TYPE_2D,
+                .format = vk->swapchain.image_format,
+                .components = {
+                    .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                    .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                    .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                    .a = VK_COMPONENT_SWIZZLE_IDENTITY,
+                },
+                .subresourceRange = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+            },
+            .mem_property_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        }));
+    }
 }
 
-static void create_pipelines(Graphics *gfx, Vulkan *vk) {
-    VkVertexInputBindingDescription default_vertex_binding = {
-        .binding = 0,
-        .stride = 20,
-        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
-    };
+static void create_pipelines(Graphics *gfx, Vulkan *vk, u32 thread_count) {
+    push_frame(gfx->mem.temp);
 
     VkExtent2D surface_extent = get_surface_extent(vk);
 
@@ -352,67 +461,97 @@ static void create_pipelines(Graphics *gfx, Vulkan *vk) {
     };
 
     // Test
-    {
-        push_frame(gfx->mem.temp);
-
-        PipelineInfo info = DEFAULT_PIPELINE_INFO;
-        info.descriptor_set_layouts = create_array<VkDescriptorSetLayout>(gfx->mem.temp, 2);
-        info.push_constant_ranges = create_array<VkPushConstantRange>(gfx->mem.temp, 1);
-        info.vertex_bindings = create_array<VkVertexInputBindingDescription>(gfx->mem.temp, 1);
-        info.vertex_attributes = create_array<VkVertexInputAttributeDescription>(gfx->mem.temp, 2);
-        info.viewports = create_array<VkViewport>(gfx->mem.temp, 1);
-        info.scissors = create_array<VkRect2D>(gfx->mem.temp, 1);
-
-        push(&info.shaders, gfx->shader.test.vert);
-        push(&info.shaders, gfx->shader.test.frag);
-        push(&info.color_blend_attachments, DEFAULT_COLOR_BLEND_ATTACHMENT);
-
-        push(info.descriptor_set_layouts, gfx->descriptor_set_layout.image_sampler);
-        // push(info.descriptor_set_layouts, gfx->descriptor_set_layout.mvp_matrix);
-        push(info.push_constant_ranges, {
-            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
-            .offset = 0,
-            .size = 64
-        });
-        push(info.vertex_bindings, default_vertex_binding);
-        push(info.vertex_attributes, {
-            .location = 0,
-            .binding = 0,
-            .format = VK_FORMAT_R32G32B32_SFLOAT,
-            .offset = 0,
-        });
-        push(info.vertex_attributes, {
-            .location = 1,
-            .binding = 0,
-            .format = VK_FORMAT_R32G32_SFLOAT,
-            .offset = 12,
-        });
-        push(info.viewports, default_viewport);
-        push(info.scissors, default_scissor);
+    for (u32 vertex_format = 0; vertex_format < (u32)VertexFormat::COUNT; ++vertex_format) {
+        auto info = allocate<PipelineInfo>(gfx->mem.temp, 1);
+        *info = DEFAULT_PIPELINE_INFO;
+        info->vertex_bindings = create_array<VkVertexInputBindingDescription>(gfx->mem.temp, 1);
+        info->vertex_attributes = create_array<VkVertexInputAttributeDescription>(gfx->mem.temp, 3);
+        info->viewports = create_array<VkViewport>(gfx->mem.temp, 1);
+        info->scissors = create_array<VkRect2D>(gfx->mem.temp, 1);
+
+        push(&info->shaders, gfx->shader.test.vert);
+        push(&info->shaders, gfx->shader.test.frag);
+        push(&info->color_blend_attachments, DEFAULT_COLOR_BLEND_ATTACHMENT);
+
+        // Descriptor set layouts and push constant ranges are reflected from the shaders.
+        apply_reflected_layout(gfx->pipeline_registry, info, gfx->mem.temp);
+        push_vertex_layout(info, (VertexFormat)vertex_format, VERTEX_ATTRIBUTE_POSITION_BIT | VERTEX_ATTRIBUTE_UV_BIT);
+        push(info->viewports, default_viewport);
+        push(info->scissors, default_scissor);
 
         // Enable depth testing.
-        info.depth_stencil.depthTestEnable = VK_TRUE;
-        info.depth_stencil.depthWriteEnable = VK_TRUE;
-        info.depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+        info->depth_stencil.depthTestEnable = VK_TRUE;
+        info->depth_stencil.depthWriteEnable = VK_TRUE;
+        info->depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
 
-        gfx->pipeline.test = create_pipeline(vk, gfx->main_render_pass, 0, &info);
+        gfx->pipeline.test[vertex_format] =
+            register_pipeline_variant(gfx->pipeline_registry, gfx->main_render_pass, 0, info);
+    }
 
-        pop_frame(gfx->mem.temp);
+    // Bindless
+    for (u32 vertex_format = 0; gfx->bindless && vertex_format < (u32)VertexFormat::COUNT; ++vertex_format) {
+        auto info = allocate<PipelineInfo>(gfx->mem.temp, 1);
+        *info = DEFAULT_PIPELINE_INFO;
+        info->descriptor_set_layouts = create_array<VkDescriptorSetLayout>(gfx->mem.temp, 1);
+        info->vertex_bindings = create_array<VkVertexInputBindingDescription>(gfx->mem.temp, 1);
+        info->vertex_attributes = create_array<VkVertexInputAttributeDescription>(gfx->mem.temp, 3);
+        info->viewports = create_array<VkViewport>(gfx->mem.temp, 1);
+        info->scissors = create_array<VkRect2D>(gfx->mem.temp, 1);
+
+        push(&info->shaders, gfx->shader.bindless.vert);
+        push(&info->shaders, gfx->shader.bindless.frag);
+        push(&info->color_blend_attachments, DEFAULT_COLOR_BLEND_ATTACHMENT);
+
+        // Texture index comes from a push constant, so it's uniform across each draw.
+        set_specialization_constant(info, VK_SHADER_STAGE_FRAGMENT_BIT, BINDLESS_UNIFORM_TEXTURE_INDEX_CONSTANT, true);
+
+        // The bindless texture array is runtime-sized and update-after-bind, so its layout can't be reflected; push
+        // constant ranges still are.
+        push(info->descriptor_set_layouts, gfx->bindless->layout);
+        apply_reflected_layout(gfx->pipeline_registry, info, gfx->mem.temp);
+        push_vertex_layout(info, (VertexFormat)vertex_format, VERTEX_ATTRIBUTE_POSITION_BIT | VERTEX_ATTRIBUTE_UV_BIT);
+        push(info->viewports, default_viewport);
+        push(info->scissors, default_scissor);
+
+        // Enable depth testing.
+        info->depth_stencil.depthTestEnable = VK_TRUE;
+        info->depth_stencil.depthWriteEnable = VK_TRUE;
+        info->depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+        gfx->pipeline.bindless[vertex_format] =
+            register_pipeline_variant(gfx->pipeline_registry, gfx->main_render_pass, 0, info);
     }
+
+    gfx->descriptor_set_layout.image_sampler = gfx->pipeline.test[0]->info.descriptor_set_layouts->data[0];
+
+    // Must match the reflected layout of test.frag's sampler.
+    DescriptorInfo image_sampler_info = {
+        .count = 1,
+        .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+    };
+    gfx->descriptor_update_template.image_sampler =
+        create_descriptor_update_template(vk, gfx->descriptor_set_layout.image_sampler, &image_sampler_info, 1);
+
+    // Precompile in the background while assets load; variants still building when first drawn are waited on.
+    start_pipeline_precompile(gfx->pipeline_registry, thread_count);
+
+    pop_frame(gfx->mem.temp);
 }
 
 static void create_framebuffers(Graphics *gfx, Vulkan *vk) {
     gfx->framebuffers = create_array<VkFramebuffer>(gfx->mem.module, vk->swapchain.image_count);
 
-    // Create framebuffer for each swapchain image.
-    for (u32 i = 0; i < vk->swapchain.image_views.count; ++i) {
+    // Create framebuffer for each swapchain image (or headless color image).
+    for (u32 i = 0; i < vk->swapchain.image_count; ++i) {
         push_frame(gfx->mem.temp);
 
         FramebufferInfo info = {};
 
         info.attachments = create_array<VkImageView>(gfx->mem.temp, 2),
         push(info.attachments, gfx->framebuffer_image.depth->view);
-        push(info.attachments, vk->swapchain.image_views[i]);
+        push(info.attachments,
+             vk->headless ? gfx->framebuffer_image.color->data[i]->view : vk->swapchain.image_views[i]);
 
         info.extent = get_surface_extent(vk);
         info.layers = 1;
@@ -463,6 +602,7 @@ static void create_render_cmd_state(Graphics *gfx, Vulkan *vk, u32 render_thread
 
 static void init_sync(Graphics *gfx, Vulkan *vk, u32 frame_count) {
     gfx->sync.curr_frame_idx = U32_MAX;
+    gfx->sync.swap_img_idx = U32_MAX;
     gfx->sync.frames = create_array<Frame>(gfx->mem.module, frame_count);
 
     for (u32 i = 0; i < frame_count; ++i) {
@@ -477,7 +617,7 @@ static void init_sync(Graphics *gfx, Vulkan *vk, u32 frame_count) {
 ////////////////////////////////////////////////////////////
 /// Interface
 ////////////////////////////////////////////////////////////
-static Graphics *create_graphics(Allocator *module_mem, Vulkan *vk, u32 render_thread_count) {
+static Graphics *create_graphics(Allocator *module_mem, Vulkan *vk, u32 thread_count, u32 render_thread_count) {
     Graphics *gfx = allocate<Graphics>(module_mem, 1);
     gfx->mem.module = module_mem;
     gfx->mem.temp = create_stack_allocator(module_mem, megabyte(1));
@@ -487,33 +627,88 @@ static Graphics *create_graphics(Allocator *module_mem, Vulkan *vk, u32 render_t
     CTK_TODO("what should alignment be?")
     gfx->staging_region = allocate_region(vk, gfx->buffer.host, megabyte(256), 16);
     create_samplers(gfx, vk);
+
+    // Descriptor sets take their layouts from the registry, so it's created before either descriptor sets or pipelines.
+    gfx->pipeline_registry = create_pipeline_registry(module_mem, vk, {
+        .max_variants = 2 * (u32)VertexFormat::COUNT,
+        .max_layouts = 2,
+        .max_descriptor_set_layouts = 4,
+        .max_precompile_threads = 16,
+    });
     create_descriptor_sets(gfx, vk);
-    create_shaders(gfx, vk);
+    create_shaders(gfx, vk, thread_count);
     create_render_passes(gfx, vk);
     create_framebuffer_images(gfx, vk);
-    create_pipelines(gfx, vk);
+    create_pipelines(gfx, vk, thread_count);
     create_framebuffers(gfx, vk);
     create_render_cmd_state(gfx, vk, render_thread_count);
-    init_sync(gfx, vk, 1);
+    init_sync(gfx, vk, FRAMES_IN_FLIGHT);
+
+    // Results are read a frame after the in-flight fence guarantees completion, so reading never waits on the GPU.
+    gfx->gpu_queries = create_gpu_queries(module_mem, vk, {
+        .max_scopes = 16,
+        .frame_latency = FRAMES_IN_FLIGHT + 1,
+        .pipeline_statistics = true,
+    });
 
     return gfx;
 }
 
+// Recompiles shaders in the background when their GLSL source changes; pipelines are swapped at the start of a frame by
+// next_frame(). Call once every pipeline has been registered and precompiled.
+static void start_shader_hot_reload(Graphics *gfx, Vulkan *vk) {
+    gfx->shader_reloader = create_shader_reloader(gfx->mem.module, vk, gfx->pipeline_registry, {
+        .compiler_path = NULL,
+        .max_shaders = CTK_ARRAY_SIZE(SHADER_INFOS),
+        .poll_interval_ms = 250,
+        .retire_frame_count = vk->swapchain.image_count,
+    });
+
+    // Same order as SHADER_INFOS.
+    Shader *shaders[] = {
+        gfx->shader.test.vert,
+        gfx->shader.test.frag,
+        gfx->shader.bindless.vert,
+        gfx->shader.bindless.frag,
+    };
+
+    for (u32 i = 0; i < CTK_ARRAY_SIZE(shaders); ++i)
+        if (shaders[i] != NULL)
+            watch_shader(gfx->shader_reloader, shaders[i], SHADER_INFOS[i].spirv_path, SHADER_TARGET_ENVS[i]);
+
+    start_shader_reload(gfx->shader_reloader);
+}
+
 static void next_frame(Graphics *gfx, Vulkan *vk) {
+    PROFILE_FUNCTION();
     // Update current frame and wait until it is no longer in-flight.
     if (++gfx->sync.curr_frame_idx >= gfx->sync.frames->size)
         gfx->sync.curr_frame_idx = 0;
 
     gfx->sync.frame = gfx->sync.frames->data + gfx->sync.curr_frame_idx;
+    u64 wait_start = get_time_ns();
     validate_result(vkWaitForFences(vk->device, 1, &gfx->sync.frame->in_flight, VK_TRUE, U64_MAX),
                     "vkWaitForFences failed");
+    count_render_stat(RenderCounter::FENCE_WAIT_NS, get_time_ns() - wait_start);
     validate_result(vkResetFences(vk->device, 1, &gfx->sync.frame->in_flight), "vkResetFences failed");
 
+    // The frame's previous submission has finished, so its transient descriptor sets can be recycled.
+    begin_descriptor_frame(gfx->descriptor_allocator, gfx->sync.curr_frame_idx);
+
     // Once current frame is not in-flight, it is safe to use it's img_aquired semaphore and aquire next swap image.
-    gfx->sync.swap_img_idx = next_swap_img_idx(vk, gfx->sync.frame->img_aquired, VK_NULL_HANDLE);
+    // Headless images have nothing to wait on and are cycled in order.
+    if (vk->headless)
+        gfx->sync.swap_img_idx = (gfx->sync.swap_img_idx + 1) % vk->swapchain.image_count;
+    else
+        gfx->sync.swap_img_idx = next_swap_img_idx(vk, gfx->sync.frame->img_aquired, VK_NULL_HANDLE);
+
+    // Commands for this frame haven't been recorded yet, so reloaded pipelines can be swapped in.
+    if (gfx->shader_reloader)
+        update_shader_reload(gfx->shader_reloader);
 }
 
 static void submit_render_cmds(Graphics *gfx, Vulkan *vk) {
+    PROFILE_FUNCTION();
     // Rendering
     {
         VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
@@ -521,12 +716,12 @@ static void submit_render_cmds(Graphics *gfx, Vulkan *vk) {
         VkSubmitInfo submit_info = {};
         submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
         submit_info.pNext = NULL;
-        submit_info.waitSemaphoreCount = 1;
+        submit_info.waitSemaphoreCount = vk->headless ? 0 : 1;
         submit_info.pWaitSemaphores = &gfx->sync.frame->img_aquired;
         submit_info.pWaitDstStageMask = &wait_stage;
         submit_info.commandBufferCount = 1;
         submit_info.pCommandBuffers = &gfx->render_pass_cmd_bufs->data[gfx->sync.swap_img_idx];
-        submit_info.signalSemaphoreCount = 1;
+        submit_info.signalSemaphoreCount = vk->headless ? 0 : 1;
         submit_info.pSignalSemaphores = &gfx->sync.frame->render_finished;
 
         validate_result(vkQueueSubmit(vk->queue.graphics, 1, &submit_info, gfx->sync.frame->in_flight),
@@ -534,7 +729,7 @@ static void submit_render_cmds(Graphics *gfx, Vulkan *vk) {
     }
 
     // Presentation
-    {
+    if (!vk->headless) {
         VkPresentInfoKHR present_info = {};
         present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
         present_info.pNext = NULL;
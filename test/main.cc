@@ -2,15 +2,28 @@
 #define STB_IMAGE_STATIC
 #include <stb/stb_image.h>
 
+#include <cfloat>
+#include <cstdlib>
+#include <cstring>
 #include <thread>
 #include <vector>
 #include "renderer/platform.h"
 #include "renderer/vulkan.h"
+#include "renderer/mesh.h"
+#include "renderer/mesh_loader.h"
+#include "renderer/meshlet.h"
+#include "renderer/texture_loader.h"
+#include "renderer/texture_streaming.h"
+#include "renderer/frame_readback.h"
+#include "renderer/benchmark_runner.h"
+#include "renderer/timer.h"
+#include "renderer/frame_timer.h"
+#include "renderer/profiler.h"
+#include "renderer/render_stats.h"
 #include "renderer/test/graphics.h"
 #include "ctk/memory.h"
 #include "ctk/containers.h"
 #include "ctk/math.h"
-#include "ctk/benchmark.h"
 #include "ctk/task.h"
 
 using namespace ctk;
@@ -26,18 +39,6 @@ struct Memory {
     Allocator *graphics;
 };
 
-struct Vertex {
-    Vec3<f32> position;
-    Vec2<f32> uv;
-};
-
-struct Mesh {
-    Array<Vertex> *vertexes;
-    Array<u32> *indexes;
-    Region *vertex_region;
-    Region *index_region;
-};
-
 struct View {
     PerspectiveInfo perspective_info;
     Vec3<f32> position;
@@ -48,23 +49,52 @@ struct View {
 struct Entity {
     Vec3<f32> position;
     Vec3<f32> rotation;
+    u32 lod; // Only accessed by the render thread drawing the entity.
+};
+
+struct LODStats {
+    u32 entity_counts[MESH_MAX_LODS];
+    u32 triangle_counts[MESH_MAX_LODS];
 };
 
+static_assert(sizeof(MeshletDrawCommand) == sizeof(VkDrawIndexedIndirectCommand),
+              "MeshletDrawCommand must match VkDrawIndexedIndirectCommand");
+
 struct Test {
     static constexpr s32 CUBE_MATRIX_SIZE = 64;
     static constexpr f32 CUBE_MATRIX_SPREAD = 2.5f;
     static constexpr u32 MAX_ENTITIES = CUBE_MATRIX_SIZE * CUBE_MATRIX_SIZE * CUBE_MATRIX_SIZE;
+    static constexpr u32 MAX_MESHLET_DRAWS = 1 << 20; // Per swapchain image.
+    static constexpr f32 LOD_MAX_ERROR_PIXELS = 1.0f;
+    static constexpr f32 LOD_HYSTERESIS = 0.25f;
 
     Memory *mem;
 
     struct {
-        Mesh quad;
+        Mesh cube;
     } mesh;
 
     struct {
         Image *test;
     } image;
 
+    // Meshlet culling output; each swapchain image has room for all meshlets of the first entity_count entities, so
+    // render threads write their entities' draws without synchronizing. Entities past entity_count draw LOD 0 whole.
+    struct {
+        Region *region;
+        MeshletDrawCommand *commands; // Mapped region.
+        u32 frame_stride;             // Commands per swapchain image.
+        u32 entity_count;
+    } meshlet_draws;
+
+    TextureStreamer *texture_streamer;
+
+    struct {
+        StreamedTexture *test;
+    } streamed_texture;
+
+    f32 nearest_entity_distance;
+
     struct {
         // Array<Region *> *mvp_matrixes;
     } uniform_buffer;
@@ -73,6 +103,11 @@ struct Test {
         ImageSampler test;
     } image_sampler;
 
+    struct {
+        u32 test;
+        u32 test_version; // Streamed texture version last written to the bindless set.
+    } bindless_texture_idx;
+
     View view;
 
     struct {
@@ -83,161 +118,199 @@ struct Test {
     FixedArray<Entity, MAX_ENTITIES> entities;
     FixedArray<Matrix, MAX_ENTITIES> mvp_matrixes;
 
-    FrameBenchmark *frame_benchmark;
+
+    // Drawn entities and triangles per LOD for the last recorded frame, summed from each render thread's stats.
+    LODStats lod_stats;
+    Array<LODStats> *thread_lod_stats;
+
+    // CPU time of the last frame's update tasks. Culling runs inside recording and is summed across render threads.
+    struct {
+        f64 transforms;
+        f64 culling;
+        f64 recording;
+    } stage_ms;
+    Array<u64> *thread_cull_ns;
+};
+
+// Stage indexes in the benchmark runner.
+struct BenchmarkStages {
+    u32 cpu_frame;
+    u32 gpu_frame;
+    u32 next_frame;
+    u32 transforms;
+    u32 culling;
+    u32 recording;
+    u32 submit;
 };
 
 static bool use_threads;
+static bool use_texture_streaming = true;
+static bool use_bindless = true;
 
 ////////////////////////////////////////////////////////////
 /// Utils
 ////////////////////////////////////////////////////////////
-static void init_mesh(Mesh *mesh, Graphics *gfx, Vulkan *vk, Array<Vertex> *vertexes, Array<u32> *indexes) {
-    mesh->vertexes = vertexes,
-    mesh->indexes = indexes,
-    mesh->vertex_region = allocate_region(vk, gfx->buffer.device, byte_count(vertexes), 16),
-    mesh->index_region = allocate_region(vk, gfx->buffer.device, byte_count(indexes), 16),
-
-    begin_temp_cmd_buf(gfx->temp_cmd_buf);
-        u32 vertex_data_size = byte_count(mesh->vertexes);
-        write_to_device_region(vk, gfx->temp_cmd_buf,
-                               gfx->staging_region, 0,
-                               mesh->vertex_region, 0,
-                               mesh->vertexes->data, vertex_data_size);
-        write_to_device_region(vk, gfx->temp_cmd_buf,
-                               gfx->staging_region, vertex_data_size,
-                               mesh->index_region,  0,
-                               mesh->indexes->data, byte_count(mesh->indexes));
-    submit_temp_cmd_buf(gfx->temp_cmd_buf, vk->queue.graphics);
-}
-
-static void create_meshes(Test *test, Graphics *gfx, Vulkan *vk) {
+static void create_meshes(Test *test, Graphics *gfx, Vulkan *vk, Platform *platform) {
+    // Prefer baked mesh file (see tools/mesh_baker.cc) and fall back to source glTF if it is missing or stale.
+    cstr baked_path = "data/cube.mesh";
+    cstr gltf_path = "data/cube.gltf";
+    Array<Mesh> *meshes = NULL;
+    MeshLoadStats stats = {};
+
+    if (load_baked_meshes(vk, gfx->temp_cmd_buf, gfx->staging_region, gfx->buffer.device, baked_path, &meshes,
+                          test->mem->fixed, &stats))
     {
-        auto vertexes = create_array<Vertex>(test->mem->fixed, 8);
-        push(vertexes, { { -1,-1,-1 }, { 0, 0 } });
-        push(vertexes, { { -1, 1,-1 }, { 0, 1 } });
-        push(vertexes, { {  1, 1,-1 }, { 1, 1 } });
-        push(vertexes, { {  1,-1,-1 }, { 1, 0 } });
-
-        push(vertexes, { {  1,-1, 1 }, { 0, 0 } });
-        push(vertexes, { {  1, 1, 1 }, { 0, 1 } });
-        push(vertexes, { { -1, 1, 1 }, { 1, 1 } });
-        push(vertexes, { { -1,-1, 1 }, { 1, 0 } });
-
-        auto indexes = create_array<u32>(test->mem->fixed, 36);
-        push(indexes, 0u);
-        push(indexes, 2u);
-        push(indexes, 1u);
-        push(indexes, 0u);
-        push(indexes, 3u);
-        push(indexes, 2u);
-
-        push(indexes, 3u);
-        push(indexes, 5u);
-        push(indexes, 2u);
-        push(indexes, 3u);
-        push(indexes, 4u);
-        push(indexes, 5u);
-
-        push(indexes, 4u);
-        push(indexes, 6u);
-        push(indexes, 5u);
-        push(indexes, 4u);
-        push(indexes, 7u);
-        push(indexes, 6u);
-
-        push(indexes, 7u);
-        push(indexes, 1u);
-        push(indexes, 6u);
-        push(indexes, 7u);
-        push(indexes, 0u);
-        push(indexes, 1u);
-
-        push(indexes, 7u);
-        push(indexes, 3u);
-        push(indexes, 0u);
-        push(indexes, 7u);
-        push(indexes, 4u);
-        push(indexes, 3u);
-
-        push(indexes, 1u);
-        push(indexes, 5u);
-        push(indexes, 6u);
-        push(indexes, 1u);
-        push(indexes, 2u);
-        push(indexes, 5u);
-
-        init_mesh(&test->mesh.quad, gfx, vk, vertexes, indexes);
-    }
-}
-
-static Image *load_image(Graphics *gfx, Vulkan *vk, cstr path, ImageInfo info) {
-    // Load Image Data to Staging Region
-    s32 width = 0;
-    s32 height = 0;
-    s32 channel_count = 0;
-    stbi_uc *data = stbi_load(path, &width, &height, &channel_count, STBI_rgb_alpha);
-    if (data == NULL)
-        CTK_FATAL("failed to load image from \"%s\"", path)
-
-    write_to_host_region(vk->device, gfx->staging_region, 0, data, width * height * STBI_rgb_alpha);
-    stbi_image_free(data);
-
-    info.image.extent.width = (u32)width;
-    info.image.extent.height = (u32)height;
-
-    // Create Vulkan Image
-    Image *image = create_image(vk, info);
-
-    // Write Image Data to Vulkan Image
-    begin_temp_cmd_buf(gfx->temp_cmd_buf);
-        write_to_image(vk, gfx->temp_cmd_buf, gfx->staging_region, 0, image);
-    submit_temp_cmd_buf(gfx->temp_cmd_buf, vk->queue.graphics);
-
-    return image;
-}
-
-static void create_images(Test *test, Graphics *gfx, Vulkan *vk) {
-    VkFormat color_format = VK_FORMAT_R8G8B8A8_UNORM;
+        print_mesh_load_stats(baked_path, &stats);
+    }
+    else {
+        // Optimization, LOD generation and meshlet building need temp memory proportional to the asset, so they get
+        // scratch sized from the glTF instead of the shared temp allocator.
+        u64 scratch_size = get_gltf_mesh_scratch_size(gltf_path, platform->thread_count, test->mem->fixed, true);
+        Allocator *scratch = create_stack_allocator(test->mem->fixed, scratch_size);
+        stats = load_gltf_meshes(vk, gfx->temp_cmd_buf, gfx->staging_region, gfx->buffer.device, gltf_path, &meshes,
+                                 platform->thread_count, test->mem->fixed, scratch, true);
+        print_mesh_load_stats(gltf_path, &stats);
+    }
 
-    {
-        test->image.test = load_image(gfx, vk, "data/test.png", {
-            .image = {
-                .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-                .flags = 0,
-                .imageType = VK_IMAGE_TYPE_2D,
-                .format = color_format,
-                .extent = { .depth = 1 },
-                .mipLevels = 1,
-                .arrayLayers = 1,
-                .samples = VK_SAMPLE_COUNT_1_BIT,
-                .tiling = VK_IMAGE_TILING_OPTIMAL,
-                .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-                .queueFamilyIndexCount = 0, // Ignored if sharingMode is not VK_SHARING_MODE_CONCURRENT.
-                .pQueueFamilyIndices = NULL, // Ignored if sharingMode is not VK_SHARING_MODE_CONCURRENT.
-                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    test->mesh.cube = meshes->data[0];
+}
+
+static void create_meshlet_draws(Test *test, Graphics *gfx, Vulkan *vk) {
+    Mesh *mesh = &test->mesh.cube;
+    test->meshlet_draws = {};
+    if (mesh->meshlet_count == 0)
+        return;
+
+    // Draw slots grow with the mesh's meshlet count, so they're capped rather than reserved for every entity.
+    u32 entity_count = Test::MAX_MESHLET_DRAWS / mesh->meshlet_count;
+    if (entity_count < Test::MAX_ENTITIES) {
+        warning("mesh has %u meshlets; only the first %u of %u entities are meshlet culled", mesh->meshlet_count,
+                entity_count, Test::MAX_ENTITIES);
+    }
+    else {
+        entity_count = Test::MAX_ENTITIES;
+    }
+
+    if (entity_count == 0)
+        return;
+
+    test->meshlet_draws.entity_count = entity_count;
+    test->meshlet_draws.frame_stride = entity_count * mesh->meshlet_count;
+
+    u64 size = (u64)vk->swapchain.image_count * test->meshlet_draws.frame_stride * sizeof(MeshletDrawCommand);
+    if (size > U32_MAX)
+        CTK_FATAL("meshlet draw commands for %u swapchain images need %llu bytes", vk->swapchain.image_count, size);
+
+    BufferInfo info = {};
+    info.size = size;
+    info.sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
+    info.usage_flags = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    info.mem_property_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    gfx->buffer.indirect = create_buffer(vk, &info);
+    test->meshlet_draws.region = allocate_region(vk, gfx->buffer.indirect, (u32)size, sizeof(u32));
+    test->meshlet_draws.commands = (MeshletDrawCommand *)map_host_region(vk->device, test->meshlet_draws.region);
+}
+
+static void load_images(Graphics *gfx, Vulkan *vk, Platform *platform, Allocator *temp,
+                        TextureLoadInfo *infos, u32 count, Image **images)
+{
+    push_frame(temp);
+
+    auto timings = allocate<TextureLoadTiming>(temp, count);
+    TextureBatchStats stats = load_textures(vk, gfx->temp_cmd_buf, gfx->staging_region, infos, count, images,
+                                            timings, platform->thread_count, temp);
+    print_texture_batch_stats(&stats, infos, timings);
+
+    pop_frame(temp);
+}
+
+static ImageInfo default_texture_info(VkFormat format) {
+    return {
+        .image = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .flags = 0,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = format,
+            .extent = { .depth = 1 },
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0, // Ignored if sharingMode is not VK_SHARING_MODE_CONCURRENT.
+            .pQueueFamilyIndices = NULL, // Ignored if sharingMode is not VK_SHARING_MODE_CONCURRENT.
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        },
+        .view = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .flags = 0,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = format,
+            .components = {
+                .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .a = VK_COMPONENT_SWIZZLE_IDENTITY,
             },
-            .view = {
-                .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-                .flags = 0,
-                .viewType = VK_IMAGE_VIEW_TYPE_2D,
-                .format = color_format,
-                .components = {
-                    .r = VK_COMPONENT_SWIZZLE_IDENTITY,
-                    .g = VK_COMPONENT_SWIZZLE_IDENTITY,
-                    .b = VK_COMPONENT_SWIZZLE_IDENTITY,
-                    .a = VK_COMPONENT_SWIZZLE_IDENTITY,
-                },
-                .subresourceRange = {
-                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                    .baseMipLevel = 0,
-                    .levelCount = 1,
-                    .baseArrayLayer = 0,
-                    .layerCount = 1,
-                },
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
             },
-            .mem_property_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        },
+        .mem_property_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+    };
+}
+
+static void create_streamed_images(Test *test, Graphics *gfx, Vulkan *vk, Platform *platform,
+                                   TextureLoadInfo *infos, u32 count, StreamedTexture **textures)
+{
+    push_frame(test->mem->temp);
+
+    auto decoded = allocate<DecodedTexture>(test->mem->temp, count);
+    auto timings = allocate<TextureLoadTiming>(test->mem->temp, count);
+    decode_textures(infos, count, decoded, timings, platform->thread_count, test->mem->temp);
+
+    for (u32 i = 0; i < count; ++i) {
+        textures[i] = create_streamed_texture(test->texture_streamer, vk, decoded[i].pixels, (u32)decoded[i].width,
+                                              (u32)decoded[i].height, infos[i].image_info, gfx->sampler.test);
+        stbi_image_free(decoded[i].pixels);
+    }
+
+    pop_frame(test->mem->temp);
+}
+
+static void create_images(Test *test, Graphics *gfx, Vulkan *vk, Platform *platform) {
+    ImageInfo color_info = default_texture_info(VK_FORMAT_R8G8B8A8_UNORM);
+
+    TextureLoadInfo infos[] = {
+        { "data/test.png", color_info },
+    };
+
+    if (use_texture_streaming) {
+        test->texture_streamer = create_texture_streamer(test->mem->fixed, vk, {
+            .memory_budget = megabyte(64),
+            .max_upload_size_per_frame = megabyte(4),
+            .max_textures = 256,
+            .retire_frame_count = vk->swapchain.image_count,
+            .initial_mip_size = 32,
         });
+
+        StreamedTexture *textures[CTK_ARRAY_SIZE(infos)] = {};
+        create_streamed_images(test, gfx, vk, platform, infos, CTK_ARRAY_SIZE(infos), textures);
+
+        test->streamed_texture.test = textures[0];
+        test->image.test = textures[0]->image_sampler.image;
+    }
+    else {
+        Image *images[CTK_ARRAY_SIZE(infos)] = {};
+        load_images(gfx, vk, platform, test->mem->temp, infos, CTK_ARRAY_SIZE(infos), images);
+
+        test->image.test = images[0];
     }
 }
 
@@ -255,13 +328,11 @@ static void create_image_samplers(Test *test, Graphics *gfx) {
 }
 
 static void bind_descriptor_data(Test *test, Graphics *gfx, Vulkan *vk) {
-    for (u32 i = 0; i < vk->swapchain.image_count; ++i) {
-        DescriptorBinding binding = {
-            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .image_sampler = &test->image_sampler.test,
-        };
+    if (gfx->bindless) {
+        test->bindless_texture_idx.test = add_bindless_texture(vk, gfx->bindless, &test->image_sampler.test);
 
-        update_descriptor_set(vk, gfx->descriptor_set.image_sampler->data[i], 1, &binding);
+        if (use_texture_streaming)
+            test->bindless_texture_idx.test_version = test->streamed_texture.test->version;
     }
 
     // for (u32 i = 0; i < vk->swapchain.image_count; ++i) {
@@ -281,6 +352,7 @@ static void create_entities(Test *test) {
         push(&test->entities, {
             .position = { x * Test::CUBE_MATRIX_SPREAD, -y * Test::CUBE_MATRIX_SPREAD, z * Test::CUBE_MATRIX_SPREAD },
             .rotation = { 0, 0, 0 },
+            .lod = 0,
         });
     }
 }
@@ -288,8 +360,9 @@ static void create_entities(Test *test) {
 static Test *create_test(Memory *mem, Graphics *gfx, Vulkan *vk, Platform *platform) {
     auto test = allocate<Test>(mem->fixed, 1);
     test->mem = mem;
-    create_meshes(test, gfx, vk);
-    create_images(test, gfx, vk);
+    create_meshes(test, gfx, vk, platform);
+    create_meshlet_draws(test, gfx, vk);
+    create_images(test, gfx, vk, platform);
     create_uniform_buffers(test, gfx, vk);
     create_image_samplers(test, gfx);
     bind_descriptor_data(test, gfx, vk);
@@ -310,9 +383,12 @@ static Test *create_test(Memory *mem, Graphics *gfx, Vulkan *vk, Platform *platf
         .max_x_angle = 89,
     };
 
-    test->input.last_mouse_position = get_mouse_position(platform);
+    if (platform->window)
+        test->input.last_mouse_position = get_mouse_position(platform);
+
     create_entities(test);
-    test->frame_benchmark = create_frame_benchmark(test->mem->fixed, 64);
+    test->thread_lod_stats = create_array_full<LODStats>(test->mem->fixed, platform->thread_count - 2);
+    test->thread_cull_ns = create_array_full<u64>(test->mem->fixed, platform->thread_count - 2);
 
     return test;
 }
@@ -412,39 +488,148 @@ static Matrix calculate_view_space_matrix(View *view) {
     return projection_matrix * view_matrix;
 }
 
+static Matrix calculate_model_matrix(Entity *entity) {
+    Matrix model_matrix = translate(MATRIX_ID, entity->position);
+    model_matrix = rotate(model_matrix, entity->rotation.x, Axis::X);
+    model_matrix = rotate(model_matrix, entity->rotation.y, Axis::Y);
+    model_matrix = rotate(model_matrix, entity->rotation.z, Axis::Z);
+    return model_matrix;
+}
+
 struct UpdateMVPMatrixesState {
     Test *test;
     Matrix view_space_matrix;
 };
 
 static void update_mvp_matrixes(void *data) {
+    PROFILE_FUNCTION();
+    u64 start = get_time_ns();
     auto state = (UpdateMVPMatrixesState *)data;
     Test *test = state->test;
     Matrix view_space_matrix = state->view_space_matrix;
+    Matrix dequantization_matrix = get_position_dequantization_matrix(&test->mesh.cube);
+    f32 nearest_distance_sq = FLT_MAX;
 
     for (u32 i = 0; i < test->entities.count; ++i) {
         Entity *entity = test->entities.data + i;
 
-        Matrix model_matrix = translate(MATRIX_ID, entity->position);
-        model_matrix = rotate(model_matrix, entity->rotation.x, Axis::X);
-        model_matrix = rotate(model_matrix, entity->rotation.y, Axis::Y);
-        model_matrix = rotate(model_matrix, entity->rotation.z, Axis::Z);
+        Vec3<f32> to_entity = entity->position - test->view.position;
+        f32 distance_sq = to_entity.x * to_entity.x + to_entity.y * to_entity.y + to_entity.z * to_entity.z;
+        if (distance_sq < nearest_distance_sq)
+            nearest_distance_sq = distance_sq;
 
-        test->mvp_matrixes.data[i] = view_space_matrix * model_matrix;
+        test->mvp_matrixes.data[i] = view_space_matrix * calculate_model_matrix(entity) * dequantization_matrix;
     }
+
+    test->nearest_entity_distance = sqrtf(nearest_distance_sq);
+    test->stage_ms.transforms = elapsed_ms(start);
 }
 
 struct RecordRenderCmdsState {
     Test *test;
     Graphics *gfx;
+    Vulkan *vk;
     Range *thread_ranges;
+    Matrix view_space_matrix;
+    f32 lod_screen_scale; // See calculate_lod_screen_scale().
 };
 
+// Pushes an entity's MVP matrix and draws its mesh LOD. LOD 0 of meshes with meshlets is culled on the calling
+// render thread and drawn from the indirect buffer, adding the time spent culling to cull_ns; returns the number of
+// triangles drawn.
+static u32 draw_mesh_lod(RecordRenderCmdsState *state, VkCommandBuffer cmd_buf, VkPipelineLayout layout, Mesh *mesh,
+                         u32 lod, u32 entity_index, u64 *cull_ns)
+{
+    Test *test = state->test;
+
+    if (lod > 0 || entity_index >= test->meshlet_draws.entity_count) {
+        Matrix *mvp_matrix = &test->mvp_matrixes.data[entity_index];
+        vkCmdPushConstants(cmd_buf, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, 64, mvp_matrix);
+        vkCmdDrawIndexed(cmd_buf, mesh->lods[lod].index_count, 1, mesh->lods[lod].first_index, 0, 0);
+        count_render_stat(RenderCounter::PUSH_CONSTANT_BYTES, 64);
+        count_render_stat(RenderCounter::DRAW_CALLS);
+        count_render_stat(RenderCounter::INSTANCES);
+        count_render_stat(RenderCounter::TRIANGLES, mesh->lods[lod].index_count / 3);
+        return mesh->lods[lod].index_count / 3;
+    }
+
+    // Culling needs this frame's matrixes, so the MVP is calculated here rather than read from test->mvp_matrixes.
+    u64 cull_start = get_time_ns();
+    Matrix model_matrix = calculate_model_matrix(test->entities.data + entity_index);
+    Matrix model_view_projection = state->view_space_matrix * model_matrix;
+    MeshletCullView cull_view = create_meshlet_cull_view(model_view_projection);
+    u32 first_draw = state->gfx->sync.swap_img_idx * test->meshlet_draws.frame_stride +
+                     entity_index * mesh->meshlet_count;
+    MeshletDrawCommand *draws = test->meshlet_draws.commands + first_draw;
+    u32 draw_count = cull_meshlets(mesh->meshlet_cull_data, &cull_view, draws);
+    *cull_ns += get_time_ns() - cull_start;
+    if (draw_count == 0)
+        return 0;
+
+    Matrix mvp_matrix = model_view_projection * get_position_dequantization_matrix(mesh);
+    vkCmdPushConstants(cmd_buf, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, 64, &mvp_matrix);
+    count_render_stat(RenderCounter::PUSH_CONSTANT_BYTES, 64);
+
+    // Culled draw commands are written straight into host-visible memory the GPU reads them from.
+    count_render_stat(RenderCounter::UPLOADED_BYTES, draw_count * sizeof(MeshletDrawCommand));
+
+    Region *draw_region = test->meshlet_draws.region;
+    VkDeviceSize offset = draw_region->offset + first_draw * sizeof(MeshletDrawCommand);
+    if (state->vk->multi_draw_indirect_enabled) {
+        vkCmdDrawIndexedIndirect(cmd_buf, draw_region->buffer->handle, offset, draw_count,
+                                 sizeof(MeshletDrawCommand));
+        count_render_stat(RenderCounter::DRAW_CALLS);
+    }
+    else {
+        for (u32 draw = 0; draw < draw_count; ++draw) {
+            vkCmdDrawIndexedIndirect(cmd_buf, draw_region->buffer->handle,
+                                     offset + draw * sizeof(MeshletDrawCommand), 1, sizeof(MeshletDrawCommand));
+        }
+        count_render_stat(RenderCounter::DRAW_CALLS, draw_count);
+    }
+
+    u32 triangle_count = 0;
+    for (u32 draw = 0; draw < draw_count; ++draw)
+        triangle_count += draws[draw].index_count / 3;
+
+    // Culling emits one instance per visible meshlet.
+    count_render_stat(RenderCounter::INSTANCES, draw_count);
+    count_render_stat(RenderCounter::TRIANGLES, triangle_count);
+    return triangle_count;
+}
+
+// Selects each entity's LOD from its projected error and draws it, recording per-LOD counts in lod_stats.
+static void draw_entities(RecordRenderCmdsState *state, VkCommandBuffer cmd_buf, VkPipelineLayout layout, Range range,
+                          LODStats *lod_stats, u64 *cull_ns)
+{
+    Test *test = state->test;
+    Mesh *mesh = &test->mesh.cube;
+
+    for (u32 i = range.start; i < range.start + range.size; ++i) {
+        Entity *entity = test->entities.data + i;
+        Vec3<f32> to_entity = entity->position - test->view.position;
+        f32 distance = sqrtf(to_entity.x * to_entity.x + to_entity.y * to_entity.y + to_entity.z * to_entity.z);
+        entity->lod = select_mesh_lod(mesh, entity->lod, distance, state->lod_screen_scale,
+                                      Test::LOD_MAX_ERROR_PIXELS, Test::LOD_HYSTERESIS);
+
+        u32 triangle_count = draw_mesh_lod(state, cmd_buf, layout, mesh, entity->lod, i, cull_ns);
+        if (triangle_count > 0) {
+            ++lod_stats->entity_counts[entity->lod];
+            lod_stats->triangle_counts[entity->lod] += triangle_count;
+        }
+    }
+}
+
 static void record_render_cmds(RecordRenderCmdsState state, u32 thread_index) {
+    PROFILE_FUNCTION();
     Test *test = state.test;
     Graphics *gfx = state.gfx;
     Range range = state.thread_ranges[thread_index];
     VkCommandBuffer cmd_buf = gfx->render_cmd_bufs->data[gfx->sync.swap_img_idx]->data[thread_index];
+    LODStats *lod_stats = test->thread_lod_stats->data + thread_index;
+    *lod_stats = {};
+    u64 *cull_ns = test->thread_cull_ns->data + thread_index;
+    *cull_ns = 0;
 
     VkCommandBufferInheritanceInfo cmd_buf_inheritance_info = {};
     cmd_buf_inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
@@ -453,7 +638,7 @@ static void record_render_cmds(RecordRenderCmdsState state, u32 thread_index) {
     cmd_buf_inheritance_info.framebuffer = gfx->framebuffers->data[gfx->sync.swap_img_idx];
     cmd_buf_inheritance_info.occlusionQueryEnable = VK_FALSE;
     cmd_buf_inheritance_info.queryFlags = 0;
-    cmd_buf_inheritance_info.pipelineStatistics = 0;
+    cmd_buf_inheritance_info.pipelineStatistics = gpu_query_statistics_flags(gfx->gpu_queries);
 
     VkCommandBufferBeginInfo cmd_buf_begin_info = {};
     cmd_buf_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -462,38 +647,72 @@ static void record_render_cmds(RecordRenderCmdsState state, u32 thread_index) {
     cmd_buf_begin_info.pInheritanceInfo = &cmd_buf_inheritance_info;
     validate_result(vkBeginCommandBuffer(cmd_buf, &cmd_buf_begin_info),
                     "failed to begin recording command buffer");
-
-    vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, gfx->pipeline.test->handle);
-
-    // Bind descriptor sets.
-    VkDescriptorSet *ds = &gfx->descriptor_set.image_sampler->data[gfx->sync.swap_img_idx];
-    vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, gfx->pipeline.test->layout,
-                            0, 1, &gfx->descriptor_set.image_sampler->data[gfx->sync.swap_img_idx],
-                            0, NULL);
+    count_render_stat(RenderCounter::SECONDARY_CMD_BUFS);
 
     // Bind mesh data.
-    Mesh *mesh = &test->mesh.quad;
+    Mesh *mesh = &test->mesh.cube;
     vkCmdBindVertexBuffers(cmd_buf, 0, 1, &mesh->vertex_region->buffer->handle, &mesh->vertex_region->offset);
     vkCmdBindIndexBuffer(cmd_buf, mesh->index_region->buffer->handle, mesh->index_region->offset, VK_INDEX_TYPE_UINT32);
+    count_render_stat(RenderCounter::VERTEX_BUFFER_BINDS);
+    count_render_stat(RenderCounter::INDEX_BUFFER_BINDS);
 
-    for (u32 i = range.start; i < range.start + range.size; ++i) {
-        vkCmdPushConstants(cmd_buf, gfx->pipeline.test->layout, VK_SHADER_STAGE_VERTEX_BIT,
-                           0, 64, &test->mvp_matrixes.data[i]);
-        vkCmdDrawIndexed(cmd_buf, mesh->indexes->count, 1, 0, 0, 0);
+    if (use_bindless && gfx->bindless) {
+        Pipeline *pipeline = get_pipeline(gfx->pipeline_registry, gfx->pipeline.bindless[(u32)mesh->vertex_format]);
+        vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->handle);
+        count_render_stat(RenderCounter::PIPELINE_BINDS);
+        bind_bindless(cmd_buf, gfx->bindless, pipeline->layout, 0);
+
+        // All entities share the test texture, so its index only needs to be pushed once.
+        vkCmdPushConstants(cmd_buf, pipeline->layout, VK_SHADER_STAGE_VERTEX_BIT,
+                           64, sizeof(u32), &test->bindless_texture_idx.test);
+        count_render_stat(RenderCounter::PUSH_CONSTANT_BYTES, sizeof(u32));
+
+        draw_entities(&state, cmd_buf, pipeline->layout, range, lod_stats, cull_ns);
+    }
+    else {
+        Pipeline *pipeline = get_pipeline(gfx->pipeline_registry, gfx->pipeline.test[(u32)mesh->vertex_format]);
+        vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->handle);
+        count_render_stat(RenderCounter::PIPELINE_BINDS);
+
+        // Bind descriptor sets.
+        vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->layout,
+                                0, 1, &gfx->descriptor_set.image_sampler,
+                                0, NULL);
+        count_render_stat(RenderCounter::DESCRIPTOR_SET_BINDS);
+
+        draw_entities(&state, cmd_buf, pipeline->layout, range, lod_stats, cull_ns);
     }
 
     vkEndCommandBuffer(cmd_buf);
 }
 
-static void record_render_cmd_bufs(Test *test, Graphics *gfx, Vulkan *vk, u32 render_thread_count) {
+static void record_render_cmd_bufs(Test *test, Graphics *gfx, Vulkan *vk, u32 render_thread_count,
+                                   Matrix view_space_matrix)
+{
     push_frame(test->mem->temp);
 
     auto thread_ranges = create_array<Range>(render_thread_count);
     partition_data(test->entities.count, thread_ranges->size, thread_ranges->data);
 
-    RecordRenderCmdsState state = { test, gfx, thread_ranges->data };
+    f32 lod_screen_scale = calculate_lod_screen_scale(test->view.perspective_info.vertical_fov,
+                                                      vk->swapchain.extent.height);
+    RecordRenderCmdsState state = { test, gfx, vk, thread_ranges->data, view_space_matrix, lod_screen_scale };
     run_parallel(state, record_render_cmds, render_thread_count, test->mem->temp);
 
+    test->lod_stats = {};
+    u64 cull_ns = 0;
+    for (u32 thread_index = 0; thread_index < render_thread_count; ++thread_index) {
+        cull_ns += test->thread_cull_ns->data[thread_index];
+
+        LODStats *thread_stats = test->thread_lod_stats->data + thread_index;
+        for (u32 lod = 0; lod < MESH_MAX_LODS; ++lod) {
+            test->lod_stats.entity_counts[lod] += thread_stats->entity_counts[lod];
+            test->lod_stats.triangle_counts[lod] += thread_stats->triangle_counts[lod];
+        }
+    }
+
+    test->stage_ms.culling = ns_to_ms(cull_ns);
+
     pop_frame(test->mem->temp);
 }
 
@@ -502,9 +721,12 @@ struct RecordRenderPassState {
     Graphics *gfx;
     Vulkan *vk;
     u32 render_thread_count;
+    Matrix view_space_matrix;
 };
 
 static void record_render_pass(void *data) {
+    PROFILE_FUNCTION();
+    u64 start = get_time_ns();
     auto state = (RecordRenderPassState *)data;
     Test *test = state->test;
     Graphics *gfx = state->gfx;
@@ -519,6 +741,7 @@ static void record_render_pass(void *data) {
     cmd_buf_begin_info.pInheritanceInfo = NULL;
     validate_result(vkBeginCommandBuffer(cmd_buf, &cmd_buf_begin_info),
                     "failed to begin recording command buffer");
+    begin_gpu_query_frame(vk, gfx->gpu_queries, cmd_buf);
 
     VkRenderPassBeginInfo rp_begin_info = {};
     rp_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -530,26 +753,79 @@ static void record_render_pass(void *data) {
         .offset = { 0, 0 },
         .extent = vk->swapchain.extent,
     };
+    begin_gpu_scope(gfx->gpu_queries, cmd_buf, "main render pass", true);
     vkCmdBeginRenderPass(cmd_buf, &rp_begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-    record_render_cmd_bufs(test, gfx, vk, render_thread_count);
+    record_render_cmd_bufs(test, gfx, vk, render_thread_count, state->view_space_matrix);
     Array<VkCommandBuffer> *render_cmd_bufs = gfx->render_cmd_bufs->data[gfx->sync.swap_img_idx];
     vkCmdExecuteCommands(cmd_buf, render_thread_count, render_cmd_bufs->data);
 
     vkCmdEndRenderPass(cmd_buf);
+    end_gpu_scope(gfx->gpu_queries, cmd_buf);
 
+    end_gpu_query_frame(gfx->gpu_queries, cmd_buf);
     vkEndCommandBuffer(cmd_buf);
+    test->stage_ms.recording = elapsed_ms(start);
+}
+
+static void stream_textures(Test *test, Graphics *gfx, Vulkan *vk) {
+    PROFILE_FUNCTION();
+    // Request texture detail for the nearest cube (2 units wide) based on last frame's entity distances.
+    static constexpr f32 CUBE_SIZE = 2.0f;
+    f32 distance = test->nearest_entity_distance > 0.1f ? test->nearest_entity_distance : 0.1f;
+    f32 half_fov = test->view.perspective_info.vertical_fov * 0.5f * (3.14159265f / 180.0f);
+    f32 view_height = 2.0f * distance * tanf(half_fov);
+    f32 screen_size = CUBE_SIZE / view_height * vk->swapchain.extent.height;
+
+    request_texture_size(test->texture_streamer, test->streamed_texture.test, screen_size);
+    update_texture_streaming(test->texture_streamer, vk);
+
+    // Bindless set is shared by all frames, and the previous frame has finished with it by now.
+    if (gfx->bindless && test->bindless_texture_idx.test_version != test->streamed_texture.test->version) {
+        update_bindless_texture(vk, gfx->bindless, test->bindless_texture_idx.test, &test->image_sampler.test);
+        test->bindless_texture_idx.test_version = test->streamed_texture.test->version;
+    }
+}
+
+static void write_frame_descriptor_sets(Test *test, Graphics *gfx) {
+    // Streaming recreates the test texture's image, so the set is written from its current image sampler each frame.
+    DescriptorBinding binding = {
+        .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .image_sampler = use_texture_streaming ? &test->streamed_texture.test->image_sampler
+                                               : &test->image_sampler.test,
+    };
+
+    DescriptorTemplateData data = {};
+    pack_descriptor_template_data(&binding, 1, &data);
+    gfx->descriptor_set.image_sampler = get_transient_descriptor_set(gfx->descriptor_allocator,
+                                                                     gfx->descriptor_set_layout.image_sampler,
+                                                                     &gfx->descriptor_update_template.image_sampler,
+                                                                     &data);
+}
+
+static void print_lod_stats(Test *test) {
+    Mesh *mesh = &test->mesh.cube;
+    for (u32 lod = 0; lod < mesh->lod_count; ++lod) {
+        print_line("LOD %u: %u entities, %u triangles", lod, test->lod_stats.entity_counts[lod],
+                   test->lod_stats.triangle_counts[lod]);
+    }
 }
 
 static UpdateMVPMatrixesState update_mvp_matrixes_state;
 static RecordRenderPassState record_render_pass_state;
 
 static void update(Test *test, Graphics *gfx, Vulkan *vk, Platform *platform) {
+    PROFILE_FUNCTION();
+    if (use_texture_streaming)
+        stream_textures(test, gfx, vk);
+
+    write_frame_descriptor_sets(test, gfx);
+
     // Update uniform buffer data.
     Matrix view_space_matrix = calculate_view_space_matrix(&test->view);
 
     update_mvp_matrixes_state = { test, view_space_matrix };
-    record_render_pass_state = { test, gfx, vk, platform->thread_count - 2 };
+    record_render_pass_state = { test, gfx, vk, platform->thread_count - 2, view_space_matrix };
 
     TaskState task_states[] = {
         { &update_mvp_matrixes_state, update_mvp_matrixes },
@@ -572,7 +848,113 @@ static void update(Test *test, Graphics *gfx, Vulkan *vk, Platform *platform) {
 ////////////////////////////////////////////////////////////
 /// Main
 ////////////////////////////////////////////////////////////
-s32 main() {
+// "--headless [frame_count]" renders offscreen for a fixed number of frames without a window.
+static u32 parse_headless_frame_count(s32 argc, char **argv) {
+    static constexpr u32 DEFAULT_HEADLESS_FRAME_COUNT = 1000;
+
+    for (s32 i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--headless") != 0)
+            continue;
+
+        u32 frame_count = i + 1 < argc ? (u32)strtoul(argv[i + 1], NULL, 10) : 0;
+        return frame_count > 0 ? frame_count : DEFAULT_HEADLESS_FRAME_COUNT;
+    }
+
+    return 0;
+}
+
+// "--readback <none|raw|ppm|png|pipe> [path]" reads headless frames back; path is a printf format given the frame index
+// for file outputs, or the command to write frames to for pipe.
+static bool parse_readback_output(s32 argc, char **argv, ReadbackOutput *output, cstr *path) {
+    static constexpr struct { cstr name; ReadbackOutput output; } OUTPUTS[] = {
+        { "none", ReadbackOutput::NONE },
+        { "raw",  ReadbackOutput::RAW  },
+        { "ppm",  ReadbackOutput::PPM  },
+        { "png",  ReadbackOutput::PNG  },
+        { "pipe", ReadbackOutput::PIPE },
+    };
+
+    for (s32 i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--readback") != 0)
+            continue;
+
+        for (u32 output_idx = 0; output_idx < CTK_ARRAY_SIZE(OUTPUTS); ++output_idx) {
+            if (strcmp(argv[i + 1], OUTPUTS[output_idx].name) == 0) {
+                *output = OUTPUTS[output_idx].output;
+                *path = i + 2 < argc ? argv[i + 2] : NULL;
+                return true;
+            }
+        }
+
+        CTK_FATAL("unknown readback output \"%s\"", argv[i + 1]);
+    }
+
+    return false;
+}
+
+// Returns the argument following name, or NULL if name isn't given.
+static cstr find_arg_value(s32 argc, char **argv, cstr name) {
+    for (s32 i = 1; i + 1 < argc; ++i)
+        if (strcmp(argv[i], name) == 0)
+            return argv[i + 1];
+
+    return NULL;
+}
+
+// Flies from the default view over the cube grid, through its center and out the far corner, looking back.
+static CameraPath create_fly_through_camera_path(Allocator *allocator) {
+    static constexpr f32 EXTENT = Test::CUBE_MATRIX_SIZE * Test::CUBE_MATRIX_SPREAD;
+    static constexpr CameraKeyframe KEYFRAMES[] = {
+        { { -0.125f * EXTENT, -1.125f * EXTENT, -0.125f * EXTENT }, { 45, -45,  0 } },
+        { {  0.25f  * EXTENT, -0.75f  * EXTENT,  0.25f  * EXTENT }, { 30, -45,  0 } },
+        { {  0.5f   * EXTENT, -0.5f   * EXTENT,  0.5f   * EXTENT }, { 0,  -45,  0 } },
+        { {  0.75f  * EXTENT, -0.5f   * EXTENT,  0.9f   * EXTENT }, { 0,  -90,  0 } },
+        { {  1.125f * EXTENT, -0.25f  * EXTENT,  1.125f * EXTENT }, { -20, -225, 0 } },
+    };
+
+    CameraPath path = {};
+    path.keyframe_count = CTK_ARRAY_SIZE(KEYFRAMES);
+    path.keyframes = allocate<CameraKeyframe>(allocator, path.keyframe_count);
+    memcpy(path.keyframes, KEYFRAMES, sizeof(KEYFRAMES));
+    return path;
+}
+
+static BenchmarkStages add_benchmark_stages(BenchmarkRunner *runner) {
+    return {
+        .cpu_frame = add_benchmark_stage(runner, "cpu_frame"),
+        .gpu_frame = add_benchmark_stage(runner, "gpu_frame"),
+        .next_frame = add_benchmark_stage(runner, "next_frame"),
+        .transforms = add_benchmark_stage(runner, "transforms"),
+        .culling = add_benchmark_stage(runner, "culling"),
+        .recording = add_benchmark_stage(runner, "recording"),
+        .submit = add_benchmark_stage(runner, "submit"),
+    };
+}
+
+// GPU results are read frame_latency frames after recording, so this records every frame still held by the queries;
+// frames recorded on an earlier call are simply written again.
+static void record_gpu_benchmark_samples(BenchmarkRunner *runner, u32 stage, GPUQueries *queries) {
+    u64 held_frame_count = queries->info.frame_latency + 1;
+    u64 first_frame = queries->frame_count > held_frame_count ? queries->frame_count - held_frame_count : 0;
+    for (u64 frame_index = first_frame; frame_index < queries->frame_count; ++frame_index) {
+        GPUQueryFrame *frame = get_gpu_query_frame(queries, frame_index);
+        if (frame != NULL)
+            record_benchmark_sample(runner, stage, (u32)frame_index, frame->scopes[0].ms);
+    }
+}
+
+static void write_benchmark_results(BenchmarkRunner *runner, cstr output_prefix) {
+    char path[256] = {};
+    snprintf(path, sizeof(path), "%s.json", output_prefix);
+    if (write_benchmark_json(runner, path))
+        print_line("wrote %s", path);
+
+    snprintf(path, sizeof(path), "%s.csv", output_prefix);
+    if (write_benchmark_csv(runner, path))
+        print_line("wrote %s", path);
+}
+
+s32 main(s32 argc, char **argv) {
     // Initialize Memory
     Allocator *fixed_mem = create_stack_allocator(gigabyte(1));
     auto mem = allocate<Memory>(fixed_mem, 1);
@@ -584,82 +966,235 @@ s32 main() {
 
     // Create Modules
     static constexpr u32 WIN_WIDTH = 1600;
-    Platform *platform = create_platform(mem->platform, {
-        .surface = {
-            .x = 0,
-            .y = 100,
-            .width = WIN_WIDTH,
-            .height = 900,
-        },
-        .title = L"Renderer",
-    });
+    static constexpr u32 WIN_HEIGHT = 900;
+    u32 headless_frame_count = parse_headless_frame_count(argc, argv);
+
+    // "--benchmark <output prefix> [--camera-path <path.json>]" replays a camera path headless and writes results to
+    // <output prefix>.json and .csv. Measures --headless frames (or the default count) after a fixed warmup.
+    static constexpr u32 BENCHMARK_WARMUP_FRAME_COUNT = 60;
+    static constexpr u32 DEFAULT_BENCHMARK_FRAME_COUNT = 1000;
+    cstr benchmark_output = find_arg_value(argc, argv, "--benchmark");
+    BenchmarkRunner *benchmark = NULL;
+    if (benchmark_output) {
+        benchmark = create_benchmark_runner(mem->fixed, {
+            .name = benchmark_output,
+            .warmup_frame_count = BENCHMARK_WARMUP_FRAME_COUNT,
+            .frame_count = headless_frame_count > 0 ? headless_frame_count : DEFAULT_BENCHMARK_FRAME_COUNT,
+            .max_stages = 8,
+        });
+        headless_frame_count = benchmark->info.warmup_frame_count + benchmark->info.frame_count;
+    }
+
+    bool headless = headless_frame_count > 0;
+
+    // "--profile <trace.json>" records profiler zones from every thread and writes them as a Chrome trace on exit.
+    cstr profile_output = find_arg_value(argc, argv, "--profile");
+    if (profile_output) {
+        if (profiler_enabled()) {
+            init_profiler(mem->fixed, {
+                .max_threads = 32,
+                .events_per_thread = 32768,
+            });
+            set_profiler_thread_name("main");
+        }
+        else {
+            warning("--profile ignored; build with RENDERER_PROFILER defined to enable the profiler");
+            profile_output = NULL;
+        }
+    }
 
-    SetWindowPos(platform->window->handle, HWND_TOP,
-                 GetSystemMetrics(SM_CXSCREEN) - WIN_WIDTH - 10, 100, 0, 0, SWP_NOSIZE);
+    Platform *platform = NULL;
+    if (headless) {
+        platform = create_headless_platform(mem->platform);
+    }
+    else {
+#ifdef _WIN32
+        platform = create_platform(mem->platform, {
+            .surface = {
+                .x = 0,
+                .y = 100,
+                .width = WIN_WIDTH,
+                .height = WIN_HEIGHT,
+            },
+            .title = L"Renderer",
+        });
 
+        SetWindowPos(platform->window->handle, HWND_TOP,
+                     GetSystemMetrics(SM_CXSCREEN) - WIN_WIDTH - 10, 100, 0, 0, SWP_NOSIZE);
+#else
+        CTK_FATAL("windowed mode is only supported on win32; run with --headless");
+#endif
+    }
+
+    u64 startup_start = get_time_ns();
     Vulkan *vk = create_vulkan(mem->vulkan, platform, {
-        .max_buffers = 2,
+        .max_buffers = 4, // Includes frame readback buffer.
         .max_regions = 32,
-        .max_images = 16,
+        .max_images = 20, // Includes headless color images.
         .max_render_passes = 2,
         .max_shaders = 16,
         .max_pipelines = 8,
         .enable_validation = false,
+        .enable_descriptor_indexing = true,
+        .pipeline_cache_path = "data/pipeline.cache",
+        .headless = {
+            .enabled = headless,
+            .extent = { WIN_WIDTH, WIN_HEIGHT },
+            .image_count = 3,
+        },
     });
 
-    Graphics *gfx = create_graphics(mem->graphics, vk, platform->thread_count - 2);
+    Graphics *gfx = create_graphics(mem->graphics, vk, platform->thread_count, platform->thread_count - 2);
     Test *test = create_test(mem, gfx, vk, platform);
 
+    // Pipelines precompile while create_test() loads assets.
+    finish_pipeline_precompile(gfx->pipeline_registry);
+    print_line("startup (%s pipeline cache, %u bytes): %.2fms", vk->pipeline_cache.warm ? "warm" : "cold",
+               vk->pipeline_cache.loaded_size, elapsed_ms(startup_start));
+    print_pipeline_registry_stats(gfx->pipeline_registry);
+    if (!headless)
+        start_shader_hot_reload(gfx, vk);
+
+    BenchmarkStages benchmark_stages = {};
+    CameraPath camera_path = {};
+    if (benchmark) {
+        benchmark_stages = add_benchmark_stages(benchmark);
+        cstr camera_path_file = find_arg_value(argc, argv, "--camera-path");
+        camera_path = camera_path_file ? load_camera_path(mem->fixed, camera_path_file)
+                                       : create_fly_through_camera_path(mem->fixed);
+    }
+
+    FrameReadback *readback = NULL;
+    ReadbackOutput readback_output = ReadbackOutput::NONE;
+    cstr readback_path = NULL;
+    if (parse_readback_output(argc, argv, &readback_output, &readback_path)) {
+        if (!headless)
+            CTK_FATAL("frame readback requires --headless");
+
+        readback = create_frame_readback(mem->fixed, vk, vk->swapchain.extent, vk->swapchain.image_format, {
+            .slot_count = 3,
+            .output = readback_output,
+            .path = readback_path,
+        });
+    }
+
+    // Logs per-frame render counters averaged over each second; benchmarks skip it so printing can't skew results.
+    init_render_stats(mem->fixed, {
+        .max_threads = 32,
+        .log_interval_ms = benchmark ? 0u : 1000u,
+    });
+
+    // "--fps-limit <fps>" paces frames to at most the given rate; the frame timer's history covers about 4 seconds.
+    cstr fps_limit = find_arg_value(argc, argv, "--fps-limit");
+    FrameTimer *frame_timer = create_frame_timer(mem->fixed, {
+        .history_size = 240,
+        .smoothing = 0.1,
+        .max_fps = fps_limit ? atof(fps_limit) : 0.0,
+    });
+
     // Main Loop
-    clock_t start = clock();
-    u32 frames = 0;
+    u32 headless_frames_rendered = 0;
     while (1) {
-start_benchmark(test->frame_benchmark, "frame");
-        process_events(platform->window);
+        PROFILE_ZONE("frame");
+        tick_frame_timer(frame_timer);
+        u64 frame_start = get_time_ns();
+        u64 stage_start = 0;
+
+        if (headless) {
+            // Headless runs have no input; they end after a fixed number of frames.
+            if (headless_frames_rendered++ == headless_frame_count)
+                break;
+        }
+        else {
+            process_events(platform->window);
+
+            // Quit event closed the window.
+            if (!platform->window->open)
+                break;
 
-        // Quit event closed the window.
-        if (!platform->window->open)
-            break;
+            // If window is open but not active (focused), skip frame processing.
+            if (!window_is_active(platform->window))
+                goto loop_end;
 
-        // If window is open but not active (focused), skip frame processing.
-        if (!window_is_active(platform->window))
-            goto loop_end;
+            handle_input(test, platform, vk);
 
-        handle_input(test, platform, vk);
+            // Input closed the window.
+            if (!platform->window->open)
+                break;
+        }
 
-        // Input closed the window.
-        if (!platform->window->open)
-            break;
+        // Benchmarks replay the camera path by frame index instead of taking input.
+        if (benchmark) {
+            CameraKeyframe pose = sample_camera_path(&camera_path, get_benchmark_progress(benchmark));
+            test->view.position = pose.position;
+            test->view.rotation = pose.rotation;
+        }
 
         // Update
-start_benchmark(test->frame_benchmark, "next_frame()");
+        stage_start = get_time_ns();
         next_frame(gfx, vk);
-end_benchmark(test->frame_benchmark);
 
-start_benchmark(test->frame_benchmark, "update()");
+        if (benchmark)
+            record_benchmark_sample(benchmark, benchmark_stages.next_frame, benchmark->frame, elapsed_ms(stage_start));
+
         update(test, gfx, vk, platform);
-end_benchmark(test->frame_benchmark);
 
+        if (benchmark)
+            record_gpu_benchmark_samples(benchmark, benchmark_stages.gpu_frame, gfx->gpu_queries);
+
+        stage_start = get_time_ns();
         submit_render_cmds(gfx, vk);
 
-loop_end:
-        // Update FPS display.
-        clock_t end = clock();
-        f64 frame_ms = clocks_to_ms(start, end);
-        if (frame_ms >= 1000.0) {
-            char buf[128] = {};
-            sprintf(buf, "%.2f FPS", (f64)frames * (frame_ms / 1000.0));
-            set_window_title(platform->window, buf);
-            start = end;
-            frames = 0;
+        if (benchmark) {
+            u32 frame = benchmark->frame;
+            record_benchmark_sample(benchmark, benchmark_stages.submit, frame, elapsed_ms(stage_start));
+            record_benchmark_sample(benchmark, benchmark_stages.transforms, frame, test->stage_ms.transforms);
+            record_benchmark_sample(benchmark, benchmark_stages.culling, frame, test->stage_ms.culling);
+            record_benchmark_sample(benchmark, benchmark_stages.recording, frame, test->stage_ms.recording);
+            record_benchmark_sample(benchmark, benchmark_stages.cpu_frame, frame, elapsed_ms(frame_start));
+            next_benchmark_frame(benchmark);
         }
-        else {
-            ++frames;
+
+        if (readback) {
+            queue_frame_readback(readback, gfx->framebuffer_image.color->data[gfx->sync.swap_img_idx],
+                                 headless_frames_rendered - 1);
         }
-end_benchmark(test->frame_benchmark);
-print_frame_benchmark(test->frame_benchmark);
-reset_frame_benchmark(test->frame_benchmark);
+
+loop_end:
+        // Render tasks have been joined, so every thread's counts for this frame are in.
+        if (end_render_stats_frame()) {
+            print_frame_time_stats(frame_timer);
+            print_lod_stats(test);
+        }
+    }
+
+    if (readback) {
+        destroy_frame_readback(readback);
+        print_frame_readback_stats(readback);
     }
 
+    // Frames still in flight must finish before headless runs exit.
+    vkDeviceWaitIdle(vk->device);
+
+    // Last frames' GPU results are only read once the device is idle.
+    flush_gpu_queries(vk, gfx->gpu_queries);
+
+    if (benchmark) {
+        record_gpu_benchmark_samples(benchmark, benchmark_stages.gpu_frame, gfx->gpu_queries);
+        print_benchmark_results(benchmark);
+        write_benchmark_results(benchmark, benchmark_output);
+    }
+
+    if (profile_output)
+        write_profiler_trace(profile_output);
+
+    if (gfx->shader_reloader)
+        stop_shader_reload(gfx->shader_reloader);
+
+    if (use_texture_streaming)
+        destroy_texture_streamer(test->texture_streamer, vk);
+
+    save_pipeline_cache(vk);
+
     return 0;
 }
@@ -0,0 +1,424 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "renderer/meshlet.h"
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+#include "ctk/math.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+struct TestMesh {
+    Vertex *vertexes;
+    u32 vertex_count;
+    u32 *indexes;
+    u32 index_count;
+};
+
+struct MeshletBuild {
+    u32 *indexes; // Reordered by build_meshlets().
+    Meshlet *meshlets;
+    u32 meshlet_count;
+};
+
+struct Triangle {
+    u32 indexes[3];
+};
+
+static u32 failure_count;
+
+////////////////////////////////////////////////////////////
+/// Internal
+////////////////////////////////////////////////////////////
+#define EXPECT(CONDITION, ...) \
+    do { \
+        if (!(CONDITION)) { \
+            print_line("FAILED %s:%u: %s", __FILE__, __LINE__, #CONDITION); \
+            print_line(__VA_ARGS__); \
+            ++failure_count; \
+        } \
+    } while (0)
+
+// Grid of quads in the z = 0 plane spanning [-1, 1], with clockwise front faces (normals toward +z).
+static TestMesh create_grid_mesh(Allocator *allocator, u32 quads_per_side) {
+    u32 side = quads_per_side + 1;
+    TestMesh mesh = {};
+    mesh.vertex_count = side * side;
+    mesh.index_count = quads_per_side * quads_per_side * 6;
+    mesh.vertexes = allocate<Vertex>(allocator, mesh.vertex_count);
+    mesh.indexes = allocate<u32>(allocator, mesh.index_count);
+
+    for (u32 y = 0; y < side; ++y) {
+        for (u32 x = 0; x < side; ++x) {
+            Vertex *vertex = mesh.vertexes + y * side + x;
+            *vertex = {};
+            vertex->position = { -1.0f + 2.0f * x / quads_per_side, -1.0f + 2.0f * y / quads_per_side, 0.0f };
+            vertex->uv = { (f32)x / quads_per_side, (f32)y / quads_per_side };
+            vertex->normal = { 0.0f, 0.0f, 1.0f };
+        }
+    }
+
+    u32 *index = mesh.indexes;
+    for (u32 y = 0; y < quads_per_side; ++y) {
+        for (u32 x = 0; x < quads_per_side; ++x) {
+            u32 v0 = y * side + x;
+            u32 v1 = v0 + 1;
+            u32 v2 = v0 + side;
+            u32 v3 = v2 + 1;
+            *index++ = v0; *index++ = v2; *index++ = v1;
+            *index++ = v1; *index++ = v2; *index++ = v3;
+        }
+    }
+
+    return mesh;
+}
+
+// UV sphere; every meshlet curves, so cones and spheres differ from the grid's degenerate planar case.
+static TestMesh create_sphere_mesh(Allocator *allocator, u32 rings, u32 segments) {
+    TestMesh mesh = {};
+    mesh.vertex_count = (rings + 1) * (segments + 1);
+    mesh.index_count = rings * segments * 6;
+    mesh.vertexes = allocate<Vertex>(allocator, mesh.vertex_count);
+    mesh.indexes = allocate<u32>(allocator, mesh.index_count);
+
+    for (u32 ring = 0; ring <= rings; ++ring) {
+        for (u32 segment = 0; segment <= segments; ++segment) {
+            f32 theta = 3.14159265f * ring / rings;
+            f32 phi = 2.0f * 3.14159265f * segment / segments;
+            Vertex *vertex = mesh.vertexes + ring * (segments + 1) + segment;
+            *vertex = {};
+            vertex->position = { sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi) };
+            vertex->uv = { (f32)segment / segments, (f32)ring / rings };
+            vertex->normal = vertex->position;
+        }
+    }
+
+    u32 *index = mesh.indexes;
+    for (u32 ring = 0; ring < rings; ++ring) {
+        for (u32 segment = 0; segment < segments; ++segment) {
+            u32 v0 = ring * (segments + 1) + segment;
+            u32 v1 = v0 + 1;
+            u32 v2 = v0 + segments + 1;
+            u32 v3 = v2 + 1;
+            *index++ = v0; *index++ = v2; *index++ = v1;
+            *index++ = v1; *index++ = v2; *index++ = v3;
+        }
+    }
+
+    return mesh;
+}
+
+// Every triangle over a handful of vertexes, so meshlets fill up on triangles long before vertexes.
+static TestMesh create_dense_mesh(Allocator *allocator, u32 vertex_count) {
+    TestMesh mesh = {};
+    mesh.vertex_count = vertex_count;
+    mesh.index_count = vertex_count * (vertex_count - 1) * (vertex_count - 2) / 6 * 3;
+    mesh.vertexes = allocate<Vertex>(allocator, mesh.vertex_count);
+    mesh.indexes = allocate<u32>(allocator, mesh.index_count);
+
+    for (u32 i = 0; i < vertex_count; ++i) {
+        f32 angle = 2.0f * 3.14159265f * i / vertex_count;
+        mesh.vertexes[i] = {};
+        mesh.vertexes[i].position = { cosf(angle), sinf(angle), (f32)(i % 3) * 0.25f };
+    }
+
+    u32 *index = mesh.indexes;
+    for (u32 a = 0; a < vertex_count; ++a) {
+        for (u32 b = a + 1; b < vertex_count; ++b) {
+            for (u32 c = b + 1; c < vertex_count; ++c) {
+                *index++ = a; *index++ = b; *index++ = c;
+            }
+        }
+    }
+
+    return mesh;
+}
+
+static MeshletBuild build_test_meshlets(Allocator *allocator, Allocator *temp, TestMesh *mesh) {
+    MeshletBuild build = {};
+    build.indexes = allocate<u32>(allocator, mesh->index_count);
+    memcpy(build.indexes, mesh->indexes, mesh->index_count * sizeof(u32));
+    build.meshlets = allocate<Meshlet>(allocator, max_meshlet_count(mesh->index_count));
+    build.meshlet_count = build_meshlets(mesh->vertexes, mesh->vertex_count, build.indexes, mesh->index_count,
+                                         build.meshlets, temp);
+    return build;
+}
+
+static s32 compare_triangles(const void *a, const void *b) {
+    return memcmp(a, b, sizeof(Triangle));
+}
+
+// Rotates each triangle to start at its lowest index (preserving winding) and sorts them, so triangle lists can be
+// compared as multisets.
+static Triangle *sorted_triangles(Allocator *allocator, u32 *indexes, u32 index_count) {
+    u32 triangle_count = index_count / 3;
+    auto triangles = allocate<Triangle>(allocator, triangle_count);
+    for (u32 i = 0; i < triangle_count; ++i) {
+        u32 *source = indexes + i * 3;
+        u32 first = 0;
+        if (source[1] < source[first]) first = 1;
+        if (source[2] < source[first]) first = 2;
+        for (u32 j = 0; j < 3; ++j)
+            triangles[i].indexes[j] = source[(first + j) % 3];
+    }
+
+    qsort(triangles, triangle_count, sizeof(Triangle), compare_triangles);
+    return triangles;
+}
+
+// Model-view-projection for a camera at camera_position looking along +z (direction = 1) or -z (direction = -1) with
+// a 90 degree field of view and Vulkan's [0, 1] depth range. Matrixes are column-major: matrix[column][row].
+static Matrix axis_view_matrix(Vec3<f32> camera_position, f32 direction) {
+    static constexpr f32 Z_NEAR = 0.1f;
+    static constexpr f32 Z_FAR = 100.0f;
+    f32 depth_scale = Z_FAR / (Z_FAR - Z_NEAR);
+    f32 depth_offset = -Z_FAR * Z_NEAR / (Z_FAR - Z_NEAR);
+
+    f32 rows[4][4] = {
+        { direction, 0, 0, -direction * camera_position.x },
+        { 0, 1, 0, -camera_position.y },
+        { 0, 0, depth_scale * direction, -depth_scale * direction * camera_position.z + depth_offset },
+        { 0, 0, direction, -direction * camera_position.z },
+    };
+
+    Matrix matrix = {};
+    for (u32 row = 0; row < 4; ++row)
+        for (u32 column = 0; column < 4; ++column)
+            matrix[column][row] = rows[row][column];
+
+    return matrix;
+}
+
+static bool scalar_meshlet_visible(Meshlet *meshlet, MeshletCullView *view) {
+    for (u32 i = 0; i < 6; ++i) {
+        f32 *plane = view->planes[i];
+        f32 distance = plane[0] * meshlet->center.x + plane[1] * meshlet->center.y + plane[2] * meshlet->center.z +
+                       plane[3];
+        if (distance < -meshlet->radius)
+            return false;
+    }
+
+    Vec3<f32> to_apex = meshlet->cone_apex - view->camera_position;
+    return dot3(to_apex, meshlet->cone_axis) <= meshlet->cone_cutoff * sqrtf(dot3(to_apex, to_apex));
+}
+
+static u32 cull_test_meshlets(Allocator *allocator, MeshletBuild *build, Vec3<f32> camera_position, f32 direction,
+                              MeshletDrawCommand **draws)
+{
+    MeshletCullData *cull_data = create_meshlet_cull_data(allocator, build->meshlets, build->meshlet_count);
+    MeshletCullView view = create_meshlet_cull_view(axis_view_matrix(camera_position, direction));
+    *draws = allocate<MeshletDrawCommand>(allocator, build->meshlet_count);
+    return cull_meshlets(cull_data, &view, *draws);
+}
+
+////////////////////////////////////////////////////////////
+/// Tests
+////////////////////////////////////////////////////////////
+static void test_deterministic(Allocator *temp, TestMesh *mesh) {
+    push_frame(temp);
+
+    MeshletBuild first = build_test_meshlets(temp, temp, mesh);
+    MeshletBuild second = build_test_meshlets(temp, temp, mesh);
+    EXPECT(first.meshlet_count == second.meshlet_count, "meshlet counts %u vs %u", first.meshlet_count,
+           second.meshlet_count);
+    EXPECT(memcmp(first.indexes, second.indexes, mesh->index_count * sizeof(u32)) == 0, "indexes differ");
+    if (first.meshlet_count == second.meshlet_count)
+        EXPECT(memcmp(first.meshlets, second.meshlets, first.meshlet_count * sizeof(Meshlet)) == 0, "meshlets differ");
+
+    pop_frame(temp);
+}
+
+static void test_limits_and_coverage(Allocator *temp, TestMesh *mesh, cstr name) {
+    push_frame(temp);
+
+    MeshletBuild build = build_test_meshlets(temp, temp, mesh);
+    EXPECT(build.meshlet_count > 0 && build.meshlet_count <= max_meshlet_count(mesh->index_count),
+           "%s: %u meshlets, bound %u", name, build.meshlet_count, max_meshlet_count(mesh->index_count));
+
+    auto vertex_stamps = allocate<u32>(temp, mesh->vertex_count);
+    memset(vertex_stamps, 0, mesh->vertex_count * sizeof(u32));
+
+    u32 next_index = 0;
+    for (u32 i = 0; i < build.meshlet_count; ++i) {
+        Meshlet *meshlet = build.meshlets + i;
+        EXPECT(meshlet->first_index == next_index, "%s: meshlet %u starts at %u, expected %u", name, i,
+               meshlet->first_index, next_index);
+        EXPECT(meshlet->index_count > 0 && meshlet->index_count % 3 == 0, "%s: meshlet %u has %u indexes", name, i,
+               meshlet->index_count);
+        EXPECT(meshlet->index_count / 3 <= MESHLET_MAX_TRIANGLES, "%s: meshlet %u has %u triangles", name, i,
+               meshlet->index_count / 3);
+        next_index = meshlet->first_index + meshlet->index_count;
+        if (next_index > mesh->index_count)
+            break;
+
+        u32 unique_vertex_count = 0;
+        f32 max_distance = 0;
+        for (u32 j = meshlet->first_index; j < next_index; ++j) {
+            u32 vertex = build.indexes[j];
+            if (vertex_stamps[vertex] != i + 1) {
+                vertex_stamps[vertex] = i + 1;
+                ++unique_vertex_count;
+            }
+
+            Vec3<f32> offset = mesh->vertexes[vertex].position - meshlet->center;
+            max_distance = fmaxf(max_distance, sqrtf(dot3(offset, offset)));
+        }
+
+        EXPECT(unique_vertex_count <= MESHLET_MAX_VERTEXES, "%s: meshlet %u has %u vertexes", name, i,
+               unique_vertex_count);
+        EXPECT(unique_vertex_count == meshlet->vertex_count, "%s: meshlet %u reports %u vertexes, has %u", name, i,
+               meshlet->vertex_count, unique_vertex_count);
+        EXPECT(max_distance <= meshlet->radius * 1.0001f + 1e-6f, "%s: meshlet %u sphere misses a vertex", name, i);
+    }
+
+    EXPECT(next_index == mesh->index_count, "%s: meshlets cover %u of %u indexes", name, next_index,
+           mesh->index_count);
+
+    // Reordering must keep every triangle, with its winding, exactly once.
+    Triangle *expected = sorted_triangles(temp, mesh->indexes, mesh->index_count);
+    Triangle *actual = sorted_triangles(temp, build.indexes, mesh->index_count);
+    EXPECT(memcmp(expected, actual, mesh->index_count / 3 * sizeof(Triangle)) == 0,
+           "%s: triangles lost, duplicated or rewound", name);
+
+    pop_frame(temp);
+}
+
+static void test_triangle_limit(Allocator *temp) {
+    push_frame(temp);
+
+    // 16 vertexes fit in one meshlet, so only the triangle limit splits the 560 triangles.
+    TestMesh mesh = create_dense_mesh(temp, 16);
+    MeshletBuild build = build_test_meshlets(temp, temp, &mesh);
+    u32 triangle_count = mesh.index_count / 3;
+    u32 expected_count = (triangle_count + MESHLET_MAX_TRIANGLES - 1) / MESHLET_MAX_TRIANGLES;
+    EXPECT(build.meshlet_count == expected_count, "%u meshlets, expected %u", build.meshlet_count, expected_count);
+    for (u32 i = 0; i + 1 < build.meshlet_count; ++i) {
+        EXPECT(build.meshlets[i].index_count == MESHLET_MAX_TRIANGLES * 3, "meshlet %u has %u triangles", i,
+               build.meshlets[i].index_count / 3);
+    }
+
+    test_limits_and_coverage(temp, &mesh, "dense");
+    pop_frame(temp);
+}
+
+static void test_cone_culling(Allocator *temp) {
+    push_frame(temp);
+
+    TestMesh mesh = create_grid_mesh(temp, 32);
+    MeshletBuild build = build_test_meshlets(temp, temp, &mesh);
+    for (u32 i = 0; i < build.meshlet_count; ++i) {
+        Meshlet *meshlet = build.meshlets + i;
+        EXPECT(meshlet->cone_cutoff <= 1 && meshlet->cone_axis.z > 0.999f, "grid meshlet %u has no +z cone", i);
+    }
+
+    // In front of the plane every meshlet is visible; behind it (same frustum, mirrored) every meshlet faces away.
+    MeshletDrawCommand *draws = NULL;
+    u32 front_count = cull_test_meshlets(temp, &build, { 0, 0, 3 }, -1, &draws);
+    EXPECT(front_count == build.meshlet_count, "front view drew %u of %u meshlets", front_count, build.meshlet_count);
+    for (u32 i = 0; i < front_count; ++i) {
+        EXPECT(draws[i].first_index == build.meshlets[i].first_index &&
+               draws[i].index_count == build.meshlets[i].index_count, "draw %u doesn't match meshlet %u", i, i);
+    }
+
+    u32 back_count = cull_test_meshlets(temp, &build, { 0, 0, -3 }, 1, &draws);
+    EXPECT(back_count == 0, "back view drew %u meshlets", back_count);
+
+    pop_frame(temp);
+}
+
+static void test_sphere_culling(Allocator *temp) {
+    push_frame(temp);
+
+    TestMesh mesh = create_grid_mesh(temp, 32);
+    MeshletBuild build = build_test_meshlets(temp, temp, &mesh);
+    MeshletDrawCommand *draws = NULL;
+
+    // Camera off to the side: the plane is front-facing but entirely outside the frustum.
+    u32 outside_count = cull_test_meshlets(temp, &build, { 10, 0, 3 }, -1, &draws);
+    EXPECT(outside_count == 0, "offscreen view drew %u meshlets", outside_count);
+
+    // Beyond the far plane.
+    u32 far_count = cull_test_meshlets(temp, &build, { 0, 0, 150 }, -1, &draws);
+    EXPECT(far_count == 0, "distant view drew %u meshlets", far_count);
+
+    // Camera half a unit over the grid's +x edge: the frustum's left plane meets the grid at x = 0.5 at 45 degrees, so
+    // only meshlets whose sphere reaches it can be drawn.
+    u32 partial_count = cull_test_meshlets(temp, &build, { 1, 0, 0.5f }, -1, &draws);
+    EXPECT(partial_count > 0 && partial_count < build.meshlet_count, "edge view drew %u of %u meshlets",
+           partial_count, build.meshlet_count);
+    for (u32 i = 0; i < partial_count; ++i) {
+        Meshlet *meshlet = NULL;
+        for (u32 j = 0; j < build.meshlet_count; ++j)
+            if (build.meshlets[j].first_index == draws[i].first_index)
+                meshlet = build.meshlets + j;
+
+        EXPECT(meshlet != NULL && meshlet->center.x + sqrtf(2.0f) * meshlet->radius >= 0.5f,
+               "edge view drew meshlet at x = %f", meshlet != NULL ? meshlet->center.x : 0.0f);
+    }
+
+    pop_frame(temp);
+}
+
+// SIMD culling must agree with a scalar reference on a curved mesh whose meshlet count isn't a multiple of 4.
+static void test_culling_matches_reference(Allocator *temp) {
+    push_frame(temp);
+
+    TestMesh mesh = create_sphere_mesh(temp, 24, 37);
+    MeshletBuild build = build_test_meshlets(temp, temp, &mesh);
+    MeshletCullData *cull_data = create_meshlet_cull_data(temp, build.meshlets, build.meshlet_count);
+    auto draws = allocate<MeshletDrawCommand>(temp, build.meshlet_count);
+
+    Vec3<f32> camera_positions[] = { { 0, 0, -3 }, { 0, 0, -1.5f }, { 0.8f, 0.3f, -2 } };
+    for (u32 i = 0; i < CTK_ARRAY_SIZE(camera_positions); ++i) {
+        MeshletCullView view = create_meshlet_cull_view(axis_view_matrix(camera_positions[i], 1));
+        u32 draw_count = cull_meshlets(cull_data, &view, draws);
+
+        u32 expected_count = 0;
+        bool order_matches = true;
+        for (u32 j = 0; j < build.meshlet_count; ++j) {
+            if (!scalar_meshlet_visible(build.meshlets + j, &view))
+                continue;
+
+            if (expected_count >= draw_count || draws[expected_count].first_index != build.meshlets[j].first_index)
+                order_matches = false;
+
+            ++expected_count;
+        }
+
+        EXPECT(draw_count == expected_count && order_matches, "view %u drew %u meshlets, reference %u", i,
+               draw_count, expected_count);
+        EXPECT(draw_count > 0 && draw_count < build.meshlet_count, "view %u drew %u of %u meshlets", i, draw_count,
+               build.meshlet_count);
+    }
+
+    pop_frame(temp);
+}
+
+s32 main() {
+    Allocator *fixed_mem = create_stack_allocator(megabyte(256));
+    Allocator *temp_mem = create_stack_allocator(fixed_mem, megabyte(128));
+
+    TestMesh grid = create_grid_mesh(fixed_mem, 40);
+    TestMesh sphere = create_sphere_mesh(fixed_mem, 48, 96);
+
+    test_deterministic(temp_mem, &grid);
+    test_deterministic(temp_mem, &sphere);
+    test_limits_and_coverage(temp_mem, &grid, "grid");
+    test_limits_and_coverage(temp_mem, &sphere, "sphere");
+    test_triangle_limit(temp_mem);
+    test_cone_culling(temp_mem);
+    test_sphere_culling(temp_mem);
+    test_culling_matches_reference(temp_mem);
+
+    if (failure_count > 0) {
+        print_line("%u meshlet test checks failed", failure_count);
+        return 1;
+    }
+
+    print_line("meshlet tests passed");
+    return 0;
+}
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <new>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <stb/stb_image.h>
+#include "renderer/vulkan.h"
+#include "renderer/timer.h"
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+#include "ctk/containers.h"
+#include "ctk/task.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+struct TextureLoadInfo {
+    cstr path;
+    ImageInfo image_info;
+};
+
+struct TextureLoadTiming {
+    u32 width;
+    u32 height;
+    u32 file_size;
+    u32 decoded_size;
+    f64 read_ms;
+    f64 decode_ms;
+};
+
+struct TextureBatchStats {
+    u32 texture_count;
+    u32 upload_count; // Number of staging region flushes.
+    u64 file_bytes;
+    u64 decoded_bytes;
+    f64 decode_ms; // Sum of per-file decode times across all threads.
+    f64 total_ms;
+};
+
+struct DecodedTexture {
+    stbi_uc *pixels;
+    s32 width;
+    s32 height;
+};
+
+struct TextureBatchState {
+    Vulkan *vk;
+    VkCommandBuffer cmd_buf;
+    Region *staging_region;
+
+    TextureLoadInfo *infos;
+    Image **images;
+    TextureLoadTiming *timings;
+    DecodedTexture *decoded;
+    u32 count;
+
+    std::atomic<u32> next_decode_idx;
+
+    // Indexes of decoded textures waiting to be uploaded, written by decode threads and consumed by the upload thread.
+    std::mutex finished_mutex;
+    std::condition_variable finished_cond;
+    u32 *finished_idxs;
+    u32 finished_count;
+    u32 uploaded_count;
+
+    TextureBatchStats stats;
+};
+
+////////////////////////////////////////////////////////////
+/// Internal
+////////////////////////////////////////////////////////////
+static u8 *read_texture_file(cstr path, u32 *size) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    *size = (u32)ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    auto data = (u8 *)malloc(*size);
+    if (fread(data, 1, *size, file) != *size) {
+        free(data);
+        data = NULL;
+    }
+
+    fclose(file);
+    return data;
+}
+
+static void decode_texture(TextureBatchState *state, u32 idx) {
+    cstr path = state->infos[idx].path;
+    TextureLoadTiming *timing = state->timings + idx;
+    DecodedTexture *decoded = state->decoded + idx;
+
+    u64 read_start = get_time_ns();
+    u8 *file_data = read_texture_file(path, &timing->file_size);
+    if (file_data == NULL)
+        CTK_FATAL("failed to read image file \"%s\"", path)
+
+    timing->read_ms = elapsed_ms(read_start);
+
+    u64 decode_start = get_time_ns();
+    s32 channel_count = 0;
+    decoded->pixels = stbi_load_from_memory(file_data, (s32)timing->file_size,
+                                            &decoded->width, &decoded->height, &channel_count, STBI_rgb_alpha);
+    free(file_data);
+
+    if (decoded->pixels == NULL)
+        CTK_FATAL("failed to decode image \"%s\": %s", path, stbi_failure_reason())
+
+    timing->decode_ms = elapsed_ms(decode_start);
+    timing->width = (u32)decoded->width;
+    timing->height = (u32)decoded->height;
+    timing->decoded_size = timing->width * timing->height * STBI_rgb_alpha;
+
+    // Hand decoded texture off to upload thread.
+    {
+        std::lock_guard<std::mutex> lock(state->finished_mutex);
+        state->finished_idxs[state->finished_count++] = idx;
+    }
+
+    state->finished_cond.notify_one();
+}
+
+static bool decode_next_texture(TextureBatchState *state) {
+    u32 idx = state->next_decode_idx.fetch_add(1);
+    if (idx >= state->count)
+        return false;
+
+    decode_texture(state, idx);
+    return true;
+}
+
+static void flush_texture_uploads(TextureBatchState *state, u32 *staging_offset) {
+    if (*staging_offset == 0)
+        return;
+
+    submit_temp_cmd_buf(state->cmd_buf, state->vk->queue.graphics);
+    *staging_offset = 0;
+    ++state->stats.upload_count;
+}
+
+static void upload_texture(TextureBatchState *state, u32 idx, u32 *staging_offset) {
+    Vulkan *vk = state->vk;
+    DecodedTexture *decoded = state->decoded + idx;
+    u32 size = state->timings[idx].decoded_size;
+
+    if (size > state->staging_region->size)
+        CTK_FATAL("image \"%s\" (%u bytes) does not fit in staging region", state->infos[idx].path, size);
+
+    // Staging region is full; wait for pending copies to complete before reusing it.
+    if (*staging_offset + size > state->staging_region->size)
+        flush_texture_uploads(state, staging_offset);
+
+    if (*staging_offset == 0)
+        begin_temp_cmd_buf(state->cmd_buf);
+
+    write_to_host_region(vk->device, state->staging_region, *staging_offset, decoded->pixels, size);
+    stbi_image_free(decoded->pixels);
+    decoded->pixels = NULL;
+
+    ImageInfo info = state->infos[idx].image_info;
+    info.image.extent.width = (u32)decoded->width;
+    info.image.extent.height = (u32)decoded->height;
+
+    Image *image = create_image(vk, info);
+    write_to_image(vk, state->cmd_buf, state->staging_region, *staging_offset, image);
+    state->images[idx] = image;
+
+    *staging_offset += size;
+}
+
+static void upload_decoded_textures(TextureBatchState *state) {
+    u32 staging_offset = 0;
+
+    while (state->uploaded_count < state->count) {
+        u32 idx = U32_MAX;
+        {
+            std::unique_lock<std::mutex> lock(state->finished_mutex);
+
+            if (state->uploaded_count < state->finished_count)
+                idx = state->finished_idxs[state->uploaded_count];
+        }
+
+        if (idx != U32_MAX) {
+            upload_texture(state, idx, &staging_offset);
+            ++state->uploaded_count;
+            continue;
+        }
+
+        // Nothing ready to upload; help decode if work remains, otherwise wait on decode threads.
+        if (decode_next_texture(state))
+            continue;
+
+        std::unique_lock<std::mutex> lock(state->finished_mutex);
+        state->finished_cond.wait(lock, [state] { return state->uploaded_count < state->finished_count; });
+    }
+
+    flush_texture_uploads(state, &staging_offset);
+}
+
+static void run_texture_decode_thread(TextureBatchState *state, u32 thread_idx) {
+    while (decode_next_texture(state));
+}
+
+static void run_texture_batch_thread(TextureBatchState *state, u32 thread_idx) {
+    // Thread 0 owns all Vulkan calls; remaining threads only decode.
+    if (thread_idx == 0) {
+        upload_decoded_textures(state);
+        return;
+    }
+
+    while (decode_next_texture(state));
+}
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+static TextureBatchStats load_textures(Vulkan *vk, VkCommandBuffer cmd_buf, Region *staging_region,
+                                       TextureLoadInfo *infos, u32 count, Image **images,
+                                       TextureLoadTiming *timings, u32 thread_count, Allocator *temp)
+{
+    push_frame(temp);
+
+    auto state = allocate<TextureBatchState>(temp, 1);
+    new (state) TextureBatchState {};
+    state->vk = vk;
+    state->cmd_buf = cmd_buf;
+    state->staging_region = staging_region;
+    state->infos = infos;
+    state->images = images;
+    state->timings = timings;
+    state->decoded = allocate<DecodedTexture>(temp, count);
+    state->count = count;
+    state->finished_idxs = allocate<u32>(temp, count);
+
+    u64 start = get_time_ns();
+    run_parallel(state, run_texture_batch_thread, thread_count > 0 ? thread_count : 1, temp);
+    state->stats.total_ms = elapsed_ms(start);
+
+    state->stats.texture_count = count;
+    for (u32 i = 0; i < count; ++i) {
+        state->stats.file_bytes += timings[i].file_size;
+        state->stats.decoded_bytes += timings[i].decoded_size;
+        state->stats.decode_ms += timings[i].decode_ms;
+    }
+
+    TextureBatchStats stats = state->stats;
+    state->~TextureBatchState();
+
+    pop_frame(temp);
+    return stats;
+}
+
+// Decodes textures in parallel without uploading them; decoded pixels must be freed with stbi_image_free().
+static void decode_textures(TextureLoadInfo *infos, u32 count, DecodedTexture *decoded, TextureLoadTiming *timings,
+                            u32 thread_count, Allocator *temp)
+{
+    push_frame(temp);
+
+    auto state = allocate<TextureBatchState>(temp, 1);
+    new (state) TextureBatchState {};
+    state->infos = infos;
+    state->timings = timings;
+    state->decoded = decoded;
+    state->count = count;
+    state->finished_idxs = allocate<u32>(temp, count);
+
+    run_parallel(state, run_texture_decode_thread, thread_count > 0 ? thread_count : 1, temp);
+    state->~TextureBatchState();
+
+    pop_frame(temp);
+}
+
+static void print_texture_batch_stats(TextureBatchStats *stats, TextureLoadInfo *infos, TextureLoadTiming *timings) {
+    for (u32 i = 0; i < stats->texture_count; ++i) {
+        TextureLoadTiming *timing = timings + i;
+        print_line("    %s (%ux%u): read %.2fms, decode %.2fms", infos[i].path, timing->width, timing->height,
+                   timing->read_ms, timing->decode_ms);
+    }
+
+    f64 decoded_mb = stats->decoded_bytes / (1024.0 * 1024.0);
+    print_line("loaded %u textures in %.2fms (%u uploads): %.2fMB decoded at %.2fMB/s per thread, %.2fMB/s overall",
+               stats->texture_count, stats->total_ms, stats->upload_count, decoded_mb,
+               stats->decode_ms > 0 ? decoded_mb / (stats->decode_ms / 1000.0) : 0.0,
+               stats->total_ms > 0 ? decoded_mb / (stats->total_ms / 1000.0) : 0.0);
+}
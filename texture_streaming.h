@@ -0,0 +1,625 @@
+#pragma once
+
+#include <math.h>
+#include "renderer/vulkan.h"
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+#include "ctk/containers.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+struct TextureStreamingInfo {
+    VkDeviceSize memory_budget;
+    VkDeviceSize max_upload_size_per_frame; // Also each upload batch's staging size; must hold a texture's mip 0.
+    u32 max_textures;
+
+    // Number of frames a replaced image must wait before being destroyed, so in-flight frames can finish with it. Also
+    // the number of upload batches.
+    u32 retire_frame_count;
+
+    // Textures start with only the mips at or below this size resident.
+    u32 initial_mip_size;
+};
+
+struct TextureMip {
+    u32 offset;
+    u32 size;
+    u32 width;
+    u32 height;
+};
+
+struct StreamedTexture {
+    ImageSampler image_sampler;
+    ImageInfo image_info;
+
+    // Full RGBA8 mip chain kept in host memory; mips are stored contiguously from most to least detailed.
+    u8 *pixels;
+    FixedArray<TextureMip, 16> mips;
+
+    // Device memory an image with mips [i, lowest] resident takes, in the same units as Image::mem_size.
+    FixedArray<VkDeviceSize, 16> residency_sizes;
+
+    u32 resident_mip; // Most detailed mip currently resident on the GPU.
+    u32 requested_mip; // Most detailed mip requested since the last update.
+    u64 last_requested_frame;
+
+    // Incremented each time the image is recreated; descriptor sets referencing an older version must be rewritten.
+    u32 version;
+};
+
+// Residency changes are recorded into a ring of upload batches instead of blocking on the queue. Each batch has its own
+// command buffer, fence and slice of the streamer's staging buffer, and is submitted once per update.
+struct TextureUploadBatch {
+    VkCommandBuffer cmd_buf;
+    VkFence fence;
+    u32 staging_offset; // Offset of the batch's slice in the staging buffer.
+    u32 staging_used;
+    u64 serial; // Incremented each time the batch is opened.
+    bool open;
+};
+
+struct RetiredImage {
+    Image image;
+    u64 frame;
+
+    // Batch that copied out of the image; it can't be destroyed until that batch's fence signals.
+    u32 batch_idx;
+    u64 batch_serial;
+};
+
+struct TextureStreamingStats {
+    VkDeviceSize resident_size;
+    VkDeviceSize uploaded_size;
+    u32 upload_count;
+    u32 eviction_count;
+};
+
+struct TextureStreamer {
+    TextureStreamingInfo info;
+    Array<StreamedTexture> *textures;
+    Array<RetiredImage> *retired_images;
+
+    // Uploads
+    Buffer *staging_buffer;
+    u8 *staging_mapped;
+    VkCommandPool cmd_pool;
+    TextureUploadBatch *upload_batches;
+    u32 upload_batch_count;
+    u32 upload_batch_idx;
+
+    VkDeviceSize resident_size;
+    u64 frame;
+    TextureStreamingStats frame_stats;
+};
+
+////////////////////////////////////////////////////////////
+/// Internal
+////////////////////////////////////////////////////////////
+static void generate_mips(StreamedTexture *texture, u8 *pixels, u32 width, u32 height) {
+    // Calculate mip chain layout.
+    u32 total_size = 0;
+    for (u32 level = 0; ; ++level) {
+        TextureMip *mip = push(&texture->mips);
+        mip->width = mip_dimension(width, level);
+        mip->height = mip_dimension(height, level);
+        mip->size = mip->width * mip->height * 4;
+        mip->offset = total_size;
+        total_size += mip->size;
+
+        if ((mip->width == 1 && mip->height == 1) || texture->mips.count == get_size(&texture->mips))
+            break;
+    }
+
+    texture->pixels = (u8 *)malloc(total_size);
+    memcpy(texture->pixels, pixels, texture->mips[0].size);
+
+    // Box-filter each mip from the previous one.
+    for (u32 level = 1; level < texture->mips.count; ++level) {
+        TextureMip *src_mip = &texture->mips[level - 1];
+        TextureMip *dst_mip = &texture->mips[level];
+        u8 *src = texture->pixels + src_mip->offset;
+        u8 *dst = texture->pixels + dst_mip->offset;
+
+        for (u32 y = 0; y < dst_mip->height; ++y)
+        for (u32 x = 0; x < dst_mip->width; ++x) {
+            u32 x0 = x * 2 < src_mip->width ? x * 2 : src_mip->width - 1;
+            u32 y0 = y * 2 < src_mip->height ? y * 2 : src_mip->height - 1;
+            u32 x1 = x0 + 1 < src_mip->width ? x0 + 1 : x0;
+            u32 y1 = y0 + 1 < src_mip->height ? y0 + 1 : y0;
+
+            for (u32 c = 0; c < 4; ++c) {
+                u32 sum = src[(y0 * src_mip->width + x0) * 4 + c] +
+                          src[(y0 * src_mip->width + x1) * 4 + c] +
+                          src[(y1 * src_mip->width + x0) * 4 + c] +
+                          src[(y1 * src_mip->width + x1) * 4 + c];
+                dst[(y * dst_mip->width + x) * 4 + c] = (u8)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+static u32 lowest_mip(StreamedTexture *texture) {
+    return texture->mips.count - 1;
+}
+
+static TextureUploadBatch *open_upload_batch(TextureStreamer *streamer, Vulkan *vk) {
+    TextureUploadBatch *batch = streamer->upload_batches + streamer->upload_batch_idx;
+    if (batch->open)
+        return batch;
+
+    // The batch was last submitted upload_batch_count updates ago, so its fence has normally signaled already.
+    validate_result(vkWaitForFences(vk->device, 1, &batch->fence, VK_TRUE, U64_MAX), "vkWaitForFences failed");
+    validate_result(vkResetFences(vk->device, 1, &batch->fence), "vkResetFences failed");
+    begin_temp_cmd_buf(batch->cmd_buf);
+    batch->staging_used = 0;
+    ++batch->serial;
+    batch->open = true;
+
+    return batch;
+}
+
+static void submit_upload_batch(TextureStreamer *streamer, Vulkan *vk) {
+    TextureUploadBatch *batch = streamer->upload_batches + streamer->upload_batch_idx;
+    if (!batch->open)
+        return;
+
+    vkEndCommandBuffer(batch->cmd_buf);
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &batch->cmd_buf;
+    validate_result(vkQueueSubmit(vk->queue.graphics, 1, &submit_info, batch->fence), "vkQueueSubmit failed");
+
+    batch->open = false;
+    streamer->upload_batch_idx = (streamer->upload_batch_idx + 1) % streamer->upload_batch_count;
+}
+
+// Reserves size bytes of staging in the open batch, submitting it and opening the next one if it's full. Returns the
+// offset of the reserved bytes in the staging buffer.
+static u32 reserve_upload_staging(TextureStreamer *streamer, Vulkan *vk, u32 size) {
+    u32 batch_staging_size = (u32)streamer->info.max_upload_size_per_frame;
+    if (size > batch_staging_size)
+        CTK_FATAL("texture upload (%u bytes) exceeds max_upload_size_per_frame (%u bytes)", size, batch_staging_size);
+
+    TextureUploadBatch *batch = open_upload_batch(streamer, vk);
+    if (batch->staging_used + size > batch_staging_size) {
+        submit_upload_batch(streamer, vk);
+        batch = open_upload_batch(streamer, vk);
+    }
+
+    u32 offset = batch->staging_offset + batch->staging_used;
+    batch->staging_used += size;
+    return offset;
+}
+
+static void retire_image(TextureStreamer *streamer, Image *image, TextureUploadBatch *batch) {
+    if (streamer->retired_images->count == streamer->retired_images->size)
+        CTK_FATAL("texture streamer cannot retire any more images");
+
+    push(streamer->retired_images, {
+        .image = *image,
+        .frame = streamer->frame,
+        .batch_idx = (u32)(batch - streamer->upload_batches),
+        .batch_serial = batch->serial,
+    });
+}
+
+static bool upload_batch_finished(TextureStreamer *streamer, Vulkan *vk, u32 batch_idx, u64 serial) {
+    TextureUploadBatch *batch = streamer->upload_batches + batch_idx;
+
+    // A batch is only reopened after waiting on its fence.
+    if (batch->serial != serial)
+        return true;
+
+    return !batch->open && vkGetFenceStatus(vk->device, batch->fence) == VK_SUCCESS;
+}
+
+static void destroy_retired_images(TextureStreamer *streamer, Vulkan *vk) {
+    for (u32 i = 0; i < streamer->retired_images->count;) {
+        RetiredImage *retired = streamer->retired_images->data + i;
+
+        if (streamer->frame - retired->frame < streamer->info.retire_frame_count ||
+            !upload_batch_finished(streamer, vk, retired->batch_idx, retired->batch_serial))
+        {
+            ++i;
+            continue;
+        }
+
+        destroy_image(vk, &retired->image);
+        *retired = streamer->retired_images->data[--streamer->retired_images->count];
+    }
+}
+
+static void image_barrier(VkImageMemoryBarrier *barrier, VkImage image, u32 base_level, u32 level_count,
+                          VkAccessFlags src_access, VkAccessFlags dst_access,
+                          VkImageLayout old_layout, VkImageLayout new_layout)
+{
+    *barrier = {};
+    barrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier->srcAccessMask = src_access;
+    barrier->dstAccessMask = dst_access;
+    barrier->oldLayout = old_layout;
+    barrier->newLayout = new_layout;
+    barrier->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier->image = image;
+    barrier->subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier->subresourceRange.baseMipLevel = base_level;
+    barrier->subresourceRange.levelCount = level_count;
+    barrier->subresourceRange.baseArrayLayer = 0;
+    barrier->subresourceRange.layerCount = 1;
+}
+
+// Fills new_image, holding mips [mip, lowest_mip], by copying mips [copy_mip, lowest_mip] from old_image (holding mips
+// [old_mip, lowest_mip]) on the GPU and uploading mips [mip, copy_mip) from staging.
+static void record_residency_change(TextureStreamer *streamer, VkCommandBuffer cmd_buf, StreamedTexture *texture,
+                                    Image *old_image, u32 old_mip, Image *new_image, u32 mip, u32 copy_mip,
+                                    u32 staging_offset)
+{
+    u32 mip_count = texture->mips.count;
+
+    // Reads of old_image by frames already submitted must finish before it's transitioned for the copy.
+    VkImageMemoryBarrier pre_barriers[2] = {};
+    u32 pre_barrier_count = 0;
+    image_barrier(&pre_barriers[pre_barrier_count++], new_image->handle, 0, mip_count - mip,
+                  0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                  VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    if (copy_mip < mip_count) {
+        image_barrier(&pre_barriers[pre_barrier_count++], old_image->handle, copy_mip - old_mip, mip_count - copy_mip,
+                      0, VK_ACCESS_TRANSFER_READ_BIT,
+                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    }
+    vkCmdPipelineBarrier(cmd_buf,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, // Dependency Flags
+                         0, NULL, // Memory Barriers
+                         0, NULL, // Buffer Memory Barriers
+                         pre_barrier_count, pre_barriers); // Image Memory Barriers
+
+    FixedArray<VkImageCopy, 16> image_copies = {};
+    for (u32 level = copy_mip; level < mip_count; ++level) {
+        VkImageCopy *copy = push(&image_copies);
+        *copy = {};
+        copy->srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - old_mip, 0, 1 };
+        copy->dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - mip, 0, 1 };
+        copy->extent = { texture->mips[level].width, texture->mips[level].height, 1 };
+    }
+
+    if (image_copies.count > 0) {
+        vkCmdCopyImage(cmd_buf, old_image->handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       new_image->handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, image_copies.count, image_copies.data);
+    }
+
+    FixedArray<VkBufferImageCopy, 16> buffer_copies = {};
+    for (u32 level = mip; level < copy_mip; ++level) {
+        VkBufferImageCopy *copy = push(&buffer_copies);
+        *copy = {};
+        copy->bufferOffset = staging_offset + texture->mips[level].offset - texture->mips[mip].offset;
+        copy->imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - mip, 0, 1 };
+        copy->imageExtent = { texture->mips[level].width, texture->mips[level].height, 1 };
+    }
+
+    if (buffer_copies.count > 0) {
+        vkCmdCopyBufferToImage(cmd_buf, streamer->staging_buffer->handle, new_image->handle,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, buffer_copies.count, buffer_copies.data);
+    }
+
+    // old_image is retired, so it's left in TRANSFER_SRC layout.
+    VkImageMemoryBarrier post_barrier = {};
+    image_barrier(&post_barrier, new_image->handle, 0, mip_count - mip,
+                  VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    vkCmdPipelineBarrier(cmd_buf,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, // Dependency Flags
+                         0, NULL, // Memory Barriers
+                         0, NULL, // Buffer Memory Barriers
+                         1, &post_barrier); // Image Memory Barriers
+}
+
+static ImageInfo get_residency_image_info(StreamedTexture *texture, u32 mip) {
+    TextureMip *top_mip = &texture->mips[mip];
+    u32 level_count = texture->mips.count - mip;
+    ImageInfo info = texture->image_info;
+    info.image.extent = { top_mip->width, top_mip->height, 1 };
+    info.image.mipLevels = level_count;
+    info.view.subresourceRange.baseMipLevel = 0;
+    info.view.subresourceRange.levelCount = level_count;
+    return info;
+}
+
+// Images take more than their texel bytes once alignment and tiling are applied, so each residency is measured once
+// with an unbound probe image rather than estimated from mip sizes.
+static void measure_residency_sizes(Vulkan *vk, StreamedTexture *texture) {
+    for (u32 mip = 0; mip < texture->mips.count; ++mip) {
+        ImageInfo info = get_residency_image_info(texture, mip);
+        VkImage probe = VK_NULL_HANDLE;
+        validate_result(vkCreateImage(vk->device, &info.image, NULL, &probe), "failed to create residency probe image");
+
+        VkMemoryRequirements mem_reqs = {};
+        vkGetImageMemoryRequirements(vk->device, probe, &mem_reqs);
+        vkDestroyImage(vk->device, probe, NULL);
+        push(&texture->residency_sizes, mem_reqs.size);
+    }
+}
+
+// Recreates texture's image with mips [mip, lowest_mip] resident; the new image is written into the same Image so
+// ImageSamplers referencing it stay valid. Mips that were already resident are copied from the old image on the GPU and
+// only newly resident mips are uploaded. Commands go into the open upload batch, which is submitted by
+// update_texture_streaming().
+static void set_texture_residency(TextureStreamer *streamer, Vulkan *vk, StreamedTexture *texture, u32 mip) {
+    Image *image = texture->image_sampler.image;
+    Image old_image = *image;
+    u32 old_mip = texture->resident_mip;
+    u32 copy_mip = old_image.handle == VK_NULL_HANDLE ? texture->mips.count : mip > old_mip ? mip : old_mip;
+
+    // Newly resident mips are contiguous in host memory, so they can be staged with a single write.
+    u32 upload_size = 0;
+    for (u32 level = mip; level < copy_mip; ++level)
+        upload_size += texture->mips[level].size;
+
+    u32 staging_offset = 0;
+    if (upload_size > 0) {
+        staging_offset = reserve_upload_staging(streamer, vk, upload_size);
+        memcpy(streamer->staging_mapped + staging_offset, texture->pixels + texture->mips[mip].offset, upload_size);
+        count_render_stat(RenderCounter::UPLOADED_BYTES, upload_size);
+    }
+
+    TextureUploadBatch *batch = open_upload_batch(streamer, vk);
+
+    init_image(vk, image, get_residency_image_info(texture, mip));
+
+    record_residency_change(streamer, batch->cmd_buf, texture, &old_image, old_mip, image, mip, copy_mip,
+                            staging_offset);
+
+    if (old_image.handle != VK_NULL_HANDLE) {
+        streamer->resident_size -= old_image.mem_size;
+        retire_image(streamer, &old_image, batch);
+    }
+
+    texture->resident_mip = mip;
+    ++texture->version;
+    streamer->resident_size += image->mem_size;
+
+    if (upload_size > 0) {
+        streamer->frame_stats.uploaded_size += upload_size;
+        ++streamer->frame_stats.upload_count;
+    }
+}
+
+// Find least recently used texture that can give up its most detailed resident mip, excluding texture.
+static StreamedTexture *find_eviction_candidate(TextureStreamer *streamer, StreamedTexture *texture) {
+    StreamedTexture *candidate = NULL;
+
+    for (u32 i = 0; i < streamer->textures->count; ++i) {
+        StreamedTexture *other = streamer->textures->data + i;
+        if (other == texture || other->resident_mip == lowest_mip(other))
+            continue;
+
+        // Only evict mips that weren't requested this frame.
+        if (other->last_requested_frame == streamer->frame && other->resident_mip >= other->requested_mip)
+            continue;
+
+        if (candidate == NULL || other->last_requested_frame < candidate->last_requested_frame)
+            candidate = other;
+    }
+
+    return candidate;
+}
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+static TextureStreamer *create_texture_streamer(Allocator *allocator, Vulkan *vk, TextureStreamingInfo info) {
+    if (info.retire_frame_count == 0)
+        CTK_FATAL("texture streamer needs a retire_frame_count of at least 1");
+
+    auto streamer = allocate<TextureStreamer>(allocator, 1);
+    *streamer = {};
+    streamer->info = info;
+    streamer->textures = create_array<StreamedTexture>(allocator, info.max_textures);
+    streamer->retired_images = create_array<RetiredImage>(allocator, info.max_textures * info.retire_frame_count * 2);
+
+    // One batch per frame that can be in flight, each with max_upload_size_per_frame bytes of staging.
+    streamer->upload_batch_count = info.retire_frame_count;
+
+    BufferInfo buffer_info = {};
+    buffer_info.size = info.max_upload_size_per_frame * streamer->upload_batch_count;
+    buffer_info.sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
+    buffer_info.usage_flags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buffer_info.mem_property_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    streamer->staging_buffer = create_buffer(vk, &buffer_info);
+
+    // Staging stays mapped; batches write straight into their slice.
+    validate_result(vkMapMemory(vk->device, streamer->staging_buffer->mem, 0, VK_WHOLE_SIZE, 0,
+                                (void **)&streamer->staging_mapped),
+                    "failed to map texture streaming staging buffer");
+
+    streamer->cmd_pool = create_cmd_pool(vk);
+    streamer->upload_batches = allocate<TextureUploadBatch>(allocator, streamer->upload_batch_count);
+    for (u32 i = 0; i < streamer->upload_batch_count; ++i) {
+        TextureUploadBatch *batch = streamer->upload_batches + i;
+        *batch = {};
+        batch->fence = create_fence(vk);
+        batch->staging_offset = (u32)(info.max_upload_size_per_frame * i);
+        allocate_cmd_bufs(vk, &batch->cmd_buf, {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = streamer->cmd_pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        });
+    }
+
+    return streamer;
+}
+
+// The texture's initial mips are uploaded by the next update_texture_streaming(), which must run before it's drawn.
+static StreamedTexture *create_streamed_texture(TextureStreamer *streamer, Vulkan *vk, u8 *pixels, u32 width,
+                                                u32 height, ImageInfo image_info, VkSampler sampler)
+{
+    if (streamer->textures->count == streamer->textures->size)
+        CTK_FATAL("texture streamer cannot create any more textures");
+
+    StreamedTexture *texture = push(streamer->textures);
+    *texture = {};
+    texture->image_info = image_info;
+
+    // Resident mips are copied between images when residency changes.
+    texture->image_info.image.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    texture->image_sampler.image = allocate(vk->pool.image);
+    *texture->image_sampler.image = {};
+    texture->image_sampler.sampler = sampler;
+    generate_mips(texture, pixels, width, height);
+    measure_residency_sizes(vk, texture);
+
+    // Mips are uploaded one per batch at most, so the most detailed one must fit in a batch's staging.
+    if (texture->mips[0].size > streamer->info.max_upload_size_per_frame) {
+        CTK_FATAL("texture mip 0 (%u bytes) exceeds max_upload_size_per_frame (%u bytes)", texture->mips[0].size,
+                  (u32)streamer->info.max_upload_size_per_frame);
+    }
+
+    u32 initial_mip = 0;
+    while (initial_mip < lowest_mip(texture) &&
+           (texture->mips[initial_mip].width > streamer->info.initial_mip_size ||
+            texture->mips[initial_mip].height > streamer->info.initial_mip_size))
+    {
+        ++initial_mip;
+    }
+
+    set_texture_residency(streamer, vk, texture, initial_mip);
+    texture->requested_mip = lowest_mip(texture);
+
+    return texture;
+}
+
+// Request the mip level needed to draw texture at screen_size pixels (its largest projected dimension).
+static void request_texture_size(TextureStreamer *streamer, StreamedTexture *texture, f32 screen_size) {
+    u32 texture_size = texture->mips[0].width > texture->mips[0].height
+                       ? texture->mips[0].width
+                       : texture->mips[0].height;
+
+    u32 mip = lowest_mip(texture);
+    if (screen_size >= 1.0f) {
+        f32 level = floorf(log2f(texture_size / screen_size));
+        mip = level <= 0.0f ? 0 : level >= mip ? mip : (u32)level;
+    }
+
+    if (mip < texture->requested_mip)
+        texture->requested_mip = mip;
+
+    texture->last_requested_frame = streamer->frame;
+}
+
+// Raises and lowers residency and submits the resulting copies without waiting on them. Call once per frame before
+// recording commands that sample streamed textures.
+static void update_texture_streaming(TextureStreamer *streamer, Vulkan *vk) {
+    streamer->frame_stats = {};
+    destroy_retired_images(streamer, vk);
+
+    // Raise residency by one mip per texture per frame, most detailed requests first, until the upload limit is hit.
+    for (u32 requested_mip = 0; requested_mip < 16; ++requested_mip)
+    for (u32 i = 0; i < streamer->textures->count; ++i) {
+        StreamedTexture *texture = streamer->textures->data + i;
+        if (texture->requested_mip != requested_mip || texture->resident_mip <= requested_mip)
+            continue;
+
+        u32 next_mip = texture->resident_mip - 1;
+        VkDeviceSize upload_size = texture->mips[next_mip].size;
+        if (streamer->frame_stats.uploaded_size + upload_size > streamer->info.max_upload_size_per_frame &&
+            streamer->frame_stats.upload_count > 0)
+        {
+            goto evict;
+        }
+
+        // Evict least recently used mips until the new residency fits in the memory budget.
+        VkDeviceSize current_size = texture->image_sampler.image->mem_size;
+        bool fits = true;
+        VkDeviceSize residency_size = texture->residency_sizes[next_mip];
+        while (streamer->resident_size - current_size + residency_size > streamer->info.memory_budget) {
+            StreamedTexture *victim = find_eviction_candidate(streamer, texture);
+            if (victim == NULL) {
+                fits = false;
+                break;
+            }
+
+            set_texture_residency(streamer, vk, victim, victim->resident_mip + 1);
+            ++streamer->frame_stats.eviction_count;
+        }
+
+        if (fits)
+            set_texture_residency(streamer, vk, texture, next_mip);
+    }
+
+evict:
+    // Trim residency back under budget in case it was lowered.
+    while (streamer->resident_size > streamer->info.memory_budget) {
+        StreamedTexture *victim = find_eviction_candidate(streamer, NULL);
+        if (victim == NULL)
+            break;
+
+        set_texture_residency(streamer, vk, victim, victim->resident_mip + 1);
+        ++streamer->frame_stats.eviction_count;
+    }
+
+    // Reset requests for next frame.
+    for (u32 i = 0; i < streamer->textures->count; ++i) {
+        StreamedTexture *texture = streamer->textures->data + i;
+        texture->requested_mip = lowest_mip(texture);
+    }
+
+    submit_upload_batch(streamer, vk);
+
+    streamer->frame_stats.resident_size = streamer->resident_size;
+    ++streamer->frame;
+}
+
+// Rewrites descriptor_set if it references an older version of texture's image. set_version tracks the version
+// descriptor_set was last written with.
+static void update_streamed_texture_descriptor(Vulkan *vk, StreamedTexture *texture, VkDescriptorSet descriptor_set,
+                                               u32 binding, u32 *set_version)
+{
+    if (*set_version == texture->version)
+        return;
+
+    DescriptorBinding descriptor_binding = {
+        .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .image_sampler = &texture->image_sampler,
+    };
+
+    update_descriptor_set(vk, descriptor_set, 1, &descriptor_binding, binding);
+    *set_version = texture->version;
+}
+
+// Waits for submitted uploads, then destroys every streamed texture's image and host mips along with the streamer's
+// upload objects.
+static void destroy_texture_streamer(TextureStreamer *streamer, Vulkan *vk) {
+    for (u32 i = 0; i < streamer->upload_batch_count; ++i) {
+        TextureUploadBatch *batch = streamer->upload_batches + i;
+        if (!batch->open)
+            validate_result(vkWaitForFences(vk->device, 1, &batch->fence, VK_TRUE, U64_MAX), "vkWaitForFences failed");
+
+        vkDestroyFence(vk->device, batch->fence, NULL);
+    }
+
+    for (u32 i = 0; i < streamer->retired_images->count; ++i)
+        destroy_image(vk, &streamer->retired_images->data[i].image);
+
+    for (u32 i = 0; i < streamer->textures->count; ++i) {
+        StreamedTexture *texture = streamer->textures->data + i;
+        destroy_image(vk, texture->image_sampler.image);
+        free(texture->pixels);
+        texture->pixels = NULL;
+    }
+
+    streamer->retired_images->count = 0;
+    streamer->textures->count = 0;
+    vkDestroyCommandPool(vk->device, streamer->cmd_pool, NULL);
+    vkUnmapMemory(vk->device, streamer->staging_buffer->mem);
+    vkDestroyBuffer(vk->device, streamer->staging_buffer->handle, NULL);
+    vkFreeMemory(vk->device, streamer->staging_buffer->mem, NULL);
+}
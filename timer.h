@@ -0,0 +1,22 @@
+#pragma once
+
+#include <chrono>
+#include "ctk/ctk.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+static u64 get_time_ns() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+static f64 ns_to_ms(u64 ns) {
+    return ns / 1000000.0;
+}
+
+static f64 elapsed_ms(u64 start_ns) {
+    return ns_to_ms(get_time_ns() - start_ns);
+}
@@ -0,0 +1,377 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "renderer/json.h"
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+#include "ctk/containers.h"
+#include "ctk/file.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+static constexpr u32 MAX_COMPARED_STAGES = 32;
+static constexpr u32 MIN_STAGE_SAMPLES = 8;
+static constexpr u64 BOOTSTRAP_SEED = 0x9E3779B97F4A7C15ull;
+
+struct CompareOptions {
+    f64 threshold;  // Relative median increase (0.03 = 3%) a significant change must exceed to count as a regression.
+    f64 alpha;      // Significance level for both the Mann-Whitney test and the two-sided bootstrap interval.
+    u32 resamples;
+    cstr stages;    // Comma-separated stage filter; NULL compares every stage present in both result sets.
+};
+
+static constexpr CompareOptions DEFAULT_COMPARE_OPTIONS = {
+    .threshold = 0.03,
+    .alpha = 0.01,
+    .resamples = 2000,
+    .stages = NULL,
+};
+
+struct StageSamples {
+    char name[64];
+    f64 *samples;
+    u32 sample_count;
+};
+
+struct BenchmarkResults {
+    char name[64];
+    StageSamples stages[MAX_COMPARED_STAGES];
+    u32 stage_count;
+};
+
+enum struct StageVerdict {
+    UNCHANGED,
+    IMPROVED,
+    REGRESSED,
+    INSUFFICIENT_DATA,
+};
+
+struct StageComparison {
+    f64 baseline_median;
+    f64 candidate_median;
+    f64 change;     // Relative median change, candidate vs baseline.
+    f64 ci_low;
+    f64 ci_high;
+    f64 p_value;
+    StageVerdict verdict;
+};
+
+////////////////////////////////////////////////////////////
+/// Internal
+////////////////////////////////////////////////////////////
+static s32 compare_f64(const void *a, const void *b) {
+    f64 lhs = *(const f64 *)a;
+    f64 rhs = *(const f64 *)b;
+    return lhs < rhs ? -1 : lhs > rhs ? 1 : 0;
+}
+
+static f64 sorted_median(f64 *sorted, u32 count) {
+    return count % 2 == 1 ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) * 0.5;
+}
+
+// Fixed-seed xorshift64* so repeated comparisons of the same files report the same interval.
+static u64 next_random(u64 *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1Dull;
+}
+
+static BenchmarkResults load_benchmark_results(Allocator *allocator, cstr path) {
+    Array<u8> *source = read_file<u8>(allocator, path);
+    if (source == NULL)
+        CTK_FATAL("failed to read benchmark results \"%s\"", path);
+
+    JSON *json = parse_json(allocator, (cstr)source->data, source->count);
+    BenchmarkResults results = {};
+    json_string(json, json_member(json, 0, "name"), results.name, sizeof(results.name));
+
+    u32 stages_idx = json_member(json, 0, "stages");
+    u32 stage_count = json_count(json, stages_idx);
+    if (stage_count == 0)
+        CTK_FATAL("benchmark results \"%s\" contain no stages", path);
+
+    if (stage_count > MAX_COMPARED_STAGES) {
+        warning("benchmark results \"%s\" contain %u stages; only the first %u are compared", path, stage_count,
+                MAX_COMPARED_STAGES);
+        stage_count = MAX_COMPARED_STAGES;
+    }
+
+    for (u32 i = 0; i < stage_count; ++i) {
+        u32 stage_idx = json_element(json, stages_idx, i);
+        u32 samples_idx = json_member(json, stage_idx, "samples");
+        u32 sample_count = json_count(json, samples_idx);
+
+        StageSamples *stage = results.stages + results.stage_count++;
+        json_string(json, json_member(json, stage_idx, "name"), stage->name, sizeof(stage->name));
+        stage->samples = allocate<f64>(allocator, sample_count > 0 ? sample_count : 1);
+        stage->sample_count = 0;
+
+        // Frames the stage was not measured in are written as null.
+        for (u32 sample = 0; sample < sample_count; ++sample) {
+            u32 sample_idx = json_element(json, samples_idx, sample);
+            if (json_node(json, sample_idx)->type == JSONType::NUMBER)
+                stage->samples[stage->sample_count++] = json_number(json, sample_idx);
+        }
+    }
+
+    return results;
+}
+
+static StageSamples *find_stage(BenchmarkResults *results, cstr name) {
+    for (u32 i = 0; i < results->stage_count; ++i)
+        if (strcmp(results->stages[i].name, name) == 0)
+            return results->stages + i;
+
+    return NULL;
+}
+
+static bool stage_selected(cstr stages, cstr name) {
+    if (stages == NULL)
+        return true;
+
+    u32 name_length = strlen(name);
+    for (cstr start = stages; *start != '\0';) {
+        cstr end = strchr(start, ',');
+        u32 length = end != NULL ? (u32)(end - start) : strlen(start);
+        if (length == name_length && strncmp(start, name, length) == 0)
+            return true;
+
+        if (end == NULL)
+            break;
+
+        start = end + 1;
+    }
+
+    return false;
+}
+
+// Two-sided Mann-Whitney U test using the normal approximation with tie and continuity correction; with the
+// hundreds of frames a benchmark run produces the approximation is well within the precision that matters here.
+static f64 mann_whitney_p_value(StageSamples *baseline, StageSamples *candidate, Allocator *temp_mem) {
+    struct RankedSample {
+        f64 value;
+        bool baseline;
+    };
+
+    u32 n1 = baseline->sample_count;
+    u32 n2 = candidate->sample_count;
+    u32 n = n1 + n2;
+    auto ranked = allocate<RankedSample>(temp_mem, n);
+    for (u32 i = 0; i < n1; ++i)
+        ranked[i] = { baseline->samples[i], true };
+
+    for (u32 i = 0; i < n2; ++i)
+        ranked[n1 + i] = { candidate->samples[i], false };
+
+    qsort(ranked, n, sizeof(RankedSample), [](const void *a, const void *b) -> s32 {
+        return compare_f64(&((const RankedSample *)a)->value, &((const RankedSample *)b)->value);
+    });
+
+    f64 baseline_rank_sum = 0.0;
+    f64 tie_sum = 0.0;
+    for (u32 i = 0; i < n;) {
+        u32 tie_end = i + 1;
+        while (tie_end < n && ranked[tie_end].value == ranked[i].value)
+            ++tie_end;
+
+        f64 tie_count = tie_end - i;
+        f64 average_rank = (i + 1 + tie_end) * 0.5;
+        for (u32 j = i; j < tie_end; ++j)
+            if (ranked[j].baseline)
+                baseline_rank_sum += average_rank;
+
+        tie_sum += tie_count * tie_count * tie_count - tie_count;
+        i = tie_end;
+    }
+
+    f64 u = baseline_rank_sum - n1 * (n1 + 1.0) * 0.5;
+    f64 mean = n1 * (f64)n2 * 0.5;
+    f64 variance = n1 * (f64)n2 / 12.0 * ((n + 1.0) - tie_sum / (n * (n - 1.0)));
+    if (variance <= 0.0)
+        return 1.0;
+
+    f64 deviation = fabs(u - mean) - 0.5;
+    f64 z = deviation > 0.0 ? deviation / sqrt(variance) : 0.0;
+    return erfc(z / sqrt(2.0));
+}
+
+static void resample(f64 *dst, StageSamples *stage, u64 *rng) {
+    for (u32 i = 0; i < stage->sample_count; ++i)
+        dst[i] = stage->samples[next_random(rng) % stage->sample_count];
+
+    qsort(dst, stage->sample_count, sizeof(f64), compare_f64);
+}
+
+// Percentile bootstrap interval for the relative change in median frame time.
+static void bootstrap_median_change(StageSamples *baseline, StageSamples *candidate, CompareOptions *options,
+                                    f64 *ci_low, f64 *ci_high, Allocator *temp_mem) {
+    auto baseline_resample = allocate<f64>(temp_mem, baseline->sample_count);
+    auto candidate_resample = allocate<f64>(temp_mem, candidate->sample_count);
+    auto changes = allocate<f64>(temp_mem, options->resamples);
+    u64 rng = BOOTSTRAP_SEED;
+    u32 change_count = 0;
+    for (u32 i = 0; i < options->resamples; ++i) {
+        resample(baseline_resample, baseline, &rng);
+        resample(candidate_resample, candidate, &rng);
+
+        f64 baseline_median = sorted_median(baseline_resample, baseline->sample_count);
+        f64 candidate_median = sorted_median(candidate_resample, candidate->sample_count);
+        if (baseline_median > 0.0)
+            changes[change_count++] = candidate_median / baseline_median - 1.0;
+    }
+
+    if (change_count == 0) {
+        *ci_low = 0.0;
+        *ci_high = 0.0;
+        return;
+    }
+
+    qsort(changes, change_count, sizeof(f64), compare_f64);
+    u32 low = (u32)(options->alpha * 0.5 * (change_count - 1) + 0.5);
+    u32 high = (u32)((1.0 - options->alpha * 0.5) * (change_count - 1) + 0.5);
+    *ci_low = changes[low];
+    *ci_high = changes[high];
+}
+
+static StageComparison compare_stage(StageSamples *baseline, StageSamples *candidate, CompareOptions *options,
+                                     Allocator *temp_mem) {
+    StageComparison comparison = {};
+    if (baseline->sample_count < MIN_STAGE_SAMPLES || candidate->sample_count < MIN_STAGE_SAMPLES) {
+        comparison.verdict = StageVerdict::INSUFFICIENT_DATA;
+        comparison.p_value = 1.0;
+        return comparison;
+    }
+
+    push_frame(temp_mem);
+
+    auto sorted = allocate<f64>(temp_mem, baseline->sample_count > candidate->sample_count
+                                         ? baseline->sample_count
+                                         : candidate->sample_count);
+    memcpy(sorted, baseline->samples, baseline->sample_count * sizeof(f64));
+    qsort(sorted, baseline->sample_count, sizeof(f64), compare_f64);
+    comparison.baseline_median = sorted_median(sorted, baseline->sample_count);
+    memcpy(sorted, candidate->samples, candidate->sample_count * sizeof(f64));
+    qsort(sorted, candidate->sample_count, sizeof(f64), compare_f64);
+    comparison.candidate_median = sorted_median(sorted, candidate->sample_count);
+    comparison.change = comparison.baseline_median > 0.0
+                        ? comparison.candidate_median / comparison.baseline_median - 1.0
+                        : 0.0;
+
+    comparison.p_value = mann_whitney_p_value(baseline, candidate, temp_mem);
+    bootstrap_median_change(baseline, candidate, options, &comparison.ci_low, &comparison.ci_high, temp_mem);
+
+    pop_frame(temp_mem);
+
+    // A stage only counts as changed when the rank test rejects equal distributions, the bootstrap interval excludes
+    // zero, and the median moved past the threshold; any one of these alone is easily tripped by frame-time noise.
+    bool significant = comparison.p_value < options->alpha;
+    if (significant && comparison.ci_low > 0.0 && comparison.change > options->threshold)
+        comparison.verdict = StageVerdict::REGRESSED;
+    else if (significant && comparison.ci_high < 0.0 && comparison.change < -options->threshold)
+        comparison.verdict = StageVerdict::IMPROVED;
+    else
+        comparison.verdict = StageVerdict::UNCHANGED;
+
+    return comparison;
+}
+
+static cstr verdict_name(StageVerdict verdict) {
+    switch (verdict) {
+        case StageVerdict::UNCHANGED: return "ok";
+        case StageVerdict::IMPROVED: return "improved";
+        case StageVerdict::REGRESSED: return "REGRESSED";
+        case StageVerdict::INSUFFICIENT_DATA: return "too few samples";
+    }
+
+    return "unknown";
+}
+
+static void print_usage() {
+    print_line("usage:");
+    print_line("    bench_compare [--threshold <percent>] [--alpha <p>] [--resamples <count>] [--stages <a,b,...>]");
+    print_line("                  <baseline.json> <candidate.json>");
+    print_line("");
+    print_line("exits with 1 if any compared stage regressed past the threshold, 2 on invalid arguments");
+}
+
+s32 main(s32 argc, cstr *argv) {
+    Allocator *fixed_mem = create_stack_allocator(gigabyte(1));
+    Allocator *temp_mem = create_stack_allocator(fixed_mem, megabyte(256));
+
+    CompareOptions options = DEFAULT_COMPARE_OPTIONS;
+    while (argc >= 3 && strncmp(argv[1], "--", 2) == 0) {
+        if (strcmp(argv[1], "--threshold") == 0) {
+            options.threshold = atof(argv[2]) / 100.0;
+        }
+        else if (strcmp(argv[1], "--alpha") == 0) {
+            options.alpha = atof(argv[2]);
+        }
+        else if (strcmp(argv[1], "--resamples") == 0) {
+            options.resamples = (u32)atoi(argv[2]);
+        }
+        else if (strcmp(argv[1], "--stages") == 0) {
+            options.stages = argv[2];
+        }
+        else {
+            print_usage();
+            return 2;
+        }
+
+        argv += 2;
+        argc -= 2;
+    }
+
+    if (argc != 3 || options.threshold < 0.0 || options.alpha <= 0.0 || options.alpha >= 1.0 ||
+        options.resamples == 0) {
+        print_usage();
+        return 2;
+    }
+
+    BenchmarkResults baseline = load_benchmark_results(fixed_mem, argv[1]);
+    BenchmarkResults candidate = load_benchmark_results(fixed_mem, argv[2]);
+    print_line("baseline:  %s (%s)", argv[1], baseline.name);
+    print_line("candidate: %s (%s)", argv[2], candidate.name);
+    print_line("threshold: %.2f%%, alpha: %g, bootstrap resamples: %u", options.threshold * 100.0, options.alpha,
+               options.resamples);
+    print_line("");
+    print_line("%-16s %12s %12s %9s %22s %10s  %s", "stage", "base p50 ms", "cand p50 ms", "change", "ci", "p",
+               "verdict");
+
+    u32 compared_count = 0;
+    u32 regressed_count = 0;
+    for (u32 i = 0; i < baseline.stage_count; ++i) {
+        StageSamples *baseline_stage = baseline.stages + i;
+        if (!stage_selected(options.stages, baseline_stage->name))
+            continue;
+
+        StageSamples *candidate_stage = find_stage(&candidate, baseline_stage->name);
+        if (candidate_stage == NULL) {
+            warning("stage \"%s\" is missing from candidate results", baseline_stage->name);
+            continue;
+        }
+
+        StageComparison comparison = compare_stage(baseline_stage, candidate_stage, &options, temp_mem);
+        print_line("%-16s %12.4f %12.4f %+8.2f%% [%+8.2f%%, %+8.2f%%] %10.2e  %s", baseline_stage->name,
+                   comparison.baseline_median, comparison.candidate_median, comparison.change * 100.0,
+                   comparison.ci_low * 100.0, comparison.ci_high * 100.0, comparison.p_value,
+                   verdict_name(comparison.verdict));
+
+        ++compared_count;
+        if (comparison.verdict == StageVerdict::REGRESSED)
+            ++regressed_count;
+    }
+
+    if (compared_count == 0) {
+        warning("no common stages to compare");
+        return 2;
+    }
+
+    print_line("");
+    print_line("%u of %u stages regressed", regressed_count, compared_count);
+    return regressed_count > 0 ? 1 : 0;
+}
@@ -0,0 +1,538 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include "renderer/mesh.h"
+#include "renderer/gltf.h"
+#include "renderer/mesh_file.h"
+#include "renderer/mesh_optimizer.h"
+#include "renderer/meshlet.h"
+#include "renderer/mesh_simplifier.h"
+#include "renderer/vertex_quantization.h"
+#include "renderer/timer.h"
+#include "ctk/ctk.h"
+#include "ctk/memory.h"
+#include "ctk/containers.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+static constexpr u32 MAX_PRINTED_MESH_STATS = 32;
+
+struct BakeOptions {
+    bool optimize;
+    bool quantize;
+    bool meshlets;
+    bool lods;
+    VertexQuantizationLimits quantization_limits;
+};
+
+static constexpr BakeOptions DEFAULT_BAKE_OPTIONS = {
+    .optimize = true,
+    .quantize = true,
+    .meshlets = true,
+    .lods = true,
+    .quantization_limits = DEFAULT_VERTEX_QUANTIZATION_LIMITS,
+};
+
+struct BakeStats {
+    u32 mesh_count;
+    u32 vertex_count;
+    u32 index_count;     // Full detail indexes only.
+    u32 lod_index_count; // Indexes of simplified LODs.
+    u32 lod_count;       // Simplified LODs, excluding full detail.
+    u32 meshlet_count;
+    u32 meshlet_vertex_count; // Sum of all meshlets' unique vertex counts.
+    VertexCacheStats before; // Across all meshes, weighted by mesh size.
+    VertexCacheStats after;
+    u32 format_mesh_counts[(u32)VertexFormat::COUNT];
+    VertexQuantizationError max_quantization_error; // Across all quantized meshes.
+    u64 f32_vertex_size;  // Bytes vertex data would take as VertexFormat::F32.
+    u64 vertex_size;      // Bytes of vertex data written, excluding padding.
+    u64 source_data_size; // Bytes written by write_gltf_primitives(), for sizing benchmark buffers.
+    u64 data_size;        // Bytes of mesh, vertex and index data written, excluding header and padding.
+    f64 total_ms;
+};
+
+struct LoadTimes {
+    f64 min_ms;
+    f64 avg_ms;
+};
+
+////////////////////////////////////////////////////////////
+/// Baking
+////////////////////////////////////////////////////////////
+static BakeStats bake_gltf(cstr gltf_path, cstr mesh_path, BakeOptions *options, u32 thread_count, Allocator *temp) {
+    BakeStats stats = {};
+    u64 start = get_time_ns();
+
+    push_frame(temp);
+
+    GLTFScene *scene = open_gltf(temp, gltf_path);
+    auto data = allocate<u8>(temp, scene->data_size);
+    write_gltf_primitives(scene, data, thread_count, temp);
+
+    // Gather converted primitives into contiguous vertex and index streams; each primitive becomes one mesh.
+    auto meshes = allocate<MeshFileMesh>(temp, scene->primitives->count);
+    auto vertex_data = allocate<u8>(temp, scene->vertex_count * sizeof(Vertex) +
+                                          scene->primitives->count * MESH_FILE_ALIGNMENT);
+    // Each mesh's simplified LODs take at most as many indexes as its full detail LOD.
+    auto indexes = allocate<u32>(temp, scene->index_count * 2);
+    auto lods = allocate<MeshLOD>(temp, scene->primitives->count * MESH_MAX_LODS);
+    u32 max_meshlets = 0;
+    for (u32 i = 0; i < scene->primitives->count; ++i)
+        max_meshlets += max_meshlet_count(scene->primitives->data[i].index_count);
+
+    auto meshlets = allocate<Meshlet>(temp, max_meshlets);
+    u64 vertex_data_size = 0;
+    u32 vertex_count = 0;
+    u32 index_count = 0;
+    u32 lod_count = 0;
+    u32 meshlet_count = 0;
+    f64 misses_before = 0;
+    f64 misses_after = 0;
+
+    for (u32 mesh_idx = 0; mesh_idx < scene->meshes->count; ++mesh_idx) {
+        GLTFMesh *gltf_mesh = scene->meshes->data + mesh_idx;
+
+        for (u32 i = 0; i < gltf_mesh->primitive_count; ++i) {
+            u32 primitive_idx = gltf_mesh->first_primitive + i;
+            GLTFPrimitive *primitive = scene->primitives->data + primitive_idx;
+            MeshFileMesh *mesh = meshes + primitive_idx;
+            *mesh = {};
+
+            if (gltf_mesh->primitive_count > 1)
+                snprintf(mesh->name, MESH_FILE_MAX_NAME_SIZE, "%s.%u", gltf_mesh->name, i);
+            else
+                snprintf(mesh->name, MESH_FILE_MAX_NAME_SIZE, "%s", gltf_mesh->name);
+
+            mesh->vertex_count = primitive->vertex_count;
+            mesh->first_index = index_count;
+            mesh->index_count = primitive->index_count;
+
+            auto mesh_vertexes = (Vertex *)(data + primitive->vertex_data_offset);
+            auto mesh_indexes = (u32 *)(data + primitive->index_data_offset);
+            if (options->optimize) {
+                MeshOptimizationStats optimization_stats =
+                    optimize_mesh(mesh_vertexes, &mesh->vertex_count, mesh_indexes, mesh->index_count, temp);
+                if (scene->primitives->count <= MAX_PRINTED_MESH_STATS)
+                    print_mesh_optimization_stats(mesh->name, &optimization_stats);
+
+                // Accumulate cache misses so totals are weighted by mesh size.
+                misses_before += optimization_stats.before.acmr * (mesh->index_count / 3);
+                misses_after += optimization_stats.after.acmr * (mesh->index_count / 3);
+            }
+
+            // Simplified LODs follow the full detail indexes in the mesh's index range.
+            u32 lod_index_count = 0;
+            if (options->lods) {
+                mesh->first_lod = lod_count;
+                mesh->lod_count = generate_mesh_lods(mesh_vertexes, mesh->vertex_count, mesh_indexes,
+                                                     mesh->index_count, lods + lod_count,
+                                                     indexes + index_count + mesh->index_count, temp);
+                for (u32 j = 1; j < mesh->lod_count; ++j)
+                    lod_index_count += lods[lod_count + j].index_count;
+
+                if (scene->primitives->count <= MAX_PRINTED_MESH_STATS)
+                    print_mesh_lods(mesh->name, lods + lod_count, mesh->lod_count);
+
+                lod_count += mesh->lod_count;
+                stats.lod_count += mesh->lod_count - 1;
+                stats.lod_index_count += lod_index_count;
+            }
+
+            // Meshlets reorder indexes in place, so they are built after vertex cache optimization. Bounds are
+            // calculated from f32 vertexes, before quantization.
+            if (options->meshlets) {
+                mesh->first_meshlet = meshlet_count;
+                mesh->meshlet_count = build_meshlets(mesh_vertexes, mesh->vertex_count, mesh_indexes,
+                                                     mesh->index_count, meshlets + meshlet_count, temp);
+                for (u32 j = 0; j < mesh->meshlet_count; ++j)
+                    stats.meshlet_vertex_count += meshlets[meshlet_count + j].vertex_count;
+
+                meshlet_count += mesh->meshlet_count;
+            }
+
+            // Vertexes are written in the smallest format whose measured error is within limits.
+            calculate_mesh_bounds(mesh, mesh_vertexes);
+            vertex_data_size = align_mesh_file_offset(vertex_data_size);
+            mesh->vertex_offset = (u32)vertex_data_size;
+            mesh->vertex_format = VertexFormat::F32;
+
+            if (options->quantize) {
+                VertexQuantizationError error = {};
+                mesh->vertex_format =
+                    select_vertex_format(mesh_vertexes, mesh->vertex_count, mesh->bounds_min,
+                                         mesh->bounds_max - mesh->bounds_min, &options->quantization_limits,
+                                         (QuantizedVertex *)(vertex_data + vertex_data_size), &error);
+
+                if (mesh->vertex_format == VertexFormat::F32) {
+                    warning("mesh \"%s\" exceeds quantization error limits (position %g, uv %g, normal %g degrees); "
+                            "keeping f32 vertexes", mesh->name, error.position, error.uv, error.normal);
+                }
+                else {
+                    VertexQuantizationError *max_error = &stats.max_quantization_error;
+                    if (error.position > max_error->position) max_error->position = error.position;
+                    if (error.uv > max_error->uv) max_error->uv = error.uv;
+                    if (error.normal > max_error->normal) max_error->normal = error.normal;
+                }
+            }
+
+            u32 mesh_vertex_size = mesh->vertex_count * vertex_format_size(mesh->vertex_format);
+            if (mesh->vertex_format == VertexFormat::F32)
+                memcpy(vertex_data + vertex_data_size, mesh_vertexes, mesh_vertex_size);
+
+            memcpy(indexes + index_count, mesh_indexes, mesh->index_count * sizeof(u32));
+
+            ++stats.format_mesh_counts[(u32)mesh->vertex_format];
+            stats.f32_vertex_size += mesh->vertex_count * sizeof(Vertex);
+            stats.vertex_size += mesh_vertex_size;
+            vertex_data_size += mesh_vertex_size;
+
+            stats.index_count += mesh->index_count;
+            mesh->index_count += lod_index_count;
+            vertex_count += mesh->vertex_count;
+            index_count += mesh->index_count;
+        }
+    }
+
+    MeshFileSectionData sections[] = {
+        {
+            .type = MeshFileSectionType::MESHES,
+            .element_size = sizeof(MeshFileMesh),
+            .data = meshes,
+            .size = scene->primitives->count * sizeof(MeshFileMesh),
+        },
+        {
+            .type = MeshFileSectionType::VERTEXES,
+            .element_size = 1,
+            .data = vertex_data,
+            .size = vertex_data_size,
+        },
+        {
+            .type = MeshFileSectionType::INDEXES,
+            .element_size = sizeof(u32),
+            .data = indexes,
+            .size = index_count * sizeof(u32),
+        },
+        {
+            .type = MeshFileSectionType::MESHLETS,
+            .element_size = sizeof(Meshlet),
+            .data = meshlets,
+            .size = meshlet_count * sizeof(Meshlet),
+        },
+        {
+            .type = MeshFileSectionType::LODS,
+            .element_size = sizeof(MeshLOD),
+            .data = lods,
+            .size = lod_count * sizeof(MeshLOD),
+        },
+    };
+
+    // Optional sections are left out when empty.
+    u32 section_count = 0;
+    for (u32 i = 0; i < CTK_ARRAY_SIZE(sections); ++i)
+        if (sections[i].size > 0 || sections[i].type <= MeshFileSectionType::INDEXES)
+            sections[section_count++] = sections[i];
+
+    if (!write_mesh_file(mesh_path, sections, section_count))
+        CTK_FATAL("failed to write mesh file \"%s\"", mesh_path);
+
+    stats.mesh_count = scene->primitives->count;
+    stats.vertex_count = vertex_count;
+    stats.meshlet_count = meshlet_count;
+    stats.source_data_size = scene->data_size;
+
+    if (options->optimize && stats.index_count > 0) {
+        u32 triangle_count = stats.index_count / 3;
+        stats.before = { (f32)(misses_before / triangle_count), (f32)(misses_before / scene->vertex_count) };
+        stats.after = { (f32)(misses_after / triangle_count), (f32)(misses_after / vertex_count) };
+    }
+    for (u32 i = 0; i < section_count; ++i)
+        stats.data_size += sections[i].size;
+
+    close_gltf(scene);
+    pop_frame(temp);
+
+    stats.total_ms = elapsed_ms(start);
+    return stats;
+}
+
+static void print_bake_stats(cstr gltf_path, cstr mesh_path, BakeStats *stats, BakeOptions *options) {
+    print_line("baked \"%s\" -> \"%s\" in %.2fms: %u meshes, %u vertexes, %u indexes, %llu bytes", gltf_path, mesh_path,
+               stats->total_ms, stats->mesh_count, stats->vertex_count, stats->index_count, stats->data_size);
+
+    if (options->optimize) {
+        print_line("    vertex cache (%u entries): ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", DEFAULT_VERTEX_CACHE_SIZE,
+                   stats->before.acmr, stats->after.acmr, stats->before.atvr, stats->after.atvr);
+    }
+
+    if (options->lods) {
+        print_line("    %u LODs, %u LOD indexes (%.1f%% of full detail)", stats->lod_count, stats->lod_index_count,
+                   stats->index_count > 0 ? 100.0 * stats->lod_index_count / stats->index_count : 0.0);
+    }
+
+    if (options->meshlets && stats->meshlet_count > 0) {
+        print_line("    %u meshlets (max %u vertexes, %u triangles): avg %.1f vertexes, %.1f triangles",
+                   stats->meshlet_count, MESHLET_MAX_VERTEXES, MESHLET_MAX_TRIANGLES,
+                   (f32)stats->meshlet_vertex_count / stats->meshlet_count,
+                   (f32)stats->index_count / 3 / stats->meshlet_count);
+    }
+
+    if (options->quantize) {
+        print_line("    vertex data: %llu -> %llu bytes (%.1f%%)", stats->f32_vertex_size, stats->vertex_size,
+                   stats->f32_vertex_size > 0 ? 100.0 * stats->vertex_size / stats->f32_vertex_size : 100.0);
+        for (u32 i = 0; i < (u32)VertexFormat::COUNT; ++i)
+            if (stats->format_mesh_counts[i] > 0)
+                print_line("    %u meshes %s", stats->format_mesh_counts[i], vertex_format_name((VertexFormat)i));
+
+        print_line("    max quantization error: position %g, uv %g, normal %g degrees",
+                   stats->max_quantization_error.position, stats->max_quantization_error.uv,
+                   stats->max_quantization_error.normal);
+    }
+}
+
+////////////////////////////////////////////////////////////
+/// Benchmark
+////////////////////////////////////////////////////////////
+// Writes a glTF scene of mesh_count separate grid meshes, each with POSITION, NORMAL and TEXCOORD_0 attributes and u16
+// indexes, laid out the way exporters typically write them (one buffer view per accessor).
+static void generate_bench_scene(cstr gltf_path, cstr bin_name, cstr bin_path, u32 mesh_count) {
+    static constexpr u32 GRID_SIZE = 16;
+    static constexpr u32 VERTEX_COUNT = (GRID_SIZE + 1) * (GRID_SIZE + 1);
+    static constexpr u32 INDEX_COUNT = GRID_SIZE * GRID_SIZE * 6;
+    static constexpr u32 POSITION_SIZE = VERTEX_COUNT * sizeof(f32) * 3;
+    static constexpr u32 NORMAL_SIZE = VERTEX_COUNT * sizeof(f32) * 3;
+    static constexpr u32 UV_SIZE = VERTEX_COUNT * sizeof(f32) * 2;
+    static constexpr u32 INDEX_SIZE = INDEX_COUNT * sizeof(u16);
+    static constexpr u32 MESH_SIZE = POSITION_SIZE + NORMAL_SIZE + UV_SIZE + INDEX_SIZE;
+
+    FILE *bin = fopen(bin_path, "wb");
+    FILE *gltf = fopen(gltf_path, "w");
+    if (bin == NULL || gltf == NULL)
+        CTK_FATAL("failed to create benchmark scene \"%s\"", gltf_path);
+
+    // Binary buffer
+    for (u32 mesh = 0; mesh < mesh_count; ++mesh) {
+        f32 height = (f32)(mesh % 7) * 0.1f;
+
+        for (u32 y = 0; y <= GRID_SIZE; ++y)
+        for (u32 x = 0; x <= GRID_SIZE; ++x) {
+            f32 position[] = { (f32)x / GRID_SIZE, height * (x % 2), (f32)y / GRID_SIZE };
+            fwrite(position, sizeof(position), 1, bin);
+        }
+
+        for (u32 i = 0; i < VERTEX_COUNT; ++i) {
+            f32 normal[] = { 0, 1, 0 };
+            fwrite(normal, sizeof(normal), 1, bin);
+        }
+
+        for (u32 y = 0; y <= GRID_SIZE; ++y)
+        for (u32 x = 0; x <= GRID_SIZE; ++x) {
+            f32 uv[] = { (f32)x / GRID_SIZE, (f32)y / GRID_SIZE };
+            fwrite(uv, sizeof(uv), 1, bin);
+        }
+
+        for (u32 y = 0; y < GRID_SIZE; ++y)
+        for (u32 x = 0; x < GRID_SIZE; ++x) {
+            u16 i0 = (u16)(y * (GRID_SIZE + 1) + x);
+            u16 i1 = (u16)(i0 + 1);
+            u16 i2 = (u16)(i0 + GRID_SIZE + 1);
+            u16 i3 = (u16)(i2 + 1);
+            u16 quad[] = { i0, i2, i1, i1, i2, i3 };
+            fwrite(quad, sizeof(quad), 1, bin);
+        }
+    }
+
+    // JSON
+    fprintf(gltf, "{\n  \"asset\": { \"version\": \"2.0\" },\n");
+    fprintf(gltf, "  \"buffers\": [ { \"uri\": \"%s\", \"byteLength\": %u } ],\n", bin_name, MESH_SIZE * mesh_count);
+
+    fprintf(gltf, "  \"bufferViews\": [\n");
+    for (u32 mesh = 0; mesh < mesh_count; ++mesh) {
+        u32 base = mesh * MESH_SIZE;
+        fprintf(gltf, "    { \"buffer\": 0, \"byteOffset\": %u, \"byteLength\": %u },\n", base, POSITION_SIZE);
+        fprintf(gltf, "    { \"buffer\": 0, \"byteOffset\": %u, \"byteLength\": %u },\n", base + POSITION_SIZE,
+                NORMAL_SIZE);
+        fprintf(gltf, "    { \"buffer\": 0, \"byteOffset\": %u, \"byteLength\": %u },\n",
+                base + POSITION_SIZE + NORMAL_SIZE, UV_SIZE);
+        fprintf(gltf, "    { \"buffer\": 0, \"byteOffset\": %u, \"byteLength\": %u }%s\n",
+                base + POSITION_SIZE + NORMAL_SIZE + UV_SIZE, INDEX_SIZE, mesh + 1 < mesh_count ? "," : "");
+    }
+    fprintf(gltf, "  ],\n");
+
+    fprintf(gltf, "  \"accessors\": [\n");
+    for (u32 mesh = 0; mesh < mesh_count; ++mesh) {
+        u32 view = mesh * 4;
+        fprintf(gltf, "    { \"bufferView\": %u, \"componentType\": 5126, \"count\": %u, \"type\": \"VEC3\" },\n",
+                view + 0, VERTEX_COUNT);
+        fprintf(gltf, "    { \"bufferView\": %u, \"componentType\": 5126, \"count\": %u, \"type\": \"VEC3\" },\n",
+                view + 1, VERTEX_COUNT);
+        fprintf(gltf, "    { \"bufferView\": %u, \"componentType\": 5126, \"count\": %u, \"type\": \"VEC2\" },\n",
+                view + 2, VERTEX_COUNT);
+        fprintf(gltf, "    { \"bufferView\": %u, \"componentType\": 5123, \"count\": %u, \"type\": \"SCALAR\" }%s\n",
+                view + 3, INDEX_COUNT, mesh + 1 < mesh_count ? "," : "");
+    }
+    fprintf(gltf, "  ],\n");
+
+    fprintf(gltf, "  \"meshes\": [\n");
+    for (u32 mesh = 0; mesh < mesh_count; ++mesh) {
+        u32 accessor = mesh * 4;
+        fprintf(gltf, "    { \"name\": \"grid_%u\", \"primitives\": [ { \"attributes\": { \"POSITION\": %u, "
+                      "\"NORMAL\": %u, \"TEXCOORD_0\": %u }, \"indices\": %u } ] }%s\n",
+                mesh, accessor, accessor + 1, accessor + 2, accessor + 3, mesh + 1 < mesh_count ? "," : "");
+    }
+    fprintf(gltf, "  ]\n}\n");
+
+    fclose(bin);
+    fclose(gltf);
+}
+
+// Both loaders are timed up to the point where vertex and index data sits in upload-ready memory (dst stands in for
+// mapped staging memory); the GPU copy that follows is identical for both formats.
+static f64 time_gltf_load(cstr path, u8 *dst, u32 thread_count, Allocator *temp) {
+    u64 start = get_time_ns();
+    push_frame(temp);
+
+    GLTFScene *scene = open_gltf(temp, path);
+    write_gltf_primitives(scene, dst, thread_count, temp);
+    close_gltf(scene);
+
+    pop_frame(temp);
+    return elapsed_ms(start);
+}
+
+static f64 time_baked_load(cstr path, u8 *dst) {
+    u64 start = get_time_ns();
+
+    MeshFile mesh_file = {};
+    if (!open_mesh_file(&mesh_file, path))
+        CTK_FATAL("failed to open mesh file \"%s\"", path);
+
+    u64 offset = 0;
+    for (u32 i = 0; i < mesh_file.header->mesh_count; ++i) {
+        MeshFileMesh *mesh = mesh_file.meshes + i;
+        u32 vertex_size = mesh->vertex_count * vertex_format_size(mesh->vertex_format);
+        u32 index_size = mesh->index_count * sizeof(u32);
+
+        memcpy(dst + offset, mesh_file.vertex_data + mesh->vertex_offset, vertex_size);
+        offset = align_mesh_file_offset(offset + vertex_size);
+        memcpy(dst + offset, mesh_file.indexes + mesh->first_index, index_size);
+        offset = align_mesh_file_offset(offset + index_size);
+    }
+
+    close_mesh_file(&mesh_file);
+    return elapsed_ms(start);
+}
+
+static LoadTimes summarize_load_times(f64 *times, u32 count) {
+    LoadTimes result = { times[0], 0 };
+
+    for (u32 i = 0; i < count; ++i) {
+        if (times[i] < result.min_ms)
+            result.min_ms = times[i];
+
+        result.avg_ms += times[i];
+    }
+
+    result.avg_ms /= count;
+    return result;
+}
+
+static void run_benchmark(u32 mesh_count, cstr dir, u32 iterations, u32 thread_count, Allocator *temp) {
+    char gltf_path[512] = {};
+    char bin_path[512] = {};
+    char mesh_path[512] = {};
+    snprintf(gltf_path, sizeof(gltf_path), "%s/bench_scene.gltf", dir);
+    snprintf(bin_path, sizeof(bin_path), "%s/bench_scene.bin", dir);
+    snprintf(mesh_path, sizeof(mesh_path), "%s/bench_scene.mesh", dir);
+
+    generate_bench_scene(gltf_path, "bench_scene.bin", bin_path, mesh_count);
+    BakeOptions options = DEFAULT_BAKE_OPTIONS;
+    BakeStats bake_stats = bake_gltf(gltf_path, mesh_path, &options, thread_count, temp);
+    print_bake_stats(gltf_path, mesh_path, &bake_stats, &options);
+
+    push_frame(temp);
+
+    // Baked data has smaller vertexes but adds LOD indexes, so size for whichever format needs more (baked data_size
+    // also counts mesh, meshlet and LOD tables, which are not copied).
+    u64 baked_size = bake_stats.data_size + bake_stats.mesh_count * 2 * MESH_FILE_ALIGNMENT;
+    u64 dst_size = baked_size > bake_stats.source_data_size ? baked_size : bake_stats.source_data_size;
+    auto dst = allocate<u8>(temp, (u32)dst_size);
+    auto gltf_times = allocate<f64>(temp, iterations);
+    auto baked_times = allocate<f64>(temp, iterations);
+
+    // Alternate formats each iteration so both see the same page cache state.
+    for (u32 i = 0; i < iterations; ++i) {
+        gltf_times[i] = time_gltf_load(gltf_path, dst, thread_count, temp);
+        baked_times[i] = time_baked_load(mesh_path, dst);
+    }
+
+    LoadTimes gltf = summarize_load_times(gltf_times, iterations);
+    LoadTimes baked = summarize_load_times(baked_times, iterations);
+    print_line("%u meshes, %u iterations (%u threads for glTF conversion):", mesh_count, iterations, thread_count);
+    print_line("    glTF:  min %8.2fms  avg %8.2fms", gltf.min_ms, gltf.avg_ms);
+    print_line("    baked: min %8.2fms  avg %8.2fms", baked.min_ms, baked.avg_ms);
+    print_line("    speedup (avg): %.2fx", baked.avg_ms > 0 ? gltf.avg_ms / baked.avg_ms : 0.0);
+
+    pop_frame(temp);
+}
+
+////////////////////////////////////////////////////////////
+/// Main
+////////////////////////////////////////////////////////////
+static void print_usage() {
+    print_line("usage:");
+    print_line("    mesh_baker [--no-optimize] [--no-quantize] [--no-meshlets] [--no-lods] <input.gltf> <output.mesh>");
+    print_line("    mesh_baker --bench <mesh_count> <output_dir> [iterations]");
+}
+
+s32 main(s32 argc, cstr *argv) {
+    Allocator *fixed_mem = create_stack_allocator(gigabyte(1));
+    Allocator *temp_mem = create_stack_allocator(fixed_mem, megabyte(512));
+    u32 thread_count = std::thread::hardware_concurrency();
+    if (thread_count == 0)
+        thread_count = 1;
+
+    if (argc >= 4 && strcmp(argv[1], "--bench") == 0) {
+        u32 mesh_count = (u32)atoi(argv[2]);
+        u32 iterations = argc >= 5 ? (u32)atoi(argv[4]) : 10;
+        run_benchmark(mesh_count, argv[3], iterations > 0 ? iterations : 1, thread_count, temp_mem);
+        return 0;
+    }
+
+    BakeOptions options = DEFAULT_BAKE_OPTIONS;
+    while (argc >= 2 && strncmp(argv[1], "--", 2) == 0) {
+        if (strcmp(argv[1], "--no-optimize") == 0) {
+            options.optimize = false;
+        }
+        else if (strcmp(argv[1], "--no-quantize") == 0) {
+            options.quantize = false;
+        }
+        else if (strcmp(argv[1], "--no-meshlets") == 0) {
+            options.meshlets = false;
+        }
+        else if (strcmp(argv[1], "--no-lods") == 0) {
+            options.lods = false;
+        }
+        else {
+            print_usage();
+            return 1;
+        }
+
+        ++argv;
+        --argc;
+    }
+
+    if (argc != 3) {
+        print_usage();
+        return 1;
+    }
+
+    BakeStats stats = bake_gltf(argv[1], argv[2], &options, thread_count, temp_mem);
+    print_bake_stats(argv[1], argv[2], &stats, &options);
+
+    return 0;
+}
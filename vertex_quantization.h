@@ -0,0 +1,313 @@
+#pragma once
+
+#include <math.h>
+#include <string.h>
+#include <cfloat>
+#include "renderer/mesh.h"
+#include "ctk/ctk.h"
+#include "ctk/math.h"
+
+using namespace ctk;
+
+////////////////////////////////////////////////////////////
+/// Data
+////////////////////////////////////////////////////////////
+// Largest acceptable quantization error for each attribute; meshes whose measured error exceeds any limit keep
+// VertexFormat::F32.
+struct VertexQuantizationLimits {
+    f32 position; // Model-space units.
+    f32 uv;       // UV units.
+    f32 normal;   // Degrees.
+};
+
+static constexpr VertexQuantizationLimits DEFAULT_VERTEX_QUANTIZATION_LIMITS = {
+    .position = 0.001f,
+    .uv = 1.0f / 1024.0f, // Half a texel of a 512x512 texture.
+    .normal = 0.5f,
+};
+
+// Largest error measured across all vertexes of a mesh, in the same units as VertexQuantizationLimits.
+struct VertexQuantizationError {
+    f32 position;
+    f32 uv;
+    f32 normal;
+};
+
+////////////////////////////////////////////////////////////
+/// Internal
+////////////////////////////////////////////////////////////
+static u16 quantize_unorm16(f32 value) {
+    value = value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+    return (u16)(value * 65535.0f + 0.5f);
+}
+
+static f32 dequantize_unorm16(u16 value) {
+    return value / 65535.0f;
+}
+
+// Matches Vulkan's snorm conversion: -32768 and -32767 both map to -1.
+static f32 dequantize_snorm16(s16 value) {
+    f32 result = value / 32767.0f;
+    return result < -1.0f ? -1.0f : result;
+}
+
+// Round-to-nearest-even; values too large for half precision become infinity.
+static u16 f32_to_half(f32 value) {
+    u32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    u32 sign = (bits >> 16) & 0x8000;
+    u32 abs_bits = bits & 0x7FFFFFFF;
+
+    // Infinity and NaN.
+    if (abs_bits >= 0x7F800000)
+        return (u16)(sign | 0x7C00 | (abs_bits > 0x7F800000 ? 0x200 : 0));
+
+    // Rounds to 65520 or larger.
+    if (abs_bits >= 0x477FF000)
+        return (u16)(sign | 0x7C00);
+
+    // Half subnormals.
+    if (abs_bits < 0x38800000) {
+        if (abs_bits <= 0x33000000)
+            return (u16)sign;
+
+        u32 exponent = abs_bits >> 23;
+        u32 mantissa = (abs_bits & 0x7FFFFF) | 0x800000;
+        u32 shift = 126 - exponent;
+        u32 result = mantissa >> shift;
+        u32 remainder = mantissa & ((1u << shift) - 1);
+        u32 halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (result & 1)))
+            ++result;
+
+        return (u16)(sign | result);
+    }
+
+    // Normals; rebias exponent from 127 to 15 and round off low 13 mantissa bits.
+    u32 result = (abs_bits - 0x38000000) >> 13;
+    u32 remainder = abs_bits & 0x1FFF;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (result & 1)))
+        ++result;
+
+    return (u16)(sign | result);
+}
+
+static f32 half_to_f32(u16 value) {
+    u32 sign = (u32)(value & 0x8000) << 16;
+    u32 exponent = (value >> 10) & 0x1F;
+    u32 mantissa = value & 0x3FF;
+
+    if (exponent == 0) {
+        f32 result = ldexpf((f32)mantissa, -24);
+        return sign ? -result : result;
+    }
+
+    u32 bits = exponent == 31
+               ? sign | 0x7F800000 | (mantissa << 13)
+               : sign | ((exponent + 112) << 23) | (mantissa << 13);
+
+    f32 result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+static Vec3<f32> normalize_vertex_normal(Vec3<f32> normal) {
+    f32 length = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+    return length > 0.0f ? Vec3<f32> { normal.x / length, normal.y / length, normal.z / length } : Vec3<f32> {};
+}
+
+// Shaders reading quantized normals must decode them the same way:
+//     vec3 n = vec3(e, 1 - abs(e.x) - abs(e.y));
+//     n.xy += mix(vec2(max(-n.z, 0)), vec2(-max(-n.z, 0)), greaterThanEqual(n.xy, vec2(0)));
+//     n = normalize(n);
+static Vec3<f32> decode_octahedral_normal(s16 *encoded) {
+    f32 x = dequantize_snorm16(encoded[0]);
+    f32 y = dequantize_snorm16(encoded[1]);
+    f32 z = 1.0f - fabsf(x) - fabsf(y);
+    f32 t = z < 0.0f ? -z : 0.0f;
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+    return normalize_vertex_normal({ x, y, z });
+}
+
+// Projects normal onto the octahedron and unfolds its lower half, then picks whichever of the 4 surrounding snorm16
+// values decodes closest to the original normal rather than simply rounding.
+static void encode_octahedral_normal(Vec3<f32> normal, s16 *encoded) {
+    f32 l1_length = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+    if (l1_length == 0.0f) {
+        encoded[0] = 0;
+        encoded[1] = 0;
+        return;
+    }
+
+    f32 x = normal.x / l1_length;
+    f32 y = normal.y / l1_length;
+    if (normal.z < 0.0f) {
+        f32 folded_x = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        f32 folded_y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = folded_x;
+        y = folded_y;
+    }
+
+    Vec3<f32> unit_normal = normalize_vertex_normal(normal);
+    f32 base_x = floorf(x * 32767.0f);
+    f32 base_y = floorf(y * 32767.0f);
+    f32 best_dot = -FLT_MAX;
+
+    for (u32 i = 0; i < 4; ++i) {
+        f32 candidate_x = base_x + (i & 1);
+        f32 candidate_y = base_y + (i >> 1);
+        s16 candidate[2] = {
+            (s16)(candidate_x < -32767.0f ? -32767.0f : candidate_x > 32767.0f ? 32767.0f : candidate_x),
+            (s16)(candidate_y < -32767.0f ? -32767.0f : candidate_y > 32767.0f ? 32767.0f : candidate_y),
+        };
+
+        Vec3<f32> decoded = decode_octahedral_normal(candidate);
+        f32 dot = decoded.x * unit_normal.x + decoded.y * unit_normal.y + decoded.z * unit_normal.z;
+        if (dot > best_dot) {
+            best_dot = dot;
+            encoded[0] = candidate[0];
+            encoded[1] = candidate[1];
+        }
+    }
+}
+
+static bool uvs_in_unit_range(Vertex *vertexes, u32 vertex_count) {
+    for (u32 i = 0; i < vertex_count; ++i) {
+        Vec2<f32> uv = vertexes[i].uv;
+        if (uv.x < 0.0f || uv.x > 1.0f || uv.y < 0.0f || uv.y > 1.0f)
+            return false;
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////
+/// Interface
+////////////////////////////////////////////////////////////
+// Positions are quantized relative to position_offset and position_scale, normally the minimum and extent of the mesh's
+// bounds so quantized positions use the full unorm16 range on every axis.
+static void quantize_vertexes(Vertex *vertexes, u32 vertex_count, VertexFormat format, Vec3<f32> position_offset,
+                              Vec3<f32> position_scale, QuantizedVertex *quantized_vertexes)
+{
+    CTK_ASSERT(format != VertexFormat::F32);
+
+    // Axes with no extent quantize to 0.
+    Vec3<f32> inverse_scale = {
+        position_scale.x > 0.0f ? 1.0f / position_scale.x : 0.0f,
+        position_scale.y > 0.0f ? 1.0f / position_scale.y : 0.0f,
+        position_scale.z > 0.0f ? 1.0f / position_scale.z : 0.0f,
+    };
+
+    for (u32 i = 0; i < vertex_count; ++i) {
+        Vertex *vertex = vertexes + i;
+        QuantizedVertex *quantized_vertex = quantized_vertexes + i;
+
+        quantized_vertex->position[0] = quantize_unorm16((vertex->position.x - position_offset.x) * inverse_scale.x);
+        quantized_vertex->position[1] = quantize_unorm16((vertex->position.y - position_offset.y) * inverse_scale.y);
+        quantized_vertex->position[2] = quantize_unorm16((vertex->position.z - position_offset.z) * inverse_scale.z);
+        quantized_vertex->position[3] = 0;
+
+        encode_octahedral_normal(vertex->normal, quantized_vertex->normal);
+
+        if (format == VertexFormat::QUANTIZED_UNORM_UV) {
+            quantized_vertex->uv[0] = quantize_unorm16(vertex->uv.x);
+            quantized_vertex->uv[1] = quantize_unorm16(vertex->uv.y);
+        }
+        else {
+            quantized_vertex->uv[0] = f32_to_half(vertex->uv.x);
+            quantized_vertex->uv[1] = f32_to_half(vertex->uv.y);
+        }
+    }
+}
+
+// Decodes a quantized vertex the same way the GPU's vertex fetch and the mesh's dequantization matrix do.
+static Vertex dequantize_vertex(QuantizedVertex *quantized_vertex, VertexFormat format, Vec3<f32> position_offset,
+                                Vec3<f32> position_scale)
+{
+    Vertex vertex = {};
+    vertex.position = {
+        position_offset.x + dequantize_unorm16(quantized_vertex->position[0]) * position_scale.x,
+        position_offset.y + dequantize_unorm16(quantized_vertex->position[1]) * position_scale.y,
+        position_offset.z + dequantize_unorm16(quantized_vertex->position[2]) * position_scale.z,
+    };
+    vertex.normal = decode_octahedral_normal(quantized_vertex->normal);
+
+    if (format == VertexFormat::QUANTIZED_UNORM_UV)
+        vertex.uv = { dequantize_unorm16(quantized_vertex->uv[0]), dequantize_unorm16(quantized_vertex->uv[1]) };
+    else
+        vertex.uv = { half_to_f32(quantized_vertex->uv[0]), half_to_f32(quantized_vertex->uv[1]) };
+
+    return vertex;
+}
+
+static VertexQuantizationError measure_quantization_error(Vertex *vertexes, QuantizedVertex *quantized_vertexes,
+                                                          u32 vertex_count, VertexFormat format,
+                                                          Vec3<f32> position_offset, Vec3<f32> position_scale)
+{
+    VertexQuantizationError error = {};
+    f64 min_normal_dot = 1.0;
+
+    for (u32 i = 0; i < vertex_count; ++i) {
+        Vertex *vertex = vertexes + i;
+        Vertex decoded = dequantize_vertex(quantized_vertexes + i, format, position_offset, position_scale);
+
+        f32 position_errors[] = {
+            fabsf(decoded.position.x - vertex->position.x),
+            fabsf(decoded.position.y - vertex->position.y),
+            fabsf(decoded.position.z - vertex->position.z),
+        };
+        for (u32 j = 0; j < CTK_ARRAY_SIZE(position_errors); ++j)
+            if (position_errors[j] > error.position)
+                error.position = position_errors[j];
+
+        // Non-finite UVs (e.g. from half overflow) compare false against everything, so test for them explicitly.
+        f32 uv_errors[] = { fabsf(decoded.uv.x - vertex->uv.x), fabsf(decoded.uv.y - vertex->uv.y) };
+        for (u32 j = 0; j < CTK_ARRAY_SIZE(uv_errors); ++j)
+            if (!(uv_errors[j] <= error.uv))
+                error.uv = isfinite(uv_errors[j]) ? uv_errors[j] : FLT_MAX;
+
+        // Degenerate normals have no direction to preserve.
+        Vec3<f32> normal = normalize_vertex_normal(vertex->normal);
+        if (normal.x != 0.0f || normal.y != 0.0f || normal.z != 0.0f) {
+            f64 dot = (f64)decoded.normal.x * normal.x + (f64)decoded.normal.y * normal.y +
+                      (f64)decoded.normal.z * normal.z;
+            if (dot < min_normal_dot)
+                min_normal_dot = dot;
+        }
+    }
+
+    min_normal_dot = min_normal_dot < -1.0 ? -1.0 : min_normal_dot;
+    error.normal = (f32)(acos(min_normal_dot) * 180.0 / 3.14159265358979323846);
+    return error;
+}
+
+// Quantizes vertexes into quantized_vertexes using the smallest vertex format whose measured error is within limits;
+// unorm16 UVs are used when all UVs are in [0, 1], and half-float UVs otherwise. Returns VertexFormat::F32 if no
+// quantized format is accurate enough, in which case quantized_vertexes is left with unspecified contents.
+static VertexFormat select_vertex_format(Vertex *vertexes, u32 vertex_count, Vec3<f32> position_offset,
+                                         Vec3<f32> position_scale, VertexQuantizationLimits *limits,
+                                         QuantizedVertex *quantized_vertexes, VertexQuantizationError *error)
+{
+    VertexFormat format = uvs_in_unit_range(vertexes, vertex_count)
+                          ? VertexFormat::QUANTIZED_UNORM_UV
+                          : VertexFormat::QUANTIZED_HALF_UV;
+
+    quantize_vertexes(vertexes, vertex_count, format, position_offset, position_scale, quantized_vertexes);
+    *error = measure_quantization_error(vertexes, quantized_vertexes, vertex_count, format, position_offset,
+                                        position_scale);
+
+    if (error->position > limits->position || error->uv > limits->uv || error->normal > limits->normal)
+        return VertexFormat::F32;
+
+    return format;
+}
+
+static cstr vertex_format_name(VertexFormat format) {
+    switch (format) {
+        case VertexFormat::F32:                return "f32";
+        case VertexFormat::QUANTIZED_UNORM_UV: return "quantized (unorm16 uv)";
+        case VertexFormat::QUANTIZED_HALF_UV:  return "quantized (half uv)";
+        default:                               return "unknown";
+    }
+}
@@ -1,13 +1,19 @@
 #pragma once
 
+#include <atomic>
 #include <vulkan/vulkan.h>
 #include "ctk/ctk.h"
 #include "ctk/memory.h"
 #include "ctk/containers.h"
 #include "ctk/file.h"
+#include "ctk/task.h"
+#include "renderer/mapped_file.h"
+#include "renderer/spirv_reflection.h"
 #include "renderer/vulkan_debug.h"
 #include "renderer/vulkan_device_features.h"
 #include "renderer/platform.h"
+#include "renderer/profiler.h"
+#include "renderer/render_stats.h"
 
 using namespace ctk;
 
@@ -28,6 +34,7 @@ using namespace ctk;
 struct Instance {
     VkInstance handle;
     VkDebugUtilsMessengerEXT debug_messenger;
+    u32 api_version; // 1.2 when the loader supports it, otherwise the loader's 1.0 or 1.1.
 };
 
 struct QueueFamilyIndexes {
@@ -40,14 +47,26 @@ struct PhysicalDevice {
     QueueFamilyIndexes queue_family_idxs;
 
     VkPhysicalDeviceType type;
+    u32 vendor_id;
+    u32 device_id;
+    u8 pipeline_cache_uuid[VK_UUID_SIZE];
     u32 min_uniform_buffer_offset_alignment;
     u32 max_push_constant_size;
+    bool timestamps_supported; // On all graphics and compute queues.
+    f32 timestamp_period;      // Nanoseconds per timestamp tick.
 
     VkPhysicalDeviceFeatures features;
     VkPhysicalDeviceMemoryProperties mem_properties;
     VkFormat depth_image_format;
+
+    // Descriptor indexing (Vulkan 1.2) support required for bindless descriptors.
+    bool descriptor_indexing_supported;
+    u32 max_update_after_bind_sampled_images;
+    u32 max_update_after_bind_storage_buffers;
 };
 
+// Headless swapchains have no handle or image views; only image_count, image_format and extent are set, and the
+// framebuffer images standing in for swapchain images are owned by the renderer.
 struct Swapchain {
     VkSwapchainKHR handle;
     FixedArray<VkImageView, 4> image_views;
@@ -86,7 +105,9 @@ struct Image {
     VkImage handle;
     VkImageView view;
     VkDeviceMemory mem;
+    VkDeviceSize mem_size;
     VkExtent3D extent;
+    u32 mip_levels;
 };
 
 struct ImageSampler {
@@ -132,6 +153,12 @@ struct FramebufferInfo {
 struct Shader {
     VkShaderModule handle;
     VkShaderStageFlagBits stage;
+    ShaderReflection reflection;
+};
+
+struct ShaderInfo {
+    cstr spirv_path;
+    VkShaderStageFlagBits stage;
 };
 
 struct DescriptorPoolInfo {
@@ -159,8 +186,41 @@ struct DescriptorBinding {
     };
 };
 
+// Writes to one descriptor set, batched with others by update_descriptor_sets().
+struct DescriptorSetUpdate {
+    VkDescriptorSet set;
+    DescriptorBinding *bindings;
+    u32 binding_count;
+    u32 first_binding;
+};
+
+// Packed data a descriptor update template reads; one element per descriptor, in binding order.
+union DescriptorTemplateData {
+    VkDescriptorImageInfo image;
+    VkDescriptorBufferInfo buffer;
+};
+
+// Update templates are core in Vulkan 1.1; on 1.0 instances handle is VK_NULL_HANDLE and sets are written from entries
+// with vkUpdateDescriptorSets() instead.
+struct DescriptorUpdateTemplate {
+    VkDescriptorUpdateTemplate handle;
+    u32 descriptor_count; // DescriptorTemplateData elements per set.
+    Array<VkDescriptorUpdateTemplateEntry> *entries; // Only on Vulkan 1.0.
+};
+
+static constexpr u32 MAX_SPECIALIZATION_CONSTANTS = 16;
+
+// Specialization constant values for one shader stage. Only 32-bit constants (bool, int, uint and float) are
+// supported, so each constant occupies one element of data.
+struct SpecializationConstants {
+    VkShaderStageFlagBits stage;
+    FixedArray<VkSpecializationMapEntry, MAX_SPECIALIZATION_CONSTANTS> entries;
+    FixedArray<u32, MAX_SPECIALIZATION_CONSTANTS> data;
+};
+
 struct PipelineInfo {
     FixedArray<Shader *, 8> shaders;
+    FixedArray<SpecializationConstants, 8> specialization_constants; // At most one entry per stage.
     FixedArray<VkPipelineColorBlendAttachmentState, 8> color_blend_attachments;
 
     Array<VkDescriptorSetLayout> *descriptor_set_layouts;
@@ -182,6 +242,97 @@ struct Pipeline {
     VkPipelineLayout layout;
 };
 
+struct PipelineBatchInfo {
+    RenderPass *render_pass;
+    u32 subpass;
+    PipelineInfo *info;
+};
+
+// Pipeline cache files wrap the driver's cache data in a header guarding against truncated or corrupt files, since
+// drivers only validate the VkPipelineCacheHeaderVersionOne at the start of the data.
+static constexpr u32 PIPELINE_CACHE_FILE_MAGIC = 0x48435052; // "RPCH"
+static constexpr u32 PIPELINE_CACHE_FILE_VERSION = 1;
+
+struct PipelineCacheFileHeader {
+    u32 magic;
+    u32 version;
+    u32 data_size;
+    u32 data_hash;
+};
+
+struct PipelineCache {
+    VkPipelineCache handle;
+    cstr path;
+    bool warm; // Initialized from a valid cache file.
+    u32 loaded_size;
+};
+
+static constexpr u32 GPU_QUERY_MAX_SCOPE_DEPTH = 16;
+
+// Collected by GPU scopes that ask for pipeline statistics; results are written in GPUScopeStatistics order.
+static constexpr VkQueryPipelineStatisticFlags GPU_QUERY_PIPELINE_STATISTICS =
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+struct GPUQueriesInfo {
+    u32 max_scopes;    // Per frame, including the frame scope itself.
+    u32 frame_latency; // Frames between recording a frame's queries and reading them; at least the frames in flight.
+    bool pipeline_statistics;
+};
+
+struct GPUScopeStatistics {
+    u64 vertex_invocations;
+    u64 clipping_invocations;
+    u64 clipping_primitives;
+    u64 fragment_invocations;
+};
+
+struct GPUScope {
+    cstr name; // Must outlive the frame's results; scopes are named with string literals.
+    u32 depth;
+    bool pipeline_statistics;
+
+    // Set once results are read; times are converted to the get_time_ns() clock.
+    u64 start_ns;
+    u64 end_ns;
+    f64 ms;
+    GPUScopeStatistics statistics;
+};
+
+// Scope 0 is the frame scope opened by begin_gpu_query_frame().
+struct GPUQueryFrame {
+    u64 frame_index;
+    GPUScope *scopes;
+    u32 scope_count;
+    bool resolved;
+};
+
+// Timestamp and pipeline statistics queries for a ring of frame_latency + 1 frames. Every call is a no-op when the
+// device doesn't support timestamps.
+struct GPUQueries {
+    GPUQueriesInfo info;
+    VkQueryPool timestamp_pool;
+    VkQueryPool statistics_pool; // VK_NULL_HANDLE unless pipeline statistics were requested and are enabled.
+    GPUQueryFrame *frames;
+    u64 *query_results;
+    u64 frame_count;
+    u32 dropped_frame_count;
+
+    // Recording
+    GPUQueryFrame *recording;
+    u32 open_scopes[GPU_QUERY_MAX_SCOPE_DEPTH];
+    u32 open_scope_count;
+    u32 statistics_scope;
+
+    // GPU timestamps are mapped to CPU time through one pair of readings taken at creation.
+    f64 timestamp_period;
+    u64 calibration_ticks;
+    u64 calibration_ns;
+    u32 profiler_track;
+};
+
 struct VulkanInfo {
     u32 max_buffers;
     u32 max_regions;
@@ -191,6 +342,16 @@ struct VulkanInfo {
     u32 max_shaders;
     u32 max_pipelines;
     bool enable_validation;
+    bool enable_descriptor_indexing;
+    cstr pipeline_cache_path; // NULL disables loading/saving the pipeline cache.
+
+    // Renders into offscreen images instead of a window swapchain, skipping surface and present entirely; no platform
+    // window is needed.
+    struct {
+        bool enabled;
+        VkExtent2D extent;
+        u32 image_count; // Offscreen images cycled through in place of swapchain images.
+    } headless;
 };
 
 struct Vulkan {
@@ -211,10 +372,14 @@ struct Vulkan {
 
     // State
     Instance instance;
-    VkSurfaceKHR surface;
+    VkSurfaceKHR surface; // VK_NULL_HANDLE when headless.
+    bool headless;
 
     PhysicalDevice physical_device;
     VkDevice device;
+    bool descriptor_indexing_enabled;
+    bool multi_draw_indirect_enabled; // Enabled whenever supported; otherwise indirect draw count must be 1.
+    bool pipeline_statistics_enabled; // Pipeline statistics queries that can stay active across secondary buffers.
 
     struct {
         VkQueue graphics;
@@ -222,6 +387,24 @@ struct Vulkan {
     } queue;
 
     Swapchain swapchain;
+    PipelineCache pipeline_cache;
+};
+
+// Batch objects are allocated from vk->pool up front on the calling thread; worker threads only initialize them.
+struct ShaderBatchState {
+    Vulkan *vk;
+    ShaderInfo *infos;
+    Shader **shaders;
+    u32 count;
+    std::atomic<u32> next_idx;
+};
+
+struct PipelineBatchState {
+    Vulkan *vk;
+    PipelineBatchInfo *infos;
+    Pipeline **pipelines;
+    u32 count;
+    std::atomic<u32> next_idx;
 };
 
 ////////////////////////////////////////////////////////////
@@ -291,6 +474,11 @@ static u32 find_memory_type_index(VkPhysicalDeviceMemoryProperties mem_props, Vk
     CTK_FATAL("failed to find memory type that satisfies property requirements");
 }
 
+static u32 mip_dimension(u32 dimension, u32 level) {
+    u32 mip_dim = dimension >> level;
+    return mip_dim > 0 ? mip_dim : 1;
+}
+
 ////////////////////////////////////////////////////////////
 /// Initialization
 ////////////////////////////////////////////////////////////
@@ -313,6 +501,25 @@ static void init_instance(Vulkan *vk, bool enable_validation) {
         debug_messenger_info.pUserData = NULL;
     }
 
+    // Bindless descriptors and their shaders (compiled for vulkan1.2 by _sync_shaders.bat) need Vulkan 1.2; everything
+    // else runs on 1.0. Asking a 1.0 loader for a newer version fails instance creation, so the instance asks for no
+    // more than the loader supports. The loader only exports vkEnumerateInstanceVersion from 1.1 on, so it's looked
+    // up rather than linked against.
+    u32 loader_version = VK_API_VERSION_1_0;
+    auto enumerate_instance_version =
+        (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(NULL, "vkEnumerateInstanceVersion");
+    if (enumerate_instance_version != NULL)
+        validate_result(enumerate_instance_version(&loader_version), "failed to query Vulkan loader version");
+
+    if (loader_version >= VK_API_VERSION_1_2) {
+        instance->api_version = VK_API_VERSION_1_2;
+    }
+    else {
+        instance->api_version = VK_MAKE_VERSION(VK_VERSION_MAJOR(loader_version), VK_VERSION_MINOR(loader_version), 0);
+        warning("Vulkan loader only supports %u.%u; bindless descriptors are unavailable",
+                VK_VERSION_MAJOR(loader_version), VK_VERSION_MINOR(loader_version));
+    }
+
     VkApplicationInfo app_info = {};
     app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
     app_info.pNext = NULL;
@@ -320,11 +527,15 @@ static void init_instance(Vulkan *vk, bool enable_validation) {
     app_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     app_info.pEngineName = "renderer";
     app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    app_info.apiVersion = VK_API_VERSION_1_0;
+    app_info.apiVersion = instance->api_version;
 
     FixedArray<cstr, 16> extensions = {};
-    push(&extensions, VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
-    push(&extensions, VK_KHR_SURFACE_EXTENSION_NAME);
+    if (!vk->headless) {
+#ifdef VK_USE_PLATFORM_WIN32_KHR
+        push(&extensions, VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+#endif
+        push(&extensions, VK_KHR_SURFACE_EXTENSION_NAME);
+    }
     if (enable_validation)
         push(&extensions, VK_EXT_DEBUG_UTILS_EXTENSION_NAME); // Validation
 
@@ -352,12 +563,19 @@ static void init_instance(Vulkan *vk, bool enable_validation) {
 }
 
 static void init_surface(Vulkan *vk, Platform *platform) {
+#ifdef VK_USE_PLATFORM_WIN32_KHR
+    if (platform->window == NULL)
+        CTK_FATAL("window surface requires a platform window; use headless mode for windowless platforms");
+
     VkWin32SurfaceCreateInfoKHR info = {};
     info.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
     info.hwnd = platform->window->handle;
     info.hinstance = platform->instance;
     validate_result(vkCreateWin32SurfaceKHR(vk->instance.handle, &info, nullptr, &vk->surface),
                     "failed to get win32 surface");
+#else
+    CTK_FATAL("window surfaces are only supported on win32; use headless mode");
+#endif
 }
 
 static QueueFamilyIndexes find_queue_family_idxs(Vulkan *vk, VkPhysicalDevice physical_device) {
@@ -374,6 +592,10 @@ static QueueFamilyIndexes find_queue_family_idxs(Vulkan *vk, VkPhysicalDevice ph
         if (queue_family_props->queueFlags & VK_QUEUE_GRAPHICS_BIT)
             queue_family_idxs.graphics = queue_family_idx;
 
+        // Nothing is presented when headless; present queue aliases graphics queue (set below).
+        if (vk->headless)
+            continue;
+
         VkBool32 present_supported = VK_FALSE;
         vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, queue_family_idx, vk->surface, &present_supported);
 
@@ -381,6 +603,9 @@ static QueueFamilyIndexes find_queue_family_idxs(Vulkan *vk, VkPhysicalDevice ph
             queue_family_idxs.present = queue_family_idx;
     }
 
+    if (vk->headless)
+        queue_family_idxs.present = queue_family_idxs.graphics;
+
     pop_frame(vk->mem.temp);
     return queue_family_idxs;
 }
@@ -450,18 +675,56 @@ static void load_physical_device(Vulkan *vk, PhysicalDeviceFeature *requested_fe
         VkPhysicalDeviceProperties properties = {};
         vkGetPhysicalDeviceProperties(vk_physical_device, &properties);
         physical_device->type = properties.deviceType;
+        physical_device->vendor_id = properties.vendorID;
+        physical_device->device_id = properties.deviceID;
+        memcpy(physical_device->pipeline_cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
         physical_device->min_uniform_buffer_offset_alignment = properties.limits.minUniformBufferOffsetAlignment;
         physical_device->max_push_constant_size = properties.limits.maxPushConstantsSize;
+        physical_device->timestamps_supported = properties.limits.timestampComputeAndGraphics == VK_TRUE;
+        physical_device->timestamp_period = properties.limits.timestampPeriod;
 
 
         vkGetPhysicalDeviceFeatures(vk_physical_device, &physical_device->features);
         vkGetPhysicalDeviceMemoryProperties(vk_physical_device, &physical_device->mem_properties);
         physical_device->depth_image_format = find_depth_image_format(physical_device->handle);
+
+        // Descriptor Indexing; the 1.2 feature and property queries are only valid when both the instance and device
+        // are 1.2.
+        if (vk->instance.api_version >= VK_API_VERSION_1_2 && properties.apiVersion >= VK_API_VERSION_1_2) {
+            VkPhysicalDeviceVulkan12Features features_12 = {};
+            features_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+            VkPhysicalDeviceFeatures2 features_2 = {};
+            features_2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features_2.pNext = &features_12;
+            vkGetPhysicalDeviceFeatures2(vk_physical_device, &features_2);
+
+            physical_device->descriptor_indexing_supported =
+                features_12.descriptorIndexing &&
+                features_12.runtimeDescriptorArray &&
+                features_12.descriptorBindingPartiallyBound &&
+                features_12.descriptorBindingSampledImageUpdateAfterBind &&
+                features_12.descriptorBindingStorageBufferUpdateAfterBind &&
+                features_12.shaderSampledImageArrayNonUniformIndexing &&
+                features_12.shaderStorageBufferArrayNonUniformIndexing;
+
+            VkPhysicalDeviceVulkan12Properties properties_12 = {};
+            properties_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+            VkPhysicalDeviceProperties2 properties_2 = {};
+            properties_2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+            properties_2.pNext = &properties_12;
+            vkGetPhysicalDeviceProperties2(vk_physical_device, &properties_2);
+
+            physical_device->max_update_after_bind_sampled_images =
+                properties_12.maxDescriptorSetUpdateAfterBindSampledImages;
+            physical_device->max_update_after_bind_storage_buffers =
+                properties_12.maxDescriptorSetUpdateAfterBindStorageBuffers;
+        }
     }
 
     // Sort out discrete and integrated gpus.
     auto discrete_devices = create_array<PhysicalDevice *>(vk->mem.temp, physical_devices->count);
     auto integrated_devices = create_array<PhysicalDevice *>(vk->mem.temp, physical_devices->count);
+    auto other_devices = create_array<PhysicalDevice *>(vk->mem.temp, physical_devices->count);
 
     for (u32 i = 0; i < physical_devices->count; ++i) {
         PhysicalDevice *physical_device = physical_devices->data + i;
@@ -470,15 +733,22 @@ static void load_physical_device(Vulkan *vk, PhysicalDeviceFeature *requested_fe
             push(discrete_devices, physical_device);
         else if (physical_device->type == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU)
             push(integrated_devices, physical_device);
+        else
+            push(other_devices, physical_device); // Virtual and CPU devices (e.g. lavapipe on CI machines).
     }
 
-    // Find suitable discrete device, or fallback to an integrated device.
+    // Find suitable discrete device, or fallback to an integrated device, then any other device.
     PhysicalDevice *suitable_device = find_suitable_physical_device(vk, discrete_devices, requested_features,
                                                                     requested_feature_count);
 
     if (suitable_device == NULL) {
         suitable_device = find_suitable_physical_device(vk, integrated_devices, requested_features,
                                                         requested_feature_count);
+    }
+
+    if (suitable_device == NULL) {
+        suitable_device = find_suitable_physical_device(vk, other_devices, requested_features,
+                                                        requested_feature_count);
 
         if (suitable_device == NULL)
             CTK_FATAL("failed to find any suitable device");
@@ -489,7 +759,9 @@ static void load_physical_device(Vulkan *vk, PhysicalDeviceFeature *requested_fe
     pop_frame(vk->mem.temp);
 }
 
-static void init_device(Vulkan *vk, PhysicalDeviceFeature *requested_features, u32 requested_feature_count) {
+static void init_device(Vulkan *vk, PhysicalDeviceFeature *requested_features, u32 requested_feature_count,
+                        bool enable_descriptor_indexing)
+{
     FixedArray<VkDeviceQueueCreateInfo, 2> queue_infos = {};
     push(&queue_infos, default_queue_info(vk->physical_device.queue_family_idxs.graphics));
 
@@ -498,11 +770,24 @@ static void init_device(Vulkan *vk, PhysicalDeviceFeature *requested_features, u
         push(&queue_infos, default_queue_info(vk->physical_device.queue_family_idxs.present));
 
     cstr extensions[] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+    u32 extension_count = vk->headless ? 0 : CTK_ARRAY_SIZE(extensions);
     VkBool32 enabled_features[(s32)PhysicalDeviceFeature::COUNT] = {};
 
     for (u32 i = 0; i < requested_feature_count; ++i)
         enabled_features[(s32)requested_features[i]] = VK_TRUE;
 
+    // Optional features.
+    vk->multi_draw_indirect_enabled = vk->physical_device.features.multiDrawIndirect == VK_TRUE;
+    if (vk->multi_draw_indirect_enabled)
+        enabled_features[(s32)PhysicalDeviceFeature::multiDrawIndirect] = VK_TRUE;
+
+    vk->pipeline_statistics_enabled = vk->physical_device.features.pipelineStatisticsQuery == VK_TRUE &&
+                                      vk->physical_device.features.inheritedQueries == VK_TRUE;
+    if (vk->pipeline_statistics_enabled) {
+        enabled_features[(s32)PhysicalDeviceFeature::pipelineStatisticsQuery] = VK_TRUE;
+        enabled_features[(s32)PhysicalDeviceFeature::inheritedQueries] = VK_TRUE;
+    }
+
     VkDeviceCreateInfo logical_device_info = {};
     logical_device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     logical_device_info.flags = 0;
@@ -510,10 +795,31 @@ static void init_device(Vulkan *vk, PhysicalDeviceFeature *requested_features, u
     logical_device_info.pQueueCreateInfos = queue_infos.data;
     logical_device_info.enabledLayerCount = 0;
     logical_device_info.ppEnabledLayerNames = NULL;
-    logical_device_info.enabledExtensionCount = CTK_ARRAY_SIZE(extensions);
-    logical_device_info.ppEnabledExtensionNames = extensions;
+    logical_device_info.enabledExtensionCount = extension_count;
+    logical_device_info.ppEnabledExtensionNames = extension_count > 0 ? extensions : NULL;
 
     logical_device_info.pEnabledFeatures = (VkPhysicalDeviceFeatures *)enabled_features;
+
+    // Enable descriptor indexing features if requested and supported.
+    VkPhysicalDeviceVulkan12Features features_12 = {};
+    features_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vk->descriptor_indexing_enabled =
+        enable_descriptor_indexing && vk->physical_device.descriptor_indexing_supported;
+
+    if (vk->descriptor_indexing_enabled) {
+        features_12.descriptorIndexing = VK_TRUE;
+        features_12.runtimeDescriptorArray = VK_TRUE;
+        features_12.descriptorBindingPartiallyBound = VK_TRUE;
+        features_12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        features_12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        features_12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        features_12.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+        logical_device_info.pNext = &features_12;
+    }
+    else if (enable_descriptor_indexing) {
+        warning("descriptor indexing requested but not supported by physical device");
+    }
+
     validate_result(vkCreateDevice(vk->physical_device.handle, &logical_device_info, NULL, &vk->device),
                     "failed to create logical device");
 }
@@ -533,6 +839,9 @@ static VkSurfaceCapabilitiesKHR get_surface_capabilities(Vulkan *vk) {
 }
 
 static VkExtent2D get_surface_extent(Vulkan *vk) {
+    if (vk->headless)
+        return vk->swapchain.extent;
+
     return get_surface_capabilities(vk).currentExtent;
 }
 
@@ -668,6 +977,20 @@ static void init_swapchain(Vulkan *vk) {
     pop_frame(vk->mem.temp);
 }
 
+static void init_headless_swapchain(Vulkan *vk, VkExtent2D extent, u32 image_count) {
+    if (extent.width == 0 || extent.height == 0)
+        CTK_FATAL("headless extent must be non-zero");
+
+    if (image_count == 0 || image_count > get_size(&vk->swapchain.image_views))
+        CTK_FATAL("headless image count must be in range [1, %u]", get_size(&vk->swapchain.image_views));
+
+    vk->swapchain.handle = VK_NULL_HANDLE;
+    vk->swapchain.image_views.count = 0;
+    vk->swapchain.image_count = image_count;
+    vk->swapchain.image_format = VK_FORMAT_B8G8R8A8_UNORM; // Same format preferred for window swapchains.
+    vk->swapchain.extent = extent;
+}
+
 static VkCommandPool create_cmd_pool(Vulkan *vk) {
     VkCommandPoolCreateInfo info = {};
     info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -680,7 +1003,118 @@ static VkCommandPool create_cmd_pool(Vulkan *vk) {
     return cmd_pool;
 }
 
+static u32 hash_pipeline_cache_data(u8 *data, u32 size) {
+    // FNV-1a
+    u32 hash = 2166136261u;
+    for (u32 i = 0; i < size; ++i)
+        hash = (hash ^ data[i]) * 16777619u;
+    return hash;
+}
+
+static u8 *read_pipeline_cache_file(cstr path, u32 *size) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    *size = (u32)ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    auto data = (u8 *)malloc(*size);
+    if (fread(data, 1, *size, file) != *size) {
+        free(data);
+        data = NULL;
+    }
+
+    fclose(file);
+    return data;
+}
+
+static u8 *discard_pipeline_cache_file(cstr path, cstr reason) {
+    warning("discarding pipeline cache \"%s\": %s", path, reason);
+    return NULL;
+}
+
+// Returns driver cache data within file data, or NULL with a warning if the file is stale or corrupt.
+static u8 *validate_pipeline_cache_file(Vulkan *vk, u8 *file_data, u32 file_size, u32 *data_size) {
+    cstr path = vk->pipeline_cache.path;
+    auto file_header = (PipelineCacheFileHeader *)file_data;
+
+    if (file_size < sizeof(PipelineCacheFileHeader) || file_header->magic != PIPELINE_CACHE_FILE_MAGIC)
+        return discard_pipeline_cache_file(path, "not a pipeline cache file");
+
+    if (file_header->version != PIPELINE_CACHE_FILE_VERSION)
+        return discard_pipeline_cache_file(path, "unsupported file version");
+
+    u8 *data = file_data + sizeof(PipelineCacheFileHeader);
+    if (file_header->data_size != file_size - sizeof(PipelineCacheFileHeader))
+        return discard_pipeline_cache_file(path, "file is truncated");
+
+    if (file_header->data_hash != hash_pipeline_cache_data(data, file_header->data_size))
+        return discard_pipeline_cache_file(path, "data hash mismatch");
+
+    // Driver cache data must have been created by the same device and driver version.
+    VkPipelineCacheHeaderVersionOne cache_header = {};
+    if (file_header->data_size < sizeof(cache_header))
+        return discard_pipeline_cache_file(path, "missing driver cache header");
+
+    memcpy(&cache_header, data, sizeof(cache_header));
+    if (cache_header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        cache_header.headerSize < sizeof(cache_header) || cache_header.headerSize > file_header->data_size)
+    {
+        return discard_pipeline_cache_file(path, "invalid driver cache header");
+    }
+
+    PhysicalDevice *physical_device = &vk->physical_device;
+    if (cache_header.vendorID != physical_device->vendor_id || cache_header.deviceID != physical_device->device_id)
+        return discard_pipeline_cache_file(path, "created by a different device");
+
+    if (memcmp(cache_header.pipelineCacheUUID, physical_device->pipeline_cache_uuid, VK_UUID_SIZE) != 0)
+        return discard_pipeline_cache_file(path, "created by a different driver version");
+
+    *data_size = file_header->data_size;
+    return data;
+}
+
+static void init_pipeline_cache(Vulkan *vk, cstr path) {
+    vk->pipeline_cache.path = path;
+
+    u8 *file_data = NULL;
+    u32 file_size = 0;
+    u8 *data = NULL;
+    u32 data_size = 0;
+
+    if (path != NULL) {
+        file_data = read_pipeline_cache_file(path, &file_size);
+        if (file_data != NULL)
+            data = validate_pipeline_cache_file(vk, file_data, file_size, &data_size);
+    }
+
+    VkPipelineCacheCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    info.initialDataSize = data_size;
+    info.pInitialData = data;
+    VkResult result = vkCreatePipelineCache(vk->device, &info, NULL, &vk->pipeline_cache.handle);
+
+    // Driver can still reject data that passed validation; start with an empty cache instead.
+    if (result != VK_SUCCESS && data != NULL) {
+        discard_pipeline_cache_file(path, "rejected by driver");
+        data = NULL;
+        data_size = 0;
+        info.initialDataSize = 0;
+        info.pInitialData = NULL;
+        result = vkCreatePipelineCache(vk->device, &info, NULL, &vk->pipeline_cache.handle);
+    }
+
+    validate_result(result, "failed to create pipeline cache");
+    vk->pipeline_cache.warm = data != NULL;
+    vk->pipeline_cache.loaded_size = data_size;
+
+    free(file_data);
+}
+
 static Vulkan *create_vulkan(Allocator *module_mem, Platform *platform, VulkanInfo info) {
+    PROFILE_FUNCTION();
     // Allocate memory for vk module.s
     auto vk = allocate<Vulkan>(module_mem, 1);
     vk->mem.module = module_mem;
@@ -693,20 +1127,66 @@ static Vulkan *create_vulkan(Allocator *module_mem, Platform *platform, VulkanIn
     vk->pool.pipeline = create_pool<Pipeline>(vk->mem.module, info.max_pipelines);
 
     // Initialization
+    vk->headless = info.headless.enabled;
     init_instance(vk, info.enable_validation);
-    init_surface(vk, platform);
+    if (!vk->headless)
+        init_surface(vk, platform);
 
     // Physical/Logical Devices
     auto requested_feature = PhysicalDeviceFeature::geometryShader;
     load_physical_device(vk, &requested_feature, 1);
-    init_device(vk, &requested_feature, 1);
+    init_device(vk, &requested_feature, 1, info.enable_descriptor_indexing);
     init_queues(vk);
 
-    init_swapchain(vk);
+    if (vk->headless)
+        init_headless_swapchain(vk, info.headless.extent, info.headless.image_count);
+    else
+        init_swapchain(vk);
+
+    init_pipeline_cache(vk, info.pipeline_cache_path);
 
     return vk;
 }
 
+// Writes pipeline cache back to its file so the next launch can skip compiling pipelines; call on shutdown.
+static void save_pipeline_cache(Vulkan *vk) {
+    PROFILE_FUNCTION();
+    cstr path = vk->pipeline_cache.path;
+    if (path == NULL)
+        return;
+
+    size_t data_size = 0;
+    validate_result(vkGetPipelineCacheData(vk->device, vk->pipeline_cache.handle, &data_size, NULL),
+                    "failed to get pipeline cache data size");
+
+    auto data = (u8 *)malloc(data_size);
+    validate_result(vkGetPipelineCacheData(vk->device, vk->pipeline_cache.handle, &data_size, data),
+                    "failed to get pipeline cache data");
+
+    PipelineCacheFileHeader header = {
+        .magic = PIPELINE_CACHE_FILE_MAGIC,
+        .version = PIPELINE_CACHE_FILE_VERSION,
+        .data_size = (u32)data_size,
+        .data_hash = hash_pipeline_cache_data(data, (u32)data_size),
+    };
+
+    FILE *file = fopen(path, "wb");
+    bool success = file != NULL &&
+                   fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(data, 1, data_size, file) == data_size;
+
+    if (file != NULL)
+        fclose(file);
+
+    // Don't leave a partially written cache behind.
+    if (!success) {
+        warning("failed to write pipeline cache \"%s\"", path);
+        remove(path);
+    }
+
+    free(data);
+}
+
 ////////////////////////////////////////////////////////////
 /// Memory
 ////////////////////////////////////////////////////////////
@@ -723,6 +1203,7 @@ allocate_device_memory(Vulkan *vk, VkMemoryRequirements mem_reqs, VkMemoryProper
 }
 
 static Buffer *create_buffer(Vulkan *vk, BufferInfo *buffer_info) {
+    PROFILE_FUNCTION();
     auto buffer = allocate(vk->pool.buffer);
     buffer->size = buffer_info->size;
 
@@ -772,6 +1253,19 @@ static void write_to_host_region(VkDevice device, Region *region, u32 offset, vo
     vkMapMemory(device, region->buffer->mem, region->offset + offset, size, 0, &mapped_mem);
     memcpy(mapped_mem, data, size);
     vkUnmapMemory(device, region->buffer->mem);
+    count_render_stat(RenderCounter::UPLOADED_BYTES, size);
+}
+
+// Maps entire host region; caller writes directly into returned memory and must call unmap_host_region() when done.
+static u8 *map_host_region(VkDevice device, Region *region) {
+    void *mapped_mem = NULL;
+    validate_result(vkMapMemory(device, region->buffer->mem, region->offset, region->size, 0, &mapped_mem),
+                    "failed to map host region");
+    return (u8 *)mapped_mem;
+}
+
+static void unmap_host_region(VkDevice device, Region *region) {
+    vkUnmapMemory(device, region->buffer->mem);
 }
 
 static void write_to_device_region(Vulkan *vk, VkCommandBuffer cmd_buf,
@@ -779,6 +1273,7 @@ static void write_to_device_region(Vulkan *vk, VkCommandBuffer cmd_buf,
                                    Region *region, u32 offset,
                                    void *data, u32 size)
 {
+    PROFILE_FUNCTION();
     write_to_host_region(vk->device, staging_region, staging_offset, data, size);
 
     VkBufferCopy copy = {};
@@ -789,25 +1284,35 @@ static void write_to_device_region(Vulkan *vk, VkCommandBuffer cmd_buf,
     vkCmdCopyBuffer(cmd_buf, staging_region->buffer->handle, region->buffer->handle, 1, &copy);
 }
 
-static Image *create_image(Vulkan *vk, ImageInfo info) {
-    Image *image = allocate(vk->pool.image);
+static void init_image(Vulkan *vk, Image *image, ImageInfo info) {
     validate_result(vkCreateImage(vk->device, &info.image, NULL, &image->handle), "failed to create image");
 
     image->extent = info.image.extent;
+    image->mip_levels = info.image.mipLevels;
 
     // Allocate / Bind Memory
     VkMemoryRequirements mem_reqs = {};
     vkGetImageMemoryRequirements(vk->device, image->handle, &mem_reqs);
     image->mem = allocate_device_memory(vk, mem_reqs, info.mem_property_flags);
+    image->mem_size = mem_reqs.size;
     validate_result(vkBindImageMemory(vk->device, image->handle, image->mem, 0), "failed to bind image memory");
 
     info.view.image = image->handle;
     validate_result(vkCreateImageView(vk->device, &info.view, NULL, &image->view), "failed to create image view");
+}
 
+static Image *create_image(Vulkan *vk, ImageInfo info) {
+    PROFILE_FUNCTION();
+    Image *image = allocate(vk->pool.image);
+    init_image(vk, image, info);
     return image;
 }
 
-static void write_to_image(Vulkan *vk, VkCommandBuffer cmd_buf, Region *region, u32 offset, Image *image) {
+// Writes mip levels [0, level_count) of image from region, with each level's data at offset + mip_offsets[level].
+static void write_mips_to_image(Vulkan *vk, VkCommandBuffer cmd_buf, Region *region, u32 offset, u32 *mip_offsets,
+                                u32 level_count, Image *image)
+{
+    PROFILE_FUNCTION();
     VkImageMemoryBarrier pre_mem_barrier = {};
     pre_mem_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     pre_mem_barrier.srcAccessMask = 0;
@@ -819,7 +1324,7 @@ static void write_to_image(Vulkan *vk, VkCommandBuffer cmd_buf, Region *region,
     pre_mem_barrier.image = image->handle;
     pre_mem_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     pre_mem_barrier.subresourceRange.baseMipLevel = 0;
-    pre_mem_barrier.subresourceRange.levelCount = 1;
+    pre_mem_barrier.subresourceRange.levelCount = level_count;
     pre_mem_barrier.subresourceRange.baseArrayLayer = 0;
     pre_mem_barrier.subresourceRange.layerCount = 1;
     vkCmdPipelineBarrier(cmd_buf,
@@ -830,20 +1335,28 @@ static void write_to_image(Vulkan *vk, VkCommandBuffer cmd_buf, Region *region,
                          0, NULL, // Buffer Memory Barriers
                          1, &pre_mem_barrier); // Image Memory Barriers
 
-    VkBufferImageCopy copy = {};
-    copy.bufferOffset = offset;
-    copy.bufferRowLength = 0;
-    copy.bufferImageHeight = 0;
-    copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    copy.imageSubresource.mipLevel = 0;
-    copy.imageSubresource.baseArrayLayer = 0;
-    copy.imageSubresource.layerCount = 1;
-    copy.imageOffset.x = 0;
-    copy.imageOffset.y = 0;
-    copy.imageOffset.z = 0;
-    copy.imageExtent = image->extent;
+    FixedArray<VkBufferImageCopy, 16> copies = {};
+    CTK_ASSERT(level_count <= get_size(&copies));
+
+    for (u32 level = 0; level < level_count; ++level) {
+        VkBufferImageCopy *copy = push(&copies);
+        copy->bufferOffset = offset + mip_offsets[level];
+        copy->bufferRowLength = 0;
+        copy->bufferImageHeight = 0;
+        copy->imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copy->imageSubresource.mipLevel = level;
+        copy->imageSubresource.baseArrayLayer = 0;
+        copy->imageSubresource.layerCount = 1;
+        copy->imageOffset.x = 0;
+        copy->imageOffset.y = 0;
+        copy->imageOffset.z = 0;
+        copy->imageExtent.width = mip_dimension(image->extent.width, level);
+        copy->imageExtent.height = mip_dimension(image->extent.height, level);
+        copy->imageExtent.depth = 1;
+    }
+
     vkCmdCopyBufferToImage(cmd_buf, region->buffer->handle, image->handle,
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copies.count, copies.data);
 
     VkImageMemoryBarrier post_mem_barrier = {};
     post_mem_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -856,7 +1369,7 @@ static void write_to_image(Vulkan *vk, VkCommandBuffer cmd_buf, Region *region,
     post_mem_barrier.image = image->handle;
     post_mem_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     post_mem_barrier.subresourceRange.baseMipLevel = 0;
-    post_mem_barrier.subresourceRange.levelCount = 1;
+    post_mem_barrier.subresourceRange.levelCount = level_count;
     post_mem_barrier.subresourceRange.baseArrayLayer = 0;
     post_mem_barrier.subresourceRange.layerCount = 1;
     vkCmdPipelineBarrier(cmd_buf,
@@ -868,6 +1381,18 @@ static void write_to_image(Vulkan *vk, VkCommandBuffer cmd_buf, Region *region,
                          1, &post_mem_barrier); // Image Memory Barriers
 }
 
+static void write_to_image(Vulkan *vk, VkCommandBuffer cmd_buf, Region *region, u32 offset, Image *image) {
+    u32 mip_offset = 0;
+    write_mips_to_image(vk, cmd_buf, region, offset, &mip_offset, 1, image);
+}
+
+static void destroy_image(Vulkan *vk, Image *image) {
+    vkDestroyImageView(vk->device, image->view, NULL);
+    vkDestroyImage(vk->device, image->handle, NULL);
+    vkFreeMemory(vk->device, image->mem, NULL);
+    *image = {};
+}
+
 static VkSampler create_sampler(VkDevice device, VkSamplerCreateInfo info) {
     VkSampler sampler = VK_NULL_HANDLE;
     validate_result(vkCreateSampler(device, &info, NULL, &sampler), "failed to create sampler");
@@ -878,6 +1403,7 @@ static VkSampler create_sampler(VkDevice device, VkSamplerCreateInfo info) {
 /// Resource Creation
 ////////////////////////////////////////////////////////////
 static RenderPass *create_render_pass(Vulkan *vk, RenderPassInfo *info) {
+    PROFILE_FUNCTION();
     push_frame(vk->mem.temp);
 
     auto render_pass = allocate(vk->pool.render_pass);
@@ -929,25 +1455,47 @@ static RenderPass *create_render_pass(Vulkan *vk, RenderPassInfo *info) {
     return render_pass;
 }
 
-static Shader *create_shader(Vulkan *vk, cstr spirv_path, VkShaderStageFlagBits stage) {
-    push_frame(vk->mem.temp);
-
-    auto shader = allocate(vk->pool.shader);
-    shader->stage = stage;
+// Loads and reflects SPIR-V bytecode from spirv_path into a new shader module. Warns and returns false if the file is
+// missing or isn't valid SPIR-V, so callers reloading shaders at runtime can keep their current module.
+static bool load_shader_module(Vulkan *vk, cstr spirv_path, VkShaderModule *handle, ShaderReflection *reflection) {
+    // Mapped rather than read into vk->mem.temp so shaders can be loaded from multiple threads.
+    MappedFile bytecode = {};
+    if (!map_file(&bytecode, spirv_path)) {
+        warning("failed to load bytecode from \"%s\"", spirv_path);
+        return false;
+    }
 
-    Array<u8> *bytecode = read_file<u8>(vk->mem.temp, spirv_path);
-    if (bytecode == NULL)
-        CTK_FATAL("failed to load bytecode from \"%s\"", spirv_path);
+    cstr error = NULL;
+    if (bytecode.size % sizeof(u32) != 0 ||
+        !reflect_spirv(reflection, (u32 *)bytecode.data, (u32)(bytecode.size / sizeof(u32)), &error))
+    {
+        warning("failed to reflect SPIR-V bytecode in \"%s\": %s", spirv_path, error ? error : "invalid size");
+        unmap_file(&bytecode);
+        return false;
+    }
 
     VkShaderModuleCreateInfo info = {};
     info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     info.flags = 0;
-    info.codeSize = byte_size(bytecode);
-    info.pCode = (const u32 *)bytecode->data;
-    validate_result(vkCreateShaderModule(vk->device, &info, NULL, &shader->handle),
-                    "failed to create shader from SPIR-V bytecode in \"%p\"", spirv_path);
+    info.codeSize = bytecode.size;
+    info.pCode = (const u32 *)bytecode.data;
+    validate_result(vkCreateShaderModule(vk->device, &info, NULL, handle),
+                    "failed to create shader from SPIR-V bytecode in \"%s\"", spirv_path);
 
-    pop_frame(vk->mem.temp);
+    unmap_file(&bytecode);
+    return true;
+}
+
+static void init_shader(Vulkan *vk, Shader *shader, cstr spirv_path) {
+    if (!load_shader_module(vk, spirv_path, &shader->handle, &shader->reflection))
+        CTK_FATAL("failed to load shader \"%s\"", spirv_path);
+}
+
+static Shader *create_shader(Vulkan *vk, cstr spirv_path, VkShaderStageFlagBits stage) {
+    PROFILE_FUNCTION();
+    auto shader = allocate(vk->pool.shader);
+    shader->stage = stage;
+    init_shader(vk, shader, spirv_path);
     return shader;
 }
 
@@ -1063,47 +1611,165 @@ static VkDescriptorSet allocate_descriptor_set(Vulkan *vk, VkDescriptorPool pool
     return descriptor_set;
 };
 
-static void update_descriptor_set(Vulkan *vk, VkDescriptorSet descriptor_set,
-                                  u32 binding_count, DescriptorBinding *bindings)
+static void pack_descriptor_template_data(DescriptorBinding *binding, DescriptorTemplateData *data) {
+    // Zero padding too, so packed data can be hashed.
+    memset(data, 0, sizeof(DescriptorTemplateData));
+
+    if (binding->type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER ||
+        binding->type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC ||
+        binding->type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+    {
+        data->buffer.buffer = binding->uniform_buffer->buffer->handle;
+        data->buffer.offset = binding->uniform_buffer->offset;
+        data->buffer.range = binding->uniform_buffer->size;
+    }
+    else if (binding->type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER) {
+        data->image.sampler = binding->image_sampler->sampler;
+        data->image.imageView = binding->image_sampler->image->view;
+        data->image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+    else {
+        CTK_FATAL("unhandled descriptor type when updating descriptor set");
+    }
+}
+
+// Packs one descriptor per binding, for templates created from DescriptorInfos with a count of 1.
+static void pack_descriptor_template_data(DescriptorBinding *bindings, u32 binding_count,
+                                          DescriptorTemplateData *data)
 {
+    for (u32 i = 0; i < binding_count; ++i)
+        pack_descriptor_template_data(bindings + i, data + i);
+}
+
+// Writes every update with a single vkUpdateDescriptorSets() call.
+static void update_descriptor_sets(Vulkan *vk, DescriptorSetUpdate *updates, u32 update_count) {
+    PROFILE_FUNCTION();
     push_frame(vk->mem.temp);
 
-    auto buf_infos = create_array<VkDescriptorBufferInfo>(vk->mem.temp, binding_count);
-    auto img_infos = create_array<VkDescriptorImageInfo>(vk->mem.temp, binding_count);
-    auto writes = create_array<VkWriteDescriptorSet>(vk->mem.temp, binding_count);
-
-    for (u32 i = 0; i < binding_count; ++i) {
-        DescriptorBinding *binding = bindings + i;
-
-        VkWriteDescriptorSet *write = push(writes);
-        write->sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        write->dstSet = descriptor_set;
-        write->dstBinding = i;
-        write->dstArrayElement = 0;
-        write->descriptorCount = 1;
-        write->descriptorType = binding->type;
-
-        if (binding->type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER ||
-            binding->type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC ||
-            binding->type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
-        {
-            VkDescriptorBufferInfo *info = push(buf_infos);
-            info->buffer = binding->uniform_buffer->buffer->handle;
-            info->offset = binding->uniform_buffer->offset;
-            info->range = binding->uniform_buffer->size;
-
-            write->pBufferInfo = info;
+    u32 write_count = 0;
+    for (u32 i = 0; i < update_count; ++i)
+        write_count += updates[i].binding_count;
+
+    auto infos = create_array<DescriptorTemplateData>(vk->mem.temp, write_count);
+    auto writes = create_array<VkWriteDescriptorSet>(vk->mem.temp, write_count);
+
+    for (u32 update_idx = 0; update_idx < update_count; ++update_idx) {
+        DescriptorSetUpdate *update = updates + update_idx;
+        for (u32 i = 0; i < update->binding_count; ++i) {
+            DescriptorBinding *binding = update->bindings + i;
+            DescriptorTemplateData *info = push(infos);
+            pack_descriptor_template_data(binding, info);
+
+            VkWriteDescriptorSet *write = push(writes);
+            *write = {};
+            write->sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write->dstSet = update->set;
+            write->dstBinding = update->first_binding + i;
+            write->dstArrayElement = 0;
+            write->descriptorCount = 1;
+            write->descriptorType = binding->type;
+
+            if (binding->type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
+                write->pImageInfo = &info->image;
+            else
+                write->pBufferInfo = &info->buffer;
         }
-        else if (binding->type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER) {
-            VkDescriptorImageInfo *info = push(img_infos);
-            info->sampler = binding->image_sampler->sampler;
-            info->imageView = binding->image_sampler->image->view;
-            info->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
 
-            write->pImageInfo = info;
-        }
-        else {
-            CTK_FATAL("unhandled descriptor type when updating descriptor set");
+    vkUpdateDescriptorSets(vk->device, writes->count, writes->data, 0, NULL);
+
+    pop_frame(vk->mem.temp);
+}
+
+static void update_descriptor_set(Vulkan *vk, VkDescriptorSet descriptor_set,
+                                  u32 binding_count, DescriptorBinding *bindings, u32 first_binding = 0)
+{
+    DescriptorSetUpdate update = {
+        .set = descriptor_set,
+        .bindings = bindings,
+        .binding_count = binding_count,
+        .first_binding = first_binding,
+    };
+
+    update_descriptor_sets(vk, &update, 1);
+}
+
+// Creates a template writing every binding of a layout created from the same descriptor infos (binding i from
+// descriptor_infos[i]). Template data for a set is descriptor_count packed DescriptorTemplateData elements.
+static DescriptorUpdateTemplate create_descriptor_update_template(Vulkan *vk, VkDescriptorSetLayout layout,
+                                                                  DescriptorInfo *descriptor_infos, u32 count)
+{
+    push_frame(vk->mem.temp);
+
+    // Vulkan 1.0 keeps the entries to write sets from.
+    bool emulated = vk->instance.api_version < VK_API_VERSION_1_1;
+    DescriptorUpdateTemplate update_template = {};
+    auto entries = create_array<VkDescriptorUpdateTemplateEntry>(emulated ? vk->mem.module : vk->mem.temp, count);
+    for (u32 i = 0; i < count; ++i) {
+        DescriptorInfo *info = descriptor_infos + i;
+        push(entries, {
+            .dstBinding = i,
+            .dstArrayElement = 0,
+            .descriptorCount = info->count,
+            .descriptorType = info->type,
+            .offset = update_template.descriptor_count * sizeof(DescriptorTemplateData),
+            .stride = sizeof(DescriptorTemplateData),
+        });
+
+        update_template.descriptor_count += info->count;
+    }
+
+    if (emulated) {
+        update_template.entries = entries;
+        pop_frame(vk->mem.temp);
+        return update_template;
+    }
+
+    VkDescriptorUpdateTemplateCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+    info.descriptorUpdateEntryCount = entries->count;
+    info.pDescriptorUpdateEntries = entries->data;
+    info.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+    info.descriptorSetLayout = layout;
+    validate_result(vkCreateDescriptorUpdateTemplate(vk->device, &info, NULL, &update_template.handle),
+                    "failed to create descriptor update template");
+
+    pop_frame(vk->mem.temp);
+
+    return update_template;
+}
+
+// Writes what vkUpdateDescriptorSetWithTemplate() would for Vulkan 1.0 instances, one descriptor per write.
+static void write_descriptor_template_data(Vulkan *vk, VkDescriptorSet descriptor_set,
+                                           DescriptorUpdateTemplate *update_template, DescriptorTemplateData *data)
+{
+    push_frame(vk->mem.temp);
+
+    auto writes = create_array<VkWriteDescriptorSet>(vk->mem.temp, update_template->descriptor_count);
+    for (u32 entry_idx = 0; entry_idx < update_template->entries->count; ++entry_idx) {
+        VkDescriptorUpdateTemplateEntry *entry = update_template->entries->data + entry_idx;
+        for (u32 i = 0; i < entry->descriptorCount; ++i) {
+            auto descriptor = (DescriptorTemplateData *)((u8 *)data + entry->offset + i * entry->stride);
+            VkWriteDescriptorSet *write = push(writes);
+            *write = {};
+            write->sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write->dstSet = descriptor_set;
+            write->dstBinding = entry->dstBinding;
+            write->dstArrayElement = entry->dstArrayElement + i;
+            write->descriptorCount = 1;
+            write->descriptorType = entry->descriptorType;
+
+            if (entry->descriptorType == VK_DESCRIPTOR_TYPE_SAMPLER ||
+                entry->descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ||
+                entry->descriptorType == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE ||
+                entry->descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ||
+                entry->descriptorType == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT)
+            {
+                write->pImageInfo = &descriptor->image;
+            }
+            else {
+                write->pBufferInfo = &descriptor->buffer;
+            }
         }
     }
 
@@ -1112,6 +1778,31 @@ static void update_descriptor_set(Vulkan *vk, VkDescriptorSet descriptor_set,
     pop_frame(vk->mem.temp);
 }
 
+static void update_descriptor_set(Vulkan *vk, VkDescriptorSet descriptor_set, DescriptorUpdateTemplate *update_template,
+                                  DescriptorTemplateData *data)
+{
+    if (update_template->handle == VK_NULL_HANDLE)
+        write_descriptor_template_data(vk, descriptor_set, update_template, data);
+    else
+        vkUpdateDescriptorSetWithTemplate(vk->device, descriptor_set, update_template->handle, data);
+}
+
+// Updates set_count sets from consecutive blocks of update_template->descriptor_count elements of data; no temporary
+// write arrays are built, so this scales to thousands of sets per frame.
+static void update_descriptor_sets(Vulkan *vk, DescriptorUpdateTemplate *update_template, u32 set_count,
+                                   VkDescriptorSet *descriptor_sets, DescriptorTemplateData *data)
+{
+    PROFILE_FUNCTION();
+    for (u32 i = 0; i < set_count; ++i)
+        update_descriptor_set(vk, descriptor_sets[i], update_template, data + i * update_template->descriptor_count);
+}
+
+static void destroy_descriptor_update_template(Vulkan *vk, DescriptorUpdateTemplate *update_template) {
+    if (update_template->handle != VK_NULL_HANDLE)
+        vkDestroyDescriptorUpdateTemplate(vk->device, update_template->handle, NULL);
+    *update_template = {};
+}
+
 static constexpr PipelineInfo DEFAULT_PIPELINE_INFO = {
     .input_assembly = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
@@ -1189,24 +1880,177 @@ static constexpr VkPipelineColorBlendAttachmentState DEFAULT_COLOR_BLEND_ATTACHM
     .colorWriteMask = COLOR_COMPONENT_RGBA,
 };
 
-static Pipeline *create_pipeline(Vulkan *vk, RenderPass *render_pass, u32 subpass, PipelineInfo *info) {
-    push_frame(vk->mem.temp);
-    Pipeline *pipeline = allocate(vk->pool.pipeline);
+static SpecializationConstants *find_specialization_constants(PipelineInfo *info, VkShaderStageFlagBits stage) {
+    for (u32 i = 0; i < info->specialization_constants.count; ++i)
+        if (info->specialization_constants.data[i].stage == stage)
+            return info->specialization_constants.data + i;
 
-    // Shader Stages
-    auto shader_stages = create_array<VkPipelineShaderStageCreateInfo>(vk->mem.temp, info->shaders.count);
+    return NULL;
+}
 
-    for (u32 i = 0; i < info->shaders.count; ++i) {
-        Shader *shader = info->shaders.data[i];
-        VkPipelineShaderStageCreateInfo *shader_stage_info = push(shader_stages);
-        shader_stage_info->sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        shader_stage_info->flags = 0;
-        shader_stage_info->stage = shader->stage;
-        shader_stage_info->module = shader->handle;
-        shader_stage_info->pName = "main";
-        shader_stage_info->pSpecializationInfo = NULL;
+static void set_specialization_constant(PipelineInfo *info, VkShaderStageFlagBits stage, u32 constant_id, u32 value) {
+    SpecializationConstants *constants = find_specialization_constants(info, stage);
+    if (constants == NULL) {
+        constants = push(&info->specialization_constants);
+        *constants = {};
+        constants->stage = stage;
     }
 
+    // Overwrite value if constant was already set.
+    for (u32 i = 0; i < constants->entries.count; ++i) {
+        if (constants->entries.data[i].constantID == constant_id) {
+            constants->data.data[i] = value;
+            return;
+        }
+    }
+
+    if (constants->entries.count == MAX_SPECIALIZATION_CONSTANTS)
+        CTK_FATAL("exceeded max specialization constants (%u) for shader stage 0x%X", MAX_SPECIALIZATION_CONSTANTS,
+                  stage);
+
+    push(&constants->entries, {
+        .constantID = constant_id,
+        .offset = constants->data.count * (u32)sizeof(u32),
+        .size = sizeof(u32),
+    });
+    push(&constants->data, value);
+}
+
+static void set_specialization_constant(PipelineInfo *info, VkShaderStageFlagBits stage, u32 constant_id, s32 value) {
+    set_specialization_constant(info, stage, constant_id, (u32)value);
+}
+
+static void set_specialization_constant(PipelineInfo *info, VkShaderStageFlagBits stage, u32 constant_id, f32 value) {
+    u32 bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    set_specialization_constant(info, stage, constant_id, bits);
+}
+
+static void set_specialization_constant(PipelineInfo *info, VkShaderStageFlagBits stage, u32 constant_id, bool value) {
+    set_specialization_constant(info, stage, constant_id, (u32)(value ? VK_TRUE : VK_FALSE));
+}
+
+// Numeric type shader inputs must declare to consume attributes of format; UNKNOWN for formats that aren't checked.
+static SPIRVNumericType vertex_format_numeric_type(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_R8_UINT:
+        case VK_FORMAT_R8G8_UINT:
+        case VK_FORMAT_R8G8B8_UINT:
+        case VK_FORMAT_B8G8R8_UINT:
+        case VK_FORMAT_R8G8B8A8_UINT:
+        case VK_FORMAT_B8G8R8A8_UINT:
+        case VK_FORMAT_A8B8G8R8_UINT_PACK32:
+        case VK_FORMAT_A2R10G10B10_UINT_PACK32:
+        case VK_FORMAT_A2B10G10R10_UINT_PACK32:
+        case VK_FORMAT_R16_UINT:
+        case VK_FORMAT_R16G16_UINT:
+        case VK_FORMAT_R16G16B16_UINT:
+        case VK_FORMAT_R16G16B16A16_UINT:
+        case VK_FORMAT_R32_UINT:
+        case VK_FORMAT_R32G32_UINT:
+        case VK_FORMAT_R32G32B32_UINT:
+        case VK_FORMAT_R32G32B32A32_UINT:
+            return SPIRVNumericType::UINT;
+        case VK_FORMAT_R8_SINT:
+        case VK_FORMAT_R8G8_SINT:
+        case VK_FORMAT_R8G8B8_SINT:
+        case VK_FORMAT_B8G8R8_SINT:
+        case VK_FORMAT_R8G8B8A8_SINT:
+        case VK_FORMAT_B8G8R8A8_SINT:
+        case VK_FORMAT_A8B8G8R8_SINT_PACK32:
+        case VK_FORMAT_A2R10G10B10_SINT_PACK32:
+        case VK_FORMAT_A2B10G10R10_SINT_PACK32:
+        case VK_FORMAT_R16_SINT:
+        case VK_FORMAT_R16G16_SINT:
+        case VK_FORMAT_R16G16B16_SINT:
+        case VK_FORMAT_R16G16B16A16_SINT:
+        case VK_FORMAT_R32_SINT:
+        case VK_FORMAT_R32G32_SINT:
+        case VK_FORMAT_R32G32B32_SINT:
+        case VK_FORMAT_R32G32B32A32_SINT:
+            return SPIRVNumericType::SINT;
+        default:
+            break;
+    }
+
+    // Remaining 8/16/32-bit color formats (UNORM, SNORM, SCALED, SRGB, SFLOAT, UFLOAT) are all read as floats.
+    if (format >= VK_FORMAT_R4G4_UNORM_PACK8 && format <= VK_FORMAT_R32G32B32A32_SFLOAT)
+        return SPIRVNumericType::FLOAT;
+
+    if (format == VK_FORMAT_B10G11R11_UFLOAT_PACK32 || format == VK_FORMAT_E5B9G9R9_UFLOAT_PACK32)
+        return SPIRVNumericType::FLOAT;
+
+    return SPIRVNumericType::UNKNOWN;
+}
+
+// Checks info against its shaders' reflected interfaces, so mismatched vertex attributes, push constant ranges or
+// descriptor sets are caught at pipeline creation instead of as GPU faults. Warns about the first mismatch found.
+static bool check_pipeline_shaders(PipelineInfo *info) {
+    for (u32 shader_idx = 0; shader_idx < info->shaders.count; ++shader_idx) {
+        Shader *shader = info->shaders.data[shader_idx];
+        ShaderReflection *reflection = &shader->reflection;
+
+        // Vertex Inputs
+        for (u32 i = 0; shader->stage == VK_SHADER_STAGE_VERTEX_BIT && i < reflection->inputs.count; ++i) {
+            ReflectedInput *input = reflection->inputs.data + i;
+            VkVertexInputAttributeDescription *attribute = NULL;
+            for (u32 j = 0; info->vertex_attributes && j < info->vertex_attributes->count; ++j)
+                if (info->vertex_attributes->data[j].location == input->location)
+                    attribute = info->vertex_attributes->data + j;
+
+            if (attribute == NULL) {
+                warning("vertex shader input at location %u has no matching vertex attribute", input->location);
+                return false;
+            }
+
+            SPIRVNumericType format_numeric_type = vertex_format_numeric_type(attribute->format);
+            if (format_numeric_type != SPIRVNumericType::UNKNOWN && format_numeric_type != input->numeric_type) {
+                warning("vertex shader input at location %u is %s but attribute format %u is read as %s",
+                        input->location, spirv_numeric_type_name(input->numeric_type), attribute->format,
+                        spirv_numeric_type_name(format_numeric_type));
+                return false;
+            }
+        }
+
+        // Push Constants
+        if (reflection->push_constant_size > 0) {
+            u32 start = reflection->push_constant_offset;
+            u32 end = start + reflection->push_constant_size;
+            bool covered = false;
+            for (u32 i = 0; info->push_constant_ranges && i < info->push_constant_ranges->count; ++i) {
+                VkPushConstantRange *range = info->push_constant_ranges->data + i;
+                if ((range->stageFlags & shader->stage) && range->offset <= start && range->offset + range->size >= end)
+                    covered = true;
+            }
+
+            if (!covered) {
+                warning("push constant block [%u, %u) of shader stage 0x%X is not covered by a push constant range",
+                        start, end, shader->stage);
+                return false;
+            }
+        }
+
+        // Descriptor Sets
+        u32 set_count = info->descriptor_set_layouts ? info->descriptor_set_layouts->count : 0;
+        for (u32 i = 0; i < reflection->bindings.count; ++i) {
+            ReflectedBinding *binding = reflection->bindings.data + i;
+            if (binding->set >= set_count) {
+                warning("shader stage 0x%X uses descriptor set %u binding %u but pipeline only has %u set layouts",
+                        shader->stage, binding->set, binding->binding, set_count);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static void validate_pipeline_shaders(PipelineInfo *info) {
+    if (!check_pipeline_shaders(info))
+        CTK_FATAL("pipeline info doesn't match its shaders' interfaces");
+}
+
+static VkPipelineLayout create_pipeline_layout(Vulkan *vk, PipelineInfo *info) {
     VkPipelineLayoutCreateInfo layout_ci = {};
     layout_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     if (info->descriptor_set_layouts) {
@@ -1217,9 +2061,44 @@ static Pipeline *create_pipeline(Vulkan *vk, RenderPass *render_pass, u32 subpas
         layout_ci.pushConstantRangeCount = info->push_constant_ranges->count;
         layout_ci.pPushConstantRanges = info->push_constant_ranges->data;
     }
-    validate_result(vkCreatePipelineLayout(vk->device, &layout_ci, NULL, &pipeline->layout),
+
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    validate_result(vkCreatePipelineLayout(vk->device, &layout_ci, NULL, &layout),
                     "failed to create graphics pipeline layout");
 
+    return layout;
+}
+
+// Creates pipeline->handle using pipeline->layout. Doesn't touch vk->mem or vk->pool, so pipelines can be initialized
+// from multiple threads.
+static void init_pipeline_handle(Vulkan *vk, Pipeline *pipeline, RenderPass *render_pass, u32 subpass,
+                                 PipelineInfo *info)
+{
+    // Shader Stages
+    FixedArray<VkPipelineShaderStageCreateInfo, 8> shader_stages = {};
+    FixedArray<VkSpecializationInfo, 8> specialization_infos = {};
+
+    for (u32 i = 0; i < info->shaders.count; ++i) {
+        Shader *shader = info->shaders.data[i];
+        VkPipelineShaderStageCreateInfo *shader_stage_info = push(&shader_stages);
+        shader_stage_info->sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shader_stage_info->flags = 0;
+        shader_stage_info->stage = shader->stage;
+        shader_stage_info->module = shader->handle;
+        shader_stage_info->pName = "main";
+        shader_stage_info->pSpecializationInfo = NULL;
+
+        SpecializationConstants *constants = find_specialization_constants(info, shader->stage);
+        if (constants != NULL && constants->entries.count > 0) {
+            shader_stage_info->pSpecializationInfo = push(&specialization_infos, {
+                .mapEntryCount = constants->entries.count,
+                .pMapEntries = constants->entries.data,
+                .dataSize = constants->data.count * sizeof(u32),
+                .pData = constants->data.data,
+            });
+        }
+    }
+
     // Vertex Attribute Descriptions
     // auto vertex_attrib_descs =
     //     create_array<VkVertexInputAttributeDescription>(vk->mem.temp, info->vertex_inputs->count);
@@ -1298,8 +2177,8 @@ static Pipeline *create_pipeline(Vulkan *vk, RenderPass *render_pass, u32 subpas
 
     VkGraphicsPipelineCreateInfo create_info = {};
     create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    create_info.stageCount = shader_stages->count;
-    create_info.pStages = shader_stages->data;
+    create_info.stageCount = shader_stages.count;
+    create_info.pStages = shader_stages.data;
     create_info.pVertexInputState = &vertex_input;
     create_info.pInputAssemblyState = &info->input_assembly;
     create_info.pTessellationState = NULL;
@@ -1314,15 +2193,86 @@ static Pipeline *create_pipeline(Vulkan *vk, RenderPass *render_pass, u32 subpas
     create_info.subpass = subpass;
     create_info.basePipelineHandle = VK_NULL_HANDLE;
     create_info.basePipelineIndex = -1;
-    validate_result(vkCreateGraphicsPipelines(vk->device, VK_NULL_HANDLE, 1, &create_info, NULL, &pipeline->handle),
+    validate_result(vkCreateGraphicsPipelines(vk->device, vk->pipeline_cache.handle, 1, &create_info, NULL,
+                                              &pipeline->handle),
                     "failed to create graphics pipeline");
+}
 
-    // Cleanup
-    pop_frame(vk->mem.temp);
+static void init_pipeline(Vulkan *vk, Pipeline *pipeline, RenderPass *render_pass, u32 subpass, PipelineInfo *info) {
+    validate_pipeline_shaders(info);
+    pipeline->layout = create_pipeline_layout(vk, info);
+    init_pipeline_handle(vk, pipeline, render_pass, subpass, info);
+}
 
+static Pipeline *create_pipeline(Vulkan *vk, RenderPass *render_pass, u32 subpass, PipelineInfo *info) {
+    PROFILE_FUNCTION();
+    Pipeline *pipeline = allocate(vk->pool.pipeline);
+    init_pipeline(vk, pipeline, render_pass, subpass, info);
     return pipeline;
 }
 
+static void run_shader_batch_thread(ShaderBatchState *state, u32 thread_idx) {
+    PROFILE_FUNCTION();
+    for (u32 idx = state->next_idx.fetch_add(1); idx < state->count; idx = state->next_idx.fetch_add(1))
+        init_shader(state->vk, state->shaders[idx], state->infos[idx].spirv_path);
+}
+
+static void run_pipeline_batch_thread(PipelineBatchState *state, u32 thread_idx) {
+    PROFILE_FUNCTION();
+    for (u32 idx = state->next_idx.fetch_add(1); idx < state->count; idx = state->next_idx.fetch_add(1)) {
+        PipelineBatchInfo *batch_info = state->infos + idx;
+        init_pipeline(state->vk, state->pipelines[idx], batch_info->render_pass, batch_info->subpass, batch_info->info);
+    }
+}
+
+// Reads SPIR-V files and creates shader modules on thread_count threads; shaders[i] is created from infos[i].
+static void create_shader_batch(Vulkan *vk, ShaderInfo *infos, u32 count, Shader **shaders, u32 thread_count,
+                                Allocator *temp)
+{
+    PROFILE_FUNCTION();
+    push_frame(temp);
+
+    for (u32 i = 0; i < count; ++i) {
+        shaders[i] = allocate(vk->pool.shader);
+        shaders[i]->stage = infos[i].stage;
+    }
+
+    auto state = allocate<ShaderBatchState>(temp, 1);
+    new (state) ShaderBatchState {};
+    state->vk = vk;
+    state->infos = infos;
+    state->shaders = shaders;
+    state->count = count;
+
+    run_parallel(state, run_shader_batch_thread, thread_count > 0 ? thread_count : 1, temp);
+    state->~ShaderBatchState();
+
+    pop_frame(temp);
+}
+
+// Creates pipelines on thread_count threads through the shared pipeline cache; pipelines[i] is created from infos[i].
+static void create_pipeline_batch(Vulkan *vk, PipelineBatchInfo *infos, u32 count, Pipeline **pipelines,
+                                  u32 thread_count, Allocator *temp)
+{
+    PROFILE_FUNCTION();
+    push_frame(temp);
+
+    for (u32 i = 0; i < count; ++i)
+        pipelines[i] = allocate(vk->pool.pipeline);
+
+    auto state = allocate<PipelineBatchState>(temp, 1);
+    new (state) PipelineBatchState {};
+    state->vk = vk;
+    state->infos = infos;
+    state->pipelines = pipelines;
+    state->count = count;
+
+    run_parallel(state, run_pipeline_batch_thread, thread_count > 0 ? thread_count : 1, temp);
+    state->~PipelineBatchState();
+
+    pop_frame(temp);
+}
+
 static VkFramebuffer create_framebuffer(VkDevice device, VkRenderPass rp, FramebufferInfo *info) {
     VkFramebufferCreateInfo create_info = {};
     create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
@@ -1383,6 +2333,7 @@ static void begin_temp_cmd_buf(VkCommandBuffer cmd_buf) {
 }
 
 static void submit_temp_cmd_buf(VkCommandBuffer cmd_buf, VkQueue queue) {
+    PROFILE_FUNCTION();
     vkEndCommandBuffer(cmd_buf);
     VkSubmitInfo submit_info = {};
     submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -1395,11 +2346,258 @@ static void submit_temp_cmd_buf(VkCommandBuffer cmd_buf, VkQueue queue) {
 ////////////////////////////////////////////////////////////
 /// Rendering
 ////////////////////////////////////////////////////////////
+// Not valid for headless swapchains; they have no presentation engine to acquire images from.
 static u32 next_swap_img_idx(Vulkan *vk, VkSemaphore semaphore, VkFence fence) {
+    PROFILE_FUNCTION();
+    CTK_ASSERT(!vk->headless);
     u32 img_idx = U32_MAX;
 
+    u64 wait_start = get_time_ns();
     validate_result(vkAcquireNextImageKHR(vk->device, vk->swapchain.handle, U64_MAX, semaphore, fence, &img_idx),
                     "failed to aquire next swapchain image");
+    count_render_stat(RenderCounter::ACQUIRE_WAIT_NS, get_time_ns() - wait_start);
 
     return img_idx;
 }
+
+////////////////////////////////////////////////////////////
+/// GPU Queries
+////////////////////////////////////////////////////////////
+static u32 gpu_timestamp_query(GPUQueries *queries, GPUQueryFrame *frame, u32 scope_idx) {
+    return ((u32)(frame - queries->frames) * queries->info.max_scopes + scope_idx) * 2;
+}
+
+static u32 gpu_statistics_query(GPUQueries *queries, GPUQueryFrame *frame, u32 scope_idx) {
+    return (u32)(frame - queries->frames) * queries->info.max_scopes + scope_idx;
+}
+
+static u64 gpu_ticks_to_ns(GPUQueries *queries, u64 ticks) {
+    f64 elapsed_ns = (f64)(s64)(ticks - queries->calibration_ticks) * queries->timestamp_period;
+    return queries->calibration_ns + (s64)elapsed_ns;
+}
+
+// Brackets a timestamp written by an otherwise idle queue with CPU times; the midpoint is accurate to within the
+// submit round trip, which is plenty for lining GPU scopes up with CPU zones in a trace.
+static void calibrate_gpu_queries(Vulkan *vk, GPUQueries *queries) {
+    VkCommandPool cmd_pool = create_cmd_pool(vk);
+    VkCommandBuffer cmd_buf = VK_NULL_HANDLE;
+    VkCommandBufferAllocateInfo cmd_buf_info = {};
+    cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmd_buf_info.commandPool = cmd_pool;
+    cmd_buf_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmd_buf_info.commandBufferCount = 1;
+    allocate_cmd_bufs(vk, &cmd_buf, cmd_buf_info);
+
+    // Calibration query follows every frame's queries.
+    u32 query = (queries->info.frame_latency + 1) * queries->info.max_scopes * 2;
+    begin_temp_cmd_buf(cmd_buf);
+    vkCmdResetQueryPool(cmd_buf, queries->timestamp_pool, query, 1);
+    vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queries->timestamp_pool, query);
+    u64 submit_ns = get_time_ns();
+    submit_temp_cmd_buf(cmd_buf, vk->queue.graphics);
+    u64 complete_ns = get_time_ns();
+
+    validate_result(vkGetQueryPoolResults(vk->device, queries->timestamp_pool, query, 1, sizeof(u64),
+                                          &queries->calibration_ticks, sizeof(u64),
+                                          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT),
+                    "failed to read calibration timestamp");
+    queries->calibration_ns = submit_ns + (complete_ns - submit_ns) / 2;
+
+    vkDestroyCommandPool(vk->device, cmd_pool, NULL);
+}
+
+// Reads a frame's results without waiting; they are only dropped if the frame somehow hasn't completed yet.
+static void resolve_gpu_query_frame(Vulkan *vk, GPUQueries *queries, GPUQueryFrame *frame) {
+    if (frame->resolved || frame->scope_count == 0)
+        return;
+
+    VkResult result = vkGetQueryPoolResults(vk->device, queries->timestamp_pool,
+                                            gpu_timestamp_query(queries, frame, 0), frame->scope_count * 2,
+                                            frame->scope_count * 2 * sizeof(u64), queries->query_results, sizeof(u64),
+                                            VK_QUERY_RESULT_64_BIT);
+    if (result == VK_NOT_READY) {
+        ++queries->dropped_frame_count;
+        return;
+    }
+
+    validate_result(result, "failed to read GPU timestamp queries");
+
+    for (u32 i = 0; i < frame->scope_count; ++i) {
+        GPUScope *scope = frame->scopes + i;
+        scope->start_ns = gpu_ticks_to_ns(queries, queries->query_results[i * 2]);
+        scope->end_ns = gpu_ticks_to_ns(queries, queries->query_results[i * 2 + 1]);
+        scope->ms = (queries->query_results[i * 2 + 1] - queries->query_results[i * 2]) * queries->timestamp_period
+                    / 1000000.0;
+
+        if (scope->pipeline_statistics) {
+            result = vkGetQueryPoolResults(vk->device, queries->statistics_pool,
+                                           gpu_statistics_query(queries, frame, i), 1, sizeof(GPUScopeStatistics),
+                                           &scope->statistics, sizeof(GPUScopeStatistics), VK_QUERY_RESULT_64_BIT);
+            if (result != VK_SUCCESS)
+                scope->statistics = {};
+        }
+
+        record_profiler_track_event(queries->profiler_track, scope->name, scope->start_ns, scope->end_ns);
+    }
+
+    frame->resolved = true;
+}
+
+static GPUQueries *create_gpu_queries(Allocator *allocator, Vulkan *vk, GPUQueriesInfo info) {
+    PROFILE_FUNCTION();
+    CTK_ASSERT(info.max_scopes > 0);
+
+    auto queries = allocate<GPUQueries>(allocator, 1);
+    *queries = {};
+    queries->info = info;
+    queries->statistics_scope = U32_MAX;
+    queries->profiler_track = U32_MAX;
+    if (!vk->physical_device.timestamps_supported) {
+        warning("timestamp queries not supported; GPU times won't be reported");
+        return queries;
+    }
+
+    u32 frame_count = info.frame_latency + 1;
+    queries->frames = allocate<GPUQueryFrame>(allocator, frame_count);
+    for (u32 i = 0; i < frame_count; ++i) {
+        queries->frames[i] = {};
+        queries->frames[i].scopes = allocate<GPUScope>(allocator, info.max_scopes);
+    }
+
+    queries->query_results = allocate<u64>(allocator, info.max_scopes * 2);
+    queries->timestamp_period = vk->physical_device.timestamp_period;
+
+    VkQueryPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    pool_info.queryCount = frame_count * info.max_scopes * 2 + 1;
+    validate_result(vkCreateQueryPool(vk->device, &pool_info, NULL, &queries->timestamp_pool),
+                    "failed to create timestamp query pool");
+
+    if (info.pipeline_statistics && vk->pipeline_statistics_enabled) {
+        pool_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        pool_info.queryCount = frame_count * info.max_scopes;
+        pool_info.pipelineStatistics = GPU_QUERY_PIPELINE_STATISTICS;
+        validate_result(vkCreateQueryPool(vk->device, &pool_info, NULL, &queries->statistics_pool),
+                        "failed to create pipeline statistics query pool");
+    }
+    else if (info.pipeline_statistics) {
+        warning("pipeline statistics queries not supported; only GPU times will be reported");
+    }
+
+    calibrate_gpu_queries(vk, queries);
+    queries->profiler_track = add_profiler_track("GPU");
+
+    return queries;
+}
+
+// Flags secondary command buffers must inherit to execute inside a pipeline statistics scope.
+static VkQueryPipelineStatisticFlags gpu_query_statistics_flags(GPUQueries *queries) {
+    return queries->statistics_pool != VK_NULL_HANDLE ? GPU_QUERY_PIPELINE_STATISTICS : 0;
+}
+
+// Scopes nest. Only one pipeline statistics scope can be open at a time, and like the rest of the scope it must begin
+// and end on the same side of a render pass boundary.
+static void begin_gpu_scope(GPUQueries *queries, VkCommandBuffer cmd_buf, cstr name,
+                            bool pipeline_statistics = false)
+{
+    GPUQueryFrame *frame = queries->recording;
+    if (frame == NULL)
+        return;
+
+    CTK_ASSERT(frame->scope_count < queries->info.max_scopes);
+    CTK_ASSERT(queries->open_scope_count < GPU_QUERY_MAX_SCOPE_DEPTH);
+
+    u32 scope_idx = frame->scope_count++;
+    GPUScope *scope = frame->scopes + scope_idx;
+    *scope = {};
+    scope->name = name;
+    scope->depth = queries->open_scope_count;
+    scope->pipeline_statistics = pipeline_statistics && queries->statistics_pool != VK_NULL_HANDLE;
+    queries->open_scopes[queries->open_scope_count++] = scope_idx;
+
+    vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queries->timestamp_pool,
+                        gpu_timestamp_query(queries, frame, scope_idx));
+
+    if (scope->pipeline_statistics) {
+        CTK_ASSERT(queries->statistics_scope == U32_MAX);
+        queries->statistics_scope = scope_idx;
+        vkCmdBeginQuery(cmd_buf, queries->statistics_pool, gpu_statistics_query(queries, frame, scope_idx), 0);
+    }
+}
+
+static void end_gpu_scope(GPUQueries *queries, VkCommandBuffer cmd_buf) {
+    GPUQueryFrame *frame = queries->recording;
+    if (frame == NULL)
+        return;
+
+    CTK_ASSERT(queries->open_scope_count > 0);
+    u32 scope_idx = queries->open_scopes[--queries->open_scope_count];
+    if (queries->statistics_scope == scope_idx) {
+        vkCmdEndQuery(cmd_buf, queries->statistics_pool, gpu_statistics_query(queries, frame, scope_idx));
+        queries->statistics_scope = U32_MAX;
+    }
+
+    vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queries->timestamp_pool,
+                        gpu_timestamp_query(queries, frame, scope_idx) + 1);
+}
+
+// Call outside a render pass at the start of a frame's command buffer, once the frame recorded frame_latency frames
+// ago is known to have completed (e.g. after waiting on its fence); that frame's results are read here.
+static void begin_gpu_query_frame(Vulkan *vk, GPUQueries *queries, VkCommandBuffer cmd_buf) {
+    if (queries->timestamp_pool == VK_NULL_HANDLE)
+        return;
+
+    CTK_ASSERT(queries->recording == NULL);
+    u32 ring_size = queries->info.frame_latency + 1;
+    u64 frame_index = queries->frame_count++;
+    if (frame_index >= queries->info.frame_latency)
+        resolve_gpu_query_frame(vk, queries, queries->frames + (frame_index - queries->info.frame_latency) % ring_size);
+
+    GPUQueryFrame *frame = queries->frames + frame_index % ring_size;
+    frame->frame_index = frame_index;
+    frame->scope_count = 0;
+    frame->resolved = false;
+
+    vkCmdResetQueryPool(cmd_buf, queries->timestamp_pool, gpu_timestamp_query(queries, frame, 0),
+                        queries->info.max_scopes * 2);
+    if (queries->statistics_pool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(cmd_buf, queries->statistics_pool, gpu_statistics_query(queries, frame, 0),
+                            queries->info.max_scopes);
+    }
+
+    queries->recording = frame;
+    begin_gpu_scope(queries, cmd_buf, "gpu frame");
+}
+
+static void end_gpu_query_frame(GPUQueries *queries, VkCommandBuffer cmd_buf) {
+    if (queries->recording == NULL)
+        return;
+
+    end_gpu_scope(queries, cmd_buf);
+    CTK_ASSERT(queries->open_scope_count == 0);
+    queries->recording = NULL;
+}
+
+// Reads every frame still waiting on results; call once the device is idle, e.g. before shutdown.
+static void flush_gpu_queries(Vulkan *vk, GPUQueries *queries) {
+    if (queries->timestamp_pool == VK_NULL_HANDLE)
+        return;
+
+    u32 ring_size = queries->info.frame_latency + 1;
+    u64 first_frame = queries->frame_count > queries->info.frame_latency
+                      ? queries->frame_count - queries->info.frame_latency
+                      : 0;
+    for (u64 frame_index = first_frame; frame_index < queries->frame_count; ++frame_index)
+        resolve_gpu_query_frame(vk, queries, queries->frames + frame_index % ring_size);
+}
+
+// Results for a frame stay available until its ring slot is reused, frame_latency + 1 frames after it was recorded.
+// Returns NULL if the frame's results haven't been read yet or are no longer held.
+static GPUQueryFrame *get_gpu_query_frame(GPUQueries *queries, u64 frame_index) {
+    if (queries->timestamp_pool == VK_NULL_HANDLE || frame_index >= queries->frame_count)
+        return NULL;
+
+    GPUQueryFrame *frame = queries->frames + frame_index % (queries->info.frame_latency + 1);
+    return frame->resolved && frame->frame_index == frame_index ? frame : NULL;
+}